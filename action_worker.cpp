@@ -0,0 +1,86 @@
+// this is action_worker.cpp
+
+#include "action_worker.h"
+
+#include <utility>
+
+ActionWorker::ActionWorker(Runner run) : run_(std::move(run)), thread_([this] { loop(); }) {
+}
+
+ActionWorker::~ActionWorker() {
+    stopping_.store(true, std::memory_order_release);
+    signal_.fetch_add(1, std::memory_order_release);
+    signal_.notify_one();
+    thread_.join();
+}
+
+void ActionWorker::post(const HotkeyAction action) noexcept {
+    posted_.fetch_add(1, std::memory_order_relaxed);
+    if (!queue_.push(action)) {
+        // 64 presses behind: nothing useful is lost, the newest is already queued.
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        handled_.fetch_add(1, std::memory_order_release);
+        handled_.notify_all();
+        return;
+    }
+    signal_.fetch_add(1, std::memory_order_release);
+    signal_.notify_one();
+}
+
+void ActionWorker::waitIdle() const {
+    for (;;) {
+        const std::uint64_t handled = handled_.load(std::memory_order_acquire);
+        if (handled >= posted_.load(std::memory_order_acquire)) return;
+        handled_.wait(handled, std::memory_order_acquire);
+    }
+}
+
+ActionWorker::Stats ActionWorker::stats() const noexcept {
+    return {posted_.load(std::memory_order_relaxed), runs_.load(std::memory_order_relaxed),
+            superseded_.load(std::memory_order_relaxed), coalesced_.load(std::memory_order_relaxed),
+            dropped_.load(std::memory_order_relaxed)};
+}
+
+void ActionWorker::loop() {
+    // What ran most recently, and how many posts were still pending when it
+    // finished: only those arrived during the run and may be its duplicates.
+    HotkeyAction last{};
+    std::uint64_t duringLast = 0;
+
+    for (;;) {
+        // Read the signal before looking at the queue, so a push landing in
+        // between changes it and the wait below returns at once.
+        const std::uint32_t seen = signal_.load(std::memory_order_acquire);
+
+        HotkeyAction next{};
+        std::uint64_t taken = 0;
+        while (const auto action = queue_.pop()) {
+            if (taken > 0) superseded_.fetch_add(1, std::memory_order_relaxed);
+            next = *action;
+            ++taken;
+        }
+
+        if (taken == 0) {
+            if (stopping_.load(std::memory_order_acquire)) return;
+            signal_.wait(seen, std::memory_order_acquire);
+            duringLast = 0; // idle in between: the next press is a new request
+            continue;
+        }
+
+        // A press posted after `last` finished is a new request even if the
+        // worker had not gone idle yet, so only coalesce when all of them
+        // were already pending at that point.
+        if (taken <= duringLast && next == last) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            duringLast -= taken;
+            handled_.fetch_add(taken, std::memory_order_release);
+        } else {
+            run_(next);
+            runs_.fetch_add(1, std::memory_order_relaxed);
+            last = next;
+            const std::uint64_t handled = handled_.fetch_add(taken, std::memory_order_acq_rel) + taken;
+            duringLast = posted_.load(std::memory_order_acquire) - handled;
+        }
+        handled_.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+// this is action_worker.h
+#pragma once
+
+#include "spsc_queue.h"
+#include "utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// ─── Hotkey Worker ─────────────────────────────────────────────────────
+
+/// Runs hotkey actions on a thread of its own, so the message loop only
+/// ever enqueues and goes straight back to GetMessage.
+///
+/// Presses are coalesced: the worker drains everything queued and runs only
+/// the newest action (older ones are stale). Presses of the same action
+/// that arrive while it is running are duplicates of that run and dropped;
+/// a different action arriving meanwhile runs next.
+class ActionWorker {
+public:
+    using Runner = std::function<void(HotkeyAction)>;
+
+    struct Stats {
+        std::uint64_t posted = 0;
+        std::uint64_t runs = 0;
+        std::uint64_t superseded = 0; // replaced by a newer press before running
+        std::uint64_t coalesced = 0;  // repeated the action that was running
+        std::uint64_t dropped = 0;    // queue full
+    };
+
+    /// Starts the worker; run is called for each action that survives coalescing.
+    explicit ActionWorker(Runner run = runHotkeyAction);
+    ~ActionWorker();
+    ActionWorker(const ActionWorker &) = delete;
+    ActionWorker &operator=(const ActionWorker &) = delete;
+
+    /// Called from the message thread only; never blocks.
+    void post(HotkeyAction action) noexcept;
+
+    /// Block until everything posted so far has been run or dropped.
+    void waitIdle() const;
+
+    Stats stats() const noexcept;
+
+private:
+    void loop();
+
+    Runner run_;
+    SpscQueue<HotkeyAction, 64> queue_;
+    std::atomic<std::uint32_t> signal_{0};   // bumped after every push, waited on when empty
+    std::atomic<std::uint64_t> handled_{0};  // posts fully dealt with
+    std::atomic<bool> stopping_{false};
+
+    std::atomic<std::uint64_t> posted_{0}, runs_{0}, superseded_{0}, coalesced_{0}, dropped_{0};
+    std::thread thread_;
+};
@@ -0,0 +1,68 @@
+// this is bench/alloc_count.cpp
+//
+// Global operator new and delete for the bench binary, forwarding to
+// malloc and counting calls so a case can check that a path doesn't
+// allocate. The array, nothrow and sized forms all come through these.
+
+#include "bench.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+    std::atomic<std::uint64_t> allocationCount{0};
+
+    /// alignment 0 for the plain forms, which delete frees with free().
+    void *allocate(const std::size_t size, const std::size_t alignment) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        const std::size_t bytes = size ? size : 1;
+#ifdef _WIN32
+        void *p = alignment == 0 ? std::malloc(bytes) : _aligned_malloc(bytes, alignment);
+#else
+        void *p = alignment == 0
+                      ? std::malloc(bytes)
+                      : std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+#endif
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+}
+
+namespace bench {
+    std::uint64_t allocations() noexcept {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+}
+
+void *operator new(const std::size_t size) {
+    return allocate(size, 0);
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, const std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
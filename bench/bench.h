@@ -0,0 +1,101 @@
+// this is bench/bench.h
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Case {
+        const char *name;
+        void (*run)();
+    };
+
+    /// All cases registered through BENCH_CASE, in link order.
+    std::vector<Case> &registry();
+
+    /// One number a run produced, kept for --json and compared by --baseline.
+    struct Result {
+        std::string name; // "<case>/<what>"
+        double value;
+        std::string unit;
+        bool lowerIsBetter;
+    };
+
+    /// Everything record() kept so far.
+    std::vector<Result> &results();
+
+    /// Keep a result under the running case's name.
+    void record(const std::string &name, double value, const char *unit, bool lowerIsBetter = true);
+
+    inline int add(const char *name, void (*run)()) {
+        registry().push_back({name, run});
+        return 0;
+    }
+
+    /// Best-of-N wall time in seconds; the best run is the least disturbed one.
+    template<typename F>
+    double bestOf(const int reps, F &&f) {
+        double best = 1e300;
+        for (int i = 0; i < reps; ++i) {
+            const auto start = Clock::now();
+            f();
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            if (elapsed.count() < best) best = elapsed.count();
+        }
+        return best;
+    }
+
+    /// Print one throughput line: name, units per second, and ns per unit (also recorded).
+    inline void report(const std::string &name, const std::size_t units, const double seconds) {
+        std::printf("%-48s %10.1f M chars/s %8.3f ns/char\n",
+                    name.c_str(), units / seconds / 1e6, seconds * 1e9 / units);
+        record(name, seconds * 1e9 / units, "ns/char");
+    }
+
+    /// Wall time of one call in seconds.
+    template<typename F>
+    double timeOnce(F &&f) {
+        const auto start = Clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        return elapsed.count();
+    }
+
+    /// Print p50/p99/p99.9/max of latency samples (seconds) in microseconds.
+    inline void reportLatency(const std::string &name, std::vector<double> samples) {
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples](const double q) {
+            return samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))] * 1e6;
+        };
+        std::printf("%-40s p50 %9.2f µs  p99 %9.2f µs  p999 %9.2f µs  max %9.2f µs\n",
+                    name.c_str(), at(0.50), at(0.99), at(0.999), samples.back() * 1e6);
+        record(name + " p50", at(0.50), "us");
+        record(name + " p99", at(0.99), "us");
+    }
+
+    /// Keep the optimiser from discarding a result.
+    template<typename T>
+    void keep(T const &value) {
+        static const void *volatile sink;
+        sink = &value;
+        (void) sink;
+    }
+
+    /// Calls to operator new so far, from any thread; the bench binary
+    /// replaces the global allocation functions to count them.
+    std::uint64_t allocations() noexcept;
+
+    /// Abort the run with a message; used when a self-check fails.
+    [[noreturn]] void fail(const std::string &what);
+}
+
+#define BENCH_CASE(fn) static const int fn##_registered = bench::add(#fn, fn)
@@ -0,0 +1,80 @@
+// this is bench/bench_clipboard_session.cpp
+//
+// The user's clipboard holds a line of text plus a large non-text format
+// (think of a copied image). Each correction snapshots it before Ctrl+C
+// and restores it afterwards. Compares keeping every format in memory with
+// spilling large ones and restoring them through delayed rendering, and
+// checks the user's data comes back intact either way.
+
+#include "bench.h"
+#include "clipboard_session.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <climits>
+
+namespace {
+    constexpr UINT kImageFormat = 0xC0DE;
+    constexpr int kCorrections = 20;
+    constexpr int kSpillBytes = 64 * 1024;
+
+    void clipboard_session() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.AUTO_FLIP_ON_CHANGE = false;
+        settings.PASTE_THRESHOLD_CHARS = 0;
+        settings.CLIPBOARD_RESTORE = true;
+
+        const std::wstring document = L"akuo gcr ng tbh";
+        const std::wstring expected = fix(document, settings.KEYMAPS.table({0, 1}));
+
+        std::printf("%10s | %-36s | %-36s\n", "image", "all in memory", "spilled + delayed rendering");
+        for (const std::size_t imageBytes: {std::size_t{4} << 10, std::size_t{1} << 20, std::size_t{32} << 20}) {
+            std::string image(imageBytes, '\0');
+            for (std::size_t i = 0; i < imageBytes; ++i) image[i] = static_cast<char>(i * 31 + 7);
+
+            char columns[2][64];
+            for (const int spill: {0, 1}) {
+                settings.CLIPBOARD_SPILL_BYTES = spill ? kSpillBytes : INT_MAX;
+                config::publish(settings);
+
+                SimDesktop desktop;
+                desktop.setLang(getLangId(0));
+                platform::install(desktop.backend());
+                auto &clipboard = *desktop.backend().clipboard;
+
+                std::size_t resident = 0;
+                std::vector<double> samples;
+                for (int i = 0; i < kCorrections; ++i) {
+                    desktop.setClipboardText(L"user text");
+                    desktop.setClipboardFormat(kImageFormat, image);
+                    desktop.setText(document, 0, document.size());
+
+                    samples.push_back(bench::timeOnce([&] {
+                        ClipboardSession session(clipboard);
+                        resident = session.snapshot()->residentBytes();
+                        copySelection();
+                        correctCopiedText();
+                        session.restore();
+                    }));
+                    if (desktop.text() != expected) bench::fail("correction text mismatch");
+                }
+
+                // Restored formats must match, delayed or not.
+                const auto renders = desktop.delayedRenders();
+                if (desktop.clipboardText() != L"user text") bench::fail("clipboard text not restored");
+                if (desktop.clipboardFormat(kImageFormat) != image) bench::fail("image format not restored");
+                const bool delayed = spill && imageBytes > static_cast<std::size_t>(kSpillBytes);
+                if (desktop.delayedRenders() != renders + (delayed ? 1 : 0)) bench::fail("image was not rendered on demand");
+
+                std::sort(samples.begin(), samples.end());
+                std::snprintf(columns[spill], sizeof(columns[spill]), "%8.2f ms, %10zu B resident",
+                              samples[samples.size() / 2] * 1e3, resident);
+            }
+            std::printf("%8zuKB | %-36s | %-36s\n", imageBytes >> 10, columns[0], columns[1]);
+        }
+    }
+}
+
+BENCH_CASE(clipboard_session);
@@ -0,0 +1,54 @@
+// this is bench/bench_clipboard_wait.cpp
+//
+// Wake-up latency and wakeup count of the polling and notification-based
+// clipboard waiters. The simulated target applies Ctrl+C on its own thread
+// a couple of milliseconds after it is sent, like a real app would.
+
+#include "bench.h"
+#include "platform_sim.h"
+
+namespace {
+    constexpr int kIterations = 300;
+    constexpr auto kCopyLatency = std::chrono::microseconds(2000);
+    constexpr auto kTimeout = std::chrono::milliseconds(200);
+
+    void measure(const char *label, SimDesktop &desktop, platform::ClipboardWaiter &waiter) {
+        auto &clipboard = *desktop.backend().clipboard;
+        auto &input = *desktop.backend().input;
+
+        std::vector<double> wake;
+        wake.reserve(kIterations);
+        const std::uint64_t wakeupsBefore = waiter.wakeups();
+
+        for (int i = 0; i < kIterations; ++i) {
+            desktop.setText(L"akuo gcr", 0, 4 + i % 4);
+            const DWORD before = clipboard.sequenceNumber();
+            input.sendCopy();
+            if (waiter.waitForChange(before, kTimeout) == before) bench::fail(std::string(label) + ": timed out");
+
+            const std::chrono::duration<double> late = bench::Clock::now() - desktop.lastClipboardChange();
+            wake.push_back(late.count());
+        }
+
+        bench::reportLatency(std::string(label) + " wake-up after change", std::move(wake));
+        std::printf("%-40s %.2f wakeups per wait\n", (std::string(label) + " wakeups").c_str(),
+                    static_cast<double>(waiter.wakeups() - wakeupsBefore) / kIterations);
+    }
+
+    void clipboard_wait() {
+        SimDesktop desktop;
+        desktop.setCopyLatency(kCopyLatency);
+        auto &clipboard = *desktop.backend().clipboard;
+
+        const auto polling = platform::makePollingWaiter(clipboard, std::chrono::milliseconds(5));
+        measure("poll 5 ms", desktop, *polling);
+
+        const auto polling1 = platform::makePollingWaiter(clipboard, std::chrono::milliseconds(1));
+        measure("poll 1 ms", desktop, *polling1);
+
+        const auto notified = clipboard.createChangeWaiter();
+        measure("event", desktop, *notified);
+    }
+}
+
+BENCH_CASE(clipboard_wait);
@@ -0,0 +1,157 @@
+// this is bench/bench_config_reload.cpp
+//
+// Hot reload under load. One thread publishes new settings back to back,
+// alternating two layout pairs that convert the same text differently
+// (en-he pasted, en-ru typed), while corrections run nonstop against the
+// simulated desktop. Each correction must come out entirely in one pair,
+// and its layout flip must land on that same pair's secondary language;
+// anything else means a half-updated config was seen. Then checks that
+// ConfigWatcher picks up edits to a real file, and what a read costs.
+
+#include "bench.h"
+#include "config.h"
+#include "config_watcher.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+    constexpr int kCorrections = 2000;
+    constexpr auto kCopyLatency = std::chrono::microseconds(200); // corrections sleep mid-way, reloads land inside
+    constexpr int kReads = 1000000;
+    constexpr int kFileEdits = 6;
+
+    config::Settings pairSettings(const char *preset, const int pasteThreshold) {
+        config::Settings settings;
+        settings.applyLayoutPreset(preset);
+        settings.DEBUG_MODE = false;
+        settings.DIRECTION_MODE = config::DirectionMode::Layout;
+        settings.PASTE_THRESHOLD_CHARS = pasteThreshold;
+        settings.PASTE_RESTORE_DELAY_MS = 0;
+        settings.AUTO_FLIP_ON_CHANGE = true;
+        return settings;
+    }
+
+    void readCost() {
+        config::publish(pairSettings("en-he", 0));
+        bool debug = false;
+        const double outer = bench::bestOf(3, [&] {
+            for (int i = 0; i < kReads; ++i) debug ^= config::current()->DEBUG_MODE;
+        });
+        const auto pinned = config::current();
+        const double nested = bench::bestOf(3, [&] {
+            for (int i = 0; i < kReads; ++i) debug ^= config::current()->DEBUG_MODE;
+        });
+        bench::keep(debug);
+        std::printf("config::current(): %.1f ns, nested in an action %.1f ns\n",
+                    outer * 1e9 / kReads, nested * 1e9 / kReads);
+    }
+
+    void hammer() {
+        const config::Settings hebrew = pairSettings("en-he", 1);  // pasted
+        const config::Settings russian = pairSettings("en-ru", 0); // typed
+
+        const std::wstring source = L"akuo gcr ng tbh";
+        const std::wstring asHebrew = fix(source, hebrew.KEYMAPS.table({0, 1}));
+        const std::wstring asRussian = fix(source, russian.KEYMAPS.table({0, 1}));
+        const LANGID english = MAKELANGID(LANG_ENGLISH, SUBLANG_DEFAULT);
+        const LANGID hebrewLang = hebrew.LAYOUTS[1].langId();
+        const LANGID russianLang = russian.LAYOUTS[1].langId();
+
+        SimDesktop desktop;
+        desktop.setCopyLatency(kCopyLatency);
+        platform::install(desktop.backend());
+
+        std::atomic<bool> done{false};
+        std::atomic<std::uint64_t> publishes{0};
+        std::thread publisher([&] {
+            for (bool flip = false; !done.load(std::memory_order_relaxed); flip = !flip) {
+                config::publish(flip ? hebrew : russian);
+                publishes.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+        int sawHebrew = 0, sawRussian = 0, overlapped = 0;
+        std::vector<double> samples;
+        samples.reserve(kCorrections);
+        for (int i = 0; i < kCorrections; ++i) {
+            desktop.setText(source, source.size(), source.size());
+            desktop.setLang(english);
+            const std::uint64_t before = publishes.load();
+            samples.push_back(bench::timeOnce([] { copyAndFlip(platform::Selection::All); }));
+            overlapped += publishes.load() != before;
+
+            const std::wstring text = desktop.text();
+            if (text == asHebrew && desktop.lang() == hebrewLang) ++sawHebrew;
+            else if (text == asRussian && desktop.lang() == russianLang) ++sawRussian;
+            else {
+                done = true;
+                publisher.join();
+                bench::fail("a correction mixed two configs");
+            }
+        }
+        done = true;
+        publisher.join();
+
+        if (sawHebrew == 0 || sawRussian == 0 || overlapped == 0) bench::fail("reloads never overlapped corrections");
+        std::printf("%d corrections during %llu reloads (%d overlapped one): %d en-he, %d en-ru, none mixed\n",
+                    kCorrections, static_cast<unsigned long long>(publishes.load()), overlapped, sawHebrew, sawRussian);
+        bench::reportLatency("correction while reloading", samples);
+    }
+
+    void watchFile() {
+        const auto path = (std::filesystem::temp_directory_path() / "lf_bench_reload.json").string();
+        auto write = [&path](const std::string &json) {
+            // Save the way many editors do: a temp file renamed over the original.
+            const std::string temp = path + ".tmp";
+            std::ofstream(temp, std::ios::binary) << json;
+            std::filesystem::rename(temp, path);
+        };
+        auto configFor = [](const char *preset, const int pad) {
+            return std::string(R"({"DEBUG_MODE": false, "LAYOUT_PRESET": ")") + preset +
+                   R"(", "PASTE_THRESHOLD_CHARS": )" + std::to_string(pad) + "}";
+        };
+
+        write(configFor("en-he", 1));
+        config::load(path);
+
+        std::vector<double> samples;
+        ConfigWatcher watcher(path, std::chrono::milliseconds(10), [&path] { config::reload(path); });
+        for (int edit = 1; edit <= kFileEdits; ++edit) {
+            const char *preset = edit % 2 ? "en-ru" : "en-he";
+            const auto start = bench::Clock::now();
+            write(configFor(preset, edit * 111));
+            while (config::current()->LAYOUT_PRESET != preset) {
+                if (bench::Clock::now() - start > std::chrono::seconds(2)) bench::fail("config edit not picked up");
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            samples.push_back(std::chrono::duration<double>(bench::Clock::now() - start).count());
+        }
+
+        // A file saved half-written must not replace a working config.
+        const std::string before = config::current()->LAYOUT_PRESET;
+        const std::uint64_t changes = watcher.changes();
+        write("{ \"LAYOUT_PRESET\": ");
+        const auto start = bench::Clock::now();
+        while (watcher.changes() == changes && bench::Clock::now() - start < std::chrono::seconds(2)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (watcher.changes() == changes) bench::fail("broken config edit not noticed");
+        if (config::current()->LAYOUT_PRESET != before) bench::fail("broken config replaced the working one");
+
+        bench::reportLatency("file edit → new config published", samples);
+        std::filesystem::remove(path);
+    }
+
+    void config_reload() {
+        readCost();
+        hammer();
+        watchFile();
+    }
+}
+
+BENCH_CASE(config_reload);
@@ -0,0 +1,161 @@
+// this is bench/bench_core.cpp
+//
+// The core text paths on generated corpora of every shape a correction
+// sees: single short words, sentences, whole documents and runs of mixed
+// scripts, in both directions. Reports ns/char and allocations per call of
+// fix(), transformText(), utf8_to_wstring() and the direction scorer, and
+// the cost of inverting and compiling a keymap. Every number is recorded,
+// so `--json` / `--baseline` can diff them between commits.
+
+#include "bench.h"
+#include "config.h"
+#include "ngram.h"
+#include "utf8.h"
+#include "utils.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+
+namespace {
+    constexpr int kReps = 15;
+
+    const wchar_t *const kEnglish[] = {
+        L"the", L"meeting", L"is", L"moved", L"to", L"tomorrow", L"please", L"send", L"report",
+        L"before", L"lunch", L"thanks", L"and", L"have", L"good", L"day", L"a", L"quarterly",
+    };
+    const wchar_t *const kHebrew[] = {
+        L"שלום", L"תודה", L"מחר", L"בבוקר", L"הפגישה", L"עם", L"כל", L"הצוות", L"אני",
+        L"שולח", L"את", L"הדוח", L"לפני", L"הצהריים", L"יום", L"טוב", L"ו", L"הרבעוני",
+    };
+
+    /// The inputs of one shape, and their length in characters.
+    struct Corpus {
+        std::string shape;
+        std::vector<std::wstring> inputs;
+        std::size_t chars = 0;
+    };
+
+    /// Words of one language typed on the other layout, cut into inputs of
+    /// the given shape; mixed alternates runs of three words in the right
+    /// and the wrong layout.
+    Corpus makeCorpus(const std::string &shape, const std::vector<std::wstring> &wrong,
+                      const std::vector<std::wstring> &right, const bool mixed) {
+        std::mt19937 rng(7);
+        auto word = [&](const std::size_t w) -> const std::wstring & {
+            const auto &words = mixed && (w / 3) % 2 == 1 ? right : wrong;
+            return words[std::uniform_int_distribution<std::size_t>(0, words.size() - 1)(rng)];
+        };
+
+        Corpus corpus{shape, {}, 0};
+        const std::size_t total = shape == "words" ? 200000 : 1 << 20; // characters
+        while (corpus.chars < total) {
+            std::wstring text;
+            if (shape == "words") {
+                text = word(0);
+            } else if (shape == "sentences") {
+                for (std::size_t w = 0; w < 10; ++w) text += (w ? L" " : L"") + word(w);
+                text += L'.';
+            } else {
+                for (std::size_t w = 0; text.size() < 64 * 1024; ++w) text += word(w) + (w % 12 == 11 ? L".\n" : L" ");
+            }
+            corpus.chars += text.size();
+            corpus.inputs.push_back(std::move(text));
+        }
+        return corpus;
+    }
+
+    /// Time f over every input, best of kReps, and count its allocations.
+    template<typename Input, typename F>
+    void measure(const std::string &name, const std::vector<Input> &inputs, const std::size_t chars, F &&f) {
+        for (const auto &in: inputs) f(in); // warm up, and let buffers reach their size
+        const std::uint64_t before = bench::allocations();
+        for (const auto &in: inputs) f(in);
+        const double allocations = static_cast<double>(bench::allocations() - before) / inputs.size();
+        const double seconds = bench::bestOf(kReps, [&] {
+            for (const auto &in: inputs) f(in);
+        });
+        std::printf("%-40s %9.2f ns/char %9.2f allocs/call\n", name.c_str(), seconds * 1e9 / chars, allocations);
+        bench::record(name, seconds * 1e9 / chars, "ns/char");
+        bench::record(name + " allocations", allocations, "allocs/call");
+    }
+
+    void core_paths() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        config::publish(settings);
+
+        const auto cfg = config::current();
+        constexpr Direction toHebrew{0, 1}, toEnglish{1, 0};
+        const KeymapTable &hebrewKeys = cfg->KEYMAPS.table(toHebrew), &englishKeys = cfg->KEYMAPS.table(toEnglish);
+
+        std::vector<std::wstring> english(std::begin(kEnglish), std::end(kEnglish));
+        std::vector<std::wstring> hebrew(std::begin(kHebrew), std::end(kHebrew));
+        std::vector<std::wstring> hebrewOnEnglishKeys, englishOnHebrewKeys;
+        for (const auto &w: hebrew) hebrewOnEnglishKeys.push_back(fix(w, englishKeys));
+        for (const auto &w: english) englishOnHebrewKeys.push_back(fix(w, hebrewKeys));
+
+        const char *const kShapes[] = {"words", "sentences", "documents"};
+        struct Way {
+            const char *name;
+            Direction direction;
+            const std::vector<std::wstring> &typed;
+        };
+        const Way ways[] = {{"en-he", toHebrew, hebrewOnEnglishKeys}, {"he-en", toEnglish, englishOnHebrewKeys}};
+
+        for (const Way &way: ways) {
+            const KeymapTable &table = cfg->KEYMAPS.table(way.direction);
+            for (const char *shape: kShapes) {
+                const Corpus corpus = makeCorpus(shape, way.typed, {}, false);
+                const std::string suffix = std::string("/") + shape + "/" + way.name;
+
+                measure("fix" + suffix, corpus.inputs, corpus.chars, [&](const std::wstring &in) {
+                    bench::keep(fix(in, table));
+                });
+                measure("transformText" + suffix, corpus.inputs, corpus.chars, [&](const std::wstring &in) {
+                    bench::keep(transformText(in, way.direction));
+                });
+
+                std::vector<std::string> utf8;
+                for (const auto &in: corpus.inputs) {
+                    utf8.emplace_back();
+                    encodeUtf8(in, utf8.back());
+                }
+                measure("utf8_to_wstring" + suffix, utf8, corpus.chars, [](const std::string &in) {
+                    bench::keep(config::utf8_to_wstring(in));
+                });
+            }
+        }
+
+        // Mixed scripts: the scorer picks the direction run by run, in place.
+        NgramModelFile englishModel = NgramModelFile::open(LF_MODEL_DIR "/english.lfng");
+        NgramModelFile hebrewModel = NgramModelFile::open(LF_MODEL_DIR "/hebrew.lfng");
+        if (!englishModel.model().valid() || !hebrewModel.model().valid()) bench::fail("models not found in " LF_MODEL_DIR);
+        const NgramModel *models[] = {&englishModel.model(), &hebrewModel.model()};
+        const DirectionScorer scorer(models, cfg->KEYMAPS);
+        std::wstring out;
+        for (const char *shape: kShapes) {
+            const Corpus corpus = makeCorpus(shape, hebrewOnEnglishKeys, english, true);
+            out.resize(64 * 1024 + 64);
+            measure(std::string("scorer/mixed-") + shape, corpus.inputs, corpus.chars, [&](const std::wstring &in) {
+                bench::keep(scorer.convert(in.data(), in.size(), out.data(), toHebrew));
+            });
+        }
+
+        // What the secondary-to-primary map and its table cost to build.
+        std::unordered_map<wchar_t, wchar_t> keys;
+        for (const auto &[from, to]: findLayoutPreset("en-he")->keys) keys[from] = to;
+        const double invert = bench::bestOf(200, [&] { bench::keep(invertKeymap(keys)); });
+        const double compile = bench::bestOf(200, [&] { bench::keep(KeymapTable::compile(keys)); });
+        std::printf("%-40s %9.2f µs/call\n%-40s %9.2f µs/call\n", "invertKeymap/en-he", invert * 1e6,
+                    "KeymapTable::compile/en-he", compile * 1e6);
+        bench::record("invertKeymap/en-he", invert * 1e6, "us");
+        bench::record("KeymapTable::compile/en-he", compile * 1e6, "us");
+    }
+}
+
+BENCH_CASE(core_paths);
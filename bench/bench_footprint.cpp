@@ -0,0 +1,130 @@
+// this is bench/bench_footprint.cpp
+//
+// The resident process under LOW_FOOTPRINT. Checks that a config read in
+// that mode keeps no key maps beside its tables, that a long correction
+// leaves its buffers behind without the mode and hands them back with it,
+// and that committed memory stays flat over many corrections of mixed
+// length once settled. Reports private, shared and committed memory after
+// a settled correction, and what settling costs.
+
+#include "bench.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "process_memory.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kLongChars = 1 << 18;
+    constexpr int kWarmup = 50;
+    constexpr int kCorrections = 400;
+    /// Committed memory may wander this much over kCorrections once warm.
+    constexpr std::size_t kFlatSlack = 256 << 10;
+
+    std::wstring makeDocument(const std::size_t chars) {
+        std::wstring text;
+        while (text.size() < chars) text += L"akuo gcr ng tbh kt ahk nv ahnt cuex kngv\n";
+        text.resize(chars);
+        return text;
+    }
+
+    config::Settings settingsFor(const bool lowFootprint) {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.applyLayoutPreset("en-he");
+        settings.DIRECTION_MODE = config::DirectionMode::Layout;
+        settings.PASTE_THRESHOLD_CHARS = 0; // typed, through the worker's buffers
+        settings.PASTE_RESTORE_DELAY_MS = 0;
+        settings.LOW_FOOTPRINT = lowFootprint;
+        return settings;
+    }
+
+    std::size_t committed() {
+        const ProcessMemory memory = processMemory();
+        if (!memory.valid) bench::fail("the OS reports no process memory");
+        return memory.committedBytes;
+    }
+
+    void correct(SimDesktop &desktop, const std::wstring &document) {
+        desktop.setText(document, 0, document.size());
+        desktop.setLang(getLangId(0));
+        runHotkeyAction(HotkeyAction::Basic);
+        if (desktop.text() == document) bench::fail("correction changed nothing");
+    }
+
+    void checkConfig() {
+        const auto path = std::filesystem::temp_directory_path() / "language_flipper_footprint.json";
+        std::ofstream(path) << R"({"DEBUG_MODE": false, "LOW_FOOTPRINT": true,
+            "LAYOUTS": [{"NAME": "English"}, {"PRESET": "en-he"}, {"PRESET": "en-ru"}]})";
+        const auto settings = config::parse(path.string());
+        std::filesystem::remove(path);
+        if (!settings) bench::fail("low-footprint config not parsed");
+        for (const auto &layout: settings->LAYOUTS) {
+            if (!layout.keys.empty() || !layout.sequences.empty()) bench::fail("layout keys kept beside KEYMAPS");
+        }
+        if (fix(L"akuo", settings->KEYMAPS.table({0, 1})) != L"שלום") bench::fail("KEYMAPS lost with the layout keys");
+        std::printf("config keeps only the compiled tables (%zu KB)\n", settings->KEYMAPS.bytes() >> 10);
+    }
+
+    /// Committed memory left after one long correction, settled or not.
+    void checkRelease(SimDesktop &desktop) {
+        const std::wstring document = makeDocument(kLongChars);
+        std::size_t kept[2];
+        for (const bool lowFootprint: {false, true}) {
+            config::publish(settingsFor(lowFootprint));
+            correct(desktop, document);
+            trimProcessMemory(); // so both sides differ only in what the worker holds on to
+            kept[lowFootprint] = committed();
+        }
+        const std::size_t buffers = document.size() * sizeof(wchar_t);
+        const std::size_t freed = kept[0] > kept[1] ? kept[0] - kept[1] : 0;
+        std::printf("%-48s %10zu KB kept without, %zu KB with (%zu KB of text)\n", "after a long correction",
+                    kept[0] >> 10, kept[1] >> 10, buffers >> 10);
+        bench::record("buffers released by settling", static_cast<double>(freed >> 10), "KB", false);
+        // The worker's copy of the text at least; allocator rounding aside.
+        if (freed < buffers - buffers / 8) bench::fail("LOW_FOOTPRINT kept the correction's buffers");
+    }
+
+    /// Committed memory after each of kCorrections settled corrections.
+    void checkFlat(SimDesktop &desktop) {
+        // Settled by hand, as the action would under LOW_FOOTPRINT, to time it apart.
+        config::publish(settingsFor(false));
+        const std::wstring documents[] = {makeDocument(40), makeDocument(4000), makeDocument(kLongChars)};
+        std::vector<std::size_t> samples;
+        std::vector<double> settle;
+        for (int i = 0; i < kWarmup + kCorrections; ++i) {
+            correct(desktop, documents[i % 3]);
+            settle.push_back(bench::timeOnce(settleFootprint));
+            // Always after the short text, so the simulated editor holds the same.
+            if (i >= kWarmup && i % 3 == 0) samples.push_back(committed());
+        }
+        const ProcessMemory memory = processMemory();
+        const auto [low, high] = std::minmax_element(samples.begin(), samples.end());
+        std::printf("%-48s %10zu KB private, %zu KB shared, %zu KB committed\n", "after a settled correction",
+                    memory.privateBytes >> 10, memory.sharedBytes >> 10, memory.committedBytes >> 10);
+        std::printf("%-48s %10zu KB over %d corrections\n", "committed range", (*high - *low) >> 10, kCorrections);
+        bench::record("private after settling", static_cast<double>(memory.privateBytes >> 10), "KB");
+        bench::record("committed after settling", static_cast<double>(memory.committedBytes >> 10), "KB");
+        bench::record("committed range", static_cast<double>((*high - *low) >> 10), "KB");
+        bench::reportLatency("settling after a correction", std::move(settle));
+        if (*high - *low > kFlatSlack) bench::fail("committed memory grows over settled corrections");
+        if (samples.back() > samples.front() + kFlatSlack) bench::fail("committed memory drifts upwards");
+    }
+
+    void idle_footprint() {
+        checkConfig();
+
+        SimDesktop desktop;
+        platform::install(desktop.backend());
+        desktop.setClipboardText(L"what the user had copied");
+        checkRelease(desktop);
+        checkFlat(desktop);
+    }
+}
+
+BENCH_CASE(idle_footprint);
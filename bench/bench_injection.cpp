@@ -0,0 +1,91 @@
+// this is bench/bench_injection.cpp
+//
+// Typing a long correction into a target whose input queue is bounded:
+// one SendInput with every event versus the paced streaming injector. The
+// simulated queue drops events past its limit, the way a flooded thread
+// queue does, so the one-shot path loses text once it outgrows the queue.
+// The streamed side converts as a correction does: through the script-run
+// converter, a batch of whole words at a time just before it is sent.
+
+#include "bench.h"
+#include "config.h"
+#include "injector.h"
+#include "platform_sim.h"
+#include "script_runs.h"
+
+#include <thread>
+
+namespace {
+    constexpr auto kKeyEventCost = std::chrono::microseconds(2);
+    constexpr std::size_t kQueueLimit = 10000; // Windows' default per-thread message limit
+
+    void waitUntilDrained(platform::Input &input) {
+        while (input.inputPending()) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    std::wstring sample(const std::size_t length) {
+        const std::wstring word = L"akuo ";
+        std::wstring text;
+        text.reserve(length);
+        while (text.size() < length) text += word[text.size() % word.size()];
+        return text;
+    }
+
+    void injection_streaming() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        config::publish(settings);
+        const auto &table = settings.KEYMAPS.table({0, 1});
+        const ScriptRunConverter runs(settings.KEYMAPS, [](const LayoutId from) { return LayoutId(1 - from); }, 0);
+
+        std::printf("target cost %lld µs per key event, queue limit %zu events, batch buffer %d chars\n",
+                    static_cast<long long>(kKeyEventCost.count()), kQueueLimit, settings.INJECT_BATCH_CHARS);
+        std::printf("%8s | %-34s | %-60s\n", "chars", "one SendInput", "streamed");
+
+        for (const std::size_t length: {1000u, 10000u, 100000u}) {
+            const std::wstring source = sample(length);
+            const std::wstring expected = fix(source, table);
+
+            double oneShotSeconds, streamSeconds;
+            std::uint64_t oneShotDropped;
+            {
+                SimDesktop desktop;
+                desktop.setKeyEventCost(kKeyEventCost);
+                desktop.setInputQueueLimit(kQueueLimit);
+                auto &input = *desktop.backend().input;
+                oneShotSeconds = bench::timeOnce([&] {
+                    input.typeText(fix(source, table));
+                    waitUntilDrained(input);
+                });
+                oneShotDropped = desktop.droppedEvents();
+                if (oneShotDropped == 0 && desktop.text() != expected) bench::fail("one-shot text mismatch");
+            }
+
+            SimDesktop desktop;
+            desktop.setKeyEventCost(kKeyEventCost);
+            desktop.setInputQueueLimit(kQueueLimit);
+            StreamingInjector injector(*desktop.backend().input);
+            const auto start = bench::Clock::now();
+            streamSeconds = bench::timeOnce([&] {
+                injector.pushMapped(source, [&](const wchar_t *src, const std::size_t n, wchar_t *dst) {
+                    runs.convert(src, n, dst);
+                });
+                injector.finish();
+            });
+            if (desktop.droppedEvents() != 0) bench::fail("streamed injection dropped events");
+            if (desktop.text() != expected) bench::fail("streamed text mismatch");
+
+            const auto &stats = injector.stats();
+            const std::chrono::duration<double> firstSent = stats.firstSent - start;
+            char oneShot[64], streamed[96];
+            std::snprintf(oneShot, sizeof(oneShot), "%8.1f ms, %6llu events dropped",
+                          oneShotSeconds * 1e3, static_cast<unsigned long long>(oneShotDropped));
+            std::snprintf(streamed, sizeof(streamed),
+                          "%8.1f ms, first after %5.1f µs, %4zu batches, peak queue %4zu",
+                          streamSeconds * 1e3, firstSent.count() * 1e6, stats.batches, desktop.peakQueuedEvents());
+            std::printf("%8zu | %-34s | %-60s\n", length, oneShot, streamed);
+        }
+    }
+}
+
+BENCH_CASE(injection_streaming);
@@ -0,0 +1,187 @@
+// this is bench/bench_ipc.cpp
+//
+// The conversion service on a real local endpoint, with clients in this
+// process. Checks each kind of request: a forced direction, "to" left to
+// the cycle, AUTO scored by the models and, after update(), by script; that
+// a batch comes back in order, that bad requests are answered without
+// dropping the connection, and that an oversized frame ends it. Then load:
+// several connections pipelining small requests, for requests per second
+// and the latency of one request.
+
+#include "bench.h"
+#include "config.h"
+#include "ipc_client.h"
+#include "ipc_server.h"
+#include "utf8.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+
+namespace {
+    constexpr LayoutId kEnglish = 0, kHebrew = 1;
+    constexpr unsigned kClients = 4;
+    constexpr unsigned kRequests = 5000; // per client
+    constexpr unsigned kDepth = 16;
+    constexpr unsigned kBatch = 4;
+
+    std::string endpointName() {
+#ifdef _WIN32
+        return "language_flipper_bench";
+#else
+        return "language_flipper_bench_" + std::to_string(getpid());
+#endif
+    }
+
+    std::string utf8(const std::wstring &text) {
+        std::string bytes;
+        encodeUtf8(text, bytes);
+        return bytes;
+    }
+
+    void expect(IpcClient &client, const std::string &text, const Direction direction, const std::string &want,
+                const Direction wantTook, const char *what) {
+        std::string out;
+        Direction took;
+        if (client.convert(text, direction, out, &took) != ipc::Status::Ok || out != want || took != wantTook) {
+            bench::fail(std::string(what) + " answered wrongly");
+        }
+    }
+
+    /// A raw frame's answer: its status, with the connection still usable.
+    ipc::Status statusOf(IpcClient &client, const std::string &frame, const std::uint32_t id) {
+        ipc::Frame answer;
+        if (!client.send(frame) || !client.receive(answer) || answer.id != id) bench::fail("no answer to a bad request");
+        return ipc::responseStatus(answer);
+    }
+
+    void checkRequests(IpcServer &server, const config::Settings &settings) {
+        const auto client = IpcClient::connect(server.endpoint());
+        if (!client) bench::fail("cannot connect to the service");
+        const auto &tables = settings.KEYMAPS;
+
+        expect(*client, "akuo", {kEnglish, kHebrew}, "שלום", {kEnglish, kHebrew}, "a forced direction");
+        expect(*client, "akuo", {kEnglish, ipc::AUTO}, "שלום", {kEnglish, kHebrew}, "to = AUTO");
+        expect(*client, "", {kHebrew, kEnglish}, "", {kHebrew, kEnglish}, "empty text");
+
+        // A Hebrew sentence typed on the English layout, told apart by the models.
+        const std::wstring meant = L"שלום, מה שלומך היום? אני מקווה שהכול בסדר";
+        const std::string typed = utf8(fix(meant, tables.table({kHebrew, kEnglish})));
+        expect(*client, typed, {ipc::AUTO, ipc::AUTO}, utf8(meant), {kEnglish, kHebrew}, "AUTO with models");
+
+        // A batch: three frames in one write, answered in order.
+        std::string batch;
+        ipc::appendRequest(batch, 7, {kEnglish, kHebrew}, "akuo");
+        ipc::appendRequest(batch, 8, {kHebrew, kEnglish}, "שלום");
+        ipc::appendRequest(batch, 9, {kEnglish, kHebrew}, ",usv");
+        if (!client->send(batch)) bench::fail("batch not sent");
+        const char *wants[] = {"שלום", "akuo", "תודה"};
+        for (std::uint32_t id = 7; id <= 9; ++id) {
+            ipc::Frame answer;
+            if (!client->receive(answer) || answer.id != id || answer.text != wants[id - 7]) {
+                bench::fail("batch answered out of order or wrongly");
+            }
+        }
+
+        // Bad requests are answered, and the connection carries on.
+        std::string bad;
+        ipc::appendRequest(bad, 20, {kEnglish, kEnglish}, "akuo");
+        if (statusOf(*client, bad, 20) != ipc::Status::Unsupported) bench::fail("from == to not Unsupported");
+        bad.clear();
+        ipc::appendRequest(bad, 21, {kEnglish, 5}, "akuo");
+        if (statusOf(*client, bad, 21) != ipc::Status::Unsupported) bench::fail("a missing layout not Unsupported");
+        bad.clear();
+        ipc::endFrame(bad, ipc::beginFrame(bad, 22, kEnglish, kHebrew, 1));
+        if (statusOf(*client, bad, 22) != ipc::Status::BadRequest) bench::fail("reserved bytes not BadRequest");
+        expect(*client, "akuo", {kEnglish, kHebrew}, "שלום", {kEnglish, kHebrew}, "a request after bad ones");
+
+        // Without models AUTO goes by script, run by run.
+        server.update(settings, {});
+        expect(*client, "hello שלום akuo", {ipc::AUTO, ipc::AUTO}, "יקךךם akuo שלום", {kEnglish, kHebrew},
+               "AUTO by script");
+
+        // A frame over MAX_FRAME gets TooLarge, then the connection closes.
+        std::string huge(4, '\0');
+        ipc::storeU32(huge.data(), ipc::MAX_FRAME + 1);
+        ipc::Frame answer;
+        if (!client->send(huge) || !client->receive(answer) || answer.id != 0 ||
+            ipc::responseStatus(answer) != ipc::Status::TooLarge) {
+            bench::fail("an oversized frame not answered TooLarge");
+        }
+        if (client->receive(answer)) bench::fail("connection still open after an oversized frame");
+        std::printf("forced, AUTO, batches, bad and oversized requests ok\n");
+    }
+
+    /// One connection keeping kDepth requests in flight; seconds per request.
+    void load(const std::string &endpoint, const std::string &text, std::vector<double> &latencies) {
+        const auto client = IpcClient::connect(endpoint);
+        if (!client) bench::fail("cannot connect to the service");
+        std::vector<std::chrono::steady_clock::time_point> sentAt(kRequests);
+        std::string out;
+        ipc::Frame answer;
+        std::uint32_t sent = 0, received = 0;
+        while (received < kRequests) {
+            while (sent < kRequests && sent - received < kDepth) {
+                out.clear();
+                const auto now = std::chrono::steady_clock::now();
+                for (std::uint32_t i = 0; i < kBatch && sent < kRequests; ++i, ++sent) {
+                    ipc::appendRequest(out, sent, {kEnglish, kHebrew}, text);
+                    sentAt[sent] = now;
+                }
+                if (!client->send(out)) bench::fail("load: send failed");
+            }
+            if (!client->receive(answer) || answer.id != received) bench::fail("load: answer lost or out of order");
+            const std::chrono::duration<double> took = std::chrono::steady_clock::now() - sentAt[received++];
+            latencies.push_back(took.count());
+        }
+    }
+
+    void throughput(IpcServer &server) {
+        const std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit";
+        std::vector<std::vector<double>> latencies(kClients);
+        std::vector<std::thread> clients;
+        const double seconds = bench::timeOnce([&] {
+            for (auto &samples: latencies) {
+                clients.emplace_back(load, std::cref(server.endpoint()), std::cref(text), std::ref(samples));
+            }
+            for (auto &client: clients) client.join();
+        });
+        std::vector<double> all;
+        for (const auto &samples: latencies) all.insert(all.end(), samples.begin(), samples.end());
+
+        const double rate = static_cast<double>(all.size()) / seconds;
+        std::printf("%-48s %10.0f req/s (%u clients, depth %u, batch %u, %zu bytes)\n", "ipc requests", rate,
+                    kClients, kDepth, kBatch, text.size());
+        bench::record("ipc requests", rate, "req/s", false);
+        bench::reportLatency("ipc request, pipelined", std::move(all));
+    }
+
+    void ipc_service() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.DIRECTION_MODE = config::DirectionMode::Auto;
+        for (auto &layout: settings.LAYOUTS) layout.model = LF_MODEL_DIR + layout.model.substr(layout.model.find('/'));
+        config::publish(settings);
+
+        auto models = IpcServer::modelsFor(settings);
+        if (models.size() != settings.LAYOUTS.size()) bench::fail("models not loaded");
+        const auto server = IpcServer::listen(ipc::endpointPath(endpointName()), 2, settings, std::move(models));
+        if (!server) bench::fail("cannot listen on " + ipc::endpointPath(endpointName()));
+        if (IpcServer::listen(server->endpoint(), 1, settings, {})) bench::fail("a second server took a live endpoint");
+
+        checkRequests(*server, settings);
+        throughput(*server);
+        if (server->stats().requests < kClients * kRequests) bench::fail("requests not counted");
+    }
+}
+
+BENCH_CASE(ipc_service);
@@ -0,0 +1,91 @@
+// this is bench/bench_kernels.cpp
+//
+// Differential check of every supported SIMD kernel against the original
+// unordered_map fix(), then per-kernel throughput.
+
+#include "bench.h"
+#include "keymap.h"
+
+#include <random>
+
+namespace {
+    const std::unordered_map<wchar_t, wchar_t> kEnglishToHebrew = {
+        {L'q', L'/'}, {L'w', L'\''}, {L'e', L'ק'}, {L'r', L'ר'}, {L't', L'א'},
+        {L'y', L'ט'}, {L'u', L'ו'}, {L'i', L'ן'}, {L'o', L'ם'}, {L'p', L'פ'},
+        {L'a', L'ש'}, {L's', L'ד'}, {L'd', L'ג'}, {L'f', L'כ'}, {L'g', L'ע'},
+        {L'h', L'י'}, {L'j', L'ח'}, {L'k', L'ל'}, {L'l', L'ך'}, {L';', L'ף'}, {L'\'', L','},
+        {L'z', L'ז'}, {L'x', L'ס'}, {L'c', L'ב'}, {L'v', L'ה'}, {L'b', L'נ'},
+        {L'n', L'מ'}, {L'm', L'צ'}, {L',', L'ת'}, {L'.', L'ץ'}, {L'/', L'.'}
+    };
+
+    std::vector<KeymapKernel> supportedKernels() {
+        std::vector<KeymapKernel> kernels{KeymapKernel::Scalar};
+        if (bestKeymapKernel() >= KeymapKernel::Sse42) kernels.push_back(KeymapKernel::Sse42);
+        if (bestKeymapKernel() >= KeymapKernel::Avx2) kernels.push_back(KeymapKernel::Avx2);
+        return kernels;
+    }
+
+    /// ASCII-heavy text with a sprinkle of arbitrary code units (controls,
+    /// Hebrew, surrogate halves, and above U+FFFF where wchar_t allows it).
+    std::wstring randomText(std::mt19937 &rng, const std::size_t length) {
+        std::uniform_int_distribution<int> roll(0, 99), ascii(0, 127), hebrew(0x05D0, 0x05EA);
+        std::uniform_int_distribution<unsigned> any(0, sizeof(wchar_t) > 2 ? 0x10FFFF : 0xFFFF);
+        std::wstring text(length, L' ');
+        for (auto &ch: text) {
+            const int r = roll(rng);
+            ch = static_cast<wchar_t>(r < 90 ? ascii(rng) : r < 96 ? hebrew(rng) : any(rng));
+        }
+        return text;
+    }
+
+    void keymap_kernels() {
+        const auto tables = {
+            std::pair{"primary→secondary", kEnglishToHebrew},
+            std::pair{"secondary→primary", invertKeymap(kEnglishToHebrew)},
+        };
+
+        // Differential check: every length up to a few blocks, plus misaligned starts.
+        std::mt19937 rng(7);
+        for (auto const &[label, map]: tables) {
+            const auto table = KeymapTable::compile(map);
+            for (std::size_t length = 0; length < 300; ++length) {
+                for (int trial = 0; trial < 8; ++trial) {
+                    const auto text = randomText(rng, length + 3);
+                    const std::wstring input = text.substr(trial % 4, length);
+                    const auto expected = fix(input, map);
+                    for (const auto kernel: supportedKernels()) {
+                        std::wstring got(input.size(), L'\0');
+                        table.apply(input.data(), input.size(), got.data(), kernel);
+                        if (got != expected) {
+                            bench::fail(std::string(keymapKernelName(kernel)) + " differs from fix() for "
+                                        + label + " at length " + std::to_string(length));
+                        }
+                    }
+                }
+            }
+        }
+        std::printf("differential check passed for %zu kernel(s), best is %s\n",
+                    supportedKernels().size(), keymapKernelName(bestKeymapKernel()));
+
+        // Throughput on 4M units of Latin typed in the wrong layout.
+        std::uniform_int_distribution<int> letter(0, 25), roll(0, 99);
+        std::wstring document(4 << 20, L' ');
+        for (auto &ch: document) {
+            const int r = roll(rng);
+            ch = r < 15 ? L' ' : r < 18 ? L'.' : r < 20 ? static_cast<wchar_t>(L'A' + letter(rng))
+                                                        : static_cast<wchar_t>(L'a' + letter(rng));
+        }
+
+        const auto table = KeymapTable::compile(kEnglishToHebrew);
+        std::wstring out(document.size(), L'\0');
+        for (const auto kernel: supportedKernels()) {
+            const double seconds = bench::bestOf(5, [&] {
+                table.apply(document.data(), document.size(), out.data(), kernel);
+            });
+            bench::keep(out);
+            bench::report(std::string("latin document ") + keymapKernelName(kernel), document.size(), seconds);
+        }
+    }
+}
+
+BENCH_CASE(keymap_kernels);
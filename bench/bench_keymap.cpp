@@ -0,0 +1,76 @@
+// this is bench/bench_keymap.cpp
+//
+// Throughput of fix(): the old unordered_map path against the compiled page
+// tables, on multi-megabyte inputs like the "All" hotkey sees.
+
+#include "bench.h"
+#include "keymap.h"
+
+#include <random>
+
+namespace {
+    // Stock English→Hebrew keymap (same as the config.cpp defaults).
+    const std::unordered_map<wchar_t, wchar_t> kEnglishToHebrew = {
+        {L'q', L'/'}, {L'w', L'\''}, {L'e', L'ק'}, {L'r', L'ר'}, {L't', L'א'},
+        {L'y', L'ט'}, {L'u', L'ו'}, {L'i', L'ן'}, {L'o', L'ם'}, {L'p', L'פ'},
+        {L'a', L'ש'}, {L's', L'ד'}, {L'd', L'ג'}, {L'f', L'כ'}, {L'g', L'ע'},
+        {L'h', L'י'}, {L'j', L'ח'}, {L'k', L'ל'}, {L'l', L'ך'}, {L';', L'ף'}, {L'\'', L','},
+        {L'z', L'ז'}, {L'x', L'ס'}, {L'c', L'ב'}, {L'v', L'ה'}, {L'b', L'נ'},
+        {L'n', L'מ'}, {L'm', L'צ'}, {L',', L'ת'}, {L'.', L'ץ'}, {L'/', L'.'}
+    };
+
+    constexpr std::size_t kDocumentChars = 4 << 20;
+    constexpr int kReps = 5;
+
+    /// Words drawn from the keymap's source side, with some capitals,
+    /// digits and newlines so the pass-through paths are exercised too.
+    std::wstring makeDocument(const std::unordered_map<wchar_t, wchar_t> &map, const std::size_t chars) {
+        std::vector<wchar_t> alphabet;
+        for (auto const &pair: map) alphabet.push_back(pair.first);
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<std::size_t> pick(0, alphabet.size() - 1);
+        std::uniform_int_distribution<int> wordLen(1, 9), roll(0, 99);
+
+        std::wstring text;
+        text.reserve(chars + 16);
+        while (text.size() < chars) {
+            for (int n = wordLen(rng); n > 0; --n) {
+                wchar_t ch = alphabet[pick(rng)];
+                if (ch >= L'a' && ch <= L'z' && roll(rng) < 5) ch = static_cast<wchar_t>(ch - 32);
+                text += ch;
+            }
+            const int r = roll(rng);
+            text += r < 3 ? L'\n' : r < 6 ? L'7' : L' ';
+        }
+        text.resize(chars);
+        return text;
+    }
+
+    void runDirection(const char *label, const std::unordered_map<wchar_t, wchar_t> &forward, const bool inverse) {
+        const auto text = makeDocument(inverse ? invertKeymap(forward) : forward, kDocumentChars);
+        const auto table = KeymapTable::compile(inverse ? invertKeymap(forward) : forward);
+
+        // The old transformText() rebuilt the reverse map on every call.
+        std::wstring viaMap;
+        const double mapSeconds = bench::bestOf(kReps, [&] {
+            viaMap = inverse ? fix(text, invertKeymap(forward)) : fix(text, forward);
+        });
+
+        std::wstring viaTable;
+        const double tableSeconds = bench::bestOf(kReps, [&] { viaTable = fix(text, table); });
+
+        if (viaMap != viaTable) bench::fail(std::string(label) + ": table output differs from map output");
+
+        bench::report(std::string(label) + " unordered_map", text.size(), mapSeconds);
+        bench::report(std::string(label) + " page table", text.size(), tableSeconds);
+        std::printf("%-48s %10.2fx\n", (std::string(label) + " speed-up").c_str(), mapSeconds / tableSeconds);
+    }
+
+    void keymap_fix() {
+        runDirection("primary→secondary", kEnglishToHebrew, false);
+        runDirection("secondary→primary", kEnglishToHebrew, true);
+    }
+}
+
+BENCH_CASE(keymap_fix);
@@ -0,0 +1,146 @@
+// this is bench/bench_layouts.cpp
+//
+// Tables for N layouts. Checks that the matrix gives the same pair tables
+// KeymapTable::compile() builds for every preset, and that a conversion
+// between two non-Latin layouts goes through the shared key. Then builds
+// matrices of 2 to 6 layouts against one compiled table per pair: the
+// matrix should grow with the layouts, not with the pairs. Last, a
+// correction with three layouts on the simulated desktop, following the
+// cycle.
+
+#include "bench.h"
+#include "config.h"
+#include "keymap.h"
+#include "layout_matrix.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <vector>
+
+namespace {
+    using Keys = std::unordered_map<wchar_t, wchar_t>;
+
+    constexpr int kReps = 20;
+
+    bool sameTable(const KeymapTable &a, const KeymapTable &b) {
+        for (std::uint32_t ch = 0; ch < 0x10000; ++ch) {
+            if (a.map(static_cast<wchar_t>(ch)) != b.map(static_cast<wchar_t>(ch))) return false;
+        }
+        return true;
+    }
+
+    Keys presetKeys(const LayoutPreset &preset) {
+        Keys keys;
+        for (const auto &[from, to]: preset.keys) keys.try_emplace(from, to);
+        return keys;
+    }
+
+    void checkPairs() {
+        const Keys english;
+        for (const auto &preset: layoutPresets()) {
+            const Keys keys = presetKeys(preset);
+            const Keys *layouts[] = {&english, &keys};
+            const auto matrix = LayoutMatrix::build(layouts);
+            if (!sameTable(matrix.table({0, 1}), KeymapTable::compile(keys)) ||
+                !sameTable(matrix.table({1, 0}), KeymapTable::compile(invertKeymap(keys)))) {
+                bench::fail(std::string(preset.name) + ": matrix differs from compile()");
+            }
+        }
+        std::printf("%zu presets: matrix tables match compile()\n", layoutPresets().size());
+
+        // Hebrew and Russian share no characters; a key both remap converts directly.
+        const Keys hebrew = presetKeys(*findLayoutPreset("en-he"));
+        const Keys russian = presetKeys(*findLayoutPreset("en-ru"));
+        const Keys *layouts[] = {&english, &hebrew, &russian};
+        const auto matrix = LayoutMatrix::build(layouts);
+        if (fix(L"шзщ", matrix.table({2, 1})) != L"ןפם" || fix(L"ןפם", matrix.table({1, 2})) != L"шзщ") {
+            bench::fail("Hebrew↔Russian did not convert through the shared keys");
+        }
+        if (fix(L"Hello", matrix.table({0, 2})) != L"руддщ") bench::fail("English→Russian in a 3-layout matrix");
+    }
+
+    void scaling() {
+        std::vector<Keys> keys(1); // English first
+        for (const auto &preset: layoutPresets()) keys.push_back(presetKeys(preset));
+
+        std::printf("%8s %14s %14s %16s %16s\n", "layouts", "matrix (KB)", "per-pair (KB)", "matrix build (µs)",
+                    "per-pair (µs)");
+        double bytesPerLayoutAt2 = 0;
+        for (std::size_t n = 2; n <= keys.size(); ++n) {
+            std::vector<const Keys *> layouts;
+            for (std::size_t i = 0; i < n; ++i) layouts.push_back(&keys[i]);
+
+            LayoutMatrix matrix;
+            const double build = bench::bestOf(kReps, [&] { matrix = LayoutMatrix::build(layouts); });
+
+            // The same tables as standalone compile() results, one per pair.
+            std::vector<Keys> pairMaps;
+            for (LayoutId from = 0; from < n; ++from) {
+                for (LayoutId to = 0; to < n; ++to) {
+                    if (from == to) continue;
+                    Keys map;
+                    for (std::uint32_t ch = 0; ch < 0x10000; ++ch) {
+                        const auto c = static_cast<wchar_t>(ch);
+                        if ((c < L'A' || c > L'Z') && matrix.table({from, to}).map(c) != c) map[c] = matrix.table({from, to}).map(c);
+                    }
+                    pairMaps.push_back(std::move(map));
+                }
+            }
+            std::vector<KeymapTable> separate;
+            const double separateBuild = bench::bestOf(kReps, [&] {
+                separate.clear();
+                for (const auto &map: pairMaps) separate.push_back(KeymapTable::compile(map));
+            });
+            std::size_t separateBytes = 0;
+            for (const auto &table: separate) {
+                separateBytes += KeymapTable::PAGE_COUNT * sizeof(std::uint16_t) +
+                                 table.pageCount() * KeymapTable::PAGE_SIZE * sizeof(KeymapTable::Unit);
+            }
+
+            std::printf("%8zu %14.1f %14.1f %16.1f %16.1f\n", n, matrix.bytes() / 1024.0, separateBytes / 1024.0,
+                        build * 1e6, separateBuild * 1e6);
+
+            const double bytesPerLayout = static_cast<double>(matrix.bytes()) / n;
+            if (n == 2) bytesPerLayoutAt2 = bytesPerLayout;
+            if (bytesPerLayout > 2 * bytesPerLayoutAt2) bench::fail("matrix memory grows faster than the layouts");
+        }
+    }
+
+    void threeLayouts() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.DIRECTION_MODE = config::DirectionMode::Layout;
+        settings.PASTE_THRESHOLD_CHARS = 0;
+        settings.LAYOUTS = config::presetLayouts(*findLayoutPreset("en-he"));
+        settings.LAYOUTS.push_back(config::presetLayouts(*findLayoutPreset("en-ru"))[1]);
+        settings.compileKeymaps();
+        config::publish(settings);
+
+        SimDesktop desktop;
+        platform::install(desktop.backend());
+
+        // Default cycle: English → Hebrew → Russian → English.
+        const std::wstring typed = fix(L"hello world", settings.KEYMAPS.table({0, 2}));
+        desktop.setText(typed, 0, typed.size());
+        desktop.setLang(getLangId(2));
+        copyAndFlip();
+        if (desktop.text() != L"hello world" || desktop.lang() != getLangId(0)) bench::fail("Russian→English via the cycle");
+
+        // Hebrew left out of the cycle: text typed in it goes to the cycle's first layout.
+        settings.LAYOUT_CYCLE = {2, 0};
+        config::publish(settings);
+        desktop.setText(L"ןפם", 0, 3);
+        desktop.setLang(getLangId(1));
+        copyAndFlip();
+        if (desktop.text() != L"шзщ" || desktop.lang() != getLangId(2)) bench::fail("Hebrew→Russian outside the cycle");
+        std::printf("3 layouts on the desktop: cycle and out-of-cycle corrections ok\n");
+    }
+
+    void layout_matrix() {
+        checkPairs();
+        scaling();
+        threeLayouts();
+    }
+}
+
+BENCH_CASE(layout_matrix);
@@ -0,0 +1,160 @@
+// this is bench/bench_logger.cpp
+//
+// The asynchronous log behind DEBUG_PRINT. Checks that threads logging at
+// once keep their order, that what the ring can't hold is counted rather
+// than waited for, and that a long message is cut to one record. Then what
+// a call costs the logging thread, with a short message and with a whole
+// selection, next to writing and flushing the line itself as DEBUG_PRINT
+// used to.
+
+#include "bench.h"
+#include "config.h"
+#include "logger.h"
+#include "utf8.h"
+#include "utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 20000;
+    constexpr int kCalls = 20000;
+
+    std::filesystem::path logPath() {
+        return std::filesystem::temp_directory_path() / "language_flipper_bench.log";
+    }
+
+    std::vector<std::string> readLines(const std::filesystem::path &path) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line);) lines.push_back(std::move(line));
+        return lines;
+    }
+
+    /// What follows the "[time #thread] " header.
+    std::string_view body(const std::string &line) {
+        const std::size_t end = line.find("] ");
+        return end == std::string::npos ? std::string_view() : std::string_view(line).substr(end + 2);
+    }
+
+    void checkOrderAndDrops() {
+        const auto before = logger::stats();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([t] {
+                for (int i = 0; i < kPerThread; ++i) DEBUG_PRINT(L"order " << t << L' ' << i);
+            });
+        }
+        for (auto &thread: threads) thread.join();
+        logger::flush();
+        const auto after = logger::stats();
+
+        std::vector<int> last(kThreads, -1);
+        std::uint64_t seen = 0, reportedDrops = 0;
+        for (const auto &line: readLines(logPath())) {
+            const std::string_view text = body(line);
+            int t, i;
+            if (std::sscanf(std::string(text).c_str(), "order %d %d", &t, &i) == 2) {
+                if (t < 0 || t >= kThreads || i <= last[t]) bench::fail("a thread's messages out of order");
+                last[t] = i;
+                ++seen;
+            } else if (unsigned long long n; std::sscanf(line.c_str(), "[log] %llu messages dropped", &n) == 1) {
+                reportedDrops += n;
+            }
+        }
+        const std::uint64_t dropped = after.dropped - before.dropped;
+        if (seen + dropped != kThreads * kPerThread) bench::fail("messages neither written nor counted as dropped");
+        if (reportedDrops != dropped) bench::fail("drops not reported in the log");
+        std::printf("%d threads × %d messages: each thread's in order, %llu written, %llu dropped and reported\n",
+                    kThreads, kPerThread, static_cast<unsigned long long>(seen), static_cast<unsigned long long>(dropped));
+    }
+
+    void checkTruncation() {
+        const std::wstring selection(1 << 20, L'ש');
+        logTransformation(selection, selection, Direction{1, 0});
+        logger::flush();
+        const auto lines = readLines(logPath());
+        if (lines.size() < 2) bench::fail("long messages not written");
+        for (const auto &line: {lines[lines.size() - 2], lines.back()}) {
+            std::wstring wide;
+            decodeUtf8(body(line), wide);
+            if (wide.size() != logger::kTextUnits + 1 || wide.back() != L'…') bench::fail("long message not cut to one record");
+        }
+        if (lines[lines.size() - 2].find("(1048576 chars)") == std::string::npos) bench::fail("selection length not logged");
+        std::printf("a 1 MiB selection logs as %zu characters and its length\n", logger::kTextUnits);
+    }
+
+    template<typename F>
+    std::vector<double> perCall(F &&f) {
+        std::vector<double> samples;
+        samples.reserve(kCalls);
+        for (int i = 0; i < kCalls; ++i) {
+            samples.push_back(bench::timeOnce(f));
+            if (i % 256 == 255) logger::flush(); // keep the ring from filling: time queueing, not dropping
+        }
+        return samples;
+    }
+
+    void cost() {
+        const std::wstring selection(64 * 1024, L'ש');
+        const std::wstring name = L"Hebrew";
+
+        const std::uint64_t allocations = bench::allocations();
+        for (int i = 0; i < 100; ++i) {
+            DEBUG_PRINT(L"Layout flipped: " << name << L"→" << name);
+            logTransformation(selection, selection, Direction{1, 0});
+        }
+        const std::uint64_t allocated = (bench::allocations() - allocations) / 100;
+        logger::flush();
+
+        bench::reportLatency("async, short message", perCall([&] {
+            DEBUG_PRINT(L"Layout flipped: " << name << L"→" << name);
+        }));
+        bench::reportLatency("async, 64K-char selection", perCall([&] {
+            logTransformation(selection, selection, Direction{1, 0});
+        }));
+
+        // The old DEBUG_PRINT: the whole line encoded, written and flushed right there.
+        std::FILE *sync = std::fopen(logPath().string().c_str(), "ab");
+        if (!sync) bench::fail("could not open the log file");
+        std::string bytes;
+        auto writeLine = [&](const std::wstring &line) {
+            bytes.clear();
+            encodeUtf8(line, bytes);
+            std::fwrite(bytes.data(), 1, bytes.size(), sync);
+            std::fflush(sync);
+        };
+        bench::reportLatency("sync, short message", perCall([&] {
+            writeLine(L"Layout flipped: " + name + L"→" + name + L"\n");
+        }));
+        bench::reportLatency("sync, 64K-char selection", perCall([&] {
+            writeLine(L"selected: " + selection + L"\n");
+        }));
+        std::fclose(sync);
+        std::printf("allocations per logged line: %llu\n", static_cast<unsigned long long>(allocated));
+        if (allocated != 0) bench::fail("logging allocates");
+    }
+
+    void logger_async() {
+        config::Settings settings;
+        settings.DEBUG_MODE = true;
+        config::publish(settings);
+        std::error_code ignored;
+        std::filesystem::remove(logPath(), ignored);
+        logger::setFile(logPath().string());
+
+        checkOrderAndDrops();
+        checkTruncation();
+        cost();
+
+        logger::flush();
+        logger::setFile("");
+        settings.DEBUG_MODE = false;
+        config::publish(settings);
+        std::filesystem::remove(logPath(), ignored);
+    }
+}
+
+BENCH_CASE(logger_async);
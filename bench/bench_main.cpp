@@ -0,0 +1,122 @@
+// this is bench/bench_main.cpp
+
+#include "bench.h"
+
+#include "third_party/json/json.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace bench {
+    namespace {
+        const char *running = "";
+    }
+
+    std::vector<Case> &registry() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    std::vector<Result> &results() {
+        static std::vector<Result> all;
+        return all;
+    }
+
+    void record(const std::string &name, const double value, const char *unit, const bool lowerIsBetter) {
+        const std::size_t start = name.find_first_not_of(' ');
+        std::string full = std::string(running) + "/" + name.substr(start == std::string::npos ? 0 : start);
+        // Seen in an earlier --repeat pass: keep the better of the two.
+        for (auto &r: results()) {
+            if (r.name != full) continue;
+            if (lowerIsBetter ? value < r.value : value > r.value) r.value = value;
+            return;
+        }
+        results().push_back({std::move(full), value, unit, lowerIsBetter});
+    }
+
+    void fail(const std::string &what) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        std::exit(1);
+    }
+}
+
+namespace {
+    bool writeResults(const std::string &path) {
+        nlohmann::ordered_json out = nlohmann::ordered_json::array();
+        for (const auto &r: bench::results()) {
+            out.push_back({{"name", r.name}, {"value", r.value}, {"unit", r.unit}, {"lower_is_better", r.lowerIsBetter}});
+        }
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << nlohmann::ordered_json{{"results", std::move(out)}}.dump(1) << '\n';
+        return static_cast<bool>(file);
+    }
+
+    /// Compare with a file written by --json; the number of results worse by
+    /// more than threshold percent, or -1 if the baseline can't be read.
+    int regressions(const std::string &path, const double threshold) {
+        std::ifstream file(path);
+        const auto baseline = nlohmann::json::parse(file, nullptr, false);
+        if (baseline.is_discarded() || !baseline.contains("results")) return -1;
+        std::map<std::string, double> before;
+        for (const auto &r: baseline["results"]) before[r["name"].get<std::string>()] = r["value"].get<double>();
+
+        int worse = 0, compared = 0;
+        std::printf("── compared with %s (threshold %.1f%%)\n", path.c_str(), threshold);
+        for (const auto &r: bench::results()) {
+            const auto it = before.find(r.name);
+            if (it == before.end()) continue;
+            ++compared;
+            const double was = it->second;
+            const double change = was != 0 ? 100 * (r.value - was) / was : r.value != 0 ? 100 : 0;
+            const bool regressed = r.lowerIsBetter ? change > threshold : change < -threshold;
+            worse += regressed;
+            if (regressed || std::abs(change) > threshold) {
+                std::printf("%-10s %-60s %12.3f → %12.3f %-11s %+7.1f%%\n", regressed ? "REGRESSED" : "improved",
+                            r.name.c_str(), was, r.value, r.unit.c_str(), change);
+            }
+        }
+        std::printf("%d of %d results regressed\n", worse, compared);
+        return worse;
+    }
+}
+
+// Usage: language_flipper_bench [filter] [--repeat N] [--json FILE] [--baseline FILE [--threshold PERCENT]]
+//   filter     runs every case whose name contains it
+//   --repeat   runs them N times, keeping the best of each result
+//   --json     writes every recorded result (ns/char, µs, allocations, …) to FILE
+//   --baseline compares them with an earlier --json file and exits 2 if any
+//              got worse by more than PERCENT (default 10)
+int main(const int argc, char **argv) {
+    const char *filter = "";
+    std::string json, baseline;
+    double threshold = 10;
+    int repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--json") == 0 && hasValue) json = argv[++i];
+        else if (std::strcmp(argv[i], "--baseline") == 0 && hasValue) baseline = argv[++i];
+        else if (std::strcmp(argv[i], "--threshold") == 0 && hasValue) threshold = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue) repeat = std::max(1, std::atoi(argv[++i]));
+        else filter = argv[i];
+    }
+
+    for (int pass = 0; pass < repeat; ++pass) {
+        for (const auto &c: bench::registry()) {
+            if (std::strstr(c.name, filter) == nullptr) continue;
+            std::printf("── %s\n", c.name);
+            bench::running = c.name;
+            c.run();
+        }
+    }
+
+    if (!json.empty() && !writeResults(json)) bench::fail("could not write " + json);
+    if (!baseline.empty()) {
+        const int worse = regressions(baseline, threshold);
+        if (worse < 0) bench::fail("could not read baseline " + baseline);
+        if (worse > 0) return 2;
+    }
+    return 0;
+}
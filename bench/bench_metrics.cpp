@@ -0,0 +1,257 @@
+// this is bench/bench_metrics.cpp
+//
+// The stage latency histograms. Checks their percentiles against exact
+// ones, that threads recording at once lose nothing, that nested stages
+// are counted once, that corrections on the simulated desktop fill every
+// stage, the trace ring and the JSON dump, and that time between stages
+// goes to none of them. Then what the timers cost, per stage and against
+// the corrections' recorded totals, with a target that answers at once and
+// one with a real target's latency.
+
+#include "bench.h"
+#include "config.h"
+#include "metrics.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include "third_party/json/json.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace {
+    using metrics::Stage;
+
+    constexpr int kCorrections = 300;
+
+    void spin(const std::chrono::microseconds time) {
+        const auto until = metrics::Clock::now() + time;
+        while (metrics::Clock::now() < until) {
+        }
+    }
+
+    void checkHistogram() {
+        std::mt19937 rng(17);
+        std::lognormal_distribution<double> latency(std::log(40e3), 1.2); // around 40 µs, long tail
+        metrics::Histogram histogram;
+        std::vector<std::uint64_t> samples;
+        for (int i = 0; i < 200000; ++i) {
+            const auto ns = static_cast<std::uint64_t>(latency(rng));
+            const std::size_t bucket = metrics::Histogram::bucketOf(ns);
+            if (metrics::Histogram::bucketFloor(bucket) > ns || metrics::Histogram::bucketFloor(bucket + 1) <= ns) {
+                bench::fail("a value outside its bucket");
+            }
+            histogram.record(ns);
+            samples.push_back(ns);
+        }
+        std::sort(samples.begin(), samples.end());
+        const auto snapshot = histogram.snapshot();
+        for (const double q: {0.5, 0.9, 0.99, 0.999}) {
+            const double exact = static_cast<double>(samples[static_cast<std::size_t>(std::ceil(q * samples.size())) - 1]);
+            if (std::abs(snapshot.percentileNs(q) - exact) > exact / 16) bench::fail("percentile off by more than a bucket");
+        }
+        if (snapshot.count != samples.size() || snapshot.maxNs != samples.back()) bench::fail("count or max wrong");
+
+        // Four threads at once lose no samples.
+        metrics::Histogram shared;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&shared, t] {
+                for (std::uint64_t i = 0; i < 250000; ++i) shared.record((i * 7 + t) % 5000000);
+            });
+        }
+        for (auto &thread: threads) thread.join();
+        if (shared.snapshot().count != 1000000) bench::fail("concurrent samples lost");
+
+        // A stage inside another is taken out of it.
+        metrics::reset();
+        {
+            metrics::StageTimer outer(Stage::TypeText);
+            {
+                metrics::StageTimer inner(Stage::TransformText);
+                spin(std::chrono::microseconds(2000));
+            }
+            spin(std::chrono::microseconds(500));
+        }
+        const auto outer = metrics::histogram(Stage::TypeText).snapshot(), inner = metrics::histogram(Stage::TransformText).snapshot();
+        if (outer.count != 1 || inner.count != 1 || outer.maxNs > 1500000 || inner.maxNs < 2000000) {
+            bench::fail("nested stage counted in the outer one");
+        }
+        std::printf("percentiles within a bucket of exact; 4 threads lost no samples; nested stages counted once\n");
+    }
+
+    struct Session {
+        SimDesktop desktop;
+        std::wstring document;
+        std::size_t lineEnd;
+
+        Session() {
+            for (int line = 0; line < 40; ++line) document += L"akuo gcr ng tbh kt ahk nv ahnt cuex kngv\n";
+            lineEnd = document.find(L'\n', document.size() / 2);
+            platform::install(desktop.backend());
+        }
+
+        /// One Basic action on a two-word selection, as the worker runs it.
+        void correct() {
+            desktop.setText(document, lineEnd - 9, lineEnd);
+            desktop.setLang(getLangId(0));
+            metrics::Correction correction;
+            flushModifiers(config::current()->BASIC_HOTKEY_MODIFIERS);
+            copyAndFlip();
+        }
+    };
+
+    void quietDefaults() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.DIRECTION_MODE = config::DirectionMode::Layout;
+        config::publish(settings);
+    }
+
+    void checkPipeline(Session &session) {
+        metrics::reset();
+        metrics::setTracing(true);
+        const int runs = static_cast<int>(metrics::kTraceCapacity) + 44;
+        for (int i = 0; i < runs; ++i) session.correct();
+        metrics::setTracing(false);
+
+        for (const Stage stage: {Stage::FlushModifiers, Stage::SendCtrlC, Stage::WaitForClipboardChange, Stage::ReadClipboard,
+                                 Stage::TransformText, Stage::TypeText, Stage::RestoreClipboard, Stage::FlipLayout,
+                                 Stage::Correction}) {
+            if (metrics::histogram(stage).snapshot().count != static_cast<std::uint64_t>(runs)) {
+                bench::fail(std::string("stage not timed once per correction: ") + metrics::stageName(stage));
+            }
+        }
+        const auto records = metrics::traceRecords();
+        if (records.size() != metrics::kTraceCapacity) bench::fail("trace ring holds the wrong number of records");
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            const auto &record = records[i];
+            std::uint64_t stages = 0;
+            for (const auto us: record.stageUs) stages += us;
+            if (record.chars != 9 || record.pasted || stages > record.totalUs + metrics::kStages ||
+                (i > 0 && record.startUs < records[i - 1].startUs)) {
+                bench::fail("trace record wrong");
+            }
+        }
+
+        const auto path = std::filesystem::temp_directory_path() / "language_flipper_latency.json";
+        if (!metrics::dump(path.string())) bench::fail("could not write the dump");
+        std::ifstream file(path);
+        const auto json = nlohmann::json::parse(file);
+        file.close();
+        std::filesystem::remove(path);
+        if (json["stages"]["correction"]["count"] != runs || json["trace"].size() != metrics::kTraceCapacity ||
+            json["stages"]["typeText"]["p99_us"].get<double>() <= 0) {
+            bench::fail("dump doesn't match the histograms");
+        }
+        std::printf("%d corrections: every stage timed once each, last %zu traced, dump parses\n", runs,
+                    metrics::kTraceCapacity);
+    }
+
+    /// Time between stages belongs to none of them: not to a stage timed
+    /// by hand, nor to restoreClipboard after the wait a paste is given.
+    void checkGaps(Session &session) {
+        metrics::reset();
+        {
+            metrics::Correction correction;
+            {
+                metrics::StageTimer before(Stage::ReadClipboard);
+                spin(std::chrono::microseconds(200));
+            }
+            spin(std::chrono::microseconds(3000));
+            {
+                metrics::StageTimer after(Stage::TransformText);
+                spin(std::chrono::microseconds(200));
+            }
+        }
+        if (metrics::histogram(Stage::ReadClipboard).snapshot().maxNs > 1500000 ||
+            metrics::histogram(Stage::TransformText).snapshot().maxNs > 1500000 ||
+            metrics::histogram(Stage::Correction).snapshot().maxNs < 3000000) {
+            bench::fail("the gap between two stages went into one of them");
+        }
+
+        constexpr int kDelayMs = 20;
+        config::Settings settings = *config::current();
+        settings.PASTE_THRESHOLD_CHARS = 1;
+        settings.PASTE_RESTORE_DELAY_MS = kDelayMs;
+        config::publish(settings);
+        metrics::reset();
+        for (int i = 0; i < 5; ++i) session.correct();
+        quietDefaults();
+        const auto pasted = metrics::histogram(Stage::PasteText).snapshot();
+        const auto restored = metrics::histogram(Stage::RestoreClipboard).snapshot();
+        const auto whole = metrics::histogram(Stage::Correction).snapshot();
+        if (pasted.count != 5 || whole.percentileNs(0.5) < kDelayMs * 1e6) bench::fail("corrections weren't pasted");
+        if (restored.maxNs > kDelayMs * 1e6 / 2) bench::fail("the wait before restoring went into restoreClipboard");
+        std::printf("a 3 ms gap between stages and a %d ms restore delay: counted in the correction only\n", kDelayMs);
+    }
+
+    /// Median of the corrections' own recorded totals (Stage::Correction).
+    double recordedCorrection(Session &session) {
+        metrics::reset();
+        for (int i = 0; i < kCorrections; ++i) session.correct();
+        return metrics::histogram(Stage::Correction).snapshot().percentileNs(0.5) / 1e9;
+    }
+
+    /// Median wall time of a correction with metrics off.
+    double untimedCorrection(Session &session) {
+        metrics::setEnabled(false);
+        std::vector<double> samples;
+        for (int i = 0; i < kCorrections; ++i) samples.push_back(bench::timeOnce([&] { session.correct(); }));
+        metrics::setEnabled(true);
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    void overhead(Session &session) {
+        constexpr int kTimers = 1000000;
+        const double on = bench::bestOf(5, [] {
+            for (int i = 0; i < kTimers; ++i) metrics::StageTimer timer(Stage::FlushModifiers);
+        }) / kTimers;
+        metrics::setEnabled(false);
+        const double off = bench::bestOf(5, [] {
+            for (int i = 0; i < kTimers; ++i) metrics::StageTimer timer(Stage::FlushModifiers);
+        }) / kTimers;
+        metrics::setEnabled(true);
+        std::printf("one stage timed: %.1f ns (%.1f ns when off)\n", on * 1e9, off * 1e9);
+
+        metrics::reset();
+        session.correct();
+        std::uint64_t timers = 0;
+        for (std::size_t s = 0; s < metrics::kStages; ++s) timers += metrics::histogram(static_cast<Stage>(s)).snapshot().count;
+        const double perCorrection = static_cast<double>(timers) * on;
+
+        // Synchronous, the simulated target costs nothing, and the timers are
+        // a large share of a correction; the 1% bound is against a target
+        // that takes time to copy and to take each typed key.
+        const double instant = recordedCorrection(session);
+        session.desktop.setCopyLatency(std::chrono::microseconds(200));
+        session.desktop.setKeyEventCost(std::chrono::microseconds(2));
+        const double realistic = recordedCorrection(session);
+        const double realisticOff = untimedCorrection(session);
+
+        std::printf("%llu stages per correction: %.2f µs of timing\n", static_cast<unsigned long long>(timers),
+                    perCorrection * 1e6);
+        std::printf("%-44s recorded median %8.1f µs, timing %.2f%%\n", "correction, target answers at once",
+                    instant * 1e6, 100 * perCorrection / instant);
+        std::printf("%-44s recorded median %8.1f µs, timing %.3f%% (metrics off: %.1f µs)\n",
+                    "correction, 200 µs copy, 2 µs per key", realistic * 1e6, 100 * perCorrection / realistic,
+                    realisticOff * 1e6);
+        if (perCorrection > 0.01 * realistic) bench::fail("timing costs more than 1% of a correction");
+    }
+
+    void metrics_latency() {
+        checkHistogram();
+        quietDefaults();
+        Session session;
+        checkPipeline(session);
+        checkGaps(session);
+        overhead(session);
+        metrics::reset();
+    }
+}
+
+BENCH_CASE(metrics_latency);
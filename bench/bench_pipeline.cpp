@@ -0,0 +1,129 @@
+// this is bench/bench_pipeline.cpp
+//
+// End-to-end latency of the basic, line and all hotkey actions against the
+// simulated desktop, broken down per pipeline stage, plus Line against a
+// target that applies its selection late (exercising the copy retry).
+
+#include "bench.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <random>
+
+namespace {
+    constexpr int kIterations = 5000;
+
+    /// Paragraphs of English words typed on the Hebrew layout's keys.
+    std::wstring makeDocument(const std::size_t lines) {
+        const wchar_t *words[] = {L"akuo", L"gcr", L"ng", L"tbh", L"kt", L"ahk", L"nv", L"ahnt", L"cuex", L"kngv"};
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<std::size_t> pick(0, std::size(words) - 1);
+        std::wstring text;
+        for (std::size_t line = 0; line < lines; ++line) {
+            for (int w = 0; w < 12; ++w) {
+                text += words[pick(rng)];
+                text += L' ';
+            }
+            text += L'\n';
+        }
+        return text;
+    }
+
+    struct Stage {
+        const char *name;
+        std::vector<double> samples;
+    };
+
+    void runAction(const char *label, const HotkeyAction action, SimDesktop &desktop, const std::wstring &document) {
+        std::vector<Stage> stages = {
+            {"flushModifiers", {}}, {"copyAndFetchSelection", {}}, {"detectLayout", {}},
+            {"transformText", {}}, {"typeText", {}}, {"flipLayout", {}}, {"total", {}},
+        };
+        for (auto &stage: stages) stage.samples.reserve(kIterations);
+
+        const std::size_t lineEnd = document.find(L'\n', document.size() / 2);
+        const LANGID primary = getLangId(0);
+
+        for (int i = 0; i < kIterations; ++i) {
+            // Basic acts on a two-word selection, Line/All select for themselves.
+            if (action == HotkeyAction::Basic) desktop.setText(document, lineEnd - 9, lineEnd);
+            else desktop.setText(document, lineEnd, lineEnd);
+            desktop.setLang(primary);
+
+            const auto cfg = config::current();
+            const UINT modifiers = action == HotkeyAction::Basic ? cfg->BASIC_HOTKEY_MODIFIERS
+                                   : action == HotkeyAction::Line ? cfg->LINE_HOTKEY_MODIFIERS
+                                                                  : cfg->ALL_HOTKEY_MODIFIERS;
+            const auto selection = action == HotkeyAction::Basic ? platform::Selection::Current
+                                   : action == HotkeyAction::Line ? platform::Selection::Line
+                                                                  : platform::Selection::All;
+            std::wstring selected, transformed;
+            Direction direction;
+            double total = 0;
+            auto timed = [&](const std::size_t stage, auto &&f) {
+                const double t = bench::timeOnce(f);
+                stages[stage].samples.push_back(t);
+                total += t;
+            };
+
+            timed(0, [&] { flushModifiers(modifiers); });
+            timed(1, [&] { selected = copyAndFetchSelection(selection); });
+            timed(2, [&] { direction = cycleDirection(detectLayout()); });
+            timed(3, [&] { transformed = transformText(selected, direction); });
+            timed(4, [&] { typeText(transformed); });
+            timed(5, [&] { flipLayout(direction); });
+            stages[6].samples.push_back(total);
+
+            if (selected.empty() || direction.from != 0) bench::fail(std::string(label) + ": nothing copied");
+        }
+
+        std::printf("%s (%zu chars selected)\n", label, desktop.clipboardText().size());
+        for (auto &stage: stages) {
+            bench::reportLatency(std::string("  ") + label + " " + stage.name, std::move(stage.samples));
+        }
+    }
+
+    void quietDefaults() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        config::publish(settings);
+    }
+
+    void pipeline_latency() {
+        quietDefaults();
+
+        SimDesktop desktop;
+        platform::install(desktop.backend());
+
+        const auto document = makeDocument(200);
+        runAction("basic", HotkeyAction::Basic, desktop, document);
+        runAction("line", HotkeyAction::Line, desktop, document);
+        runAction("all", HotkeyAction::All, desktop, document);
+    }
+
+    /// Line against a target that copies after 1 ms but only applies the
+    /// selection after 60 ms, later than the first retry window.
+    void pipeline_slow_selection() {
+        quietDefaults();
+
+        SimDesktop desktop;
+        desktop.setCopyLatency(std::chrono::microseconds(1000));
+        desktop.setSelectLatency(std::chrono::microseconds(60000));
+        platform::install(desktop.backend());
+
+        const auto document = makeDocument(20);
+        const std::size_t lineEnd = document.find(L'\n', document.size() / 2);
+        std::vector<double> samples;
+        for (int i = 0; i < 20; ++i) {
+            desktop.setText(document, lineEnd, lineEnd);
+            std::wstring selected;
+            samples.push_back(bench::timeOnce([&] { selected = copyAndFetchSelection(platform::Selection::Line); }));
+            if (selected.empty()) bench::fail("slow selection: copy never succeeded");
+        }
+        bench::reportLatency("line, selection applied after 60 ms", std::move(samples));
+    }
+}
+
+BENCH_CASE(pipeline_latency);
+BENCH_CASE(pipeline_slow_selection);
@@ -0,0 +1,50 @@
+// this is bench/bench_replacement.cpp
+//
+// End-to-end replacement time versus text length, typing vs pasting. The
+// simulated target charges a fixed cost per injected key event, which is
+// what makes per-character typing slow in real apps. The paste restore
+// delay is set to zero here; in the app it adds PASTE_RESTORE_DELAY_MS.
+
+#include "bench.h"
+#include "clipboard_session.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+namespace {
+    constexpr auto kKeyEventCost = std::chrono::microseconds(10);
+
+    void replacement_strategy() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.PASTE_RESTORE_DELAY_MS = 0;
+
+        SimDesktop desktop;
+        desktop.setKeyEventCost(kKeyEventCost);
+        desktop.setClipboardText(L"previous");
+        platform::install(desktop.backend());
+
+        std::printf("target cost %lld µs per key event\n", static_cast<long long>(kKeyEventCost.count()));
+        std::printf("%10s %14s %14s\n", "chars", "type (ms)", "paste (ms)");
+
+        for (const std::size_t length: {10u, 100u, 1000u, 10000u, 100000u}) {
+            const std::wstring text(length, L'ש');
+            double seconds[2];
+            for (const int paste: {0, 1}) {
+                settings.PASTE_THRESHOLD_CHARS = paste ? 1 : 0;
+                config::publish(settings);
+                seconds[paste] = bench::bestOf(3, [&] {
+                    desktop.setText(L"", 0, 0);
+                    ClipboardSession session(*desktop.backend().clipboard);
+                    replaceSelection(text);
+                    session.restore();
+                });
+                if (desktop.text() != text) bench::fail("replacement text mismatch");
+            }
+            std::printf("%10zu %14.3f %14.3f\n", length, seconds[0] * 1e3, seconds[1] * 1e3);
+        }
+        if (desktop.clipboardText() != L"previous") bench::fail("clipboard not restored after paste");
+    }
+}
+
+BENCH_CASE(replacement_strategy);
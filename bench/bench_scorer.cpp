@@ -0,0 +1,110 @@
+// this is bench/bench_scorer.cpp
+//
+// Direction scoring: model load time, a few correctness checks, and the
+// cost per selection of scoring every run under both language models.
+// The text mixes English words with Hebrew words typed on the English
+// layout, which is what a selection looks like when only part of it was
+// typed in the wrong layout.
+
+#include "bench.h"
+#include "config.h"
+#include "ngram.h"
+
+#include <string>
+#include <vector>
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+
+namespace {
+    const wchar_t *const kEnglish[] = {
+        L"the", L"meeting", L"is", L"moved", L"to", L"tomorrow", L"please", L"send",
+        L"report", L"before", L"lunch", L"thanks", L"and", L"have", L"good", L"day",
+    };
+    const wchar_t *const kHebrew[] = {
+        L"שלום", L"תודה", L"מחר", L"בבוקר", L"הפגישה", L"עם", L"כל", L"הצוות",
+        L"אני", L"שולח", L"את", L"הדוח", L"לפני", L"הצהריים", L"יום", L"טוב",
+    };
+
+    /// Words alternating in runs between English and Hebrew typed on the
+    /// English layout; expected holds what a correct conversion gives.
+    void mixedText(const KeymapTable &toPrimary, const std::size_t length, std::wstring &typed, std::wstring &expected) {
+        typed.clear();
+        expected.clear();
+        for (std::size_t w = 0; typed.size() < length; ++w) {
+            if (w) {
+                typed += L' ';
+                expected += L' ';
+            }
+            const bool hebrew = (w / 3) % 2 == 1;
+            const std::wstring word = hebrew ? kHebrew[w % 16] : kEnglish[w % 16];
+            expected += word;
+            typed += hebrew ? fix(word, toPrimary) : word;
+        }
+        typed.resize(length);
+        expected.resize(length);
+    }
+
+    std::wstring convert(const DirectionScorer &scorer, const std::wstring &text, const Direction preferred) {
+        std::wstring out(text.size(), L'\0');
+        scorer.convert(text.data(), text.size(), out.data(), preferred);
+        return out;
+    }
+
+    void direction_scorer() {
+        const config::Settings settings;
+
+        NgramModelFile english, hebrew;
+        const double load = bench::timeOnce([&] {
+            english = NgramModelFile::open(LF_MODEL_DIR "/english.lfng");
+            hebrew = NgramModelFile::open(LF_MODEL_DIR "/hebrew.lfng");
+        });
+        if (!english.model().valid() || !hebrew.model().valid()) bench::fail("models not found in " LF_MODEL_DIR);
+        std::printf("load both models (mmap): %.1f µs\n", load * 1e6);
+
+        const NgramModel *models[] = {&english.model(), &hebrew.model()};
+        const DirectionScorer scorer(models, settings.KEYMAPS);
+        constexpr Direction toHebrew{0, 1}, toEnglish{1, 0};
+
+        // Only the wrong-layout word changes, whichever layout is active.
+        if (convert(scorer, L"hello akuo world", toHebrew) != L"hello שלום world")
+            bench::fail("mixed run not converted per word");
+        if (convert(scorer, L"akuo", toEnglish) != L"שלום")
+            bench::fail("scorer did not override the active layout");
+        if (convert(scorer, L"hello world", toHebrew) != L"hello world")
+            bench::fail("correct text was converted");
+
+        std::printf("%10s %12s %12s %12s %10s\n", "chars", "p50 (µs)", "p99 (µs)", "ns/char", "words ok");
+        for (const std::size_t length: {50u, 500u, 1000u, 5000u}) {
+            std::wstring typed, expected;
+            mixedText(settings.KEYMAPS.table(toEnglish), length, typed, expected);
+            std::wstring out(length, L'\0');
+
+            std::vector<double> samples;
+            for (int i = 0; i < 2000; ++i) {
+                samples.push_back(bench::timeOnce([&] {
+                    scorer.convert(typed.data(), length, out.data(), toHebrew);
+                }));
+            }
+            bench::keep(out);
+            std::sort(samples.begin(), samples.end());
+            const double p50 = samples[samples.size() / 2], p99 = samples[samples.size() * 99 / 100];
+
+            std::size_t words = 0, right = 0;
+            for (std::size_t i = 0; i < length;) {
+                std::size_t end = expected.find(L' ', i);
+                if (end == std::wstring::npos) end = length;
+                ++words;
+                right += out.compare(i, end - i, expected, i, end - i) == 0;
+                i = end + 1;
+            }
+            std::printf("%10zu %12.2f %12.2f %12.2f %9.0f%%\n", length, p50 * 1e6, p99 * 1e6,
+                        p50 * 1e9 / length, 100.0 * right / words);
+
+            if (length == 1000 && p99 >= 1e-3) bench::fail("scoring a typical selection took 1 ms or more");
+        }
+    }
+}
+
+BENCH_CASE(direction_scorer);
@@ -0,0 +1,144 @@
+// this is bench/bench_script_runs.cpp
+//
+// Selections typed partly in each layout, converted run by run out of the
+// layout each script belongs to. Checks where runs split, what the digits,
+// spaces and the punctuation both layouts type join, that one-script text
+// comes out as the plain table gives it, and the multi-unit path. Then
+// throughput against the plain single-direction table on the same text, in
+// one script and mixed word by word.
+
+#include "bench.h"
+#include "config.h"
+#include "script_runs.h"
+#include "utf8.h"
+
+#include <random>
+#include <string>
+
+namespace {
+    constexpr std::size_t kDocumentChars = 4 << 20;
+    constexpr int kReps = 5;
+
+    struct Layouts {
+        config::Settings settings;
+
+        explicit Layouts(const char *preset) { settings.applyLayoutPreset(preset); }
+
+        ScriptRunConverter converter(const LayoutId active) const {
+            return {settings.KEYMAPS, [this](const LayoutId from) { return settings.nextLayout(from); }, active};
+        }
+    };
+
+    std::wstring inPlace(const ScriptRunConverter &runs, const std::wstring &text) {
+        std::wstring out(text.size(), L'\0');
+        runs.convert(text.data(), text.size(), out.data());
+        return out;
+    }
+
+    std::wstring appending(const ScriptRunConverter &runs, const std::wstring &text) {
+        std::wstring out;
+        runs.convert(text, out);
+        return out;
+    }
+
+    void expect(const ScriptRunConverter &runs, const std::wstring &text, const std::wstring &want) {
+        if (inPlace(runs, text) != want || appending(runs, text) != want) {
+            std::string utf8;
+            encodeUtf8(text, utf8);
+            std::string got;
+            encodeUtf8(inPlace(runs, text), got);
+            bench::fail("\"" + utf8 + "\" split into the wrong runs: " + got);
+        }
+    }
+
+    void checkRuns() {
+        const Layouts hebrew("en-he");
+        const auto &tables = hebrew.settings.KEYMAPS;
+        const auto fromEnglish = hebrew.converter(0), fromHebrew = hebrew.converter(1);
+
+        // Each half out of its own layout, whichever is active.
+        expect(fromEnglish, L"hello שלום akuo", L"יקךךם akuo שלום");
+        expect(fromHebrew, L"hello שלום akuo", L"יקךךם akuo שלום");
+        // A comma after a Hebrew word is Hebrew's; one starting a Latin word
+        // is the Hebrew letter on that key, and so is the dot inside one.
+        expect(fromEnglish, L"שלום, ,usv", L"akuo' תודה");
+        expect(fromEnglish, L"akuo ,usv. nv", L"שלום תודהץ מה");
+        // Digits and spaces join the run before them; leading ones the first run.
+        expect(fromEnglish, L"12 akuo 34 שלום 56", L"12 שלום 34 akuo 56");
+        // A word switching script halfway splits where the script does; a
+        // comma at the switch stays with the letters before it.
+        expect(fromEnglish, L"abcשלום", L"שנבakuo");
+        expect(fromEnglish, L"שלום,abc", L"akuo'שנב");
+        expect(fromEnglish, L"abc,שלום", L"שנבתakuo");
+        expect(fromHebrew, L"שלום/abc.", L"akuoqשנבץ");
+        // Nothing any one layout types: read as the active layout.
+        expect(fromEnglish, L"2, 3.", L"2ת 3ץ");
+        expect(fromHebrew, L"2, 3.", L"2' 3/");
+
+        // Text in one script converts exactly as the table does.
+        const std::wstring english = L"Lorem ipsum, dolor sit amet; 42 (consectetur) adipiscing/elit.";
+        if (inPlace(fromEnglish, english) != fix(english, tables.table({0, 1}))) {
+            bench::fail("one-script text differs from the table");
+        }
+        const std::wstring converted = fix(english, tables.table({0, 1}));
+        if (inPlace(fromEnglish, converted) != fix(converted, tables.table({1, 0}))) {
+            bench::fail("one-script Hebrew differs from the table");
+        }
+
+        // Multi-unit keys: lam-alef on B converts back as one run.
+        const Layouts arabic("en-ar");
+        const auto &arabicTables = arabic.settings.KEYMAPS;
+        std::wstring typed;
+        arabicTables.transducer({0, 1}).apply(L"table", typed);
+        std::wstring want;
+        arabicTables.transducer({1, 0}).apply(typed, want);
+        want += L' ';
+        arabicTables.transducer({0, 1}).apply(L"bob", want);
+        if (appending(arabic.converter(0), typed + L" bob") != want) bench::fail("multi-unit runs converted wrongly");
+        std::printf("runs, neutrals, shared punctuation and multi-unit keys ok\n");
+    }
+
+    /// Lower-case words over a–z; mixed puts every other word through the
+    /// table into the other layout's script.
+    std::wstring makeDocument(const KeymapTable &other, const bool mixed) {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> letter(0, 25), wordLen(1, 9);
+        std::wstring text, word;
+        text.reserve(kDocumentChars + 16);
+        for (bool flip = false; text.size() < kDocumentChars; flip = !flip) {
+            word.clear();
+            for (int n = wordLen(rng); n > 0; --n) word += static_cast<wchar_t>(L'a' + letter(rng));
+            text += mixed && flip ? fix(word, other) : word;
+            text += L' ';
+        }
+        text.resize(kDocumentChars);
+        return text;
+    }
+
+    void throughput() {
+        const Layouts hebrew("en-he");
+        const auto &tables = hebrew.settings.KEYMAPS;
+        const auto runs = hebrew.converter(0);
+
+        for (const bool mixed: {false, true}) {
+            const auto text = makeDocument(tables.table({0, 1}), mixed);
+            std::wstring out(text.size(), L'\0');
+            const double plain = bench::bestOf(kReps, [&] {
+                tables.table({0, 1}).apply(text.data(), text.size(), out.data());
+            });
+            const double segmented = bench::bestOf(kReps, [&] { runs.convert(text.data(), text.size(), out.data()); });
+            const char *what = mixed ? "mixed" : "one script";
+            bench::report(std::string("single-direction table, ") + what, text.size(), plain);
+            bench::report(std::string("script runs, ") + what, text.size(), segmented);
+            std::printf("%-48s %10.1fx\n", (std::string("script runs / table, ") + what).c_str(), segmented / plain);
+            if (segmented > 8 * plain) bench::fail("script runs more than 8x the single-direction table");
+        }
+    }
+
+    void script_runs() {
+        checkRuns();
+        throughput();
+    }
+}
+
+BENCH_CASE(script_runs);
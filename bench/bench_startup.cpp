@@ -0,0 +1,94 @@
+// this is bench/bench_startup.cpp
+//
+// The part of startup before the hotkeys are registered that we control:
+// config::load() with the keymap spelled out in JSON (parsed, then compiled
+// into page tables) against a config that only names a built-in preset.
+// Also checks every preset's compile-time tables against compile().
+
+#include "bench.h"
+#include "config.h"
+#include "layout_presets.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    constexpr int kReps = 50;
+
+    const char *const kKeymapConfig = R"({
+  "DEBUG_MODE": false,
+  "LANG_PRIMARY": 9, "SUBLANG_PRIMARY": 1, "ROLE_NAME_PRIMARY": "English",
+  "LANG_SECONDARY": 13, "SUBLANG_SECONDARY": 1, "ROLE_NAME_SECONDARY": "Hebrew",
+  "KEYMAP_PRIMARY_TO_SECONDARY": {
+    "q": "/", "w": "'", "e": "ק", "r": "ר", "t": "א", "y": "ט", "u": "ו", "i": "ן", "o": "ם", "p": "פ",
+    "a": "ש", "s": "ד", "d": "ג", "f": "כ", "g": "ע", "h": "י", "j": "ח", "k": "ל", "l": "ך", ";": "ף",
+    "'": ",", "z": "ז", "x": "ס", "c": "ב", "v": "ה", "b": "נ", "n": "מ", "m": "צ", ",": "ת", ".": "ץ",
+    "/": "."
+  },
+  "BASIC_HOTKEY_MODIFIERS": ["ctrl"], "BASIC_HOTKEY_VK": "m", "BASIC_HOTKEY_ID": 1
+})";
+
+    const char *const kPresetConfig = R"({
+  "DEBUG_MODE": false,
+  "LAYOUT_PRESET": "en-he",
+  "BASIC_HOTKEY_MODIFIERS": ["ctrl"], "BASIC_HOTKEY_VK": "m", "BASIC_HOTKEY_ID": 1
+})";
+
+    std::string writeConfig(const char *name, const char *json) {
+        const auto path = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream(path, std::ios::binary) << json;
+        return path;
+    }
+
+    bool sameTable(const KeymapTable &a, const KeymapTable &b) {
+        for (std::uint32_t ch = 0; ch < 0x10000; ++ch) {
+            if (a.map(static_cast<wchar_t>(ch)) != b.map(static_cast<wchar_t>(ch))) return false;
+        }
+        return true;
+    }
+
+    void startup_config() {
+        for (const auto &preset: layoutPresets()) {
+            std::unordered_map<wchar_t, wchar_t> map;
+            for (const auto &[from, to]: preset.keys) map[from] = to;
+            if (!sameTable(preset.toSecondary(), KeymapTable::compile(map)) ||
+                !sameTable(preset.toPrimary(), KeymapTable::compile(invertKeymap(map)))) {
+                bench::fail(std::string(preset.name) + ": compile-time table differs from compile()");
+            }
+        }
+        std::printf("%zu presets match compile()\n", layoutPresets().size());
+
+        const std::string keymapPath = writeConfig("lf_bench_keymap.json", kKeymapConfig);
+        const std::string presetPath = writeConfig("lf_bench_preset.json", kPresetConfig);
+
+        std::printf("%-34s %12s %12s\n", "", "first (µs)", "best (µs)");
+        for (const auto &[label, path]: {std::pair{"config.json with KEYMAP", keymapPath},
+                                         std::pair{"config.json with LAYOUT_PRESET", presetPath}}) {
+            const double first = bench::timeOnce([&] { config::load(path); });
+            const double best = bench::bestOf(kReps, [&] { config::load(path); });
+            std::printf("%-34s %12.1f %12.1f\n", label, first * 1e6, best * 1e6);
+            bench::record(std::string(label) + ", first", first * 1e6, "us");
+            bench::record(std::string(label) + ", best", best * 1e6, "us");
+            if (config::current()->KEYMAPS.table({0, 1}).map(L'a') != L'ש') bench::fail(std::string(label) + ": wrong keymap");
+        }
+
+        std::unordered_map<wchar_t, wchar_t> map;
+        for (const auto &[from, to]: findLayoutPreset("en-he")->keys) map[from] = to;
+        const double build = bench::bestOf(kReps, [&] {
+            bench::keep(KeymapTable::compile(map));
+            bench::keep(KeymapTable::compile(invertKeymap(map)));
+        });
+        const double view = bench::bestOf(kReps, [&] {
+            bench::keep(findLayoutPreset("en-he")->toSecondary());
+            bench::keep(findLayoutPreset("en-he")->toPrimary());
+        });
+        std::printf("%-34s %12s %12.1f\n", "build both tables at runtime", "", build * 1e6);
+        std::printf("%-34s %12s %12.3f\n", "use both preset tables", "", view * 1e6);
+
+        std::filesystem::remove(keymapPath);
+        std::filesystem::remove(presetPath);
+    }
+}
+
+BENCH_CASE(startup_config);
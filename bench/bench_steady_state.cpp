@@ -0,0 +1,115 @@
+// this is bench/bench_steady_state.cpp
+//
+// Heap allocations per correction once the worker's buffers are warm: the
+// basic, line and all actions, typed and pasted, converted by layout and
+// through the scorer, with single- and multi-character keys, on selections
+// from one line to a long document.
+// Only runHotkeyAction() is counted, not setting up the simulated desktop
+// in between. Any allocation fails the run.
+
+#include "bench.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <string>
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+
+namespace {
+    constexpr int kCorrections = 20;
+
+    std::wstring makeDocument(const std::size_t lines) {
+        std::wstring text;
+        for (std::size_t line = 0; line < lines; ++line) text += L"akuo gcr ng tbh kt ahk nv ahnt cuex kngv\n";
+        return text;
+    }
+
+    struct Scenario {
+        const char *name;
+        const char *preset;
+        config::DirectionMode mode;
+        int pasteThreshold; // 0 = always typed, 1 = always pasted
+    };
+
+    void select(SimDesktop &desktop, const HotkeyAction action, const std::wstring &document) {
+        // Basic corrects the whole document as its selection; Line and All select for themselves.
+        if (action == HotkeyAction::Basic) desktop.setText(document, 0, document.size());
+        else desktop.setText(document, document.size() - 1, document.size() - 1);
+        desktop.setLang(getLangId(0));
+    }
+
+    /// Allocations made by kCorrections runs of action over document.
+    std::uint64_t count(SimDesktop &desktop, const HotkeyAction action, const std::wstring &document) {
+        std::uint64_t total = 0;
+        for (int i = 0; i < kCorrections; ++i) {
+            select(desktop, action, document);
+            const std::uint64_t before = bench::allocations();
+            runHotkeyAction(action);
+            total += bench::allocations() - before;
+            if (desktop.text() == document) bench::fail("correction changed nothing");
+        }
+        return total;
+    }
+
+    void correction_allocations() {
+        const Scenario scenarios[] = {
+            {"layout, typed", "en-he", config::DirectionMode::Layout, 0},
+            {"layout, pasted", "en-he", config::DirectionMode::Layout, 1},
+            {"scorer, typed", "en-he", config::DirectionMode::Auto, 0},
+            {"scorer, pasted", "en-he", config::DirectionMode::Auto, 1},
+            {"multi-unit, typed", "en-ar", config::DirectionMode::Layout, 0},
+            {"multi-unit, pasted", "en-ar", config::DirectionMode::Layout, 1},
+        };
+        const struct {
+            const char *name;
+            HotkeyAction action;
+        } actions[] = {{"basic", HotkeyAction::Basic}, {"line", HotkeyAction::Line}, {"all", HotkeyAction::All}};
+        const std::wstring documents[] = {makeDocument(1), makeDocument(40), makeDocument(2000)};
+
+        SimDesktop desktop;
+        platform::install(desktop.backend());
+        desktop.setClipboardText(L"what the user had copied");
+
+        std::uint64_t worst = 0;
+        for (const Scenario &scenario: scenarios) {
+            config::Settings settings;
+            settings.DEBUG_MODE = false;
+            settings.applyLayoutPreset(scenario.preset);
+            settings.DIRECTION_MODE = scenario.mode;
+            settings.PASTE_THRESHOLD_CHARS = scenario.pasteThreshold;
+            settings.PASTE_RESTORE_DELAY_MS = 0;
+            for (auto &layout: settings.LAYOUTS) layout.model = LF_MODEL_DIR + layout.model.substr(layout.model.find('/'));
+            config::publish(settings);
+            if (scenario.mode == config::DirectionMode::Auto && !languageModels()) bench::fail("models not found in " LF_MODEL_DIR);
+
+            // Warm up on the longest text, then count on every length.
+            for (const auto &[name, action]: actions) {
+                for (int i = 0; i < 2; ++i) {
+                    select(desktop, action, documents[2]);
+                    runHotkeyAction(action);
+                }
+            }
+            for (const auto &[name, action]: actions) {
+                std::printf("%-18s %-6s", scenario.name, name);
+                for (const auto &document: documents) {
+                    const std::uint64_t allocations = count(desktop, action, document);
+                    const double perCorrection = static_cast<double>(allocations) / kCorrections;
+                    std::printf("  %6zu chars: %5.2f allocs", action == HotkeyAction::Line ? document.find(L'\n') + 1
+                                                                                                : document.size(),
+                                perCorrection);
+                    bench::record(std::string(scenario.name) + "/" + name + "/" + std::to_string(document.size()),
+                                  perCorrection, "allocs/correction");
+                    worst = std::max(worst, allocations);
+                }
+                std::printf("\n");
+            }
+        }
+        if (worst > 0) bench::fail("a warm correction allocated");
+        std::printf("no allocations once warm\n");
+    }
+}
+
+BENCH_CASE(correction_allocations);
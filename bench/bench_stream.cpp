@@ -0,0 +1,197 @@
+// this is bench/bench_stream.cpp
+//
+// Bulk conversion through the reader → transform → writer pipeline, as
+// language_flipper_cli runs it. Checks that chunking, thread count and a
+// streamed source don't change the output, then reports GB/s on a large
+// in-memory document next to plain memcpy and next to applyUtf8() alone on
+// one thread, forced and scored. The last shows what the pipeline itself
+// costs; the gap to memcpy is the per-character work.
+
+#include "bench.h"
+#include "config.h"
+#include "ngram.h"
+#include "stream_convert.h"
+#include "utf8.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+
+namespace {
+    constexpr std::size_t kDocumentBytes = 64 << 20;
+    constexpr int kReps = 3;
+
+    const wchar_t *const kWords[] = {
+        L"the", L"meeting", L"is", L"moved", L"to", L"tomorrow", L"please", L"send",
+        L"report", L"before", L"lunch", L"thanks", L"and", L"have", L"good", L"day",
+    };
+
+    class StringSink final : public ByteSink {
+    public:
+        bool write(const std::string_view bytes) override {
+            text.append(bytes);
+            return true;
+        }
+        std::string text;
+    };
+
+    /// Keeps nothing, so the numbers are the pipeline's own.
+    class NullSink final : public ByteSink {
+    public:
+        bool write(const std::string_view bytes) override {
+            last = bytes.empty() ? 0 : bytes.back();
+            return true;
+        }
+        char last = 0;
+    };
+
+    /// Hands out a string in small, uneven reads, like a pipe.
+    class PipeSource final : public ByteSource {
+    public:
+        explicit PipeSource(const std::string_view text) : text_(text) {
+        }
+        std::size_t read(char *dst, const std::size_t capacity) override {
+            const std::size_t n = std::min({capacity, text_.size(), std::size_t{4093}});
+            std::memcpy(dst, text_.data(), n);
+            text_.remove_prefix(n);
+            return n;
+        }
+
+    private:
+        std::string_view text_;
+    };
+
+    /// English sentences typed on the Hebrew layout, as UTF-8 lines.
+    std::string makeDocument(const KeymapTable &toHebrew, const std::size_t bytes) {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<std::size_t> pick(0, std::size(kWords) - 1);
+        std::uniform_int_distribution<int> roll(0, 99);
+        std::wstring line;
+        std::string text;
+        text.reserve(bytes + 256);
+        while (text.size() < bytes) {
+            line.clear();
+            for (int w = 0; w < 12; ++w) {
+                if (w) line += L' ';
+                line += fix(kWords[pick(rng)], toHebrew);
+            }
+            line += roll(rng) < 10 ? L"\r\n" : L"\n";
+            encodeUtf8(line, text);
+        }
+        return text;
+    }
+
+    std::string reference(const LayoutMatrix &keymaps, const Direction direction, const std::string_view text) {
+        std::wstring wide, converted;
+        decodeUtf8(text, wide);
+        keymaps.transducer(direction).apply(wide, converted);
+        std::string out;
+        encodeUtf8(converted, out);
+        return out;
+    }
+
+    void checkOrder(const config::Settings &settings) {
+        const Direction toEnglish{1, 0};
+        const std::string text = makeDocument(settings.KEYMAPS.table({0, 1}), 1 << 20);
+        const std::string expected = reference(settings.KEYMAPS, toEnglish, text);
+
+        for (const unsigned workers: {1u, 3u, 8u}) {
+            StreamConverter::Options options;
+            options.direction = toEnglish;
+            options.workers = workers;
+            options.chunkBytes = 4096;
+            const StreamConverter converter(settings.KEYMAPS, {}, options);
+
+            StringSink mapped;
+            converter.run(text, mapped);
+            if (mapped.text != expected) bench::fail("chunked conversion differs with " + std::to_string(workers) + " threads");
+
+            StringSink piped;
+            PipeSource source(text);
+            converter.run(source, piped);
+            if (piped.text != expected) bench::fail("piped conversion differs with " + std::to_string(workers) + " threads");
+        }
+
+        // A chunk boundary inside a word with no whitespace for a whole chunk.
+        const std::string word(10000, 'a');
+        StreamConverter::Options options;
+        options.direction = {0, 1};
+        options.chunkBytes = 1000;
+        StringSink sink;
+        StreamConverter(settings.KEYMAPS, {}, options).run(word, sink);
+        if (sink.text != reference(settings.KEYMAPS, {0, 1}, word)) bench::fail("unbroken text split wrongly");
+
+        // Multi-unit keys (lam-alef on B) convert UTF-8 to UTF-8 without decoding.
+        std::unordered_map<wchar_t, wchar_t> arabic;
+        for (const auto &[from, to]: findLayoutPreset("en-ar")->keys) arabic.try_emplace(from, to);
+        arabic.erase(L'b');
+        const std::unordered_map<wchar_t, wchar_t> english;
+        const std::vector<KeymapRule> none, sequences = {{L"b", L"لا"}};
+        const std::unordered_map<wchar_t, wchar_t> *keys[] = {&english, &arabic};
+        const std::vector<KeymapRule> *rules[] = {&none, &sequences};
+        const auto matrix = LayoutMatrix::build(keys, rules);
+        const std::string typed = makeDocument(KeymapTable(), 1 << 20);
+        options.direction = {0, 1};
+        options.workers = 3;
+        options.chunkBytes = 4096;
+        StringSink arabicSink;
+        StreamConverter(matrix, {}, options).run(typed, arabicSink);
+        if (arabicSink.text != reference(matrix, {0, 1}, typed)) bench::fail("multi-unit chunks differ");
+        std::printf("1 MiB in 4 KiB chunks: same output for 1, 3 and 8 threads, mapped and piped, with multi-unit keys\n");
+    }
+
+    void throughput(const config::Settings &settings) {
+        const std::string text = makeDocument(settings.KEYMAPS.table({0, 1}), kDocumentBytes);
+        std::printf("document: %.1f MiB, %u hardware threads\n", text.size() / 1048576.0,
+                    std::thread::hardware_concurrency());
+
+        std::string copy(text.size(), '\0');
+        const double copySeconds = bench::bestOf(kReps, [&] { std::memcpy(copy.data(), text.data(), text.size()); });
+        std::printf("%-36s %8.2f GB/s\n", "memcpy", text.size() / copySeconds / 1e9);
+
+        auto measure = [&](const char *label, const StreamConverter &converter) {
+            NullSink sink;
+            StreamConverter::Stats stats;
+            const double seconds = bench::bestOf(kReps, [&] { stats = converter.run(text, sink); });
+            std::printf("%-36s %8.2f GB/s  (%u threads, %llu chunks, %.0f%% of memcpy)\n", label,
+                        text.size() / seconds / 1e9, stats.workers, static_cast<unsigned long long>(stats.chunks),
+                        100.0 * copySeconds / seconds);
+        };
+
+        const KeymapTransducer &toEnglish = settings.KEYMAPS.transducer({1, 0});
+        std::string converted(text.size() + 64, '\0');
+        const double transformSeconds = bench::bestOf(kReps, [&] { bench::keep(toEnglish.applyUtf8(text, converted)); });
+        std::printf("%-36s %8.2f GB/s  (%.0f%% of memcpy)\n", "applyUtf8 alone, Hebrew→English",
+                    text.size() / transformSeconds / 1e9, 100.0 * copySeconds / transformSeconds);
+
+        for (const unsigned workers: {1u, 2u, 4u}) {
+            StreamConverter::Options options;
+            options.direction = {1, 0};
+            options.workers = workers;
+            measure(("forced Hebrew→English, " + std::to_string(workers) + " thr").c_str(),
+                    StreamConverter(settings.KEYMAPS, {}, options));
+        }
+
+        const auto english = NgramModelFile::open(LF_MODEL_DIR "/english.lfng");
+        const auto hebrew = NgramModelFile::open(LF_MODEL_DIR "/hebrew.lfng");
+        if (!english.model().valid() || !hebrew.model().valid()) bench::fail("models not built");
+        const NgramModel *models[] = {&english.model(), &hebrew.model()};
+        measure("scored per run", StreamConverter(settings.KEYMAPS, models, {}));
+    }
+
+    void stream_convert() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        config::publish(settings);
+        checkOrder(settings);
+        throughput(settings);
+    }
+}
+
+BENCH_CASE(stream_convert);
@@ -0,0 +1,147 @@
+// this is bench/bench_transducer.cpp
+//
+// Keymaps with keys longer than one code unit. Checks longest-match
+// semantics, combining marks, surrogate pairs and dead keys, and that a
+// layout typing two letters on one key round-trips through the matrix.
+// Then throughput: a keymap without such keys must run as fast as the plain
+// page table, and one with them is timed on the same English text.
+
+#include "bench.h"
+#include "config.h"
+#include "keymap.h"
+#include "keymap_transducer.h"
+#include "layout_matrix.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+    using Keys = std::unordered_map<wchar_t, wchar_t>;
+
+    constexpr std::size_t kDocumentChars = 4 << 20;
+    constexpr int kReps = 5;
+
+    std::wstring convert(const KeymapTransducer &transducer, const std::wstring &text) {
+        std::wstring out;
+        transducer.apply(text, out);
+        return out;
+    }
+
+    void expect(const char *what, const std::wstring &got, const std::wstring &want) {
+        if (got != want) bench::fail(std::string(what) + " converted wrongly");
+    }
+
+    void checkRules() {
+        const std::vector<KeymapRule> rules = {
+            {L"ab", L"X"}, {L"abcd", L"Y"}, {L"b", L"Z"},
+            {L"é", L"é"},                   // base letter + combining acute
+            {std::wstring{wchar_t(0xD83D), wchar_t(0xDE00)}, L":)"}, // a surrogate pair as UTF-16 units
+            {L"ab", L"ignored"},                  // the first rule for a source wins
+        };
+        const auto transducer = KeymapTransducer::compile(KeymapTable(), rules);
+        expect("longest match", convert(transducer, L"abcabcdxab bb"), L"XcYxX ZZ");
+        expect("combining mark", convert(transducer, L"café"), L"café");
+        expect("surrogate pair", convert(transducer, std::wstring{L'[', wchar_t(0xD83D), wchar_t(0xDE00), L']'}),
+               L"[:)]");
+        expect("table between matches", convert(transducer, L"HELLO"), L"hello");
+
+        // Through config: multi-character entries become sequences.
+        config::Layout layout;
+        config::parse_keys(nlohmann::json::parse(R"({"q": "/", "b": "لا", "`e": "è"})"), layout);
+        if (layout.keys.size() != 1 || layout.sequences.size() != 2) bench::fail("parse_keys dropped multi-unit keys");
+
+        // US English and an Arabic layout typing lam-alef on B, plus dead keys.
+        const Keys english;
+        Keys arabic;
+        for (const auto &[from, to]: findLayoutPreset("en-ar")->keys) arabic.try_emplace(from, to);
+        arabic.erase(L'b');
+        const std::vector<KeymapRule> arabicSequences = {{L"b", L"لا"}, {L"`e", L"è"}};
+        const std::vector<KeymapRule> none;
+        const Keys *keys[] = {&english, &arabic};
+        const std::vector<KeymapRule> *sequences[] = {&none, &arabicSequences};
+        const auto matrix = LayoutMatrix::build(keys, sequences);
+
+        const std::wstring typed = L"table `e bob";
+        const std::wstring arabicText = convert(matrix.transducer({0, 1}), typed);
+        if (arabicText.find(L"لا") == std::wstring::npos || arabicText.find(L'è') == std::wstring::npos) {
+            bench::fail("English→Arabic did not produce the sequences");
+        }
+        expect("Arabic→English round trip", convert(matrix.transducer({1, 0}), arabicText), typed);
+        if (matrix.singleUnit() || !KeymapTransducer(matrix.table({0, 1})).singleUnit()) {
+            bench::fail("singleUnit() reports the wrong tables");
+        }
+        std::printf("longest match, combining marks, surrogate pairs and dead keys ok\n");
+    }
+
+    /// Lower-case words over a–z (plus the dead-key accent now and then).
+    std::wstring makeDocument(const std::size_t chars, const bool deadKeys) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> letter(0, 25), wordLen(1, 9), roll(0, 99);
+        std::wstring text;
+        text.reserve(chars + 16);
+        while (text.size() < chars) {
+            for (int n = wordLen(rng); n > 0; --n) {
+                if (deadKeys && roll(rng) < 3) text += L'`';
+                text += static_cast<wchar_t>(L'a' + letter(rng));
+            }
+            text += L' ';
+        }
+        text.resize(chars);
+        return text;
+    }
+
+    void throughput() {
+        Keys arabic;
+        for (const auto &[from, to]: findLayoutPreset("en-ar")->keys) arabic.try_emplace(from, to);
+        const Keys english;
+        const std::vector<KeymapRule> none;
+
+        // Single-unit keys only: the transducer is the page table.
+        {
+            const Keys *keys[] = {&english, &arabic};
+            const auto matrix = LayoutMatrix::build(keys);
+            const auto &transducer = matrix.transducer({0, 1});
+            const auto text = makeDocument(kDocumentChars, false);
+
+            std::wstring viaTable, viaTransducer;
+            const double tableSeconds = bench::bestOf(kReps, [&] { viaTable = fix(text, matrix.table({0, 1})); });
+            const double transducerSeconds = bench::bestOf(kReps, [&] { viaTransducer = convert(transducer, text); });
+            if (viaTable != viaTransducer) bench::fail("single-unit transducer differs from the table");
+            bench::report("single-unit page table", text.size(), tableSeconds);
+            bench::report("single-unit transducer", text.size(), transducerSeconds);
+            if (transducerSeconds > 1.3 * tableSeconds) bench::fail("single-unit transducer slower than the table");
+        }
+
+        // Lam-alef on B and Latin dead keys: B and ` start rules.
+        {
+            Keys withSequences = arabic;
+            withSequences.erase(L'b');
+            std::vector<KeymapRule> sequences = {{L"b", L"لا"}};
+            for (wchar_t ch = L'a'; ch <= L'z'; ++ch) {
+                const wchar_t accented = ch == L'a' ? L'à' : ch == L'e' ? L'è' : ch == L'i' ? L'ì' : ch == L'o' ? L'ò'
+                                         : ch == L'u' ? L'ù' : L'\0';
+                if (accented) sequences.push_back({std::wstring{L'`', ch}, std::wstring(1, accented)});
+            }
+            const Keys *keys[] = {&english, &withSequences};
+            const std::vector<KeymapRule> *rules[] = {&none, &sequences};
+            const auto matrix = LayoutMatrix::build(keys, rules);
+            const auto text = makeDocument(kDocumentChars, true);
+
+            std::wstring converted, back;
+            const double forward = bench::bestOf(kReps, [&] { converted = convert(matrix.transducer({0, 1}), text); });
+            const double backward = bench::bestOf(kReps, [&] { back = convert(matrix.transducer({1, 0}), converted); });
+            // G then H also types lam-alef, so compare as Arabic text.
+            if (convert(matrix.transducer({0, 1}), back) != converted) bench::fail("multi-unit round trip differs");
+            bench::report("multi-unit English→Arabic", text.size(), forward);
+            bench::report("multi-unit Arabic→English", converted.size(), backward);
+            std::printf("%-48s %10zu\n", "trie states (English→Arabic)", matrix.transducer({0, 1}).states());
+        }
+    }
+
+    void keymap_transducer() {
+        checkRules();
+        throughput();
+    }
+}
+
+BENCH_CASE(keymap_transducer);
@@ -0,0 +1,274 @@
+// this is bench/bench_typing.cpp
+//
+// As-you-type detection, replayed from keystroke streams: the English and
+// Hebrew corpora typed key by key, every third sentence started in the
+// wrong layout, with the odd typo taken back with Backspace. A stream
+// records physical keys (as what US QWERTY types on them), so what lands
+// depends on the layout active at each key, which the watcher flips as it
+// fixes words. The run checks what was caught against what was meant and
+// that words typed right are left alone, then what a key costs the hook.
+// The models were trained on these same sentences, so the rates are the
+// best case; the per-key cost is not.
+
+#include "bench.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "typing_watcher.h"
+#include "utf8.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef LF_MODEL_DIR
+#define LF_MODEL_DIR "models"
+#endif
+#ifndef LF_CORPUS_DIR
+#define LF_CORPUS_DIR "res/corpus"
+#endif
+
+namespace {
+    constexpr LayoutId kEnglish = 0, kHebrew = 1;
+
+    /// One recorded key: a physical key, or the user switching layout by hand.
+    struct Stroke {
+        enum class Kind { Key, Backspace, Switch } kind;
+        wchar_t key = 0;             // what US QWERTY types on it
+        LayoutId layout = NO_LAYOUT; // Switch only
+    };
+
+    struct Recording {
+        std::vector<Stroke> strokes;
+        std::wstring meant; // the text the user had in mind
+    };
+
+    std::vector<std::wstring> readLines(const char *path) {
+        std::ifstream file(path, std::ios::binary);
+        const std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::wstring text;
+        decodeUtf8(bytes, text);
+        std::vector<std::wstring> lines;
+        for (std::size_t start = 0; start < text.size();) {
+            std::size_t end = text.find(L'\n', start);
+            if (end == std::wstring::npos) end = text.size();
+            std::wstring line = text.substr(start, end - start);
+            if (!line.empty() && line.back() == L'\r') line.pop_back();
+            if (!line.empty()) lines.push_back(std::move(line));
+            start = end + 1;
+        }
+        return lines;
+    }
+
+    /// Sentences of both corpora in turn, each ended with Enter.
+    Recording record(const config::Settings &settings) {
+        const auto english = readLines(LF_CORPUS_DIR "/english.txt");
+        const auto hebrew = readLines(LF_CORPUS_DIR "/hebrew.txt");
+        if (english.empty() || hebrew.empty()) bench::fail("corpus not found in " LF_CORPUS_DIR);
+        const KeymapTable &hebrewKeys = settings.KEYMAPS.table({kHebrew, kEnglish});
+
+        Recording recording;
+        std::size_t keys = 0;
+        for (std::size_t s = 0; s < 2 * std::min(english.size(), hebrew.size()); ++s) {
+            const bool isHebrew = s % 2 == 1;
+            const std::wstring &sentence = isHebrew ? hebrew[s / 2] : english[s / 2];
+            // Two sentences in three the user remembers to switch first.
+            const LayoutId meant = isHebrew ? kHebrew : kEnglish;
+            if (s % 3 != 2) recording.strokes.push_back({Stroke::Kind::Switch, 0, meant});
+            for (const wchar_t ch: sentence) {
+                const wchar_t key = isHebrew ? hebrewKeys.map(ch) : ch;
+                if (++keys % 23 == 0 && ch != L' ') {
+                    recording.strokes.push_back({Stroke::Kind::Key, key == L'q' ? L'w' : L'q'});
+                    recording.strokes.push_back({Stroke::Kind::Backspace});
+                }
+                recording.strokes.push_back({Stroke::Kind::Key, key});
+            }
+            recording.strokes.push_back({Stroke::Kind::Key, L'\r'});
+            recording.meant += sentence;
+            recording.meant += L'\r';
+        }
+        return recording;
+    }
+
+    LayoutId layoutOf(const config::Settings &settings, const LANGID lang) {
+        for (std::size_t i = 0; i < settings.LAYOUTS.size(); ++i) {
+            if (settings.LAYOUTS[i].langId() == lang) return static_cast<LayoutId>(i);
+        }
+        return NO_LAYOUT;
+    }
+
+    /// What a key types in layout.
+    wchar_t typedOn(const config::Settings &settings, const wchar_t key, const LayoutId layout) {
+        if (key == L' ' || key == L'\r' || layout == kEnglish) return key;
+        return settings.KEYMAPS.table({kEnglish, layout}).map(key);
+    }
+
+    std::vector<std::wstring> words(const std::wstring &text) {
+        std::vector<std::wstring> out(1);
+        for (const wchar_t ch: text) {
+            if (ch == L' ' || ch == L'\r') {
+                if (!out.back().empty()) out.emplace_back();
+            } else {
+                out.back() += ch;
+            }
+        }
+        if (out.back().empty()) out.pop_back();
+        return out;
+    }
+
+    /// Equal but for case: a capital typed on a layout without case can't come back.
+    bool sameWord(const std::wstring &a, const std::wstring &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const wchar_t x, const wchar_t y) {
+            return NgramModel::symbol(x) == NgramModel::symbol(y);
+        });
+    }
+
+    std::unique_ptr<TypingWatcher> makeWatcher(const config::Settings &settings) {
+        std::vector<NgramModelFile> files;
+        for (const auto &layout: settings.LAYOUTS) {
+            files.push_back(NgramModelFile::open(layout.model));
+            if (!files.back().model().valid()) bench::fail("models not found in " LF_MODEL_DIR);
+        }
+        return std::make_unique<TypingWatcher>(settings, std::move(files));
+    }
+
+    /// Replay through a watcher fixing words on the desktop; typed gets
+    /// what the keys put down before any fix.
+    void replay(const config::Settings &settings, const Recording &recording, SimDesktop &desktop,
+                TypingWatcher &watcher, std::wstring &typed) {
+        auto &input = *platform::current().input;
+        desktop.setText(L"", 0, 0);
+        desktop.setLang(getLangId(kEnglish));
+        typed.clear();
+        for (const Stroke &stroke: recording.strokes) {
+            switch (stroke.kind) {
+                case Stroke::Kind::Switch:
+                    desktop.setLang(getLangId(stroke.layout));
+                    break;
+                case Stroke::Kind::Backspace:
+                    typed.pop_back();
+                    if (!watcher.press({KeyPress::Kind::Backspace, 0, desktop.lang()})) input.retype(1, {});
+                    break;
+                case Stroke::Kind::Key: {
+                    const wchar_t ch = typedOn(settings, stroke.key, layoutOf(settings, desktop.lang()));
+                    typed += ch;
+                    if (!watcher.press({KeyPress::Kind::Text, ch, desktop.lang()})) input.typeText({&ch, 1});
+                    break;
+                }
+            }
+        }
+    }
+
+    void checkCatches(const config::Settings &settings, const Recording &recording, SimDesktop &desktop) {
+        auto watcher = makeWatcher(settings);
+        std::wstring typed;
+        replay(settings, recording, desktop, *watcher, typed);
+
+        const auto meant = words(recording.meant), before = words(typed), after = words(desktop.text());
+        if (meant.size() != before.size() || meant.size() != after.size()) bench::fail("replay lost word boundaries");
+        std::size_t wrong = 0, caught = 0, tooShort = 0, right = 0, broken = 0;
+        for (std::size_t i = 0; i < meant.size(); ++i) {
+            if (before[i] == meant[i]) {
+                ++right;
+                broken += after[i] != meant[i];
+            } else if (before[i].size() < static_cast<std::size_t>(settings.AS_YOU_TYPE_MIN_CHARS)) {
+                ++tooShort;
+            } else {
+                ++wrong;
+                caught += sameWord(after[i], meant[i]);
+            }
+        }
+        const auto stats = watcher->stats();
+        std::printf("%zu keys, %zu words: %zu typed in the wrong layout, %zu caught (%.0f%%), %zu too short to judge\n",
+                    recording.strokes.size(), meant.size(), wrong, caught, 100.0 * caught / std::max<std::size_t>(wrong, 1),
+                    tooShort);
+        std::printf("%zu typed right, %zu of them converted by mistake; %llu judged, %llu fixed\n", right, broken,
+                    static_cast<unsigned long long>(stats.words), static_cast<unsigned long long>(stats.fixed));
+        bench::record("caught", 100.0 * caught / std::max<std::size_t>(wrong, 1), "%", false);
+        bench::record("false fixes", static_cast<double>(broken), "words");
+        if (caught * 10 < wrong * 8) bench::fail("fewer than 80% of wrong-layout words caught");
+        if (broken * 100 > right) bench::fail("more than 1% of correct words converted");
+    }
+
+    void checkOffer(const config::Settings &base, SimDesktop &desktop) {
+        config::Settings settings = base;
+        settings.AS_YOU_TYPE = config::TypingMode::Offer;
+        config::publish(settings);
+        auto &input = *platform::current().input;
+        const KeyPress hotkey{KeyPress::Kind::Other, 0, getLangId(kEnglish), settings.BASIC_HOTKEY_MODIFIERS,
+                              settings.BASIC_HOTKEY_VK};
+
+        for (const bool take: {true, false}) {
+            auto watcher = makeWatcher(settings);
+            desktop.setText(L"", 0, 0);
+            desktop.setLang(getLangId(kEnglish));
+            watcher->press({KeyPress::Kind::Text, L' ', desktop.lang()});
+            input.typeText(L" ");
+            for (const wchar_t ch: std::wstring(L"akuo ")) {
+                if (watcher->press({KeyPress::Kind::Text, ch, desktop.lang()})) bench::fail("offer mode retyped by itself");
+                input.typeText({&ch, 1});
+            }
+            if (watcher->stats().offered != 1) bench::fail("wrong-layout word not offered");
+            if (!take) watcher->press({KeyPress::Kind::Text, L'x', desktop.lang()});
+            const bool used = watcher->press(hotkey);
+            if (used != take || desktop.text() != (take ? L" שלום " : L" akuo ")) bench::fail("offer not taken by the hotkey alone");
+        }
+        std::printf("offer: the basic hotkey right after the word converts it; any other key first drops it\n");
+        config::publish(base);
+    }
+
+    void cost(config::Settings settings, const Recording &recording) {
+        // Offers never type, so this is the scoring alone on every key.
+        settings.AS_YOU_TYPE = config::TypingMode::Offer;
+        config::publish(settings);
+        auto watcher = makeWatcher(settings);
+
+        std::vector<KeyPress> keys;
+        LayoutId layout = kEnglish;
+        for (const Stroke &stroke: recording.strokes) {
+            if (stroke.kind == Stroke::Kind::Switch) layout = stroke.layout;
+            else if (stroke.kind == Stroke::Kind::Backspace) keys.push_back({KeyPress::Kind::Backspace, 0, getLangId(layout)});
+            else keys.push_back({KeyPress::Kind::Text, typedOn(settings, stroke.key, layout), getLangId(layout)});
+        }
+
+        std::vector<double> samples;
+        samples.reserve(keys.size() * 5);
+        const std::uint64_t allocations = bench::allocations();
+        for (int pass = 0; pass < 5; ++pass) {
+            for (const KeyPress &key: keys) samples.push_back(bench::timeOnce([&] { watcher->press(key); }));
+        }
+        const std::uint64_t allocated = bench::allocations() - allocations;
+        bench::reportLatency("per key", samples);
+
+        const double total = bench::bestOf(5, [&] {
+            for (const KeyPress &key: keys) watcher->press(key);
+        });
+        std::printf("%.1f ns per key over the stream, %llu allocations in %zu keys\n", total * 1e9 / keys.size(),
+                    static_cast<unsigned long long>(allocated), samples.size());
+        bench::record("per key", total * 1e9 / keys.size(), "ns");
+        if (allocated != 0) bench::fail("scoring a key allocates");
+    }
+
+    void typing_watch() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.AS_YOU_TYPE = config::TypingMode::Fix;
+        settings.AUTO_FLIP_ON_CHANGE = true;
+        for (auto &layout: settings.LAYOUTS) layout.model = LF_MODEL_DIR + layout.model.substr(layout.model.find('/'));
+        config::publish(settings);
+
+        SimDesktop desktop;
+        platform::install(desktop.backend());
+        const Recording recording = record(settings);
+
+        checkCatches(settings, recording, desktop);
+        checkOffer(settings, desktop);
+        cost(settings, recording);
+        settings.AS_YOU_TYPE = config::TypingMode::Off;
+        config::publish(settings);
+    }
+}
+
+BENCH_CASE(typing_watch);
@@ -0,0 +1,190 @@
+// this is bench/bench_utf8_codec.cpp
+//
+// The UTF-8 ↔ wchar_t codec. Every kernel this CPU runs must give the
+// scalar kernel's output and error report on random text, valid and not,
+// cut at every alignment the vector blocks see. Then decode and encode
+// speed on mixed Hebrew/Latin text and on plain English, next to
+// std::wstring_convert, which config used before.
+
+#include "bench.h"
+#include "keymap.h"
+#include "utf8.h"
+
+#include <codecvt>
+#include <locale>
+#include <random>
+#include <string>
+
+namespace {
+    constexpr std::size_t kDocumentBytes = 16 << 20;
+    constexpr int kReps = 5;
+
+    const KeymapKernel kKernels[] = {KeymapKernel::Scalar, KeymapKernel::Sse42, KeymapKernel::Avx2};
+
+    bool runs(const KeymapKernel kernel) {
+        return static_cast<int>(kernel) <= static_cast<int>(bestKeymapKernel());
+    }
+
+    /// Mostly what the vector blocks take, with the odd character they don't.
+    std::string makeBytes(std::mt19937 &rng, const std::size_t pieces, const bool malformed) {
+        static const char *const kValid[] = {"a", "Z", " ", "\n", "ש", "ל", "ם", "ж", "λ", "ب", "é", "€", "😀", "ab", "שלום "};
+        static const char *const kBad[] = {"\xFF", "\x80", "\xC0\x80", "\xC1\xBF", "\xED\xA0\x80", "\xE2\x82", "\xF0\x9F\x98",
+                                           "\xF5\x80\x80\x80", "\xD7"};
+        std::uniform_int_distribution<std::size_t> valid(0, std::size(kValid) - 1), bad(0, std::size(kBad) - 1);
+        std::uniform_int_distribution<int> roll(0, 99);
+        std::string text;
+        for (std::size_t i = 0; i < pieces; ++i) text += malformed && roll(rng) < 4 ? kBad[bad(rng)] : kValid[valid(rng)];
+        return text;
+    }
+
+    /// Units the vector blocks take and the edges of what they don't.
+    std::wstring makeUnits(std::mt19937 &rng, const std::size_t count) {
+        static const unsigned kUnits[] = {'a', ' ', 0x7F, 0x80, 0x5D0, 0x7FF, 0x800, 0x20AC, 0xFFFD, 0xFFFF,
+                                          0xD83D, 0xDE00, 0xDC00, 0x10000, 0x1F600, 0x10FFFF, 0x110000};
+        std::uniform_int_distribution<std::size_t> pick(0, std::size(kUnits) - 1);
+        std::uniform_int_distribution<int> roll(0, 99);
+        std::wstring text;
+        for (std::size_t i = 0; i < count; ++i) {
+            unsigned unit = roll(rng) < 70 ? static_cast<unsigned>(roll(rng) < 50 ? 'a' + roll(rng) % 26 : 0x5D0 + roll(rng) % 27)
+                                           : kUnits[pick(rng)];
+            if (sizeof(wchar_t) == 2) unit &= 0xFFFF;
+            text += static_cast<wchar_t>(unit);
+        }
+        return text;
+    }
+
+    bool sameStatus(const Utf8Status a, const Utf8Status b) {
+        return a.errors == b.errors && (a.ok() || a.firstError == b.firstError);
+    }
+
+    void checkKernels() {
+        std::mt19937 rng(3);
+        for (int round = 0; round < 400; ++round) {
+            const std::string bytes = makeBytes(rng, 1 + round % 97, round % 3 == 0);
+            const std::wstring units = makeUnits(rng, 1 + round % 89);
+            for (std::size_t skip = 0; skip < 4 && skip < bytes.size(); ++skip) {
+                const std::string_view in = std::string_view(bytes).substr(skip);
+                std::wstring want;
+                const Utf8Status wantStatus = decodeUtf8(in, want, KeymapKernel::Scalar);
+                std::string back;
+                if (wantStatus.ok() && (!encodeUtf8(want, back, KeymapKernel::Scalar).ok() || back != in)) {
+                    bench::fail("valid UTF-8 did not round-trip");
+                }
+                for (const KeymapKernel kernel: kKernels) {
+                    if (!runs(kernel)) continue;
+                    std::wstring got = L"x"; // appends after what is there
+                    if (!sameStatus(decodeUtf8(in, got, kernel), wantStatus) || got != L"x" + want) {
+                        bench::fail(std::string("decode differs on ") + keymapKernelName(kernel));
+                    }
+                }
+            }
+
+            std::string want;
+            const Utf8Status wantStatus = encodeUtf8(units, want, KeymapKernel::Scalar);
+            for (const KeymapKernel kernel: kKernels) {
+                if (!runs(kernel)) continue;
+                std::string got = "x";
+                if (!sameStatus(encodeUtf8(units, got, kernel), wantStatus) || got != "x" + want) {
+                    bench::fail(std::string("encode differs on ") + keymapKernelName(kernel));
+                }
+            }
+        }
+
+        // Errors are counted and placed.
+        std::wstring wide;
+        const Utf8Status bad = decodeUtf8("ab\xFF\xC3(cd", wide);
+        if (bad.errors != 2 || bad.firstError != 2 || wide != L"ab��(cd") bench::fail("decode errors misreported");
+        std::string narrow;
+        const Utf8Status lone = encodeUtf8(std::wstring{L'x', wchar_t(0xDC00), L'y'}, narrow);
+        if (lone.errors != 1 || lone.firstError != 1 || narrow != "x\xEF\xBF\xBDy") bench::fail("encode errors misreported");
+        std::printf("kernels agree with scalar on valid and malformed text (best: %s)\n",
+                    keymapKernelName(bestKeymapKernel()));
+    }
+
+    /// Words picked from the list, with spaces and the odd full stop between them.
+    template<std::size_t N>
+    std::string makeDocument(const char *const (&words)[N]) {
+        std::mt19937 rng(9);
+        std::uniform_int_distribution<std::size_t> pick(0, N - 1);
+        std::string text;
+        text.reserve(kDocumentBytes + 64);
+        while (text.size() < kDocumentBytes) {
+            text += words[pick(rng)];
+            text += rng() % 11 == 0 ? ".\n" : " ";
+        }
+        return text;
+    }
+
+    void throughput(const char *name, const std::string &text) {
+        std::wstring wide;
+        decodeUtf8(text, wide);
+        std::printf("%s: %.1f MiB, %zu characters\n", name, text.size() / 1048576.0, wide.size());
+
+        auto line = [&](const std::string &name, const double seconds) {
+            std::printf("%-36s %8.2f GB/s %8.3f ns/byte\n", name.c_str(), text.size() / seconds / 1e9,
+                        seconds * 1e9 / text.size());
+        };
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#elif defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4996)
+#endif
+        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> convert;
+        std::wstring viaCodecvt;
+        std::string backViaCodecvt;
+        const double codecvtDecode = bench::bestOf(kReps, [&] { viaCodecvt = convert.from_bytes(text); });
+        const double codecvtEncode = bench::bestOf(kReps, [&] { backViaCodecvt = convert.to_bytes(viaCodecvt); });
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#elif defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+        if (viaCodecvt != wide || backViaCodecvt != text) bench::fail("codecvt read the document differently");
+        line("decode, codecvt", codecvtDecode);
+
+        double best = 0;
+        for (const KeymapKernel kernel: kKernels) {
+            if (!runs(kernel)) continue;
+            std::wstring out;
+            out.reserve(text.size());
+            const double seconds = bench::bestOf(kReps, [&] {
+                out.clear();
+                decodeUtf8(text, out, kernel);
+            });
+            if (out != wide) bench::fail("decode differs");
+            line(std::string("decode, ") + keymapKernelName(kernel), seconds);
+            best = seconds;
+        }
+        const double decodeSpeedup = codecvtDecode / best;
+
+        line("encode, codecvt", codecvtEncode);
+        for (const KeymapKernel kernel: kKernels) {
+            if (!runs(kernel)) continue;
+            std::string out;
+            out.reserve(wide.size() * 4);
+            const double seconds = bench::bestOf(kReps, [&] {
+                out.clear();
+                encodeUtf8(wide, out, kernel);
+            });
+            if (out != text) bench::fail("encode differs");
+            line(std::string("encode, ") + keymapKernelName(kernel), seconds);
+            best = seconds;
+        }
+        std::printf("best kernel against codecvt: decode %.1fx, encode %.1fx\n", decodeSpeedup, codecvtEncode / best);
+    }
+
+    void utf8_codec() {
+        static const char *const kMixed[] = {"שלום", "עולם", "הפגישה", "נדחתה", "למחר", "תודה", "Zoom", "PDF", "v2.1",
+                                             "report", "בבקשה", "לשלוח", "את", "הדוח", "email", "12:30", "—", "ok"};
+        static const char *const kEnglish[] = {"the", "meeting", "was", "moved", "to", "tomorrow", "please", "send",
+                                               "report", "Zoom", "PDF", "v2.1", "email", "12:30", "thanks", "ok"};
+        checkKernels();
+        throughput("mixed Hebrew/Latin", makeDocument(kMixed));
+        throughput("English", makeDocument(kEnglish));
+    }
+}
+
+BENCH_CASE(utf8_codec);
@@ -0,0 +1,239 @@
+// this is bench/bench_utf8_transform.cpp
+//
+// UTF-8 in, UTF-8 out through KeymapTransducer::applyUtf8(). Checks it gives
+// byte for byte what decodeUtf8() → apply() → encodeUtf8() gives, on text
+// with multi-unit keys, astral characters and malformed bytes; that
+// utf8Size() is exact; and that feeding the input in scraps and taking the
+// output through a tiny window changes nothing. Steady-state calls must not
+// allocate. Then times both paths on the same documents; applyUtf8() losing
+// to the wide string it exists to avoid is a failure.
+
+#include "bench.h"
+#include "config.h"
+#include "keymap_transducer.h"
+#include "layout_matrix.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+    using Keys = std::unordered_map<wchar_t, wchar_t>;
+
+    constexpr std::size_t kDocumentBytes = 16 << 20;
+    constexpr int kReps = 5;
+
+    /// The wstring path, with buffers kept between calls as a caller would.
+    struct WidePath {
+        std::wstring wide, converted;
+        std::string out;
+
+        const std::string &operator()(const KeymapTransducer &keymap, const std::string_view text) {
+            wide.clear();
+            converted.clear();
+            out.clear();
+            decodeUtf8(text, wide);
+            keymap.apply(wide, converted);
+            encodeUtf8(converted, out);
+            return out;
+        }
+    };
+
+    /// English with Arabic lam-alef on B and Latin dead keys, plus the plain en-he pair.
+    struct Keymaps {
+        LayoutMatrix arabic;
+        LayoutMatrix hebrew;
+    };
+
+    Keymaps makeKeymaps() {
+        const Keys english;
+        Keys arabic;
+        for (const auto &[from, to]: findLayoutPreset("en-ar")->keys) arabic.try_emplace(from, to);
+        arabic.erase(L'b');
+        const std::vector<KeymapRule> none;
+        const std::vector<KeymapRule> sequences = {{L"b", L"لا"}, {L"`e", L"è"}, {L"`a", L"à"}, {L"`", L"ذ"}};
+        const Keys *arabicKeys[] = {&english, &arabic};
+        const std::vector<KeymapRule> *rules[] = {&none, &sequences};
+
+        Keys hebrew;
+        for (const auto &[from, to]: findLayoutPreset("en-he")->keys) hebrew.try_emplace(from, to);
+        const Keys *hebrewKeys[] = {&english, &hebrew};
+        return {LayoutMatrix::build(arabicKeys, rules), LayoutMatrix::build(hebrewKeys)};
+    }
+
+    /// Letters of both scripts, dead keys, an emoji, and bytes that aren't UTF-8.
+    std::string makeMixed(std::mt19937 &rng, const std::size_t pieces) {
+        static const char *const kPieces[] = {
+            "a", "b", "e", "t", "Q", " ", "`", "`e", "`a", "\r\n", "ש", "ל", "لا", "ب", "é", "😀", "€",
+            "\xFF", "\x80", "\xC0\x80", "\xED\xA0\x80", "\xE2\x82", "\xF0\x9F\x98",
+        };
+        std::uniform_int_distribution<std::size_t> pick(0, std::size(kPieces) - 1);
+        std::string text;
+        for (std::size_t i = 0; i < pieces; ++i) text += kPieces[pick(rng)];
+        return text;
+    }
+
+    /// Feed text in scraps of 1–17 bytes, taking the output through a window of 4–11 bytes.
+    std::string convertInScraps(const KeymapTransducer &keymap, const std::string_view text, std::mt19937 &rng) {
+        std::uniform_int_distribution<std::size_t> scrap(1, 17), window(4, 11);
+        std::string pending, out;
+        char buffer[11];
+        std::size_t at = 0;
+        while (at < text.size() || !pending.empty()) {
+            const std::size_t take = std::min(scrap(rng), text.size() - at);
+            pending.append(text.substr(at, take));
+            at += take;
+            const bool last = at == text.size();
+            for (;;) {
+                const auto progress = keymap.applyUtf8(pending, std::span(buffer, window(rng)), last);
+                out.append(buffer, progress.written);
+                pending.erase(0, progress.read);
+                if (progress.read == 0) break;
+            }
+            if (last && !pending.empty()) bench::fail("applyUtf8 stuck on the last bytes");
+        }
+        return out;
+    }
+
+    void checkOutput(const Keymaps &keymaps) {
+        std::mt19937 rng(11);
+        WidePath wide;
+        const KeymapTransducer *transducers[] = {
+            &keymaps.arabic.transducer({0, 1}), &keymaps.arabic.transducer({1, 0}),
+            &keymaps.hebrew.transducer({0, 1}), &keymaps.hebrew.transducer({1, 0}),
+        };
+        for (int round = 0; round < 200; ++round) {
+            const std::string text = makeMixed(rng, 1 + round * 3);
+            for (const auto *keymap: transducers) {
+                const std::string want = wide(*keymap, text);
+                if (keymap->utf8Size(text) != want.size()) bench::fail("utf8Size differs from the wstring path");
+
+                std::string exact(want.size(), '\0');
+                const auto progress = keymap->applyUtf8(text, exact);
+                if (progress.read != text.size() || progress.written != want.size() || exact != want) {
+                    bench::fail("applyUtf8 differs from the wstring path");
+                }
+                if (convertInScraps(*keymap, text, rng) != want) bench::fail("applyUtf8 differs when resumed");
+            }
+        }
+
+        // A rule cut by the end of the input waits for the rest.
+        const auto &toArabic = keymaps.arabic.transducer({0, 1});
+        char out[16];
+        const auto cut = toArabic.applyUtf8("ab`", out, false);
+        if (cut.read != 2) bench::fail("a dead key at the end of a chunk was not held back");
+        std::printf("same bytes as decode → apply → encode, whole and in scraps; utf8Size exact\n");
+    }
+
+    void checkAllocations(const Keymaps &keymaps) {
+        std::mt19937 rng(5);
+        const std::string text = makeMixed(rng, 4096);
+        std::string out(keymaps.arabic.transducer({0, 1}).utf8Size(text) * 2 + 64, '\0');
+        std::size_t sink = 0;
+
+        auto steady = [&] {
+            for (const auto &matrix: {&keymaps.arabic, &keymaps.hebrew}) {
+                for (const Direction d: {Direction{0, 1}, Direction{1, 0}}) {
+                    const auto &keymap = matrix->transducer(d);
+                    sink += keymap.utf8Size(text);
+                    sink += keymap.applyUtf8(text, out).written;
+                    sink += keymap.applyUtf8(std::string_view(text).substr(0, 1001), out, false).read;
+                }
+            }
+        };
+        steady();
+        const std::uint64_t before = bench::allocations();
+        for (int i = 0; i < 100; ++i) steady();
+        const std::uint64_t spanAllocations = bench::allocations() - before;
+        bench::keep(sink);
+
+        WidePath wide;
+        const auto &keymap = keymaps.arabic.transducer({0, 1});
+        wide(keymap, text);
+        const std::uint64_t wideBefore = bench::allocations();
+        for (int i = 0; i < 100; ++i) wide(keymap, text);
+        const std::uint64_t keptAllocations = bench::allocations() - wideBefore;
+        for (int i = 0; i < 100; ++i) WidePath()(keymap, text);
+        const std::uint64_t freshAllocations = bench::allocations() - wideBefore - keptAllocations;
+
+        std::printf("allocations in 1200 applyUtf8/utf8Size calls: %llu; 100 wstring-path calls: %llu with buffers "
+                    "kept, %llu with fresh ones\n",
+                    static_cast<unsigned long long>(spanAllocations), static_cast<unsigned long long>(keptAllocations),
+                    static_cast<unsigned long long>(freshAllocations));
+        if (spanAllocations != 0) bench::fail("applyUtf8 allocated");
+    }
+
+    /// Lines of words over a–z, typed on the target layout when typedOn is given.
+    std::string makeDocument(const KeymapTransducer *typedOn, const bool deadKeys) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> letter(0, 25), wordLen(1, 9), roll(0, 99);
+        std::wstring line, typed;
+        std::string text;
+        text.reserve(kDocumentBytes + 256);
+        while (text.size() < kDocumentBytes) {
+            line.clear();
+            for (int w = 0; w < 12; ++w) {
+                for (int n = wordLen(rng); n > 0; --n) {
+                    if (deadKeys && roll(rng) < 3) line += L'`';
+                    line += static_cast<wchar_t>(L'a' + letter(rng));
+                }
+                line += L' ';
+            }
+            line += L'\n';
+            typed.clear();
+            if (typedOn) typedOn->apply(line, typed);
+            encodeUtf8(typedOn ? typed : line, text);
+        }
+        return text;
+    }
+
+    void throughput(const Keymaps &keymaps) {
+        const auto &toHebrew = keymaps.hebrew.transducer({0, 1});
+        const auto &toArabic = keymaps.arabic.transducer({0, 1});
+        struct Case {
+            const char *name;
+            const KeymapTransducer &keymap;
+            std::string text;
+        };
+        const Case cases[] = {
+            {"English→Hebrew", toHebrew, makeDocument(nullptr, false)},
+            {"Hebrew→English", keymaps.hebrew.transducer({1, 0}), makeDocument(&toHebrew, false)},
+            {"English→Arabic (multi-unit)", toArabic, makeDocument(nullptr, true)},
+            {"Arabic→English (multi-unit)", keymaps.arabic.transducer({1, 0}), makeDocument(&toArabic, true)},
+        };
+
+        auto line = [](const std::string &name, const std::size_t bytes, const double seconds) {
+            std::printf("%-48s %8.2f GB/s %8.3f ns/byte\n", name.c_str(), bytes / seconds / 1e9, seconds * 1e9 / bytes);
+        };
+        for (const auto &c: cases) {
+            WidePath wide;
+            std::string out(c.keymap.utf8Size(c.text), '\0');
+            KeymapTransducer::Utf8Progress progress;
+            // Alternate the two paths so a burst of load on a shared core slows both, not just one.
+            double wideSeconds = 1e300, spanSeconds = 1e300;
+            for (int round = 0; round < 3; ++round) {
+                wideSeconds = std::min(wideSeconds, bench::bestOf(kReps, [&] { wide(c.keymap, c.text); }));
+                spanSeconds = std::min(spanSeconds, bench::bestOf(kReps, [&] { progress = c.keymap.applyUtf8(c.text, out); }));
+            }
+            if (progress.read != c.text.size() || out != wide.out) bench::fail(std::string(c.name) + " differs");
+
+            const double sizeSeconds = bench::bestOf(kReps, [&] { bench::keep(c.keymap.utf8Size(c.text)); });
+            line(std::string(c.name) + ", wstring path", c.text.size(), wideSeconds);
+            line(std::string(c.name) + ", applyUtf8", c.text.size(), spanSeconds);
+            line(std::string(c.name) + ", utf8Size", c.text.size(), sizeSeconds);
+            if (spanSeconds > wideSeconds) bench::fail(std::string(c.name) + ": applyUtf8 slower than the wstring path");
+        }
+    }
+
+    void utf8_transform() {
+        const Keymaps keymaps = makeKeymaps();
+        checkOutput(keymaps);
+        checkAllocations(keymaps);
+        throughput(keymaps);
+    }
+}
+
+BENCH_CASE(utf8_transform);
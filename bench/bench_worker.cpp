@@ -0,0 +1,77 @@
+// this is bench/bench_worker.cpp
+//
+// Stress test for the hotkey worker: bursts of presses of the same hotkey
+// against the simulated desktop, each burst landing while its first press
+// is still being corrected. Every burst must produce exactly one
+// correction: a second one would flip the text back, since the layout
+// flips after each run. The next burst starts the moment the worker
+// reports idle, so its first press must not be mistaken for a duplicate.
+// Also reports how long post() holds the message thread.
+
+#include "action_worker.h"
+#include "bench.h"
+#include "config.h"
+#include "platform_sim.h"
+#include "utils.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+    constexpr int kBursts = 200;
+    constexpr int kPressesPerBurst = 8;
+    constexpr auto kPressGap = std::chrono::microseconds(50);
+    constexpr auto kCopyLatency = std::chrono::milliseconds(2);
+
+    void worker_coalescing() {
+        config::Settings settings;
+        settings.DEBUG_MODE = false;
+        settings.AUTO_FLIP_ON_CHANGE = true;
+        settings.PASTE_THRESHOLD_CHARS = 0;
+        config::publish(settings);
+
+        SimDesktop desktop;
+        desktop.setCopyLatency(kCopyLatency);
+        platform::install(desktop.backend());
+
+        const std::wstring source = L"akuo gcr ng tbh";
+        const std::wstring expected = fix(source, settings.KEYMAPS.table({0, 1}));
+        const LANGID primary = getLangId(0);
+
+        // Each run holds until its whole burst is posted, however the
+        // scheduler stretches the gaps between presses.
+        std::atomic<bool> burstPosted{false};
+        ActionWorker worker([&burstPosted](const HotkeyAction) {
+            burstPosted.wait(false);
+            copyAndFlip(platform::Selection::All);
+        });
+        std::vector<double> postLatency;
+        postLatency.reserve(kBursts * kPressesPerBurst);
+
+        for (int burst = 0; burst < kBursts; ++burst) {
+            desktop.setText(source, source.size(), source.size());
+            desktop.setLang(primary);
+            burstPosted.store(false);
+
+            for (int press = 0; press < kPressesPerBurst; ++press) {
+                postLatency.push_back(bench::timeOnce([&] { worker.post(HotkeyAction::All); }));
+                std::this_thread::sleep_for(kPressGap);
+            }
+            burstPosted.store(true);
+            burstPosted.notify_all();
+            worker.waitIdle();
+
+            if (desktop.text() != expected) bench::fail("burst did not end with exactly one correction");
+        }
+
+        const auto stats = worker.stats();
+        if (stats.runs != kBursts) bench::fail("expected one run per burst");
+        std::printf("%d bursts x %d presses: %llu runs, %llu coalesced, %llu superseded, %llu dropped\n",
+                    kBursts, kPressesPerBurst, static_cast<unsigned long long>(stats.runs),
+                    static_cast<unsigned long long>(stats.coalesced), static_cast<unsigned long long>(stats.superseded),
+                    static_cast<unsigned long long>(stats.dropped));
+        bench::reportLatency("post() on the message thread", postLatency);
+    }
+}
+
+BENCH_CASE(worker_coalescing);
@@ -0,0 +1,27 @@
+// this is clipboard_session.cpp
+
+#include "clipboard_session.h"
+#include "config.h"
+
+#include <algorithm>
+
+ClipboardSession::ClipboardSession(platform::Clipboard &clipboard) : clipboard_(clipboard) {
+    const auto cfg = config::current();
+    if (!cfg->CLIPBOARD_RESTORE) return;
+    sequence_ = clipboard_.sequenceNumber();
+    snapshot_ = clipboard_.snapshot(static_cast<std::size_t>(std::max(cfg->CLIPBOARD_SPILL_BYTES, 0)));
+}
+
+ClipboardSession::~ClipboardSession() {
+    restore();
+}
+
+void ClipboardSession::restore() {
+    if (!snapshot_) return;
+    // Nothing was copied (e.g. an empty selection): the user's data is still there.
+    if (clipboard_.sequenceNumber() == sequence_) {
+        clipboard_.release(std::move(snapshot_));
+        return;
+    }
+    clipboard_.restore(std::move(snapshot_));
+}
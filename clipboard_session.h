@@ -0,0 +1,31 @@
+// this is clipboard_session.h
+#pragma once
+
+#include "platform.h"
+
+#include <memory>
+
+// ─── Clipboard Session ─────────────────────────────────────────────────
+
+/// Keeps the user's clipboard across one correction. Construct it before
+/// the synthetic Ctrl+C; restore() (or the destructor) puts the snapshot
+/// back if anything replaced the clipboard in between. Controlled by
+/// CLIPBOARD_RESTORE and CLIPBOARD_SPILL_BYTES.
+class ClipboardSession {
+public:
+    explicit ClipboardSession(platform::Clipboard &clipboard);
+    ~ClipboardSession();
+    ClipboardSession(const ClipboardSession &) = delete;
+    ClipboardSession &operator=(const ClipboardSession &) = delete;
+
+    /// Put the user's clipboard back now; later calls do nothing.
+    void restore();
+
+    /// What was saved (nullptr if restoring is off or already done).
+    const platform::ClipboardSnapshot *snapshot() const noexcept { return snapshot_.get(); }
+
+private:
+    platform::Clipboard &clipboard_;
+    std::unique_ptr<platform::ClipboardSnapshot> snapshot_;
+    DWORD sequence_ = 0;
+};
@@ -1,116 +1,267 @@
 #include "config.h"
 #include "utils.h"
+#include "utf8.h"
 #include "third_party/json/json.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <codecvt>
-#include <locale>
+#include <stdexcept>
 
 
 using json = nlohmann::json;
 
 namespace config {
-    // All config variables declared as extern in config.h
-    bool DEBUG_MODE = true;
-
-    WORD LANG_PRIMARY = LANG_ENGLISH;
-    WORD SUBLANG_PRIMARY = SUBLANG_DEFAULT;
-    std::wstring ROLE_NAME_PRIMARY = L"English";
-
-    WORD LANG_SECONDARY = LANG_HEBREW;
-    WORD SUBLANG_SECONDARY = SUBLANG_DEFAULT;
-    std::wstring ROLE_NAME_SECONDARY = L"Hebrew";
-
-    std::unordered_map<wchar_t, wchar_t> KEYMAP_PRIMARY_TO_SECONDARY = {
-        {L'q', L'/'}, {L'w', L'\''}, {L'e', L'ק'}, {L'r', L'ר'}, {L't', L'א'},
-        {L'y', L'ט'}, {L'u', L'ו'}, {L'i', L'ן'}, {L'o', L'ם'}, {L'p', L'פ'},
-        {L'a', L'ש'}, {L's', L'ד'}, {L'd', L'ג'}, {L'f', L'כ'}, {L'g', L'ע'},
-        {L'h', L'י'}, {L'j', L'ח'}, {L'k', L'ל'}, {L'l', L'ך'}, {L';', L'ף'}, {L'\'', L','},
-        {L'z', L'ז'}, {L'x', L'ס'}, {L'c', L'ב'}, {L'v', L'ה'}, {L'b', L'נ'},
-        {L'n', L'מ'}, {L'm', L'צ'}, {L',', L'ת'}, {L'.', L'ץ'}, {L'/', L'.'}
-    };
-    int CLIPBOARD_POLL_TIMEOUT_MS = 200;
-    int CLIPBOARD_POLL_INTERVAL_MS = 5;
-
-    UINT BASIC_HOTKEY_MODIFIERS = MOD_CONTROL;
-    UINT BASIC_HOTKEY_VK = 'M';
-    int BASIC_HOTKEY_ID = 1;
-
-    UINT LINE_HOTKEY_MODIFIERS = MOD_CONTROL | MOD_ALT;
-    UINT LINE_HOTKEY_VK = 'M';
-    int LINE_HOTKEY_ID = 2;
-
-    UINT ALL_HOTKEY_MODIFIERS = MOD_CONTROL | MOD_ALT;
-    UINT ALL_HOTKEY_VK = 'N';
-    int ALL_HOTKEY_ID = 3;
-
-    bool AUTO_FLIP_ON_CHANGE = true;
+    namespace {
+        RcuCell<Settings> &cell() {
+            static RcuCell<Settings> settings(std::make_unique<const Settings>());
+            return settings;
+        }
+    }
 
-    void load(const std::string &filename) {
+    Snapshot current() noexcept {
+        return cell().read();
+    }
+
+    void publish(Settings settings) {
+        cell().publish(std::make_unique<const Settings>(std::move(settings)));
+    }
+
+    std::optional<Settings> parse(const std::string &filename) {
         std::ifstream file(filename);
         if (!file) {
-            DEBUG_PRINT(L"[config] Could not open config file: " << std::wstring(filename.begin(), filename.end()));
-            return;
+            DEBUG_PRINT(L"[config] Could not open config file: " << utf8_to_wstring(filename));
+            return std::nullopt;
         }
 
         json j;
         try {
             file >> j;
         } catch (const std::exception &e) {
-            DEBUG_PRINT(L"[config] JSON parsing error: "<< std::wstring(
-                std::string(e.what()).begin(), std::string(e.what()).end()));
-            return;
-        }
-
-        if (j.contains("DEBUG_MODE")) DEBUG_MODE = j["DEBUG_MODE"];
-        if (j.contains("LANG_PRIMARY")) LANG_PRIMARY = j["LANG_PRIMARY"];
-        if (j.contains("SUBLANG_PRIMARY")) SUBLANG_PRIMARY = j["SUBLANG_PRIMARY"];
-        if (j.contains("ROLE_NAME_PRIMARY"))
-            ROLE_NAME_PRIMARY = utf8_to_wstring(j["ROLE_NAME_PRIMARY"].get<std::string>());
-
-        if (j.contains("LANG_SECONDARY")) LANG_SECONDARY = j["LANG_SECONDARY"];
-        if (j.contains("SUBLANG_SECONDARY")) SUBLANG_SECONDARY = j["SUBLANG_SECONDARY"];
-        if (j.contains("ROLE_NAME_SECONDARY"))
-            ROLE_NAME_SECONDARY = utf8_to_wstring(j["ROLE_NAME_SECONDARY"].get<std::string>());
-
-        if (j.contains("KEYMAP_PRIMARY_TO_SECONDARY")) {
-            KEYMAP_PRIMARY_TO_SECONDARY.clear();
-            for (auto &[key, val]: j["KEYMAP_PRIMARY_TO_SECONDARY"].items()) {
-                std::wstring k_w = utf8_to_wstring(key);
-                std::wstring v_w = utf8_to_wstring(val.get<std::string>());
-                if (!k_w.empty() && !v_w.empty()) {
-                    KEYMAP_PRIMARY_TO_SECONDARY[k_w[0]] = v_w[0];
-                }
+            DEBUG_PRINT(L"[config] JSON parsing error: " << utf8_to_wstring(e.what()));
+            return std::nullopt;
+        }
+
+        Settings s;
+        try {
+            if (j.contains("DEBUG_MODE")) s.DEBUG_MODE = j["DEBUG_MODE"];
+            if (j.contains("LAYOUT_PRESET") && !s.applyLayoutPreset(j["LAYOUT_PRESET"].get<std::string>())) {
+                DEBUG_PRINT(L"[config] Unknown LAYOUT_PRESET: " << utf8_to_wstring(j["LAYOUT_PRESET"].get<std::string>()));
             }
+            // The two-layout keys describe LAYOUTS[0] (primary) and [1] (secondary).
+            if (j.contains("LANG_PRIMARY")) s.LAYOUTS[0].lang = j["LANG_PRIMARY"];
+            if (j.contains("SUBLANG_PRIMARY")) s.LAYOUTS[0].sublang = j["SUBLANG_PRIMARY"];
+            if (j.contains("ROLE_NAME_PRIMARY"))
+                s.LAYOUTS[0].name = utf8_to_wstring(j["ROLE_NAME_PRIMARY"].get<std::string>());
+            if (j.contains("MODEL_PRIMARY")) s.LAYOUTS[0].model = j["MODEL_PRIMARY"].get<std::string>();
+
+            if (j.contains("LANG_SECONDARY")) s.LAYOUTS[1].lang = j["LANG_SECONDARY"];
+            if (j.contains("SUBLANG_SECONDARY")) s.LAYOUTS[1].sublang = j["SUBLANG_SECONDARY"];
+            if (j.contains("ROLE_NAME_SECONDARY"))
+                s.LAYOUTS[1].name = utf8_to_wstring(j["ROLE_NAME_SECONDARY"].get<std::string>());
+            if (j.contains("MODEL_SECONDARY")) s.LAYOUTS[1].model = j["MODEL_SECONDARY"].get<std::string>();
+
+            // The primary layout is US QWERTY, so the keymap is the secondary's key table.
+            if (j.contains("KEYMAP_PRIMARY_TO_SECONDARY")) {
+                s.LAYOUTS[0].keys.clear();
+                s.LAYOUTS[0].sequences.clear();
+                parse_keys(j["KEYMAP_PRIMARY_TO_SECONDARY"], s.LAYOUTS[1]);
+            }
+
+            if (j.contains("LAYOUTS")) s.LAYOUTS = parse_layouts(j["LAYOUTS"]);
+            if (j.contains("LAYOUT_CYCLE")) s.LAYOUT_CYCLE = parse_cycle(j["LAYOUT_CYCLE"], s.LAYOUTS);
+
+            if (j.contains("CLIPBOARD_POLL_TIMEOUT_MS")) s.CLIPBOARD_POLL_TIMEOUT_MS = j["CLIPBOARD_POLL_TIMEOUT_MS"];
+            if (j.contains("CLIPBOARD_POLL_INTERVAL_MS")) s.CLIPBOARD_POLL_INTERVAL_MS = j["CLIPBOARD_POLL_INTERVAL_MS"];
+            if (j.contains("CLIPBOARD_WAIT_MODE")) s.CLIPBOARD_WAIT_MODE = parse_wait_mode(j["CLIPBOARD_WAIT_MODE"]);
+            if (j.contains("DIRECTION_MODE")) s.DIRECTION_MODE = parse_direction_mode(j["DIRECTION_MODE"]);
+            if (j.contains("SELECT_COPY_RETRY_MS")) s.SELECT_COPY_RETRY_MS = j["SELECT_COPY_RETRY_MS"];
+            if (j.contains("SELECT_COPY_RETRIES")) s.SELECT_COPY_RETRIES = j["SELECT_COPY_RETRIES"];
+
+            if (j.contains("BASIC_HOTKEY_MODIFIERS")) s.BASIC_HOTKEY_MODIFIERS = parse_modifiers(j["BASIC_HOTKEY_MODIFIERS"]);
+            if (j.contains("BASIC_HOTKEY_VK")) s.BASIC_HOTKEY_VK = parse_vk(j["BASIC_HOTKEY_VK"]);
+            if (j.contains("BASIC_HOTKEY_ID")) s.BASIC_HOTKEY_ID = j["BASIC_HOTKEY_ID"];
+
+            if (j.contains("LINE_HOTKEY_MODIFIERS")) s.LINE_HOTKEY_MODIFIERS = parse_modifiers(j["LINE_HOTKEY_MODIFIERS"]);
+            if (j.contains("LINE_HOTKEY_VK")) s.LINE_HOTKEY_VK = parse_vk(j["LINE_HOTKEY_VK"]);
+            if (j.contains("LINE_HOTKEY_ID")) s.LINE_HOTKEY_ID = j["LINE_HOTKEY_ID"];
+
+            if (j.contains("ALL_HOTKEY_MODIFIERS")) s.ALL_HOTKEY_MODIFIERS = parse_modifiers(j["ALL_HOTKEY_MODIFIERS"]);
+            if (j.contains("ALL_HOTKEY_VK")) s.ALL_HOTKEY_VK = parse_vk(j["ALL_HOTKEY_VK"]);
+            if (j.contains("ALL_HOTKEY_ID")) s.ALL_HOTKEY_ID = j["ALL_HOTKEY_ID"];
+
+            if (j.contains("AUTO_FLIP_ON_CHANGE")) s.AUTO_FLIP_ON_CHANGE = j["AUTO_FLIP_ON_CHANGE"];
+            if (j.contains("AS_YOU_TYPE")) s.AS_YOU_TYPE = parse_typing_mode(j["AS_YOU_TYPE"]);
+            if (j.contains("AS_YOU_TYPE_MIN_CHARS")) s.AS_YOU_TYPE_MIN_CHARS = j["AS_YOU_TYPE_MIN_CHARS"];
+            if (j.contains("IPC_ENDPOINT")) s.IPC_ENDPOINT = j["IPC_ENDPOINT"].get<std::string>();
+            if (j.contains("IPC_THREADS")) s.IPC_THREADS = j["IPC_THREADS"];
+
+            if (j.contains("PASTE_THRESHOLD_CHARS")) s.PASTE_THRESHOLD_CHARS = j["PASTE_THRESHOLD_CHARS"];
+            if (j.contains("PASTE_RESTORE_DELAY_MS")) s.PASTE_RESTORE_DELAY_MS = j["PASTE_RESTORE_DELAY_MS"];
+
+            if (j.contains("CLIPBOARD_RESTORE")) s.CLIPBOARD_RESTORE = j["CLIPBOARD_RESTORE"];
+            if (j.contains("CLIPBOARD_SPILL_BYTES")) s.CLIPBOARD_SPILL_BYTES = j["CLIPBOARD_SPILL_BYTES"];
+
+            if (j.contains("INJECT_BATCH_CHARS")) s.INJECT_BATCH_CHARS = j["INJECT_BATCH_CHARS"];
+            if (j.contains("INJECT_DRAIN_TIMEOUT_MS")) s.INJECT_DRAIN_TIMEOUT_MS = j["INJECT_DRAIN_TIMEOUT_MS"];
+
+            if (j.contains("CONFIG_WATCH_POLL_MS")) s.CONFIG_WATCH_POLL_MS = j["CONFIG_WATCH_POLL_MS"];
+
+            if (j.contains("METRICS")) s.METRICS = j["METRICS"];
+            if (j.contains("METRICS_TRACE")) s.METRICS_TRACE = j["METRICS_TRACE"];
+            if (j.contains("METRICS_FILE")) s.METRICS_FILE = j["METRICS_FILE"].get<std::string>();
+            if (j.contains("LOG_FILE")) s.LOG_FILE = j["LOG_FILE"].get<std::string>();
+            if (j.contains("LOW_FOOTPRINT")) s.LOW_FOOTPRINT = j["LOW_FOOTPRINT"];
+            if (j.contains("MEMORY_BUDGET_KB")) s.MEMORY_BUDGET_KB = j["MEMORY_BUDGET_KB"];
+
+            if (j.contains("KEYMAP_PRIMARY_TO_SECONDARY") || j.contains("LAYOUTS")) s.compileKeymaps();
+            if (s.LOW_FOOTPRINT) s.dropLayoutKeys();
+        } catch (const std::exception &e) {
+            // A value of the wrong type or an unusable layout list; half-read settings are never published.
+            DEBUG_PRINT(L"[config] Bad value in " << utf8_to_wstring(filename) << L": "
+                << utf8_to_wstring(e.what()));
+            return std::nullopt;
         }
 
-        if (j.contains("CLIPBOARD_POLL_TIMEOUT_MS")) CLIPBOARD_POLL_TIMEOUT_MS = j["CLIPBOARD_POLL_TIMEOUT_MS"];
-        if (j.contains("CLIPBOARD_POLL_INTERVAL_MS")) CLIPBOARD_POLL_INTERVAL_MS = j["CLIPBOARD_POLL_INTERVAL_MS"];
+        return s;
+    }
 
-        if (j.contains("BASIC_HOTKEY_MODIFIERS")) BASIC_HOTKEY_MODIFIERS = parse_modifiers(j["BASIC_HOTKEY_MODIFIERS"]);
-        if (j.contains("BASIC_HOTKEY_VK")) BASIC_HOTKEY_VK = parse_vk(j["BASIC_HOTKEY_VK"]);
-        if (j.contains("BASIC_HOTKEY_ID")) BASIC_HOTKEY_ID = j["BASIC_HOTKEY_ID"];
+    void load(const std::string &filename) {
+        auto settings = parse(filename);
+        publish(settings ? std::move(*settings) : Settings{});
+        DEBUG_PRINT(L"[config] Loaded configuration from " << utf8_to_wstring(filename));
+    }
 
-        if (j.contains("LINE_HOTKEY_MODIFIERS")) LINE_HOTKEY_MODIFIERS = parse_modifiers(j["LINE_HOTKEY_MODIFIERS"]);
-        if (j.contains("LINE_HOTKEY_VK")) LINE_HOTKEY_VK = parse_vk(j["LINE_HOTKEY_VK"]);
-        if (j.contains("LINE_HOTKEY_ID")) LINE_HOTKEY_ID = j["LINE_HOTKEY_ID"];
+    bool reload(const std::string &filename) {
+        auto settings = parse(filename);
+        if (!settings) return false;
+        publish(std::move(*settings));
+        DEBUG_PRINT(L"[config] Reloaded configuration from " << utf8_to_wstring(filename));
+        return true;
+    }
 
-        if (j.contains("ALL_HOTKEY_MODIFIERS")) ALL_HOTKEY_MODIFIERS = parse_modifiers(j["ALL_HOTKEY_MODIFIERS"]);
-        if (j.contains("ALL_HOTKEY_VK")) ALL_HOTKEY_VK = parse_vk(j["ALL_HOTKEY_VK"]);
-        if (j.contains("ALL_HOTKEY_ID")) ALL_HOTKEY_ID = j["ALL_HOTKEY_ID"];
+    void Settings::compileKeymaps() {
+        std::vector<const std::unordered_map<wchar_t, wchar_t> *> keys;
+        std::vector<const std::vector<KeymapRule> *> sequences;
+        keys.reserve(LAYOUTS.size());
+        sequences.reserve(LAYOUTS.size());
+        for (const auto &layout: LAYOUTS) {
+            keys.push_back(&layout.keys);
+            sequences.push_back(&layout.sequences);
+        }
+        KEYMAPS = LayoutMatrix::build(keys, sequences);
+    }
+
+    void Settings::dropLayoutKeys() {
+        for (auto &layout: LAYOUTS) {
+            std::unordered_map<wchar_t, wchar_t>().swap(layout.keys);
+            std::vector<KeymapRule>().swap(layout.sequences);
+        }
+    }
+
+    bool Settings::applyLayoutPreset(const std::string &name) {
+        const LayoutPreset *preset = findLayoutPreset(name);
+        if (!preset) return false;
+
+        LAYOUT_PRESET = name;
+        LAYOUTS = presetLayouts(*preset);
+        LAYOUT_CYCLE.clear();
+        KEYMAPS = LayoutMatrix::pair(preset->toSecondary(), preset->toPrimary());
+        return true;
+    }
 
-        if (j.contains("AUTO_FLIP_ON_CHANGE")) AUTO_FLIP_ON_CHANGE = j["AUTO_FLIP_ON_CHANGE"];
+    LayoutId Settings::nextLayout(const LayoutId from) const {
+        if (from >= LAYOUTS.size()) return NO_LAYOUT;
+        if (LAYOUT_CYCLE.empty()) return static_cast<LayoutId>((from + 1) % LAYOUTS.size());
 
-        if (DEBUG_MODE) {
-            DEBUG_PRINT(L"[config] Loaded configuration from "
-                << std::wstring(filename.begin(), filename.end()));
+        auto at = std::find(LAYOUT_CYCLE.begin(), LAYOUT_CYCLE.end(), from);
+        if (at == LAYOUT_CYCLE.end() || ++at == LAYOUT_CYCLE.end()) return LAYOUT_CYCLE.front();
+        return *at;
+    }
+
+    namespace {
+        std::string defaultModelPath(const std::wstring &name) {
+            std::string file;
+            for (const wchar_t ch: name) {
+                if (ch >= 0x80) return ""; // not guessable; MODEL has to name it
+                file += static_cast<char>(ch >= L'A' && ch <= L'Z' ? ch + 32 : ch);
+            }
+            return "models/" + file + ".lfng";
         }
     }
 
-    std::wstring utf8_to_wstring(const std::string &str) {
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > conv;
-        return conv.from_bytes(str);
+    std::vector<Layout> presetLayouts(const LayoutPreset &preset) {
+        Layout primary{preset.rolePrimary, preset.langPrimary, preset.sublangPrimary, {}, "", {}};
+        Layout secondary{preset.roleSecondary, preset.langSecondary, preset.sublangSecondary, {}, "", {}};
+        for (const auto &[from, to]: preset.keys) secondary.keys.try_emplace(from, to);
+        primary.model = defaultModelPath(primary.name);
+        secondary.model = defaultModelPath(secondary.name);
+        return {std::move(primary), std::move(secondary)};
+    }
+
+    std::wstring utf8_to_wstring(const std::string_view str) {
+        std::wstring out;
+        decodeUtf8(str, out);
+        return out;
+    }
+
+    void parse_keys(const json &obj, Layout &layout) {
+        layout.keys.clear();
+        layout.sequences.clear();
+        for (auto &[key, val]: obj.items()) {
+            std::wstring k_w = utf8_to_wstring(key);
+            std::wstring v_w = utf8_to_wstring(val.get<std::string>());
+            if (k_w.empty() || v_w.empty()) continue;
+            if (k_w.size() == 1 && v_w.size() == 1) {
+                layout.keys[k_w[0]] = v_w[0];
+            } else {
+                layout.sequences.push_back({std::move(k_w), std::move(v_w)});
+            }
+        }
+    }
+
+    std::vector<Layout> parse_layouts(const json &arr) {
+        if (!arr.is_array() || arr.size() < 2 || arr.size() > LayoutMatrix::MAX_LAYOUTS) {
+            throw std::invalid_argument("LAYOUTS must list 2 to " + std::to_string(LayoutMatrix::MAX_LAYOUTS) +
+                                        " layouts");
+        }
+
+        std::vector<Layout> layouts;
+        for (const auto &entry: arr) {
+            // A preset contributes its second layout; the keys below override it.
+            Layout layout;
+            if (entry.contains("PRESET")) {
+                const auto name = entry["PRESET"].get<std::string>();
+                const LayoutPreset *preset = findLayoutPreset(name);
+                if (!preset) throw std::invalid_argument("unknown PRESET " + name);
+                layout = std::move(presetLayouts(*preset)[1]);
+            }
+            if (entry.contains("NAME")) layout.name = utf8_to_wstring(entry["NAME"].get<std::string>());
+            if (entry.contains("LANG")) layout.lang = entry["LANG"];
+            if (entry.contains("SUBLANG")) layout.sublang = entry["SUBLANG"];
+            if (entry.contains("KEYS")) parse_keys(entry["KEYS"], layout);
+            layout.model = entry.contains("MODEL") ? entry["MODEL"].get<std::string>()
+                                                   : defaultModelPath(layout.name);
+            layouts.push_back(std::move(layout));
+        }
+        return layouts;
+    }
+
+    std::vector<LayoutId> parse_cycle(const json &arr, const std::vector<Layout> &layouts) {
+        std::vector<LayoutId> cycle;
+        for (const auto &entry: arr) {
+            const std::wstring name = utf8_to_wstring(entry.get<std::string>());
+            const auto at = std::find_if(layouts.begin(), layouts.end(),
+                                         [&name](const Layout &layout) { return layout.name == name; });
+            if (at == layouts.end()) throw std::invalid_argument("LAYOUT_CYCLE names an unknown layout");
+            const auto id = static_cast<LayoutId>(at - layouts.begin());
+            if (std::find(cycle.begin(), cycle.end(), id) != cycle.end()) {
+                throw std::invalid_argument("LAYOUT_CYCLE lists a layout twice");
+            }
+            cycle.push_back(id);
+        }
+        if (cycle.size() < 2) throw std::invalid_argument("LAYOUT_CYCLE needs at least 2 layouts");
+        return cycle;
     }
 
     UINT parse_modifiers(const json &arr) {
@@ -142,4 +293,32 @@ namespace config {
         }
         return 0; // fallback
     }
+
+    ClipboardWaitMode parse_wait_mode(const json &j) {
+        if (j.is_string()) {
+            std::string s = j.get<std::string>();
+            for (auto &c: s) c = tolower(c);
+            if (s == "poll") return ClipboardWaitMode::Poll;
+        }
+        return ClipboardWaitMode::Event; // default, and anything unrecognised
+    }
+
+    DirectionMode parse_direction_mode(const json &j) {
+        if (j.is_string()) {
+            std::string s = j.get<std::string>();
+            for (auto &c: s) c = tolower(c);
+            if (s == "layout") return DirectionMode::Layout;
+        }
+        return DirectionMode::Auto; // default, and anything unrecognised
+    }
+
+    TypingMode parse_typing_mode(const json &j) {
+        if (j.is_string()) {
+            std::string s = j.get<std::string>();
+            for (auto &c: s) c = tolower(c);
+            if (s == "offer") return TypingMode::Offer;
+            if (s == "fix") return TypingMode::Fix;
+        }
+        return TypingMode::Off; // default, and anything unrecognised
+    }
 }
@@ -1,46 +1,188 @@
 // this is config.h
 #pragma once
 
+#include "keymap.h"
+#include "layout_matrix.h"
+#include "layout_presets.h"
+#include "rcu_cell.h"
 #include "third_party/json/json.hpp"
-#include <windows.h>        // for WORD, LANG_* and SUBLANG_* macros
+#include "win32_compat.h"   // for WORD, LANG_* and SUBLANG_* macros
+#include <optional>
+#include <string_view>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace config {
 
-    extern bool DEBUG_MODE;
+    /// How waitForClipboardChange() learns that the copy landed.
+    enum class ClipboardWaitMode { Event, Poll };
 
-    extern WORD LANG_PRIMARY;
-    extern WORD SUBLANG_PRIMARY;
-    extern std::wstring ROLE_NAME_PRIMARY;
+    // How to choose which way to convert: from the active layout to the
+    // next one in LAYOUT_CYCLE, or per run by scoring the candidate
+    // readings with the language models.
+    enum class DirectionMode { Layout, Auto };
 
-    extern WORD LANG_SECONDARY;
-    extern WORD SUBLANG_SECONDARY;
-    extern std::wstring ROLE_NAME_SECONDARY;
+    /// What to do with a word the typing watcher finds typed in the wrong
+    /// layout: nothing, offer it to the basic hotkey, or retype it at once.
+    enum class TypingMode { Off, Offer, Fix };
 
-    extern std::unordered_map<wchar_t, wchar_t> KEYMAP_PRIMARY_TO_SECONDARY;
+    /// One keyboard layout the program converts between.
+    struct Layout {
+        std::wstring name; // for logs, e.g. L"Hebrew"
+        WORD lang = LANG_ENGLISH;
+        WORD sublang = SUBLANG_DEFAULT;
+        // What this layout types on each key, by what US QWERTY types there; empty for US QWERTY.
+        std::unordered_map<wchar_t, wchar_t> keys;
+        // Trigram model (.lfng) of its language.
+        std::string model;
+        // Keys where the key (a dead-key sequence) or what the layout types
+        // there is longer than one code unit; the rest are in keys.
+        std::vector<KeymapRule> sequences;
 
-    extern int CLIPBOARD_POLL_TIMEOUT_MS ;
-    extern int CLIPBOARD_POLL_INTERVAL_MS;
+        LANGID langId() const { return MAKELANGID(lang, sublang); }
+    };
 
-    extern UINT BASIC_HOTKEY_MODIFIERS;
-    extern UINT BASIC_HOTKEY_VK;
-    extern int  BASIC_HOTKEY_ID;
+    /// Both layouts of a built-in preset, each with the model named after it
+    /// ("models/<name>.lfng").
+    std::vector<Layout> presetLayouts(const LayoutPreset &preset);
 
-    extern UINT LINE_HOTKEY_MODIFIERS ;
-    extern UINT LINE_HOTKEY_VK;
-    extern int  LINE_HOTKEY_ID;
+    /// Every setting: the defaults below, overridden by config.json. Once
+    /// published a Settings is never modified; a reload publishes a new one.
+    struct Settings {
+        bool DEBUG_MODE = true;
 
-    extern UINT ALL_HOTKEY_MODIFIERS;
-    extern UINT ALL_HOTKEY_VK;
-    extern int  ALL_HOTKEY_ID;
+        // Built-in layout pair (see layout_presets.h) applied before the layout keys.
+        std::string LAYOUT_PRESET;
 
-    extern bool AUTO_FLIP_ON_CHANGE ;
+        // The layouts to convert between, from LAYOUTS in the file or from the
+        // *_PRIMARY/*_SECONDARY keys (layouts 0 and 1). The defaults are the en-he preset.
+        std::vector<Layout> LAYOUTS = presetLayouts(*findLayoutPreset("en-he"));
 
+        // Conversion order for DIRECTION_MODE "layout": text typed in one of
+        // these goes to the next (wrapping); others go to the first. Empty
+        // means the LAYOUTS order.
+        std::vector<LayoutId> LAYOUT_CYCLE;
+
+        // Every table between LAYOUTS, built by compileKeymaps() or taken
+        // from the preset's compile-time tables.
+        LayoutMatrix KEYMAPS = LayoutMatrix::pair(findLayoutPreset("en-he")->toSecondary(),
+                                                  findLayoutPreset("en-he")->toPrimary());
+
+        int CLIPBOARD_POLL_TIMEOUT_MS = 200;
+        int CLIPBOARD_POLL_INTERVAL_MS = 5;
+        ClipboardWaitMode CLIPBOARD_WAIT_MODE = ClipboardWaitMode::Event;
+
+        DirectionMode DIRECTION_MODE = DirectionMode::Auto;
+
+        // Line/All: how long to wait for the copy before re-sending Ctrl+C, and how often.
+        int SELECT_COPY_RETRY_MS = 40;
+        int SELECT_COPY_RETRIES = 2;
+
+        UINT BASIC_HOTKEY_MODIFIERS = MOD_CONTROL;
+        UINT BASIC_HOTKEY_VK = 'M';
+        int BASIC_HOTKEY_ID = 1;
+
+        UINT LINE_HOTKEY_MODIFIERS = MOD_CONTROL | MOD_ALT;
+        UINT LINE_HOTKEY_VK = 'M';
+        int LINE_HOTKEY_ID = 2;
+
+        UINT ALL_HOTKEY_MODIFIERS = MOD_CONTROL | MOD_ALT;
+        UINT ALL_HOTKEY_VK = 'N';
+        int ALL_HOTKEY_ID = 3;
+
+        bool AUTO_FLIP_ON_CHANGE = true;
+
+        // Watch typing and catch words typed in the wrong layout as each one ends (needs the models).
+        TypingMode AS_YOU_TYPE = TypingMode::Off;
+        // Shorter words are never caught: too few trigrams to tell.
+        int AS_YOU_TYPE_MIN_CHARS = 3;
+
+        // Serve conversions to editor plugins on this pipe name or socket path; empty = off.
+        std::string IPC_ENDPOINT;
+        // Threads answering every client of IPC_ENDPOINT.
+        int IPC_THREADS = 2;
+
+        // Corrections at least this long are pasted (Ctrl+V) instead of typed; 0 = always type.
+        int PASTE_THRESHOLD_CHARS = 200;
+        // How long the target gets to read a paste before the user's clipboard is put back.
+        int PASTE_RESTORE_DELAY_MS = 100;
+
+        // Put the user's clipboard (every format) back after each correction.
+        bool CLIPBOARD_RESTORE = true;
+        // Saved clipboard formats larger than this go to a temp file instead of memory.
+        int CLIPBOARD_SPILL_BYTES = 64 * 1024;
+
+        // Most characters typed per SendInput batch; batches shrink to match how fast the target reads them.
+        int INJECT_BATCH_CHARS = 256;
+        // Longest wait for the target to drain one batch before sending the next anyway.
+        int INJECT_DRAIN_TIMEOUT_MS = 250;
+
+        // How often the config file is checked for changes where the OS can't notify us.
+        int CONFIG_WATCH_POLL_MS = 500;
+
+        // Time every pipeline stage into latency histograms (see metrics.h).
+        bool METRICS = true;
+        // Also keep a trace record of each of the last corrections.
+        bool METRICS_TRACE = false;
+        // Where the percentiles are written at exit and on Ctrl+Break in the console; empty = nowhere.
+        std::string METRICS_FILE = "latency.json";
+
+        // Where DEBUG_MODE output goes, appended as UTF-8; empty = the console.
+        std::string LOG_FILE;
+
+        // Keep the resident process small: drop the layouts' key maps once
+        // KEYMAPS is built, and after each correction free its buffers and
+        // trim the working set (the next correction pays a few page faults).
+        bool LOW_FOOTPRINT = false;
+        // Private memory (KB) the process should stay within; over it after a correction is logged. 0 = no budget.
+        int MEMORY_BUDGET_KB = 0;
+
+        /// Rebuild KEYMAPS from the keys of LAYOUTS.
+        void compileKeymaps();
+
+        /// Free the keys of LAYOUTS, which only compileKeymaps() reads.
+        void dropLayoutKeys();
+
+        /// Take both layouts and their tables from a built-in preset; false if unknown.
+        bool applyLayoutPreset(const std::string &name);
+
+        /// The layout text typed in from converts to under DIRECTION_MODE
+        /// "layout"; NO_LAYOUT if from isn't one of LAYOUTS.
+        LayoutId nextLayout(LayoutId from) const;
+    };
+
+    /// A published Settings, kept alive while this is. Taking one is lock-free.
+    using Snapshot = RcuCell<Settings>::Reader;
+
+    /// The current settings. Nested calls on a thread that already holds a
+    /// Snapshot see that same one, so one hotkey action sees one config.
+    Snapshot current() noexcept;
+
+    /// Make settings current. Waits for readers of the old settings, so it
+    /// must not be called while holding a Snapshot.
+    void publish(Settings settings);
+
+    /// The defaults overridden by filename; nullopt if it can't be read or parsed.
+    std::optional<Settings> parse(const std::string &filename);
+
+    /// Publish filename's settings, or the defaults if it can't be used.
     void load(const std::string &filename);
-    std::wstring utf8_to_wstring(const std::string& str);
+
+    /// Publish filename's settings if it parses; the current ones stay otherwise.
+    bool reload(const std::string &filename);
+
+    /// Decode UTF-8; bad bytes become U+FFFD (decodeUtf8() reports them).
+    std::wstring utf8_to_wstring(std::string_view str);
+    /// Fill layout.keys and layout.sequences from a "key": "typed" object.
+    void parse_keys(const nlohmann::json& obj, Layout& layout);
+    std::vector<Layout> parse_layouts(const nlohmann::json& arr);
+    std::vector<LayoutId> parse_cycle(const nlohmann::json& arr, const std::vector<Layout>& layouts);
     UINT parse_modifiers(const nlohmann::json& arr);
     UINT parse_vk(const nlohmann::json& j);
+    ClipboardWaitMode parse_wait_mode(const nlohmann::json& j);
+    DirectionMode parse_direction_mode(const nlohmann::json& j);
+    TypingMode parse_typing_mode(const nlohmann::json& j);
 
 
-}
\ No newline at end of file
+}
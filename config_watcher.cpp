@@ -0,0 +1,93 @@
+// this is config_watcher.cpp
+
+#include "config_watcher.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    // Quiet time required after the last write before the file is reloaded.
+    constexpr auto kSettleTime = std::chrono::milliseconds(50);
+}
+
+ConfigWatcher::ConfigWatcher(std::string path, const std::chrono::milliseconds pollInterval, Callback onChange)
+    : path_(std::move(path)), pollInterval_(std::max(pollInterval, std::chrono::milliseconds(1))),
+      onChange_(std::move(onChange)) {
+#ifdef _WIN32
+    auto dir = std::filesystem::absolute(path_).parent_path();
+    notification_ = FindFirstChangeNotificationW(dir.c_str(), FALSE,
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                 FILE_NOTIFY_CHANGE_SIZE);
+    if (notification_ == INVALID_HANDLE_VALUE) notification_ = nullptr; // fall back to polling
+    stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+#endif
+    // Compare against the file as it is now, not whenever the thread gets going.
+    thread_ = std::thread([this, seen = stamp()] { loop(seen); });
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    stop_.notify_all();
+#ifdef _WIN32
+    if (stopEvent_) SetEvent(stopEvent_);
+#endif
+    thread_.join();
+#ifdef _WIN32
+    if (notification_) FindCloseChangeNotification(notification_);
+    if (stopEvent_) CloseHandle(stopEvent_);
+#endif
+}
+
+ConfigWatcher::Stamp ConfigWatcher::stamp() const {
+    std::error_code error;
+    Stamp s;
+    s.modified = std::filesystem::last_write_time(path_, error);
+    if (error) return {};
+    s.size = std::filesystem::file_size(path_, error);
+    if (error) return {};
+    s.exists = true;
+    return s;
+}
+
+bool ConfigWatcher::waitForActivity() {
+#ifdef _WIN32
+    if (notification_ && stopEvent_) {
+        const HANDLE handles[2] = {stopEvent_, notification_};
+        const DWORD woke = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (woke != WAIT_OBJECT_0 + 1) return false;
+        FindNextChangeNotification(notification_);
+        return true;
+    }
+#endif
+    std::unique_lock lock(mutex_);
+    return !stop_.wait_for(lock, pollInterval_, [this] { return stopping_; });
+}
+
+void ConfigWatcher::loop(Stamp seen) {
+    while (waitForActivity()) {
+        Stamp now = stamp();
+        if (now == seen) continue; // another file in the directory, or nothing yet
+
+        // Let the writer finish: wait until the stamp holds still.
+        for (;;) {
+            {
+                std::unique_lock lock(mutex_);
+                if (stop_.wait_for(lock, kSettleTime, [this] { return stopping_; })) return;
+            }
+            const Stamp settled = stamp();
+            if (settled == now) break;
+            now = settled;
+        }
+        seen = now;
+        if (!now.exists) continue; // deleted or mid-rename; the next write brings it back
+
+        ++changes_;
+        onChange_();
+    }
+}
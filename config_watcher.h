@@ -0,0 +1,63 @@
+// this is config_watcher.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// ─── Config File Watcher ───────────────────────────────────────────────
+
+/// Watches one file from a thread of its own and calls onChange there once
+/// the file has changed and then stayed the same for a moment, so an editor
+/// that saves in several writes (or by renaming a temp file) triggers one
+/// reload. Windows wakes us through directory change notifications; other
+/// platforms check the file every pollInterval.
+class ConfigWatcher {
+public:
+    using Callback = std::function<void()>;
+
+    ConfigWatcher(std::string path, std::chrono::milliseconds pollInterval, Callback onChange);
+    ~ConfigWatcher();
+    ConfigWatcher(const ConfigWatcher &) = delete;
+    ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+    /// Changes seen (after settling) so far.
+    std::uint64_t changes() const noexcept { return changes_; }
+
+private:
+    /// What we compare to notice a change: modification time and size.
+    struct Stamp {
+        std::filesystem::file_time_type modified{};
+        std::uintmax_t size = 0;
+        bool exists = false;
+
+        bool operator==(const Stamp &) const = default;
+    };
+
+    Stamp stamp() const;
+    void loop(Stamp seen);
+
+    /// Sleep until the OS reports activity or the poll interval passes;
+    /// false once stopping.
+    bool waitForActivity();
+
+    const std::string path_;
+    const std::chrono::milliseconds pollInterval_;
+    const Callback onChange_;
+    std::atomic<std::uint64_t> changes_{0};
+
+    std::mutex mutex_;
+    std::condition_variable stop_;
+    bool stopping_ = false;
+#ifdef _WIN32
+    void *notification_ = nullptr; // FindFirstChangeNotification handle on the directory
+    void *stopEvent_ = nullptr;
+#endif
+    std::thread thread_;
+};
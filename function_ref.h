@@ -0,0 +1,37 @@
+// this is function_ref.h
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// ─── Function Reference ────────────────────────────────────────────────
+
+/// A non-owning reference to a callable, for callbacks that are only called
+/// before the function taking them returns. Unlike std::function it never
+/// allocates, however much the callable captures; the callable has to
+/// outlive the reference (a lambda passed straight into the call does).
+template<typename Signature>
+class FunctionRef;
+
+template<typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    template<typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> && std::is_invocable_r_v<R, F &, Args...>)
+    FunctionRef(F &&f) noexcept
+        : object_(const_cast<void *>(static_cast<const void *>(std::addressof(f)))),
+          call_([](void *object, Args... args) -> R {
+              return std::invoke(*static_cast<std::remove_reference_t<F> *>(object), std::forward<Args>(args)...);
+          }) {
+    }
+
+    R operator()(Args... args) const {
+        return call_(object_, std::forward<Args>(args)...);
+    }
+
+private:
+    void *object_;
+    R (*call_)(void *, Args...);
+};
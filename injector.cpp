@@ -0,0 +1,138 @@
+// this is injector.cpp
+
+#include "injector.h"
+#include "config.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace {
+    // Aim for batches the target takes about this long to consume: long
+    // enough that polling overhead stays small, short enough to stay responsive.
+    constexpr auto kTargetBatchTime = std::chrono::milliseconds(8);
+    constexpr auto kPollInterval = std::chrono::microseconds(250);
+    constexpr std::size_t kMinBatch = 8;
+    constexpr std::size_t kFirstBatch = 32;
+
+    bool isBreak(const wchar_t ch) noexcept {
+        return ch == L' ' || ch == L'\t' || ch == L'\n' || ch == L'\r';
+    }
+
+    /// How much of src to convert next: up to room units, cut after the
+    /// last break in them; if there is none, the first word, as long as it
+    /// fits in capacity. 0 when it doesn't fit in what is left.
+    std::size_t nextPiece(const std::wstring_view src, const std::size_t room, const std::size_t capacity) {
+        if (src.size() <= room) return src.size();
+        for (std::size_t i = room; i > 0; --i) {
+            if (isBreak(src[i - 1])) return i;
+        }
+        std::size_t end = room;
+        while (end < src.size() && end < capacity && !isBreak(src[end])) ++end;
+        if (end < src.size() && end < capacity) return end + 1;
+        return end == src.size() ? end : 0;
+    }
+}
+
+StreamingInjector::StreamingInjector(platform::Input &input) : StreamingInjector(input, owned_) {
+}
+
+StreamingInjector::StreamingInjector(platform::Input &input, std::vector<wchar_t> &buffer)
+    : input_(input),
+      drainTimeout_(std::chrono::milliseconds(std::max(config::current()->INJECT_DRAIN_TIMEOUT_MS, 0))) {
+    buffer.resize(static_cast<std::size_t>(std::max(config::current()->INJECT_BATCH_CHARS, 1)));
+    buffer_ = buffer;
+    batch_ = std::min(kFirstBatch, buffer_.size());
+}
+
+void StreamingInjector::push(std::wstring_view text) {
+    while (!text.empty()) {
+        const std::size_t n = std::min(text.size(), batch_ > used_ ? batch_ - used_ : 0);
+        std::copy_n(text.data(), n, buffer_.data() + used_);
+        used_ += n;
+        text.remove_prefix(n);
+        if (used_ >= batch_) flush();
+    }
+}
+
+void StreamingInjector::pushMapped(std::wstring_view src, const Map map) {
+    while (!src.empty()) {
+        std::size_t n = nextPiece(src, batch_ > used_ ? batch_ - used_ : 0, buffer_.size() - used_);
+        if (n == 0) {
+            // The next word doesn't fit after what is buffered; send that first.
+            if (used_ > 0) {
+                flush();
+                continue;
+            }
+            n = buffer_.size(); // a word longer than the whole buffer
+        }
+        map(src.data(), n, buffer_.data() + used_);
+        used_ += n;
+        src.remove_prefix(n);
+        if (used_ >= batch_) flush();
+    }
+}
+
+void StreamingInjector::pushConverted(std::wstring_view src, const Convert convert, std::wstring &piece) {
+    while (!src.empty()) {
+        const std::size_t n = nextPiece(src, batch_, src.size()); // push() splits it into batches
+        piece.clear();
+        convert(src.substr(0, n), piece);
+        push(piece);
+        src.remove_prefix(n);
+    }
+}
+
+void StreamingInjector::finish() {
+    if (used_ > 0) flush();
+    waitForDrain();
+}
+
+void StreamingInjector::flush() {
+    waitForDrain();
+
+    input_.typeText(std::wstring_view(buffer_.data(), used_));
+    sentAt_ = Clock::now();
+    if (stats_.batches == 0) {
+        stats_.firstSent = sentAt_;
+        stats_.smallestBatch = used_;
+    }
+    ++stats_.batches;
+    stats_.chars += used_;
+    stats_.smallestBatch = std::min(stats_.smallestBatch, used_);
+    stats_.largestBatch = std::max(stats_.largestBatch, used_);
+    inFlight_ = used_;
+    used_ = 0;
+}
+
+void StreamingInjector::waitForDrain() {
+    if (inFlight_ == 0) return;
+    const std::size_t sent = std::exchange(inFlight_, 0);
+
+    // Already gone by the time the next batch filled: the target keeps up.
+    if (!input_.inputPending()) {
+        batch_ = std::min(batch_ * 2, buffer_.size());
+        return;
+    }
+
+    const auto start = Clock::now();
+    const auto deadline = sentAt_ + drainTimeout_;
+    bool drained = false;
+    while (!drained && Clock::now() < deadline) {
+        std::this_thread::sleep_for(kPollInterval);
+        drained = !input_.inputPending();
+    }
+    const auto now = Clock::now();
+    stats_.waited += now - start;
+
+    if (!drained) {
+        ++stats_.drainTimeouts;
+        batch_ = std::max(batch_ / 2, std::min(kMinBatch, buffer_.size()));
+        return;
+    }
+
+    // Size the next batch to take about kTargetBatchTime at the rate just seen.
+    const double perSecond = static_cast<double>(sent) / std::chrono::duration<double>(now - sentAt_).count();
+    const auto wanted = static_cast<std::size_t>(perSecond * std::chrono::duration<double>(kTargetBatchTime).count());
+    batch_ = std::clamp(wanted, std::min(kMinBatch, buffer_.size()), buffer_.size());
+}
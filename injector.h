@@ -0,0 +1,81 @@
+// this is injector.h
+#pragma once
+
+#include "function_ref.h"
+#include "platform.h"
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ─── Streaming Injection ───────────────────────────────────────────────
+
+/// Types text into the foreground window in bounded batches.
+///
+/// Characters collect in a buffer of INJECT_BATCH_CHARS; each batch goes
+/// out as one typeText() call once the target has drained the previous
+/// one, so its input queue never holds more than a batch. The batch size
+/// follows the measured drain rate. Memory use does not depend on how much
+/// text goes through.
+class StreamingInjector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        std::size_t batches = 0;
+        std::size_t chars = 0;
+        std::size_t smallestBatch = 0;
+        std::size_t largestBatch = 0;
+        std::size_t drainTimeouts = 0;
+        Clock::duration waited{};         // blocked waiting for the target
+        Clock::time_point firstSent{};    // when the first batch went out
+    };
+
+    explicit StreamingInjector(platform::Input &input);
+
+    /// Batch in buffer instead of a buffer of its own, sizing it first; a
+    /// caller that keeps it across injectors types without allocating.
+    StreamingInjector(platform::Input &input, std::vector<wchar_t> &buffer);
+    StreamingInjector(const StreamingInjector &) = delete;
+    StreamingInjector &operator=(const StreamingInjector &) = delete;
+
+    /// Queue text; full batches are sent as they fill.
+    void push(std::wstring_view text);
+
+    /// Converts n units of src into dst, the same length.
+    using Map = FunctionRef<void(const wchar_t *src, std::size_t n, wchar_t *dst)>;
+
+    /// Appends the conversion of src to out, whatever its length.
+    using Convert = FunctionRef<void(std::wstring_view src, std::wstring &out)>;
+
+    /// Convert src a batch at a time, straight into the batch buffer, and
+    /// queue the result, so typing starts before the rest of src has been
+    /// converted. Pieces end between words: a word is converted whole.
+    void pushMapped(std::wstring_view src, Map map);
+
+    /// Same for conversions that change the length (keys typing several
+    /// units): each piece goes through piece, whose capacity is kept.
+    void pushConverted(std::wstring_view src, Convert convert, std::wstring &piece);
+
+    /// Send what is left and wait for the target to drain it.
+    void finish();
+
+    const Stats &stats() const noexcept { return stats_; }
+
+private:
+    void flush();
+    void waitForDrain();
+
+    platform::Input &input_;
+    std::vector<wchar_t> owned_;         // the buffer, unless the caller lent one
+    std::span<wchar_t> buffer_;
+    std::size_t used_ = 0;
+    std::size_t batch_;                  // send once this many are buffered
+    std::size_t inFlight_ = 0;           // size of the last batch sent
+    Clock::time_point sentAt_{};
+    Clock::duration drainTimeout_;
+    Stats stats_;
+};
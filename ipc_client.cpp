@@ -0,0 +1,131 @@
+// this is ipc_client.cpp
+
+#include "ipc_client.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#include "config.h"
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::size_t kReadBytes = 64 << 10;
+}
+
+std::string ipc::endpointPath(const std::string_view name) {
+#ifdef _WIN32
+    constexpr std::string_view prefix = R"(\\.\pipe\)";
+    if (name.starts_with(prefix)) return std::string(name);
+    return std::string(prefix) + std::string(name);
+#else
+    if (name.find('/') != std::string_view::npos) return std::string(name);
+    const char *dir = std::getenv("XDG_RUNTIME_DIR");
+    return std::string(dir && *dir ? dir : "/tmp") + "/" + std::string(name) + ".sock";
+#endif
+}
+
+IpcClient::~IpcClient() {
+#ifdef _WIN32
+    if (pipe_) CloseHandle(pipe_);
+#else
+    if (fd_ >= 0) close(fd_);
+#endif
+}
+
+std::unique_ptr<IpcClient> IpcClient::connect(const std::string &endpoint) {
+    std::unique_ptr<IpcClient> client(new IpcClient);
+#ifdef _WIN32
+    const std::wstring name = config::utf8_to_wstring(endpoint);
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const HANDLE pipe = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0,
+                                        nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            client->pipe_ = pipe;
+            return client;
+        }
+        // Every instance is taken until the server puts up the next one.
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(name.c_str(), 1000)) return nullptr;
+    }
+    return nullptr;
+#else
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) return nullptr;
+    std::memcpy(address.sun_path, endpoint.data(), endpoint.size());
+    client->fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd_ < 0 || ::connect(client->fd_, reinterpret_cast<const sockaddr *>(&address), sizeof address) != 0) {
+        return nullptr;
+    }
+    return client;
+#endif
+}
+
+bool IpcClient::send(std::string_view bytes) {
+    while (!bytes.empty()) {
+#ifdef _WIN32
+        DWORD put = 0;
+        if (!WriteFile(pipe_, bytes.data(), static_cast<DWORD>(bytes.size()), &put, nullptr)) return false;
+#else
+        const ssize_t put = ::send(fd_, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+#endif
+        bytes.remove_prefix(static_cast<std::size_t>(put));
+    }
+    return true;
+}
+
+bool IpcClient::fill() {
+    const std::size_t filled = in_.size();
+    in_.resize(filled + kReadBytes);
+    for (;;) {
+#ifdef _WIN32
+        DWORD got = 0;
+        const bool ok = ReadFile(pipe_, in_.data() + filled, kReadBytes, &got, nullptr) && got > 0;
+        in_.resize(filled + got);
+        return ok;
+#else
+        const ssize_t got = recv(fd_, in_.data() + filled, kReadBytes, 0);
+        if (got < 0 && errno == EINTR) continue;
+        in_.resize(filled + static_cast<std::size_t>(got > 0 ? got : 0));
+        return got > 0;
+#endif
+    }
+}
+
+bool IpcClient::receive(ipc::Frame &frame) {
+    in_.erase(0, consumed_);
+    consumed_ = 0;
+    for (;;) {
+        std::size_t length = 0;
+        switch (ipc::readFrame(in_, frame, length)) {
+            case ipc::Read::Frame:
+                consumed_ = length;
+                return true;
+            case ipc::Read::Partial:
+                if (!fill()) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+}
+
+ipc::Status IpcClient::convert(const std::string_view text, const Direction direction, std::string &out,
+                               Direction *took) {
+    const std::uint32_t id = nextId_++;
+    request_.clear();
+    ipc::appendRequest(request_, id, direction, text);
+    ipc::Frame frame;
+    if (!send(request_) || !receive(frame) || frame.id != id) return ipc::Status::BadRequest;
+    out.assign(frame.text);
+    if (took) *took = ipc::responseDirection(frame);
+    return ipc::responseStatus(frame);
+}
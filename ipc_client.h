@@ -0,0 +1,49 @@
+// this is ipc_client.h
+#pragma once
+
+#include "ipc_protocol.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// ─── Conversion Service Client ─────────────────────────────────────────
+
+/// A blocking connection to the conversion service (IpcServer), as an
+/// editor plugin would hold one. convert() is one request and its answer;
+/// send() and receive() let a caller pipeline and batch (ipc_protocol.h).
+class IpcClient {
+public:
+    ~IpcClient();
+    IpcClient(const IpcClient &) = delete;
+    IpcClient &operator=(const IpcClient &) = delete;
+
+    /// Connect to endpoint (ipc::endpointPath() form); nullptr if nothing listens there.
+    static std::unique_ptr<IpcClient> connect(const std::string &endpoint);
+
+    /// Write all of bytes (one or more whole frames); false if the connection broke.
+    bool send(std::string_view bytes);
+
+    /// Wait for the next answer; frame views a buffer the next receive() reuses.
+    /// false if the connection closed or broke first.
+    bool receive(ipc::Frame &frame);
+
+    /// Convert text in direction (either end may be ipc::AUTO), replacing
+    /// out with the answer's text; took gets the conversion it reports.
+    ipc::Status convert(std::string_view text, Direction direction, std::string &out, Direction *took = nullptr);
+
+private:
+    IpcClient() = default;
+
+    /// Read at least once more into in_; false at the end of the stream.
+    bool fill();
+
+#ifdef _WIN32
+    void *pipe_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    std::string in_, request_;
+    std::size_t consumed_ = 0; // bytes of in_ the last receive() returned
+    std::uint32_t nextId_ = 1;
+};
@@ -0,0 +1,118 @@
+// this is ipc_protocol.h
+#pragma once
+
+#include "layout_matrix.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ─── Conversion Service Frames ─────────────────────────────────────────
+
+/// The frames editor plugins exchange with the conversion service
+/// (IPC_ENDPOINT). A frame is a little-endian u32 counting the bytes after
+/// it, an id, four tag bytes and UTF-8 text:
+///
+///     request:  size u32 | id u32 | from u8 | to u8 | 0 u8 | 0 u8 | text
+///     response: size u32 | id u32 | status u8 | from u8 | to u8 | 0 u8 | text
+///
+/// from and to are indices into LAYOUTS. A from of AUTO picks the direction
+/// per run, with the models if the service has them, else by script; a to
+/// of AUTO is the next layout in the cycle. A response echoes the request's
+/// id and says which conversion most of the text took.
+///
+/// Requests on one connection are answered in order, so a client may write
+/// any number before reading the answers (pipelining), and several frames
+/// in one write (a batch) are answered in one write.
+namespace ipc {
+    /// The size field, the id and the tag bytes.
+    inline constexpr std::size_t HEADER_BYTES = 12;
+
+    /// Largest size field accepted. A bigger one is answered TooLarge (and
+    /// one too small BadRequest) with id 0, and the connection is closed.
+    inline constexpr std::uint32_t MAX_FRAME = 16u << 20;
+
+    inline constexpr LayoutId AUTO = NO_LAYOUT;
+
+    enum class Status : std::uint8_t {
+        Ok = 0,
+        BadRequest = 1,  // nonzero reserved bytes, or a size too small for a frame
+        Unsupported = 2, // a layout the service doesn't have, or from == to
+        TooLarge = 3,
+    };
+
+    struct Frame {
+        std::uint32_t id = 0;
+        std::uint8_t tag[4] = {};
+        std::string_view text; // views the buffer it was read from
+    };
+
+    enum class Read {
+        Frame,    // one frame read; length says how many bytes it took
+        Partial,  // not all of it has arrived
+        TooLarge, // size over MAX_FRAME
+        Invalid,  // size too small for the id and tags
+    };
+
+    inline std::uint32_t loadU32(const char *at) noexcept {
+        const auto *b = reinterpret_cast<const unsigned char *>(at);
+        return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<std::uint32_t>(b[3]) << 24);
+    }
+
+    inline void storeU32(char *at, const std::uint32_t value) noexcept {
+        for (int i = 0; i < 4; ++i) at[i] = static_cast<char>(value >> (8 * i));
+    }
+
+    /// Read the frame at the start of bytes.
+    inline Read readFrame(const std::string_view bytes, Frame &frame, std::size_t &length) noexcept {
+        if (bytes.size() < 4) return Read::Partial;
+        const std::uint32_t size = loadU32(bytes.data());
+        if (size > MAX_FRAME) return Read::TooLarge;
+        if (size < HEADER_BYTES - 4) return Read::Invalid;
+        if (bytes.size() - 4 < size) return Read::Partial;
+        frame.id = loadU32(bytes.data() + 4);
+        for (int i = 0; i < 4; ++i) frame.tag[i] = static_cast<std::uint8_t>(bytes[8 + i]);
+        frame.text = bytes.substr(HEADER_BYTES, size - (HEADER_BYTES - 4));
+        length = 4 + size;
+        return Read::Frame;
+    }
+
+    /// Append a frame's header with a size of 0; returns where it starts.
+    /// Append the text, then endFrame().
+    inline std::size_t beginFrame(std::string &out, const std::uint32_t id, const std::uint8_t a,
+                                  const std::uint8_t b, const std::uint8_t c) {
+        const std::size_t at = out.size();
+        out.resize(at + HEADER_BYTES);
+        storeU32(out.data() + at, 0);
+        storeU32(out.data() + at + 4, id);
+        out[at + 8] = static_cast<char>(a);
+        out[at + 9] = static_cast<char>(b);
+        out[at + 10] = static_cast<char>(c);
+        out[at + 11] = 0;
+        return at;
+    }
+
+    /// Fill in the size of the frame beginFrame() started at at.
+    inline void endFrame(std::string &out, const std::size_t at) noexcept {
+        storeU32(out.data() + at, static_cast<std::uint32_t>(out.size() - at - 4));
+    }
+
+    inline void appendRequest(std::string &out, const std::uint32_t id, const Direction direction,
+                              const std::string_view text) {
+        const std::size_t at = beginFrame(out, id, direction.from, direction.to, 0);
+        out.append(text);
+        endFrame(out, at);
+    }
+
+    inline Direction requestDirection(const Frame &frame) noexcept { return {frame.tag[0], frame.tag[1]}; }
+
+    inline Status responseStatus(const Frame &frame) noexcept { return static_cast<Status>(frame.tag[0]); }
+
+    inline Direction responseDirection(const Frame &frame) noexcept { return {frame.tag[1], frame.tag[2]}; }
+
+    /// The endpoint a name stands for: a pipe under \\.\pipe\ on Windows; a
+    /// socket path elsewhere, where a bare name goes in $XDG_RUNTIME_DIR (or
+    /// /tmp) with ".sock" added.
+    std::string endpointPath(std::string_view name);
+}
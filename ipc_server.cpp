@@ -0,0 +1,481 @@
+// this is ipc_server.cpp
+
+#include "ipc_server.h"
+#include "script_runs.h"
+#include "utf8.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /// Bytes asked for per read.
+    constexpr std::size_t kReadBytes = 64 << 10;
+    /// Answers a client hasn't taken yet beyond which it isn't read.
+    constexpr std::size_t kMaxPending = 4 << 20;
+    constexpr unsigned kMaxThreads = 64;
+
+    unsigned threadsFor(const config::Settings &settings) {
+        return std::clamp(static_cast<unsigned>(std::max(settings.IPC_THREADS, 1)), 1u, kMaxThreads);
+    }
+}
+
+/// Per worker: the wide text AUTO requests are converted through.
+struct IpcServer::Scratch {
+    std::wstring wide, converted;
+};
+
+/// What requests are converted with; replaced whole by update().
+struct IpcServer::Engine {
+    LayoutMatrix tables;
+    LayoutId next[LayoutMatrix::MAX_LAYOUTS];
+    std::vector<NgramModelFile> files;
+    std::vector<const NgramModel *> models; // empty: AUTO goes by script
+
+    Engine(const config::Settings &settings, std::vector<NgramModelFile> modelFiles)
+        : tables(settings.KEYMAPS), files(std::move(modelFiles)) {
+        std::fill(std::begin(next), std::end(next), NO_LAYOUT);
+        for (std::size_t l = 0; l < tables.layouts(); ++l) next[l] = settings.nextLayout(static_cast<LayoutId>(l));
+        if (files.size() == tables.layouts()) {
+            for (const auto &file: files) models.push_back(&file.model());
+        }
+    }
+
+    /// Append the answer to request to out.
+    void answer(const ipc::Frame &request, std::string &out, Scratch &scratch) const {
+        auto reply = [&](const ipc::Status status, const Direction took) {
+            return ipc::beginFrame(out, request.id, static_cast<std::uint8_t>(status), took.from, took.to);
+        };
+        if (request.tag[2] != 0 || request.tag[3] != 0) {
+            ipc::endFrame(out, reply(ipc::Status::BadRequest, {}));
+            return;
+        }
+
+        Direction direction = ipc::requestDirection(request);
+        if (direction.from == ipc::AUTO) {
+            scratch.wide.clear();
+            scratch.converted.clear();
+            decodeUtf8(request.text, scratch.wide);
+            const Direction took = models.empty()
+                                       ? ScriptRunConverter(tables, [this](const LayoutId from) { return next[from]; },
+                                                            NO_LAYOUT).convert(scratch.wide, scratch.converted)
+                                       : DirectionScorer(models, tables).convert(scratch.wide, scratch.converted,
+                                                                                 Direction{}).dominant();
+            const std::size_t at = reply(ipc::Status::Ok, took);
+            encodeUtf8(scratch.converted, out);
+            ipc::endFrame(out, at);
+            return;
+        }
+
+        if (direction.from < tables.layouts() && direction.to == ipc::AUTO) direction.to = next[direction.from];
+        if (!direction.converts() || direction.from >= tables.layouts() || direction.to >= tables.layouts()) {
+            ipc::endFrame(out, reply(ipc::Status::Unsupported, {}));
+            return;
+        }
+        // Straight from the request's bytes into the answer's.
+        const KeymapTransducer &keymap = tables.transducer(direction);
+        const std::size_t at = reply(ipc::Status::Ok, direction);
+        const std::size_t textAt = out.size();
+        out.resize(textAt + keymap.utf8Size(request.text));
+        keymap.applyUtf8(request.text, std::span(out).subspan(textAt));
+        ipc::endFrame(out, at);
+    }
+};
+
+struct IpcServer::Connection {
+#ifdef _WIN32
+    enum class Op { Connect, Read, Write };
+
+    OVERLAPPED overlapped{};
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    Op op = Op::Connect;
+#else
+    int fd = -1;
+    std::size_t sent = 0;  // bytes of out written so far
+#endif
+    bool ended = false;    // nothing more is read: the client is done, or its stream broke
+    std::string in, out;
+};
+
+IpcServer::IpcServer(std::string endpoint, const config::Settings &settings, std::vector<NgramModelFile> models)
+    : endpoint_(std::move(endpoint)), engine_(std::make_unique<const Engine>(settings, std::move(models))) {
+}
+
+IpcServer::~IpcServer() {
+    close();
+}
+
+std::unique_ptr<IpcServer> IpcServer::listen(const std::string &endpoint, const unsigned threads,
+                                             const config::Settings &settings, std::vector<NgramModelFile> models) {
+    std::unique_ptr<IpcServer> server(new IpcServer(endpoint, settings, std::move(models)));
+    if (!server->open()) return nullptr;
+    for (unsigned i = 0; i < std::clamp(threads, 1u, kMaxThreads); ++i) {
+        server->workers_.emplace_back([s = server.get()] { s->work(); });
+    }
+    return server;
+}
+
+std::unique_ptr<IpcServer> IpcServer::create() {
+    const auto cfg = config::current();
+    if (cfg->IPC_ENDPOINT.empty()) return nullptr;
+
+    const std::string endpoint = ipc::endpointPath(cfg->IPC_ENDPOINT);
+    auto server = listen(endpoint, threadsFor(*cfg), *cfg, modelsFor(*cfg));
+    if (server) {
+        DEBUG_PRINT(L"[ipc] Serving conversions on " << config::utf8_to_wstring(endpoint) << L" with "
+            << server->threads() << L" threads");
+    } else {
+        DEBUG_PRINT(L"[ipc] Could not open " << config::utf8_to_wstring(endpoint) << L"; not serving conversions");
+    }
+    return server;
+}
+
+std::vector<NgramModelFile> IpcServer::modelsFor(const config::Settings &settings) {
+    std::vector<NgramModelFile> files;
+    if (settings.DIRECTION_MODE != config::DirectionMode::Auto) return files;
+    for (const auto &layout: settings.LAYOUTS) {
+        files.push_back(NgramModelFile::open(layout.model));
+        if (!files.back().model().valid()) {
+            DEBUG_PRINT(L"[ipc] Could not load the model for " << layout.name << L" ("
+                << config::utf8_to_wstring(layout.model) << L"); detecting by script");
+            files.clear();
+            break;
+        }
+    }
+    return files;
+}
+
+bool IpcServer::serves(const config::Settings &settings) const {
+    return !settings.IPC_ENDPOINT.empty() && endpoint_ == ipc::endpointPath(settings.IPC_ENDPOINT) &&
+           threads() == threadsFor(settings);
+}
+
+void IpcServer::update(const config::Settings &settings, std::vector<NgramModelFile> models) {
+    engine_.publish(std::make_unique<const Engine>(settings, std::move(models)));
+}
+
+IpcServer::Stats IpcServer::stats() const noexcept {
+    return {connectionCount_.load(), requests_.load(), bytesIn_.load(), bytesOut_.load()};
+}
+
+bool IpcServer::answer(std::string &in, std::string &out, Scratch &scratch) {
+    const auto engine = engine_.read();
+    std::size_t at = 0, length = 0;
+    std::uint64_t answered = 0;
+    bool ok = true;
+    ipc::Frame frame;
+    for (;;) {
+        const ipc::Read read = ipc::readFrame(std::string_view(in).substr(at), frame, length);
+        if (read == ipc::Read::Partial) break;
+        if (read != ipc::Read::Frame) {
+            const auto status = read == ipc::Read::TooLarge ? ipc::Status::TooLarge : ipc::Status::BadRequest;
+            ipc::endFrame(out, ipc::beginFrame(out, 0, static_cast<std::uint8_t>(status), NO_LAYOUT, NO_LAYOUT));
+            at = in.size();
+            ok = false;
+            break;
+        }
+        engine->answer(frame, out, scratch);
+        at += length;
+        ++answered;
+    }
+    in.erase(0, at);
+    requests_ += answered;
+    return ok;
+}
+
+#ifdef _WIN32
+
+// ─── Named Pipes on a Completion Port ───
+
+bool IpcServer::open() {
+    port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+    return port_ && listenOne();
+}
+
+bool IpcServer::listenOne() {
+    // The first instance claims the name: a pipe someone else already has fails here.
+    const std::wstring name = config::utf8_to_wstring(endpoint_);
+    const HANDLE pipe = CreateNamedPipeW(name.c_str(),
+                                         PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED |
+                                         (firstInstance_ ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                         PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                         PIPE_UNLIMITED_INSTANCES, kReadBytes, kReadBytes, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE) return false;
+    firstInstance_ = false;
+
+    auto *c = new Connection;
+    c->pipe = pipe;
+    {
+        std::lock_guard lock(connectionsMutex_);
+        connections_.insert(c);
+    }
+    if (!CreateIoCompletionPort(pipe, port_, 0, 0)) {
+        drop(c);
+        return false;
+    }
+    if (!ConnectNamedPipe(pipe, &c->overlapped)) {
+        const DWORD error = GetLastError();
+        // A client that got in between creating and waiting queues nothing by itself.
+        if (error == ERROR_PIPE_CONNECTED) {
+            PostQueuedCompletionStatus(port_, 0, 0, &c->overlapped);
+        } else if (error != ERROR_IO_PENDING) {
+            drop(c);
+            return false;
+        }
+    }
+    return true;
+}
+
+void IpcServer::work() {
+    Scratch scratch;
+    for (;;) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED *overlapped = nullptr;
+        const BOOL ok = GetQueuedCompletionStatus(port_, &bytes, &key, &overlapped, INFINITE);
+        if (!overlapped) return; // close() posted a stop, or the port is gone
+        complete(*CONTAINING_RECORD(overlapped, Connection, overlapped), ok != FALSE, bytes, scratch);
+    }
+}
+
+void IpcServer::complete(Connection &c, const bool ok, const unsigned long bytes, Scratch &scratch) {
+    switch (c.op) {
+        case Connection::Op::Connect:
+            listenOne(); // the next client gets a fresh instance
+            if (!ok) return drop(&c);
+            ++connectionCount_;
+            break;
+        case Connection::Op::Read:
+            if (!ok) return drop(&c);
+            c.in.resize(c.in.size() - kReadBytes + bytes);
+            bytesIn_ += bytes;
+            if (!answer(c.in, c.out, scratch)) c.ended = true;
+            break;
+        case Connection::Op::Write:
+            if (!ok) return drop(&c);
+            bytesOut_ += bytes;
+            c.out.clear();
+            if (c.ended) return drop(&c);
+            break;
+    }
+
+    // One operation in flight per connection: the answers if there are
+    // any, else the next read. Requests sent meanwhile wait in the pipe.
+    c.overlapped = {};
+    BOOL started;
+    if (!c.out.empty()) {
+        c.op = Connection::Op::Write;
+        started = WriteFile(c.pipe, c.out.data(), static_cast<DWORD>(c.out.size()), nullptr, &c.overlapped);
+    } else {
+        c.op = Connection::Op::Read;
+        const std::size_t filled = c.in.size();
+        c.in.resize(filled + kReadBytes);
+        started = ReadFile(c.pipe, c.in.data() + filled, kReadBytes, nullptr, &c.overlapped);
+    }
+    if (!started && GetLastError() != ERROR_IO_PENDING) drop(&c);
+}
+
+void IpcServer::drop(Connection *c) {
+    {
+        std::lock_guard lock(connectionsMutex_);
+        connections_.erase(c);
+    }
+    DisconnectNamedPipe(c->pipe);
+    CloseHandle(c->pipe);
+    delete c;
+}
+
+void IpcServer::close() {
+    for (std::size_t i = 0; i < workers_.size(); ++i) PostQueuedCompletionStatus(port_, 0, 0, nullptr);
+    for (auto &worker: workers_) worker.join();
+    for (Connection *c: connections_) {
+        // Whatever it waits for writes into it: cancel that and let it finish first.
+        CancelIoEx(c->pipe, &c->overlapped);
+        if (!HasOverlappedIoCompleted(&c->overlapped)) {
+            DWORD bytes = 0;
+            GetOverlappedResult(c->pipe, &c->overlapped, &bytes, TRUE);
+        }
+        CloseHandle(c->pipe);
+        delete c;
+    }
+    connections_.clear();
+    if (port_) CloseHandle(port_);
+}
+
+#else
+
+// ─── Unix Sockets on epoll ───
+
+bool IpcServer::open() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (endpoint_.empty() || endpoint_.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, endpoint_.data(), endpoint_.size());
+    const auto *named = reinterpret_cast<const sockaddr *>(&address);
+
+    // A socket file left by a process that's gone is taken over; one that
+    // still answers is someone else's, and anything else isn't ours to remove.
+    struct stat info{};
+    if (lstat(endpoint_.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) return false;
+        const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool live = probe >= 0 && connect(probe, named, sizeof address) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) return false;
+        unlink(endpoint_.c_str());
+    }
+
+    listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener_ < 0 || bind(listener_, named, sizeof address) != 0) return false;
+    bound_ = true;
+    // Only this user's processes may connect.
+    if (chmod(endpoint_.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listener_, SOMAXCONN) != 0) return false;
+
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_ < 0 || wake_ < 0) return false;
+    // The listener is handed to one worker at a time; the wake-up stays
+    // readable and reaches them all.
+    epoll_event listen{};
+    listen.events = EPOLLIN | EPOLLONESHOT;
+    listen.data.ptr = &listener_;
+    epoll_event wake{};
+    wake.events = EPOLLIN;
+    wake.data.ptr = &wake_;
+    return epoll_ctl(epoll_, EPOLL_CTL_ADD, listener_, &listen) == 0 &&
+           epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &wake) == 0;
+}
+
+void IpcServer::work() {
+    Scratch scratch;
+    epoll_event events[16];
+    for (;;) {
+        const int n = epoll_wait(epoll_, events, static_cast<int>(std::size(events)), -1);
+        if (n < 0 && errno != EINTR) return;
+        for (int i = 0; i < n; ++i) {
+            void *const source = events[i].data.ptr;
+            if (source == &wake_) return;
+            if (source == &listener_) acceptAll();
+            else serve(*static_cast<Connection *>(source), events[i].events, scratch);
+        }
+    }
+}
+
+void IpcServer::acceptAll() {
+    for (;;) {
+        const int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) break; // none left, or out of descriptors until one closes
+        auto *c = new Connection;
+        c->fd = fd;
+        {
+            std::lock_guard lock(connectionsMutex_);
+            connections_.insert(c);
+        }
+        ++connectionCount_;
+        // One-shot: whoever takes an event has the connection to itself until it re-arms.
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = c;
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) drop(c);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = &listener_;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, listener_, &event);
+}
+
+void IpcServer::serve(Connection &c, const std::uint32_t events, Scratch &scratch) {
+    if (events & EPOLLERR) return drop(&c);
+
+    // Read and answer until nothing more has arrived, or the client is
+    // too far behind on its answers.
+    while (!c.ended && c.out.size() - c.sent < kMaxPending) {
+        const std::size_t filled = c.in.size();
+        c.in.resize(filled + kReadBytes);
+        const ssize_t got = recv(c.fd, c.in.data() + filled, kReadBytes, 0);
+        c.in.resize(filled + static_cast<std::size_t>(std::max<ssize_t>(got, 0)));
+        if (got == 0) {
+            c.ended = true;
+        } else if (got < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return drop(&c);
+        } else {
+            bytesIn_ += static_cast<std::uint64_t>(got);
+            if (!answer(c.in, c.out, scratch)) c.ended = true;
+            if (static_cast<std::size_t>(got) < kReadBytes) break; // drained; a later arrival re-arms
+        }
+    }
+
+    // Every answer ready goes out in one write, as far as the socket takes it.
+    while (c.sent < c.out.size()) {
+        const ssize_t put = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (put > 0) {
+            c.sent += static_cast<std::size_t>(put);
+            bytesOut_ += static_cast<std::uint64_t>(put);
+        } else if (put < 0 && errno == EINTR) {
+            continue;
+        } else if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return drop(&c);
+        }
+    }
+    if (c.sent == c.out.size()) {
+        c.out.clear();
+        c.sent = 0;
+        if (c.ended) return drop(&c);
+    }
+
+    epoll_event event{};
+    event.events = EPOLLONESHOT;
+    if (!c.ended && c.out.size() - c.sent < kMaxPending) event.events |= EPOLLIN;
+    if (c.sent < c.out.size()) event.events |= EPOLLOUT;
+    event.data.ptr = &c;
+    if (epoll_ctl(epoll_, EPOLL_CTL_MOD, c.fd, &event) != 0) drop(&c);
+}
+
+void IpcServer::drop(Connection *c) {
+    {
+        std::lock_guard lock(connectionsMutex_);
+        connections_.erase(c);
+    }
+    ::close(c->fd);
+    delete c;
+}
+
+void IpcServer::close() {
+    if (wake_ >= 0) {
+        const std::uint64_t one = 1;
+        if (write(wake_, &one, sizeof one) < 0) {
+            // Can't fail on an eventfd short of overflowing it.
+        }
+    }
+    for (auto &worker: workers_) worker.join();
+    for (Connection *c: connections_) {
+        ::close(c->fd);
+        delete c;
+    }
+    connections_.clear();
+    if (listener_ >= 0) ::close(listener_);
+    if (bound_) unlink(endpoint_.c_str());
+    if (epoll_ >= 0) ::close(epoll_);
+    if (wake_ >= 0) ::close(wake_);
+}
+
+#endif
@@ -0,0 +1,112 @@
+// this is ipc_server.h
+#pragma once
+
+#include "config.h"
+#include "ipc_protocol.h"
+#include "ngram.h"
+#include "rcu_cell.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// ─── Conversion Service ────────────────────────────────────────────────
+
+/// Serves conversions to editor plugins over a local endpoint (IPC_ENDPOINT),
+/// so they can fix a region of their buffer in place, without the clipboard
+/// and synthetic keys (ipc_protocol.h has the frames).
+///
+/// A small pool of threads serves every client: on Windows each waits on an
+/// I/O completion port the pipe instances are bound to, elsewhere on one
+/// epoll set of Unix sockets. A connection is only ever handled by one of
+/// them at a time, which reads what has arrived, answers every complete
+/// request in it with one write, and goes back to waiting; a client that
+/// doesn't read its answers stops being read until it does.
+class IpcServer {
+public:
+    struct Stats {
+        std::uint64_t connections = 0;
+        std::uint64_t requests = 0;
+        std::uint64_t bytesIn = 0;
+        std::uint64_t bytesOut = 0;
+    };
+
+    ~IpcServer();
+    IpcServer(const IpcServer &) = delete;
+    IpcServer &operator=(const IpcServer &) = delete;
+
+    /// Listen on endpoint (ipc::endpointPath() form) with threads threads,
+    /// converting between settings' layouts; models[i] is the model file of
+    /// layout i, or models is empty to pick directions by script. nullptr if
+    /// the endpoint can't be opened, e.g. another process has it.
+    static std::unique_ptr<IpcServer> listen(const std::string &endpoint, unsigned threads,
+                                             const config::Settings &settings, std::vector<NgramModelFile> models);
+
+    /// For the current config; nullptr when IPC_ENDPOINT is empty or can't be opened.
+    static std::unique_ptr<IpcServer> create();
+
+    /// Models of settings' layouts: none in "layout" mode or if one can't be loaded.
+    static std::vector<NgramModelFile> modelsFor(const config::Settings &settings);
+
+    /// Convert with these layouts and models from the next request on;
+    /// connections stay open.
+    void update(const config::Settings &settings, std::vector<NgramModelFile> models);
+
+    /// True if settings' IPC_ENDPOINT and IPC_THREADS are what this server runs with.
+    bool serves(const config::Settings &settings) const;
+
+    const std::string &endpoint() const noexcept { return endpoint_; }
+    unsigned threads() const noexcept { return static_cast<unsigned>(workers_.size()); }
+
+    Stats stats() const noexcept;
+
+private:
+    struct Engine;
+    struct Connection;
+    struct Scratch;
+
+    IpcServer(std::string endpoint, const config::Settings &settings, std::vector<NgramModelFile> models);
+
+    bool open();
+    void close();
+    void work();
+    void drop(Connection *c);
+
+    /// Answer every complete request at the start of in, appending the
+    /// answers to out and dropping the requests from in; false if the
+    /// stream can't be followed any further.
+    bool answer(std::string &in, std::string &out, Scratch &scratch);
+
+    std::string endpoint_;
+    RcuCell<Engine> engine_;
+    std::vector<std::thread> workers_;
+
+    std::mutex connectionsMutex_; // only taken to add or drop one
+    std::unordered_set<Connection *> connections_;
+
+    std::atomic<std::uint64_t> connectionCount_{0}, requests_{0}, bytesIn_{0}, bytesOut_{0};
+
+#ifdef _WIN32
+    /// Put up the pipe instance the next client connects to.
+    bool listenOne();
+    /// An operation of c's finished; start its next one.
+    void complete(Connection &c, bool ok, unsigned long bytes, Scratch &scratch);
+
+    void *port_ = nullptr; // the completion port
+    bool firstInstance_ = true;
+#else
+    void acceptAll();
+    /// c is readable or writable: read, answer, write, and wait again.
+    void serve(Connection &c, std::uint32_t events, Scratch &scratch);
+
+    int listener_ = -1;
+    bool bound_ = false;   // the socket file is ours to remove
+    int epoll_ = -1;
+    int wake_ = -1;        // eventfd made readable to stop the workers
+#endif
+};
@@ -0,0 +1,84 @@
+// this is keymap.cpp
+
+#include "keymap.h"
+
+// ─── Flat Lookup Tables ────────────────────────────────────────────────
+
+namespace {
+    constexpr std::array<KeymapPair, 0> kNoPairs{};
+}
+
+KeymapTable::KeymapTable() : KeymapTable(view(staticKeymap<kNoPairs, false>)) {
+}
+
+KeymapTable KeymapTable::compile(const std::unordered_map<wchar_t, wchar_t> &map) {
+    auto storage = std::make_shared<Storage>();
+    storage->index.assign(PAGE_COUNT, 0);
+    storage->pages.assign(PAGE_SIZE, 0);
+
+    auto set = [&storage](const wchar_t from, const wchar_t to) {
+        const auto u = static_cast<Unit>(from);
+        if constexpr (sizeof(wchar_t) > 2) {
+            if (u >= CODE_SPACE) return;
+        }
+
+        std::uint16_t &page = storage->index[u >> PAGE_BITS];
+        if (page == 0) {
+            page = static_cast<std::uint16_t>(storage->pages.size() / PAGE_SIZE);
+            storage->pages.resize(storage->pages.size() + PAGE_SIZE, 0);
+        }
+        storage->pages[(static_cast<std::size_t>(page) << PAGE_BITS) | (u & (PAGE_SIZE - 1))] =
+                static_cast<Unit>(static_cast<Unit>(to) - u);
+    };
+
+    // fix() lowercases A–Z before the lookup, so uppercase keys are never hit.
+    for (auto const &[from, to]: map) {
+        if (from >= L'A' && from <= L'Z') continue;
+        set(from, to);
+    }
+    for (wchar_t upper = L'A'; upper <= L'Z'; ++upper) {
+        const auto lower = static_cast<wchar_t>(upper + 32);
+        const auto it = map.find(lower);
+        set(upper, it != map.end() ? it->second : lower);
+    }
+
+    const std::uint16_t *index = storage->index.data();
+    const Unit *pages = storage->pages.data();
+    const std::size_t pageCount = storage->pages.size() / PAGE_SIZE;
+    return view(std::move(storage), index, pages, pageCount);
+}
+
+KeymapTable KeymapTable::view(std::shared_ptr<const void> owner, const std::uint16_t *index, const Unit *pages,
+                              const std::size_t pageCount) {
+    KeymapTable table(std::move(owner), index, pages, pageCount, AsciiPlanes{}, false);
+    table.asciiVectorizable_ = buildAsciiPlanes(table.ascii_, [&table](const wchar_t ch) { return table.map(ch); });
+    return table;
+}
+
+// ─── Mapping Helpers ───────────────────────────────────────────────────
+
+std::unordered_map<wchar_t, wchar_t> invertKeymap(const std::unordered_map<wchar_t, wchar_t> &map) {
+    std::unordered_map<wchar_t, wchar_t> inverse;
+    inverse.reserve(map.size());
+    for (auto const &pair: map) {
+        inverse[pair.second] = pair.first;
+    }
+    return inverse;
+}
+
+std::wstring fix(const std::wstring &src, const std::unordered_map<wchar_t, wchar_t> &map) {
+    std::wstring out;
+    out.reserve(src.size());
+    for (wchar_t ch: src) {
+        if (ch >= L'A' && ch <= L'Z') ch = static_cast<wchar_t>(ch + 32);
+        auto it = map.find(ch);
+        out += (it != map.end()) ? it->second : ch;
+    }
+    return out;
+}
+
+std::wstring fix(const std::wstring &src, const KeymapTable &table) {
+    std::wstring out(src.size(), L'\0');
+    table.apply(src.data(), src.size(), out.data());
+    return out;
+}
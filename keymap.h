@@ -0,0 +1,239 @@
+// this is keymap.h
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ─── Flat Lookup Tables ────────────────────────────────────────────────
+
+/// Transform implementations; apply() uses the best one CPUID reports.
+enum class KeymapKernel { Scalar, Sse42, Avx2 };
+
+/// One key of a layout pair: what it types in the primary and the secondary layout.
+struct KeymapPair {
+    wchar_t from;
+    wchar_t to;
+};
+
+template<std::size_t Pages>
+struct StaticKeymap;
+
+/// Fastest kernel this CPU (and OS) supports, detected once.
+KeymapKernel bestKeymapKernel();
+
+const char *keymapKernelName(KeymapKernel kernel);
+
+/// A keymap compiled into a dense two-level page table over all of Unicode.
+///
+/// The top level is indexed by (ch >> 8) and picks a 256-entry page; each
+/// entry holds the delta to add to ch. Every page without a mapping points
+/// at the shared all-zero page 0, so pass-through characters cost the same
+/// two loads as mapped ones and nothing is ever hashed or allocated.
+///
+/// The A–Z lowercasing that fix() always did is folded into the table.
+///
+/// A table either owns pages built by compile() (shared between copies),
+/// views pages kept alive by another owner (see LayoutMatrix), or views a
+/// StaticKeymap that was built by the compiler.
+class KeymapTable {
+public:
+    using Unit = std::make_unsigned_t<wchar_t>;
+
+    static constexpr std::uint32_t PAGE_BITS = 8;
+    static constexpr std::uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static constexpr std::uint32_t CODE_SPACE = 0x110000;
+    static constexpr std::uint32_t PAGE_COUNT = CODE_SPACE >> PAGE_BITS;
+
+    /// Identity table (only A–Z lowercasing).
+    KeymapTable();
+
+    /// Compile a char→char keymap into page tables.
+    static KeymapTable compile(const std::unordered_map<wchar_t, wchar_t> &map);
+
+    /// Use a compile-time table in place; nothing is built or allocated.
+    template<std::size_t Pages>
+    static KeymapTable view(const StaticKeymap<Pages> &table) noexcept {
+        return KeymapTable(nullptr, table.index, table.pages, Pages, table.ascii, table.asciiVectorizable);
+    }
+
+    /// Use pages owned by owner: PAGE_COUNT index entries, each naming a
+    /// page of deltas from pages (page 0 all zero). pageCount is what
+    /// pageCount() reports. Copies keep owner alive.
+    static KeymapTable view(std::shared_ptr<const void> owner, const std::uint16_t *index, const Unit *pages,
+                            std::size_t pageCount);
+
+    /// Map a single code unit.
+    wchar_t map(const wchar_t ch) const noexcept {
+        const auto u = static_cast<Unit>(ch);
+        if constexpr (sizeof(wchar_t) > 2) {
+            if (u >= CODE_SPACE) return ch;
+        }
+        const std::uint32_t page = index_[u >> PAGE_BITS];
+        return static_cast<wchar_t>(static_cast<Unit>(u + pages_[(page << PAGE_BITS) | (u & (PAGE_SIZE - 1))]));
+    }
+
+    /// Map n code units from src into dst (dst may alias src).
+    void apply(const wchar_t *src, std::size_t n, wchar_t *dst) const noexcept;
+
+    /// Same, through a specific kernel (must not exceed bestKeymapKernel()).
+    void apply(const wchar_t *src, std::size_t n, wchar_t *dst, KeymapKernel kernel) const noexcept;
+
+    /// Outputs for ASCII inputs split into low/high byte planes, stored as
+    /// XOR deltas between consecutive 16-entry rows for the pshufb lookups.
+    struct AsciiPlanes {
+        alignas(16) std::uint8_t lo[8][16];
+        alignas(16) std::uint8_t hi[8][16];
+    };
+
+    /// nullptr when an ASCII character maps above U+FFFF (SIMD can't help).
+    const AsciiPlanes *asciiPlanes() const noexcept { return asciiVectorizable_ ? &ascii_ : nullptr; }
+
+    /// Number of distinct pages allocated, including the shared zero page.
+    std::size_t pageCount() const noexcept { return pageCount_; }
+
+    /// False when page (unit >> PAGE_BITS) maps every unit to itself, so a
+    /// scan over the table's entries can skip it.
+    bool pageMapped(const std::uint32_t page) const noexcept { return index_[page] != 0; }
+
+    /// Fill planes from map(ch) for ch < 128; false if an output needs more than 16 bits.
+    template<typename Map>
+    static constexpr bool buildAsciiPlanes(AsciiPlanes &planes, Map &&map) {
+        std::uint8_t lo[128]{}, hi[128]{};
+        bool vectorizable = true;
+        for (int ch = 0; ch < 128; ++ch) {
+            const auto out = static_cast<Unit>(map(static_cast<wchar_t>(ch)));
+            if (out > 0xFFFF) vectorizable = false;
+            lo[ch] = static_cast<std::uint8_t>(out & 0xFF);
+            hi[ch] = static_cast<std::uint8_t>(out >> 8);
+        }
+
+        // Row h holds row(h) ^ row(h-1): XOR-ing every row whose index is at most
+        // the input's high nibble telescopes to the wanted row.
+        for (int row = 0; row < 8; ++row) {
+            for (int col = 0; col < 16; ++col) {
+                const int at = row * 16 + col;
+                planes.lo[row][col] = static_cast<std::uint8_t>(lo[at] ^ (row ? lo[at - 16] : 0));
+                planes.hi[row][col] = static_cast<std::uint8_t>(hi[at] ^ (row ? hi[at - 16] : 0));
+            }
+        }
+        return vectorizable;
+    }
+
+private:
+    struct Storage {
+        std::vector<std::uint16_t> index;
+        std::vector<Unit> pages;
+    };
+
+    KeymapTable(std::shared_ptr<const void> storage, const std::uint16_t *index, const Unit *pages,
+                const std::size_t pageCount, const AsciiPlanes &ascii, const bool asciiVectorizable) noexcept
+        : storage_(std::move(storage)), index_(index), pages_(pages), pageCount_(pageCount),
+          ascii_(ascii), asciiVectorizable_(asciiVectorizable) {
+    }
+
+    std::shared_ptr<const void> storage_;    // null when viewing a StaticKeymap
+    const std::uint16_t *index_;             // PAGE_COUNT entries → page id
+    const Unit *pages_;                      // pageCount_ * PAGE_SIZE deltas
+    std::size_t pageCount_;
+    AsciiPlanes ascii_{};
+    bool asciiVectorizable_ = false;
+};
+
+// ─── Compile-Time Tables ───────────────────────────────────────────────
+
+namespace keymap_detail {
+    /// Calls set(from, to) for every entry KeymapTable::compile() would set
+    /// for these pairs (swapped when inverse), in the same order. Where two
+    /// pairs share a key the first one listed wins.
+    template<std::size_t N, typename Set>
+    constexpr void forEachKey(const std::array<KeymapPair, N> &pairs, const bool inverse, Set &&set) {
+        auto key = [&](const std::size_t i) { return inverse ? pairs[i].to : pairs[i].from; };
+        auto value = [&](const std::size_t i) { return inverse ? pairs[i].from : pairs[i].to; };
+        auto first = [&](const wchar_t k) {
+            std::size_t i = 0;
+            while (i < N && key(i) != k) ++i;
+            return i;
+        };
+        auto inRange = [](const wchar_t ch) {
+            if constexpr (sizeof(wchar_t) > 2) return static_cast<KeymapTable::Unit>(ch) < KeymapTable::CODE_SPACE;
+            else return true;
+        };
+
+        for (std::size_t i = 0; i < N; ++i) {
+            const wchar_t k = key(i);
+            if ((k >= L'A' && k <= L'Z') || first(k) != i || !inRange(k)) continue;
+            set(k, value(i));
+        }
+        for (wchar_t upper = L'A'; upper <= L'Z'; ++upper) {
+            const auto lower = static_cast<wchar_t>(upper + 32);
+            const std::size_t at = first(lower);
+            set(upper, at < N ? value(at) : lower);
+        }
+    }
+}
+
+/// Pages a StaticKeymap needs for these pairs, including the zero page.
+template<std::size_t N>
+constexpr std::size_t staticKeymapPages(const std::array<KeymapPair, N> &pairs, const bool inverse) {
+    std::uint32_t seen[N + 26]{};
+    std::size_t count = 0;
+    keymap_detail::forEachKey(pairs, inverse, [&](const wchar_t from, wchar_t) {
+        const std::uint32_t page = static_cast<KeymapTable::Unit>(from) >> KeymapTable::PAGE_BITS;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (seen[i] == page) return;
+        }
+        seen[count++] = page;
+    });
+    return count + 1;
+}
+
+/// The same page table KeymapTable::compile() builds, built by the compiler
+/// instead so it sits ready in the binary's read-only data.
+template<std::size_t Pages>
+struct StaticKeymap {
+    std::uint16_t index[KeymapTable::PAGE_COUNT]{};
+    KeymapTable::Unit pages[Pages * KeymapTable::PAGE_SIZE]{};
+    KeymapTable::AsciiPlanes ascii{};
+    bool asciiVectorizable = false;
+
+    template<std::size_t N>
+    constexpr StaticKeymap(const std::array<KeymapPair, N> &pairs, const bool inverse) {
+        using Unit = KeymapTable::Unit;
+        std::uint16_t used = 1;
+        keymap_detail::forEachKey(pairs, inverse, [&](const wchar_t from, const wchar_t to) {
+            const auto u = static_cast<Unit>(from);
+            std::uint16_t &page = index[u >> KeymapTable::PAGE_BITS];
+            if (page == 0) page = used++;
+            pages[(static_cast<std::size_t>(page) << KeymapTable::PAGE_BITS) | (u & (KeymapTable::PAGE_SIZE - 1))] =
+                    static_cast<Unit>(static_cast<Unit>(to) - u);
+        });
+        asciiVectorizable = KeymapTable::buildAsciiPlanes(ascii, [this](const wchar_t ch) {
+            const auto u = static_cast<Unit>(ch);
+            const std::uint32_t page = index[u >> KeymapTable::PAGE_BITS];
+            return static_cast<wchar_t>(static_cast<Unit>(u + pages[(page << KeymapTable::PAGE_BITS) | u]));
+        });
+    }
+};
+
+/// A table compiled from a constexpr array of pairs (forward or inverted).
+template<const auto &Pairs, bool Inverse>
+inline constexpr StaticKeymap<staticKeymapPages(Pairs, Inverse)> staticKeymap{Pairs, Inverse};
+
+// ─── Mapping Helpers ───────────────────────────────────────────────────
+
+/// Swap keys and values of a keymap (used for the Secondary→Primary direction).
+std::unordered_map<wchar_t, wchar_t> invertKeymap(const std::unordered_map<wchar_t, wchar_t> &map);
+
+/// Apply the mapping table to a string, lowercasing A–Z first.
+std::wstring fix(const std::wstring &src,
+                 const std::unordered_map<wchar_t, wchar_t> &map);
+
+/// Same result as the map overload, through a precompiled table.
+std::wstring fix(const std::wstring &src, const KeymapTable &table);
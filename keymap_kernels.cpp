@@ -0,0 +1,236 @@
+// this is keymap_kernels.cpp
+//
+// SIMD kernels for KeymapTable::apply(). Text we convert is mostly ASCII
+// Latin typed in the wrong layout, so the vector paths handle blocks that
+// are entirely ASCII and hand anything else to the scalar page-table path.
+// The A–Z lowercasing is already folded into the byte planes, so the
+// vector lowercase step costs nothing extra.
+
+#include "keymap.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KEYMAP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define KEYMAP_X86 0
+#endif
+
+#if KEYMAP_X86 && (defined(__GNUC__) || defined(__clang__))
+#define KEYMAP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KEYMAP_TARGET(isa)
+#endif
+
+namespace {
+    void applyScalar(const KeymapTable &table, const wchar_t *src, const std::size_t n, wchar_t *dst) noexcept {
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[i] = table.map(src[i]);
+        }
+    }
+
+#if KEYMAP_X86
+
+    // ─── SSE4.2: 16 code units per step ─────────────────────────────────────
+
+    /// Look up 16 byte indices (< 0x80) in a 128-entry plane. pshufb yields 0
+    /// for negative indices, so after subtracting 16*h only inputs whose
+    /// high nibble is >= h still hit row h.
+    KEYMAP_TARGET("sse4.2")
+    inline __m128i lookupPlane(const __m128i idx, const __m128i (&rows)[8]) {
+        const __m128i sixteen = _mm_set1_epi8(16);
+        __m128i x = idx;
+        __m128i r = _mm_shuffle_epi8(rows[0], x);
+        for (int h = 1; h < 8; ++h) {
+            x = _mm_sub_epi8(x, sixteen);
+            r = _mm_xor_si128(r, _mm_shuffle_epi8(rows[h], x));
+        }
+        return r;
+    }
+
+    KEYMAP_TARGET("sse4.2")
+    void applySse42(const KeymapTable &table, const wchar_t *src, const std::size_t n, wchar_t *dst) noexcept {
+        const auto *planes = table.asciiPlanes();
+        std::size_t i = 0;
+
+        if (planes != nullptr) {
+            __m128i lo[8], hi[8];
+            for (int h = 0; h < 8; ++h) {
+                lo[h] = _mm_load_si128(reinterpret_cast<const __m128i *>(planes->lo[h]));
+                hi[h] = _mm_load_si128(reinterpret_cast<const __m128i *>(planes->hi[h]));
+            }
+
+            for (; i + 16 <= n; i += 16) {
+                const auto *in = reinterpret_cast<const __m128i *>(src + i);
+                auto *out = reinterpret_cast<__m128i *>(dst + i);
+                __m128i bytes;
+
+                if constexpr (sizeof(wchar_t) == 2) {
+                    const __m128i a = _mm_loadu_si128(in), b = _mm_loadu_si128(in + 1);
+                    if (!_mm_testz_si128(_mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(0xFF80)))) {
+                        applyScalar(table, src + i, 16, dst + i);
+                        continue;
+                    }
+                    bytes = _mm_packus_epi16(a, b);
+                } else {
+                    const __m128i a = _mm_loadu_si128(in), b = _mm_loadu_si128(in + 1);
+                    const __m128i c = _mm_loadu_si128(in + 2), d = _mm_loadu_si128(in + 3);
+                    const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+                    if (!_mm_testz_si128(any, _mm_set1_epi32(~0x7F))) {
+                        applyScalar(table, src + i, 16, dst + i);
+                        continue;
+                    }
+                    bytes = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+                }
+
+                const __m128i outLo = lookupPlane(bytes, lo), outHi = lookupPlane(bytes, hi);
+                const __m128i w0 = _mm_unpacklo_epi8(outLo, outHi);
+                const __m128i w1 = _mm_unpackhi_epi8(outLo, outHi);
+
+                if constexpr (sizeof(wchar_t) == 2) {
+                    _mm_storeu_si128(out, w0);
+                    _mm_storeu_si128(out + 1, w1);
+                } else {
+                    _mm_storeu_si128(out, _mm_cvtepu16_epi32(w0));
+                    _mm_storeu_si128(out + 1, _mm_cvtepu16_epi32(_mm_srli_si128(w0, 8)));
+                    _mm_storeu_si128(out + 2, _mm_cvtepu16_epi32(w1));
+                    _mm_storeu_si128(out + 3, _mm_cvtepu16_epi32(_mm_srli_si128(w1, 8)));
+                }
+            }
+        }
+
+        applyScalar(table, src + i, n - i, dst + i);
+    }
+
+    // ─── AVX2: 32 code units per step ───────────────────────────────────────
+
+    KEYMAP_TARGET("avx2")
+    inline __m256i lookupPlane(const __m256i idx, const __m256i (&rows)[8]) {
+        const __m256i sixteen = _mm256_set1_epi8(16);
+        __m256i x = idx;
+        __m256i r = _mm256_shuffle_epi8(rows[0], x);
+        for (int h = 1; h < 8; ++h) {
+            x = _mm256_sub_epi8(x, sixteen);
+            r = _mm256_xor_si256(r, _mm256_shuffle_epi8(rows[h], x));
+        }
+        return r;
+    }
+
+    KEYMAP_TARGET("avx2")
+    void applyAvx2(const KeymapTable &table, const wchar_t *src, const std::size_t n, wchar_t *dst) noexcept {
+        const auto *planes = table.asciiPlanes();
+        std::size_t i = 0;
+
+        if (planes != nullptr) {
+            __m256i lo[8], hi[8];
+            for (int h = 0; h < 8; ++h) {
+                lo[h] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(planes->lo[h])));
+                hi[h] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(planes->hi[h])));
+            }
+
+            for (; i + 32 <= n; i += 32) {
+                const auto *in = reinterpret_cast<const __m256i *>(src + i);
+                auto *out = reinterpret_cast<__m256i *>(dst + i);
+                __m256i bytes;
+
+                // packus works per 128-bit lane, so each branch restores order with a permute.
+                if constexpr (sizeof(wchar_t) == 2) {
+                    const __m256i a = _mm256_loadu_si256(in), b = _mm256_loadu_si256(in + 1);
+                    if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_set1_epi16(static_cast<short>(0xFF80)))) {
+                        applyScalar(table, src + i, 32, dst + i);
+                        continue;
+                    }
+                    bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                } else {
+                    const __m256i a = _mm256_loadu_si256(in), b = _mm256_loadu_si256(in + 1);
+                    const __m256i c = _mm256_loadu_si256(in + 2), d = _mm256_loadu_si256(in + 3);
+                    const __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+                    if (!_mm256_testz_si256(any, _mm256_set1_epi32(~0x7F))) {
+                        applyScalar(table, src + i, 32, dst + i);
+                        continue;
+                    }
+                    const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+                    bytes = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+                }
+
+                const __m256i outLo = lookupPlane(bytes, lo), outHi = lookupPlane(bytes, hi);
+                const __m256i w0 = _mm256_unpacklo_epi8(outLo, outHi); // units 0–7 | 16–23
+                const __m256i w1 = _mm256_unpackhi_epi8(outLo, outHi); // units 8–15 | 24–31
+                const __m256i first = _mm256_permute2x128_si256(w0, w1, 0x20);
+                const __m256i second = _mm256_permute2x128_si256(w0, w1, 0x31);
+
+                if constexpr (sizeof(wchar_t) == 2) {
+                    _mm256_storeu_si256(out, first);
+                    _mm256_storeu_si256(out + 1, second);
+                } else {
+                    _mm256_storeu_si256(out, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(first)));
+                    _mm256_storeu_si256(out + 1, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(first, 1)));
+                    _mm256_storeu_si256(out + 2, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(second)));
+                    _mm256_storeu_si256(out + 3, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(second, 1)));
+                }
+            }
+        }
+
+        applySse42(table, src + i, n - i, dst + i);
+    }
+
+#endif
+
+    KeymapKernel detectKernel() {
+#if KEYMAP_X86
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return KeymapKernel::Avx2;
+        if (__builtin_cpu_supports("sse4.2")) return KeymapKernel::Sse42;
+#else
+        int regs[4];
+        __cpuid(regs, 0);
+        const int maxLeaf = regs[0];
+        __cpuid(regs, 1);
+        const bool sse42 = regs[2] & (1 << 20);
+        const bool osAvx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        bool avx2 = false;
+        if (maxLeaf >= 7) {
+            __cpuidex(regs, 7, 0);
+            avx2 = regs[1] & (1 << 5);
+        }
+        if (osAvx && avx2) return KeymapKernel::Avx2;
+        if (sse42) return KeymapKernel::Sse42;
+#endif
+#endif
+        return KeymapKernel::Scalar;
+    }
+}
+
+KeymapKernel bestKeymapKernel() {
+    static const KeymapKernel best = detectKernel();
+    return best;
+}
+
+const char *keymapKernelName(const KeymapKernel kernel) {
+    switch (kernel) {
+        case KeymapKernel::Avx2: return "avx2";
+        case KeymapKernel::Sse42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+void KeymapTable::apply(const wchar_t *src, const std::size_t n, wchar_t *dst) const noexcept {
+    apply(src, n, dst, bestKeymapKernel());
+}
+
+void KeymapTable::apply(const wchar_t *src, const std::size_t n, wchar_t *dst,
+                        const KeymapKernel kernel) const noexcept {
+#if KEYMAP_X86
+    switch (kernel) {
+        case KeymapKernel::Avx2: return applyAvx2(*this, src, n, dst);
+        case KeymapKernel::Sse42: return applySse42(*this, src, n, dst);
+        default: break;
+    }
+#else
+    (void) kernel;
+#endif
+    applyScalar(*this, src, n, dst);
+}
@@ -0,0 +1,437 @@
+// this is keymap_transducer.cpp
+
+#include "keymap_transducer.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+    using Unit = KeymapTable::Unit;
+
+    constexpr char32_t kReplacement = 0xFFFD;
+
+    /// What encodeUtf8() writes for a code point: itself, or U+FFFD for a
+    /// lone surrogate or anything past U+10FFFF.
+    char32_t scalar(const char32_t cp) noexcept {
+        return (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF ? kReplacement : cp;
+    }
+
+    /// Bytes of the UTF-8 that decoded, with nothing malformed, to units.
+    std::size_t sourceBytes(const wchar_t *units, const std::size_t n) noexcept {
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto unit = static_cast<Unit>(units[i]);
+            bytes += unit >= 0xD800 && unit <= 0xDFFF ? 2 : utf8Length(unit); // half of a 4-byte sequence
+        }
+        return bytes;
+    }
+
+    /// The code units decodeUtf8() gives for cp; returns how many.
+    int toUnits(const char32_t cp, Unit units[2]) noexcept {
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (cp > 0xFFFF) {
+                units[0] = static_cast<Unit>(0xD800 + ((cp - 0x10000) >> 10));
+                units[1] = static_cast<Unit>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+                return 2;
+            }
+        }
+        units[0] = static_cast<Unit>(cp);
+        return 1;
+    }
+
+    /// Writes UTF-8 into the caller's buffer.
+    class BufferOut {
+    public:
+        explicit BufferOut(const std::span<char> dst) noexcept
+            : begin_(dst.data()), at_(dst.data()), end_(dst.data() + dst.size()) {
+        }
+
+        bool fits(const std::size_t bytes) const noexcept { return static_cast<std::size_t>(end_ - at_) >= bytes; }
+        /// One byte or two for cp below U+0800, without a branch on which; needs fits(2).
+        void putShort(const char32_t cp) noexcept {
+            const bool two = cp >= 0x80;
+            at_[0] = static_cast<char>(two ? 0xC0 | (cp >> 6) : cp);
+            at_[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            at_ += 1 + two;
+        }
+        void put(const char32_t cp) noexcept {
+            if (cp < 0x800 && end_ - at_ >= 2) {
+                // One byte or two without a branch on which: store both, keep what cp needs.
+                const bool two = cp >= 0x80;
+                at_[0] = static_cast<char>(two ? 0xC0 | (cp >> 6) : cp);
+                at_[1] = static_cast<char>(0x80 | (cp & 0x3F));
+                at_ += 1 + two;
+                return;
+            }
+            at_ = writeUtf8(at_, cp);
+        }
+        std::size_t written() const noexcept { return static_cast<std::size_t>(at_ - begin_); }
+
+    private:
+        char *begin_, *at_, *end_;
+    };
+
+    /// Counts what BufferOut would write.
+    class CountingOut {
+    public:
+        static constexpr bool fits(std::size_t) noexcept { return true; }
+        void put(const char32_t cp) noexcept { written_ += utf8Length(cp); }
+        void putShort(const char32_t cp) noexcept { written_ += 1 + (cp >= 0x80); }
+        std::size_t written() const noexcept { return written_; }
+
+    private:
+        std::size_t written_ = 0;
+    };
+
+    /// Encode units as encodeUtf8() does, all of them or (if they don't fit) none.
+    template<typename Out>
+    bool emit(Out &out, const wchar_t *units, const std::size_t n) noexcept {
+        auto next = [&](std::size_t &i) {
+            auto cp = static_cast<char32_t>(static_cast<Unit>(units[i++]));
+            if (sizeof(wchar_t) == 2 && cp >= 0xD800 && cp <= 0xDBFF && i < n) {
+                const auto low = static_cast<char32_t>(static_cast<Unit>(units[i]));
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            return scalar(cp);
+        };
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < n;) bytes += utf8Length(next(i));
+        if (!out.fits(bytes)) return false;
+        for (std::size_t i = 0; i < n;) out.put(next(i));
+        return true;
+    }
+}
+
+KeymapTransducer KeymapTransducer::compile(KeymapTable table, const std::span<const KeymapRule> rules) {
+    KeymapTransducer transducer(std::move(table));
+
+    // Build with ordered child maps, then flatten into sorted edge runs.
+    struct Building {
+        std::map<KeymapTable::Unit, std::uint32_t> children;
+        const std::wstring *output = nullptr;
+    };
+    std::vector<Building> building(1);
+    std::size_t longest = 0;
+    for (const auto &rule: rules) {
+        if (rule.from.empty()) continue;
+        std::uint32_t at = 0;
+        for (const wchar_t ch: rule.from) {
+            const auto unit = static_cast<KeymapTable::Unit>(ch);
+            const auto it = building[at].children.find(unit);
+            if (it != building[at].children.end()) {
+                at = it->second;
+            } else {
+                const auto next = static_cast<std::uint32_t>(building.size());
+                building[at].children.emplace(unit, next);
+                building.emplace_back();
+                at = next;
+            }
+        }
+        if (!building[at].output) building[at].output = &rule.to;
+        longest = std::max(longest, rule.from.size());
+    }
+    if (building.size() == 1) return transducer;
+
+    auto trie = std::make_shared<Trie>();
+    trie->nodes.resize(building.size());
+    for (std::size_t i = 0; i < building.size(); ++i) {
+        Node &node = trie->nodes[i];
+        node.firstEdge = static_cast<std::uint32_t>(trie->edges.size());
+        node.edges = static_cast<std::uint32_t>(building[i].children.size());
+        for (const auto &[unit, target]: building[i].children) trie->edges.push_back({unit, target});
+        if (building[i].output) {
+            node.output = static_cast<std::uint32_t>(trie->outputs.size());
+            node.outputLength = static_cast<std::uint32_t>(building[i].output->size());
+            trie->outputs += *building[i].output;
+        }
+    }
+    for (const auto &[unit, target]: building[0].children) {
+        trie->starts.set(unit & ((1u << FILTER_BITS) - 1));
+    }
+    trie->longest = longest;
+    transducer.trie_ = std::move(trie);
+    return transducer;
+}
+
+const KeymapTransducer::Node *KeymapTransducer::step(const Node *at, const KeymapTable::Unit unit) const noexcept {
+    const Trie &trie = *trie_;
+    const Edge *first = trie.edges.data() + at->firstEdge;
+    const Edge *last = first + at->edges;
+    const Edge *edge = std::lower_bound(first, last, unit,
+                                        [](const Edge &e, const KeymapTable::Unit u) { return e.unit < u; });
+    if (edge == last || edge->unit != unit) return nullptr;
+    return trie.nodes.data() + edge->target;
+}
+
+std::size_t KeymapTransducer::match(const std::wstring_view src, const Node *&node) const noexcept {
+    const Node *at = trie_->nodes.data();
+    std::size_t length = 0;
+    node = nullptr;
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        at = step(at, static_cast<KeymapTable::Unit>(src[i]));
+        if (!at) break;
+        if (at->output != NO_OUTPUT) {
+            length = i + 1;
+            node = at;
+        }
+    }
+    return length;
+}
+
+void KeymapTransducer::apply(const std::wstring_view src, std::wstring &out) const {
+    auto mapRun = [&](const std::size_t begin, const std::size_t end) {
+        if (end - begin < SHORT_RUN) {
+            // Between close matches the kernels' setup costs more than the lookups.
+            for (std::size_t i = begin; i < end; ++i) out.push_back(table_.map(src[i]));
+            return;
+        }
+        const std::size_t at = out.size();
+        out.resize(at + (end - begin));
+        table_.apply(src.data() + begin, end - begin, out.data() + at);
+    };
+
+    if (!trie_) {
+        mapRun(0, src.size());
+        return;
+    }
+
+    out.reserve(out.size() + src.size());
+    std::size_t plain = 0; // start of the text not written yet
+    std::size_t i = 0;
+    while (i < src.size()) {
+        const auto unit = static_cast<KeymapTable::Unit>(src[i]);
+        if (!trie_->starts.test(unit & ((1u << FILTER_BITS) - 1))) {
+            ++i;
+            continue;
+        }
+        const Node *node;
+        const std::size_t length = match(src.substr(i), node);
+        if (length == 0) {
+            ++i;
+            continue;
+        }
+        mapRun(plain, i);
+        out.append(trie_->outputs, node->output, node->outputLength);
+        i += length;
+        plain = i;
+    }
+    mapRun(plain, src.size());
+}
+
+template<typename Out>
+std::size_t KeymapTransducer::convertUtf8(const std::string_view src, Out &out, const bool last) const noexcept {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(src.data());
+    const std::size_t n = src.size();
+    const Trie *trie = trie_.get();
+
+    // A sequence cut off by the end of src, which the next input may complete.
+    auto cutOff = [&](const std::size_t at) { return !last && at + utf8SequenceLength(bytes[at]) > n; };
+    auto mayStart = [trie](const Unit unit) { return trie && trie->starts.test(unit & ((1u << FILTER_BITS) - 1)); };
+
+    // One character through the table.
+    auto plain = [&](const Unit *units, const int count) {
+        if (count == 1) {
+            const char32_t mapped = scalar(static_cast<Unit>(table_.map(static_cast<wchar_t>(units[0]))));
+            if (!out.fits(utf8Length(mapped))) return false;
+            out.put(mapped);
+            return true;
+        }
+        const wchar_t mapped[2] = {table_.map(static_cast<wchar_t>(units[0])), table_.map(static_cast<wchar_t>(units[1]))};
+        return emit(out, mapped, 2);
+    };
+
+    // A BMP character that starts no rule, the common case.
+    auto simple = [&](const char32_t cp) {
+        const char32_t mapped = scalar(static_cast<Unit>(table_.map(static_cast<wchar_t>(cp))));
+        if (!out.fits(utf8Length(mapped))) return false;
+        out.put(mapped);
+        return true;
+    };
+
+    constexpr std::size_t kBlock = 16;
+    std::size_t i = 0;
+    while (i < n) {
+        // Blocks of ASCII and two-byte letters (Hebrew, Cyrillic, Greek,
+        // Arabic) that start no rule, checked for room once per block: the
+        // bulk of any text. A block ends early at anything else, which the
+        // steps below take one character at a time.
+        if (n - i > kBlock && out.fits(4 * (kBlock + 1))) {
+            const std::size_t stop = i + kBlock;
+            while (i < stop) {
+                const unsigned char lead = bytes[i];
+                Unit cp;
+                if (lead < 0x80) {
+                    cp = lead;
+                } else if (lead >= 0xC2 && lead <= 0xDF && (bytes[i + 1] & 0xC0) == 0x80) {
+                    cp = static_cast<Unit>(((lead & 0x1F) << 6) | (bytes[i + 1] & 0x3F));
+                } else {
+                    break;
+                }
+                if (mayStart(cp)) break;
+                const auto mapped = static_cast<Unit>(table_.map(static_cast<wchar_t>(cp)));
+                if (mapped < 0x800) {
+                    out.putShort(mapped);
+                } else {
+                    out.put(scalar(mapped));
+                }
+                i += 1 + (lead >= 0x80);
+            }
+            if (i >= stop) continue;
+        }
+
+        // ASCII and two-byte letters first.
+        const unsigned char lead = bytes[i];
+        if (lead < 0x80) {
+            if (!mayStart(lead)) {
+                if (!simple(lead)) break;
+                ++i;
+                continue;
+            }
+        } else if (lead >= 0xC2 && lead <= 0xDF && i + 1 < n && (bytes[i + 1] & 0xC0) == 0x80) {
+            const char32_t cp = ((lead & 0x1F) << 6) | (bytes[i + 1] & 0x3F);
+            if (!mayStart(static_cast<Unit>(cp))) {
+                if (!simple(cp)) break;
+                i += 2;
+                continue;
+            }
+        }
+
+        if (cutOff(i)) break;
+        const Utf8Char c = readUtf8(bytes + i, n - i);
+        Unit units[2];
+        const int count = toUnits(c.cp, units);
+
+        if (mayStart(units[0])) {
+            // The longest rule from here, reading characters as the walk needs them.
+            const Node *at = trie->nodes.data();
+            const Node *accepted = nullptr;
+            std::size_t acceptedEnd = 0;
+            std::size_t j = i;
+            bool open = false; // rules still went on where src ended
+            Utf8Char d = c;
+            for (;;) {
+                Unit next[2];
+                const int nextCount = toUnits(d.cp, next);
+                for (int k = 0; k < nextCount && at; ++k) at = step(at, next[k]);
+                if (!at) break;
+                j += d.length;
+                if (at->output != NO_OUTPUT) {
+                    accepted = at;
+                    acceptedEnd = j;
+                }
+                if (at->edges == 0) break;
+                if (j == n || cutOff(j)) {
+                    open = true;
+                    break;
+                }
+                d = readUtf8(bytes + j, n - j);
+            }
+            if (open && !last) break;
+            if (accepted) {
+                if (!emit(out, trie->outputs.data() + accepted->output, accepted->outputLength)) break;
+                i = acceptedEnd;
+                continue;
+            }
+        }
+
+        if (!plain(units, count)) break;
+        i += c.length;
+    }
+    return i;
+}
+
+KeymapTransducer::Utf8Progress KeymapTransducer::applyUtf8(const std::string_view src, const std::span<char> dst,
+                                                           const bool last) const noexcept {
+    // Chunks small enough to stay in cache go through the vector kernels:
+    // decode, the table over the runs between rule matches, encode. A chunk
+    // with rules and a malformed byte, whose units can't be traced back to
+    // bytes, takes the steps in convertUtf8(), as does whatever the chunks
+    // can't finish (a cut-off tail, a nearly full dst).
+    constexpr std::size_t kChunk = 256;
+    constexpr std::size_t kMaxBytes = sizeof(wchar_t) == 2 ? 3 : 4; // per unit
+    wchar_t units[kChunk], mapped[2 * kChunk];
+    std::size_t read = 0, written = 0;
+    while (read < src.size()) {
+        const std::string_view chunk = src.substr(read, kChunk);
+        const bool final = last && read + chunk.size() == src.size();
+        const std::size_t length = final ? chunk.size() : utf8CompleteLength(chunk);
+        if (length == 0) break;
+        wchar_t *decoded = units;
+        const Utf8Status status = decodeUtf8(chunk.substr(0, length), decoded);
+        const auto count = static_cast<std::size_t>(decoded - units);
+
+        if (trie_ && !status.ok()) {
+            BufferOut out(dst.subspan(written));
+            const std::size_t step = convertUtf8(chunk.substr(0, length), out, final);
+            read += step;
+            written += out.written();
+            if (step == 0) break;
+            continue;
+        }
+
+        // Map the chunk into mapped, then encode it in one go. Short of the
+        // end of src, a match may need units the next chunk brings, so stop
+        // where the longest rule could still fit.
+        wchar_t *to = mapped;
+        auto mapRun = [&](const std::size_t begin, const std::size_t end) {
+            if (end - begin < SHORT_RUN) {
+                for (std::size_t i = begin; i < end; ++i) *to++ = table_.map(units[i]);
+                return;
+            }
+            table_.apply(units + begin, end - begin, to);
+            to += end - begin;
+        };
+        std::size_t done = count; // units of the chunk converted
+        if (!trie_) {
+            mapRun(0, count);
+        } else {
+            std::size_t cut = final ? count : count - std::min(count, trie_->longest - 1);
+            if (cut > 0 && cut < count && (static_cast<Unit>(units[cut]) & 0xFC00) == 0xDC00) --cut; // whole pairs only
+            std::size_t plain = 0, i = 0;
+            while (i < cut) {
+                if (!trie_->starts.test(static_cast<Unit>(units[i]) & ((1u << FILTER_BITS) - 1))) {
+                    ++i;
+                    continue;
+                }
+                const Node *node;
+                const std::size_t matched = match(std::wstring_view(units + i, count - i), node);
+                if (matched == 0) {
+                    ++i;
+                    continue;
+                }
+                mapRun(plain, i);
+                if (node->outputLength > static_cast<std::size_t>(mapped + 2 * kChunk - to) - (count - i)) {
+                    plain = i; // mapped is full: leave the match to the next chunk
+                    break;
+                }
+                to = std::copy_n(trie_->outputs.data() + node->output, node->outputLength, to);
+                i += matched;
+                plain = i;
+            }
+            mapRun(plain, i);
+            done = i;
+        }
+
+        const auto produced = static_cast<std::size_t>(to - mapped);
+        if (dst.size() - written < produced * kMaxBytes) break;
+        char *at = dst.data() + written;
+        encodeUtf8(std::wstring_view(mapped, produced), at);
+        const std::size_t step = done == count ? length : length - sourceBytes(units + done, count - done);
+        read += step;
+        written = static_cast<std::size_t>(at - dst.data());
+        if (step == 0) break;
+    }
+    BufferOut out(dst.subspan(written));
+    read += convertUtf8(src.substr(read), out, last);
+    return {read, written + out.written()};
+}
+
+std::size_t KeymapTransducer::utf8Size(const std::string_view src) const noexcept {
+    CountingOut out;
+    convertUtf8(src, out, true);
+    return out.written();
+}
@@ -0,0 +1,112 @@
+// this is keymap_transducer.h
+#pragma once
+
+#include "keymap.h"
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ─── Multi-Unit Keymaps ────────────────────────────────────────────────
+
+/// One mapping whose sides may be longer than one code unit: a surrogate
+/// pair, a base letter with combining marks, a dead-key sequence, or a key
+/// that types several characters.
+struct KeymapRule {
+    std::wstring from;
+    std::wstring to;
+};
+
+/// A KeymapTable plus rules over strings, compiled into a trie and applied
+/// in one left-to-right pass with longest-match semantics: at each position
+/// the longest rule matching there wins; where none does, the code unit goes
+/// through the table. A failed longer match only backs up to the last rule
+/// seen, so a pass costs at most the input times the longest rule.
+///
+/// Most positions can't start a rule, which a 4096-bit filter on the low
+/// bits of the code unit says in one load; the text between matches goes
+/// through the table's own kernels. Without rules apply() is exactly the
+/// table's apply().
+class KeymapTransducer {
+public:
+    /// The table alone (identity table by default).
+    KeymapTransducer() = default;
+    explicit KeymapTransducer(KeymapTable table) noexcept : table_(std::move(table)) {
+    }
+
+    /// Compile rules on top of table. Where two rules share a source the
+    /// first one listed wins; rules with an empty source are dropped.
+    static KeymapTransducer compile(KeymapTable table, std::span<const KeymapRule> rules);
+
+    /// No rules: every code unit maps to exactly one.
+    bool singleUnit() const noexcept { return !trie_; }
+
+    const KeymapTable &table() const noexcept { return table_; }
+
+    /// Append the conversion of src to out.
+    void apply(std::wstring_view src, std::wstring &out) const;
+
+    /// How far applyUtf8() got: bytes of src read, bytes of dst written.
+    struct Utf8Progress {
+        std::size_t read = 0;
+        std::size_t written = 0;
+    };
+
+    /// Convert UTF-8 straight into dst, with the output decodeUtf8() →
+    /// apply() → encodeUtf8() would give, but without a wide string and
+    /// without allocating. It stops early before a character or rule output
+    /// that doesn't fit in dst and, unless last, before a character or rule
+    /// match that may go on past the end of src. To resume, pass the unread
+    /// bytes again followed by the next ones. Bytes of dst past the written
+    /// ones may have been used as scratch. Text goes through the codec and
+    /// table kernels a cache-sized chunk at a time.
+    Utf8Progress applyUtf8(std::string_view src, std::span<char> dst, bool last = true) const noexcept;
+
+    /// Exact size of applyUtf8()'s output for the whole of src, for sizing dst up front.
+    std::size_t utf8Size(std::string_view src) const noexcept;
+
+    /// Number of trie states (0 without rules).
+    std::size_t states() const noexcept { return trie_ ? trie_->nodes.size() : 0; }
+
+private:
+    static constexpr std::uint32_t FILTER_BITS = 12;
+    static constexpr std::uint32_t NO_OUTPUT = 0xFFFFFFFF;
+    static constexpr std::size_t SHORT_RUN = 32; // shorter gaps are mapped a unit at a time
+
+    struct Node {
+        std::uint32_t firstEdge = 0;
+        std::uint32_t edges = 0;
+        std::uint32_t output = NO_OUTPUT; // offset into Trie::outputs, or NO_OUTPUT
+        std::uint32_t outputLength = 0;
+    };
+
+    struct Edge {
+        KeymapTable::Unit unit;
+        std::uint32_t target;
+    };
+
+    struct Trie {
+        std::vector<Node> nodes;  // nodes[0] is the root
+        std::vector<Edge> edges;  // each node's edges sorted by unit
+        std::wstring outputs;
+        std::bitset<1u << FILTER_BITS> starts; // low bits of every rule's first unit
+        std::size_t longest = 0;                // units in the longest rule's source
+    };
+
+    /// Length of the longest rule matching at src[0] (0 if none) and its node.
+    std::size_t match(std::wstring_view src, const Node *&node) const noexcept;
+
+    /// The node after unit from at, or nullptr if no rule goes on with it.
+    const Node *step(const Node *at, KeymapTable::Unit unit) const noexcept;
+
+    template<typename Out>
+    std::size_t convertUtf8(std::string_view src, Out &out, bool last) const noexcept;
+
+    KeymapTable table_;
+    std::shared_ptr<const Trie> trie_; // null without rules; shared between copies
+};
@@ -0,0 +1,235 @@
+// this is layout_matrix.cpp
+//
+// All tables live in one block: a page index per source layout and one
+// pool of pages. Every pair out of a source views that source's index; the
+// pool is laid out so the pairs also share their zero pages, leaving each
+// pair only the pages holding the characters its source types. Keys typing
+// more than one unit become rules of the pairs' transducers. The script
+// table is read back off the finished tables, so presets get one too.
+
+#include "layout_matrix.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    using Unit = KeymapTable::Unit;
+    using Keys = std::unordered_map<wchar_t, wchar_t>;
+    using Sequences = std::unordered_map<std::wstring, std::wstring>;
+
+    struct Storage {
+        std::vector<std::uint16_t> indices; // PAGE_COUNT entries per source layout
+        std::vector<Unit> pages;
+    };
+
+    bool inRange(const wchar_t ch) {
+        if constexpr (sizeof(wchar_t) > 2) return static_cast<Unit>(ch) < KeymapTable::CODE_SPACE;
+        else return true;
+    }
+
+    wchar_t typedOn(const Keys &keys, const wchar_t position) {
+        const auto it = keys.find(position);
+        return it != keys.end() ? it->second : position;
+    }
+
+    /// For one source layout: each character it types → the key it's on.
+    /// Where two keys type the same character the lower one wins. Keys in
+    /// typesSequence type more than one unit and decode through the rules.
+    Keys positionsOf(const Keys &keys, const std::vector<wchar_t> &positions, const Keys &typesSequence) {
+        Keys decode;
+        for (const wchar_t position: positions) {
+            if (const auto it = keys.find(position); it != keys.end()) decode.try_emplace(it->second, position);
+        }
+        for (const wchar_t position: positions) {
+            if (!keys.contains(position) && !typesSequence.contains(position)) decode.try_emplace(position, position);
+        }
+        return decode;
+    }
+
+    /// What a layout types on a key, or a sequence of them.
+    std::wstring typedOn(const Keys &keys, const Sequences &sequences, const std::wstring &position) {
+        if (const auto it = sequences.find(position); it != sequences.end()) return it->second;
+        if (position.size() == 1) return std::wstring(1, typedOn(keys, position[0]));
+        return position;
+    }
+
+    /// Shared by every matrix no tables were built for.
+    const std::shared_ptr<const ScriptTable> &noScripts() {
+        static const auto none = std::make_shared<const ScriptTable>();
+        return none;
+    }
+}
+
+LayoutMatrix::LayoutMatrix() : layouts_(2), pairs_(4), scripts_(noScripts()) {
+}
+
+LayoutMatrix LayoutMatrix::pair(KeymapTable forward, KeymapTable backward) {
+    LayoutMatrix matrix;
+    matrix.pairs_[1] = KeymapTransducer(std::move(forward));
+    matrix.pairs_[2] = KeymapTransducer(std::move(backward));
+    matrix.scripts_ = std::make_shared<const ScriptTable>(ScriptTable::build(matrix));
+    return matrix;
+}
+
+LayoutMatrix LayoutMatrix::build(const std::span<const Keys *const> keys,
+                                 const std::span<const std::vector<KeymapRule> *const> sequences) {
+    const std::size_t n = std::min(keys.size(), MAX_LAYOUTS);
+
+    // Multi-unit keys per layout (the first rule for a key wins), and the
+    // single keys among them, which type no single character.
+    std::vector<Sequences> rules(n);
+    std::vector<Keys> typesSequence(n);
+    std::vector<std::wstring> sequencePositions;
+    for (std::size_t i = 0; i < n && i < sequences.size(); ++i) {
+        if (!sequences[i]) continue;
+        for (const auto &[position, typed]: *sequences[i]) {
+            if (position.empty() || !rules[i].try_emplace(position, typed).second) continue;
+            sequencePositions.push_back(position);
+            if (position.size() == 1) typesSequence[i].try_emplace(position[0], position[0]);
+        }
+    }
+    std::sort(sequencePositions.begin(), sequencePositions.end());
+    sequencePositions.erase(std::unique(sequencePositions.begin(), sequencePositions.end()), sequencePositions.end());
+
+    // Every key some layout puts something other than US QWERTY on.
+    std::vector<wchar_t> positions;
+    for (std::size_t i = 0; i < n; ++i) {
+        for (const auto &[position, typed]: *keys[i]) positions.push_back(position);
+    }
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+    auto storage = std::make_shared<Storage>();
+    storage->indices.assign(n * KeymapTable::PAGE_COUNT, 0);
+
+    // Characters each source converts (A–Z are folded in below, as
+    // KeymapTable::compile() does) and the pages they occupy, numbered from 1.
+    std::vector<Keys> decode(n);
+    std::vector<std::size_t> slots(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        decode[i] = positionsOf(*keys[i], positions, typesSequence[i]);
+        std::uint16_t *index = storage->indices.data() + i * KeymapTable::PAGE_COUNT;
+        auto claim = [&](const wchar_t ch) {
+            std::uint16_t &page = index[static_cast<Unit>(ch) >> KeymapTable::PAGE_BITS];
+            if (page == 0) page = static_cast<std::uint16_t>(++slots[i]);
+        };
+        for (const auto &[ch, position]: decode[i]) {
+            if (inRange(ch) && !(ch >= L'A' && ch <= L'Z')) claim(ch);
+        }
+        claim(L'A');
+    }
+
+    // Page layout: n - 1 zero pages, then per source its slots, each slot
+    // holding one page per target. The table for the t-th target of a
+    // source starts t pages in, so page id 0 lands on a zero page for
+    // every pair and slot s of the source on page (s - 1) * (n - 1).
+    const std::size_t targets = n - 1;
+    std::size_t total = targets;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint16_t *index = storage->indices.data() + i * KeymapTable::PAGE_COUNT;
+        for (std::size_t page = 0; page < KeymapTable::PAGE_COUNT; ++page) {
+            if (index[page] != 0) index[page] = static_cast<std::uint16_t>(total + (index[page] - 1) * targets);
+        }
+        total += slots[i] * targets;
+    }
+    if (total > 0xFFFF) throw std::length_error("layout keys span too many pages");
+    storage->pages.assign(total * KeymapTable::PAGE_SIZE, 0);
+
+    // Which of its source's targets a pair is: 0 .. n - 2.
+    auto column = [](const std::size_t from, const std::size_t to) { return to < from ? to : to - 1; };
+
+    for (std::size_t from = 0; from < n; ++from) {
+        const std::uint16_t *index = storage->indices.data() + from * KeymapTable::PAGE_COUNT;
+        for (std::size_t to = 0; to < n; ++to) {
+            if (from == to) continue;
+            Unit *pages = storage->pages.data() + column(from, to) * KeymapTable::PAGE_SIZE;
+            auto set = [&](const wchar_t ch, const wchar_t out) {
+                const auto u = static_cast<Unit>(ch);
+                const std::size_t page = index[u >> KeymapTable::PAGE_BITS];
+                pages[(page << KeymapTable::PAGE_BITS) | (u & (KeymapTable::PAGE_SIZE - 1))] =
+                        static_cast<Unit>(static_cast<Unit>(out) - u);
+            };
+
+            for (const auto &[ch, position]: decode[from]) {
+                if (inRange(ch) && !(ch >= L'A' && ch <= L'Z')) set(ch, typedOn(*keys[to], position));
+            }
+            for (wchar_t upper = L'A'; upper <= L'Z'; ++upper) {
+                const auto lower = static_cast<wchar_t>(upper + 32);
+                const auto it = decode[from].find(lower);
+                set(upper, it != decode[from].end() ? typedOn(*keys[to], it->second) : lower);
+            }
+        }
+    }
+
+    LayoutMatrix matrix;
+    matrix.layouts_ = n;
+    matrix.pairs_.assign(n * n, KeymapTransducer());
+    matrix.bytes_ = storage->indices.size() * sizeof(std::uint16_t) + storage->pages.size() * sizeof(Unit);
+    const std::shared_ptr<const Storage> owner = std::move(storage);
+    std::vector<KeymapRule> pairRules;
+    for (std::size_t from = 0; from < n; ++from) {
+        for (std::size_t to = 0; to < n; ++to) {
+            if (from == to) continue;
+            auto table = KeymapTable::view(owner, owner->indices.data() + from * KeymapTable::PAGE_COUNT,
+                                           owner->pages.data() + column(from, to) * KeymapTable::PAGE_SIZE,
+                                           1 + slots[from]);
+
+            // Keys either layout types a sequence on, unless the table
+            // already covers them (one unit on both sides of a single key).
+            pairRules.clear();
+            for (const auto &position: sequencePositions) {
+                std::wstring src = typedOn(*keys[from], rules[from], position);
+                std::wstring dst = typedOn(*keys[to], rules[to], position);
+                if (src == dst || (position.size() == 1 && src.size() == 1 && dst.size() == 1)) continue;
+                pairRules.push_back({std::move(src), std::move(dst)});
+            }
+            KeymapTransducer &pair = matrix.pairs_[from * n + to];
+            pair = KeymapTransducer::compile(std::move(table), pairRules);
+            matrix.singleUnit_ = matrix.singleUnit_ && pair.singleUnit();
+        }
+    }
+    matrix.scripts_ = std::make_shared<const ScriptTable>(ScriptTable::build(matrix));
+    return matrix;
+}
+
+ScriptTable::ScriptTable() : index_(KeymapTable::PAGE_COUNT, 0), pages_(KeymapTable::PAGE_SIZE, 0) {
+}
+
+ScriptTable ScriptTable::build(const LayoutMatrix &tables) {
+    constexpr std::uint32_t pages = sizeof(wchar_t) > 2 ? KeymapTable::PAGE_COUNT : 0x10000 >> KeymapTable::PAGE_BITS;
+    const std::size_t n = tables.layouts();
+
+    ScriptTable scripts;
+    std::uint8_t movedBy[KeymapTable::PAGE_SIZE]; // bit l: converting out of layout l moves the unit
+    for (std::uint32_t page = 0; page < pages; ++page) {
+        std::fill(movedBy, movedBy + KeymapTable::PAGE_SIZE, 0);
+        bool any = false;
+        for (std::size_t from = 0; from < n; ++from) {
+            for (std::size_t to = 0; to < n; ++to) {
+                if (from == to) continue;
+                const KeymapTable &table = tables.table({static_cast<LayoutId>(from), static_cast<LayoutId>(to)});
+                if (!table.pageMapped(page)) continue;
+                for (std::uint32_t unit = 0; unit < KeymapTable::PAGE_SIZE; ++unit) {
+                    const auto ch = static_cast<wchar_t>((page << KeymapTable::PAGE_BITS) | unit);
+                    const wchar_t lower = ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + 32) : ch;
+                    const wchar_t out = table.map(ch);
+                    if (out != ch && out != lower) {
+                        movedBy[unit] |= static_cast<std::uint8_t>(1u << from);
+                        any = true;
+                    }
+                }
+            }
+        }
+        if (!any) continue;
+
+        const std::size_t id = scripts.pages_.size() / KeymapTable::PAGE_SIZE;
+        if (id > 0xFF) throw std::length_error("layout scripts span too many pages");
+        scripts.index_[page] = static_cast<std::uint8_t>(id);
+        for (const std::uint8_t moved: movedBy) {
+            scripts.pages_.push_back(std::has_single_bit(moved) ? moved : 0);
+        }
+    }
+    std::copy_n(scripts.pages_.begin() + scripts.index_[0] * KeymapTable::PAGE_SIZE, 128, scripts.ascii_);
+    return scripts;
+}
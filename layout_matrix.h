@@ -0,0 +1,131 @@
+// this is layout_matrix.h
+#pragma once
+
+#include "keymap.h"
+#include "keymap_transducer.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// ─── Layouts & Directions ──────────────────────────────────────────────
+
+/// Index of a layout in the configured list.
+using LayoutId = std::uint8_t;
+
+/// What detection reports when the active layout isn't a configured one.
+inline constexpr LayoutId NO_LAYOUT = 0xFF;
+
+/// A conversion from one layout to another; from == to reads text as typed.
+struct Direction {
+    LayoutId from = NO_LAYOUT;
+    LayoutId to = NO_LAYOUT;
+
+    /// True when both ends are layouts and they differ.
+    bool converts() const noexcept { return from != to && from != NO_LAYOUT && to != NO_LAYOUT; }
+
+    bool operator==(const Direction &) const = default;
+};
+
+class ScriptTable;
+
+// ─── Per-Pair Tables ───────────────────────────────────────────────────
+
+/// Every source→target table for a set of layouts, built once per config.
+///
+/// Layouts are described by key position: keys maps what US QWERTY types on
+/// a key to what the layout types there (empty for US QWERTY itself). A→B
+/// decodes each character to the key A types it with and gives what B types
+/// on that key; characters A can't type pass through.
+///
+/// Every table out of the same layout touches the same pages, so they share
+/// one page index and each pair adds only its own few pages: memory and build
+/// time grow with the number of layouts, not with a full table per pair.
+///
+/// Keys whose key or output is longer than one code unit come as rules
+/// (from: what US QWERTY types, to: what the layout types) and give the
+/// pairs they touch a transducer on top of the table.
+class LayoutMatrix {
+public:
+    static constexpr std::size_t MAX_LAYOUTS = 8;
+
+    /// Two layouts, both tables identity (A–Z lowercasing only).
+    LayoutMatrix();
+
+    /// Build every table; keys[i] is layout i's key table and sequences[i]
+    /// (if given) its multi-unit keys. 2 to MAX_LAYOUTS layouts.
+    static LayoutMatrix build(std::span<const std::unordered_map<wchar_t, wchar_t> *const> keys,
+                              std::span<const std::vector<KeymapRule> *const> sequences = {});
+
+    /// Two layouts whose tables were built elsewhere, e.g. a preset's compile-time ones.
+    static LayoutMatrix pair(KeymapTable forward, KeymapTable backward);
+
+    std::size_t layouts() const noexcept { return layouts_; }
+
+    /// The table for d (both ends < layouts()); identity when from == to.
+    /// Maps one code unit to one, so it ignores the multi-unit keys.
+    const KeymapTable &table(const Direction d) const noexcept { return transducer(d).table(); }
+
+    /// The full conversion for d, multi-unit keys included.
+    const KeymapTransducer &transducer(const Direction d) const noexcept { return pairs_[d.from * layouts_ + d.to]; }
+
+    /// No pair has multi-unit keys: every conversion keeps the text's length.
+    bool singleUnit() const noexcept { return singleUnit_; }
+
+    /// Bytes of page index and pages built for this matrix (0 after pair()).
+    std::size_t bytes() const noexcept { return bytes_; }
+
+    /// Which layout types each character, read off these tables.
+    const ScriptTable &scripts() const noexcept { return *scripts_; }
+
+private:
+    std::size_t layouts_ = 0;
+    std::vector<KeymapTransducer> pairs_; // layouts_ rows (from) of layouts_ columns (to)
+    std::size_t bytes_ = 0;
+    bool singleUnit_ = true;
+    std::shared_ptr<const ScriptTable> scripts_;
+};
+
+// ─── Script Classes ────────────────────────────────────────────────────
+
+/// The layout each code unit is typed in, as a page table like KeymapTable's.
+/// A unit belongs to a layout when converting out of that layout moves it
+/// (A–Z lowercasing aside): Latin letters to US QWERTY, Hebrew ones to
+/// Hebrew. Units no layout moves (digits, space) and units several layouts
+/// type on different keys ('.', ',' and '/' against Hebrew, or letters two
+/// Cyrillic layouts share) belong to none: their layout comes from the text
+/// around them.
+class ScriptTable {
+public:
+    /// Every unit belongs to no layout.
+    ScriptTable();
+
+    /// From every table out of every layout in tables.
+    static ScriptTable build(const LayoutMatrix &tables);
+
+    /// 1 << the one layout typing ch, or 0.
+    std::uint8_t layoutBit(const wchar_t ch) const noexcept {
+        const auto u = static_cast<KeymapTable::Unit>(ch);
+        if (u < 128) return ascii_[u];
+        if constexpr (sizeof(wchar_t) > 2) {
+            if (u >= KeymapTable::CODE_SPACE) return 0;
+        }
+        const std::size_t page = index_[u >> KeymapTable::PAGE_BITS];
+        return pages_[(page << KeymapTable::PAGE_BITS) | (u & (KeymapTable::PAGE_SIZE - 1))];
+    }
+
+    /// The one layout typing ch, or NO_LAYOUT.
+    LayoutId layoutOf(const wchar_t ch) const noexcept {
+        const std::uint8_t bit = layoutBit(ch);
+        return bit ? static_cast<LayoutId>(std::countr_zero(bit)) : NO_LAYOUT;
+    }
+
+private:
+    std::vector<std::uint8_t> index_; // PAGE_COUNT entries → page id
+    std::vector<std::uint8_t> pages_; // layout bits; page 0 all 0
+    std::uint8_t ascii_[128] = {};    // ASCII's bits again, one load away
+};
@@ -0,0 +1,95 @@
+// this is layout_presets.cpp
+//
+// Keymaps of the standard Windows layouts against US QWERTY. Each one is
+// compiled into both page tables by the compiler (see StaticKeymap), so the
+// tables live in read-only data and choosing a preset costs nothing.
+
+#include "layout_presets.h"
+
+namespace {
+    constexpr auto kHebrew = std::to_array<KeymapPair>({
+        {L'q', L'/'}, {L'w', L'\''}, {L'e', L'ק'}, {L'r', L'ר'}, {L't', L'א'},
+        {L'y', L'ט'}, {L'u', L'ו'}, {L'i', L'ן'}, {L'o', L'ם'}, {L'p', L'פ'},
+        {L'a', L'ש'}, {L's', L'ד'}, {L'd', L'ג'}, {L'f', L'כ'}, {L'g', L'ע'},
+        {L'h', L'י'}, {L'j', L'ח'}, {L'k', L'ל'}, {L'l', L'ך'}, {L';', L'ף'}, {L'\'', L','},
+        {L'z', L'ז'}, {L'x', L'ס'}, {L'c', L'ב'}, {L'v', L'ה'}, {L'b', L'נ'},
+        {L'n', L'מ'}, {L'm', L'צ'}, {L',', L'ת'}, {L'.', L'ץ'}, {L'/', L'.'}
+    });
+
+    constexpr auto kRussian = std::to_array<KeymapPair>({
+        {L'`', L'ё'},
+        {L'q', L'й'}, {L'w', L'ц'}, {L'e', L'у'}, {L'r', L'к'}, {L't', L'е'}, {L'y', L'н'},
+        {L'u', L'г'}, {L'i', L'ш'}, {L'o', L'щ'}, {L'p', L'з'}, {L'[', L'х'}, {L']', L'ъ'},
+        {L'a', L'ф'}, {L's', L'ы'}, {L'd', L'в'}, {L'f', L'а'}, {L'g', L'п'}, {L'h', L'р'},
+        {L'j', L'о'}, {L'k', L'л'}, {L'l', L'д'}, {L';', L'ж'}, {L'\'', L'э'},
+        {L'z', L'я'}, {L'x', L'ч'}, {L'c', L'с'}, {L'v', L'м'}, {L'b', L'и'}, {L'n', L'т'},
+        {L'm', L'ь'}, {L',', L'б'}, {L'.', L'ю'}, {L'/', L'.'}
+    });
+
+    constexpr auto kUkrainian = std::to_array<KeymapPair>({
+        {L'`', L'\''},
+        {L'q', L'й'}, {L'w', L'ц'}, {L'e', L'у'}, {L'r', L'к'}, {L't', L'е'}, {L'y', L'н'},
+        {L'u', L'г'}, {L'i', L'ш'}, {L'o', L'щ'}, {L'p', L'з'}, {L'[', L'х'}, {L']', L'ї'},
+        {L'\\', L'ґ'},
+        {L'a', L'ф'}, {L's', L'і'}, {L'd', L'в'}, {L'f', L'а'}, {L'g', L'п'}, {L'h', L'р'},
+        {L'j', L'о'}, {L'k', L'л'}, {L'l', L'д'}, {L';', L'ж'}, {L'\'', L'є'},
+        {L'z', L'я'}, {L'x', L'ч'}, {L'c', L'с'}, {L'v', L'м'}, {L'b', L'и'}, {L'n', L'т'},
+        {L'm', L'ь'}, {L',', L'б'}, {L'.', L'ю'}, {L'/', L'.'}
+    });
+
+    // Arabic (101). B types the two-letter lam-alef, which a one-for-one
+    // table can't express, so it is left out.
+    constexpr auto kArabic = std::to_array<KeymapPair>({
+        {L'`', L'ذ'},
+        {L'q', L'ض'}, {L'w', L'ص'}, {L'e', L'ث'}, {L'r', L'ق'}, {L't', L'ف'}, {L'y', L'غ'},
+        {L'u', L'ع'}, {L'i', L'ه'}, {L'o', L'خ'}, {L'p', L'ح'}, {L'[', L'ج'}, {L']', L'د'},
+        {L'a', L'ش'}, {L's', L'س'}, {L'd', L'ي'}, {L'f', L'ب'}, {L'g', L'ل'}, {L'h', L'ا'},
+        {L'j', L'ت'}, {L'k', L'ن'}, {L'l', L'م'}, {L';', L'ك'}, {L'\'', L'ط'},
+        {L'z', L'ئ'}, {L'x', L'ء'}, {L'c', L'ؤ'}, {L'v', L'ر'}, {L'n', L'ى'}, {L'm', L'ة'},
+        {L',', L'و'}, {L'.', L'ز'}, {L'/', L'ظ'}
+    });
+
+    constexpr auto kGreek = std::to_array<KeymapPair>({
+        {L'q', L';'}, {L'w', L'ς'}, {L'e', L'ε'}, {L'r', L'ρ'}, {L't', L'τ'},
+        {L'y', L'υ'}, {L'u', L'θ'}, {L'i', L'ι'}, {L'o', L'ο'}, {L'p', L'π'},
+        {L'a', L'α'}, {L's', L'σ'}, {L'd', L'δ'}, {L'f', L'φ'}, {L'g', L'γ'},
+        {L'h', L'η'}, {L'j', L'ξ'}, {L'k', L'κ'}, {L'l', L'λ'}, {L';', L'΄'},
+        {L'z', L'ζ'}, {L'x', L'χ'}, {L'c', L'ψ'}, {L'v', L'ω'}, {L'b', L'β'},
+        {L'n', L'ν'}, {L'm', L'μ'}
+    });
+
+    template<const auto &Pairs>
+    constexpr LayoutPreset preset(const std::string_view name, const WORD lang, const wchar_t *role) {
+        return {
+            name,
+            LANG_ENGLISH, SUBLANG_DEFAULT, L"English",
+            lang, SUBLANG_DEFAULT, role,
+            Pairs,
+            []() noexcept { return KeymapTable::view(staticKeymap<Pairs, false>); },
+            []() noexcept { return KeymapTable::view(staticKeymap<Pairs, true>); },
+        };
+    }
+
+    constexpr LayoutPreset kPresets[] = {
+        preset<kHebrew>("en-he", LANG_HEBREW, L"Hebrew"),
+        preset<kRussian>("en-ru", LANG_RUSSIAN, L"Russian"),
+        preset<kUkrainian>("en-uk", LANG_UKRAINIAN, L"Ukrainian"),
+        preset<kArabic>("en-ar", LANG_ARABIC, L"Arabic"),
+        preset<kGreek>("en-el", LANG_GREEK, L"Greek"),
+    };
+}
+
+std::span<const LayoutPreset> layoutPresets() {
+    return kPresets;
+}
+
+const LayoutPreset *findLayoutPreset(const std::string_view name) {
+    auto lower = [](const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; };
+    for (const auto &preset: kPresets) {
+        if (preset.name.size() != name.size()) continue;
+        bool same = true;
+        for (std::size_t i = 0; i < name.size() && same; ++i) same = lower(name[i]) == preset.name[i];
+        if (same) return &preset;
+    }
+    return nullptr;
+}
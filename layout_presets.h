@@ -0,0 +1,38 @@
+// this is layout_presets.h
+#pragma once
+
+#include "keymap.h"
+#include "win32_compat.h"   // for WORD
+
+#include <span>
+#include <string_view>
+
+// ─── Built-in Layout Pairs ─────────────────────────────────────────────
+
+/// A common primary/secondary layout pair whose tables were built at
+/// compile time. Naming one in LAYOUT_PRESET replaces the LANG_*,
+/// ROLE_NAME_* and KEYMAP settings without parsing or building anything.
+struct LayoutPreset {
+    std::string_view name; // what LAYOUT_PRESET says, e.g. "en-he"
+
+    WORD langPrimary;
+    WORD sublangPrimary;
+    const wchar_t *rolePrimary;
+
+    WORD langSecondary;
+    WORD sublangSecondary;
+    const wchar_t *roleSecondary;
+
+    /// Primary key → secondary character, as KEYMAP_PRIMARY_TO_SECONDARY would list them.
+    std::span<const KeymapPair> keys;
+
+    /// Views of the compile-time tables for each direction.
+    KeymapTable (*toSecondary)() noexcept;
+    KeymapTable (*toPrimary)() noexcept;
+};
+
+/// Every built-in preset.
+std::span<const LayoutPreset> layoutPresets();
+
+/// The preset called name (case-insensitive), or nullptr.
+const LayoutPreset *findLayoutPreset(std::string_view name);
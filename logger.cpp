@@ -0,0 +1,281 @@
+// this is logger.cpp
+
+#include "logger.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace logger {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        const Clock::time_point kStart = Clock::now();
+
+        std::atomic<std::uint32_t> nextThread{0};
+
+        std::uint32_t threadNumber() noexcept {
+            thread_local const std::uint32_t number = nextThread.fetch_add(1, std::memory_order_relaxed) + 1;
+            return number;
+        }
+
+        /// A bounded ring for many producers and the one writer. Each cell
+        /// carries a sequence number: pos while free for the producer that
+        /// claims position pos, pos + 1 once its record is in, and
+        /// pos + kCapacity after the writer took it out.
+        struct Cell {
+            std::atomic<std::size_t> sequence{0};
+            Record record;
+        };
+
+        class Writer {
+        public:
+            Writer() : cells_(std::make_unique<Cell[]>(kCapacity)) {
+                for (std::size_t i = 0; i < kCapacity; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+                thread_ = std::thread([this] { run(); });
+            }
+
+            ~Writer() {
+                {
+                    std::lock_guard lock(mutex_);
+                    stop_ = true;
+                }
+                wake_.notify_one();
+                thread_.join();
+            }
+
+            bool push(const Record &record) noexcept {
+                std::size_t pos = enqueue_.load(std::memory_order_relaxed);
+                Cell *cell;
+                for (;;) {
+                    cell = &cells_[pos & (kCapacity - 1)];
+                    const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                    const auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+                    if (lag == 0) {
+                        if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (lag < 0) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    } else {
+                        pos = enqueue_.load(std::memory_order_relaxed);
+                    }
+                }
+                Record &slot = cell->record;
+                slot.timeUs = record.timeUs;
+                slot.thread = record.thread;
+                slot.length = record.length;
+                slot.truncated = record.truncated;
+                std::copy_n(record.text, record.length, slot.text);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+
+                // Pairs with the fence in run(): either the writer sees this
+                // record before it parks, or we see it parked and wake it.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (parked_.load(std::memory_order_relaxed)) wakeWriter();
+                return true;
+            }
+
+            void setFile(const std::string &path) {
+                std::lock_guard lock(mutex_);
+                path_ = path;
+                ++sinkGeneration_;
+            }
+
+            void flush() {
+                const std::size_t target = enqueue_.load(std::memory_order_acquire);
+                const std::uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+                wakeWriter();
+                std::unique_lock lock(mutex_);
+                drained_.wait(lock, [&] {
+                    return (static_cast<std::ptrdiff_t>(flushed_ - target) >= 0 && droppedWritten_ >= dropped) || stop_;
+                });
+            }
+
+            Stats stats() const noexcept {
+                return {written_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed)};
+            }
+
+        private:
+            void wakeWriter() {
+                if (!parked_.exchange(false, std::memory_order_seq_cst)) return;
+                std::lock_guard lock(mutex_);
+                wake_.notify_one();
+            }
+
+            bool ready() const noexcept {
+                return cells_[dequeue_ & (kCapacity - 1)].sequence.load(std::memory_order_acquire) == dequeue_ + 1;
+            }
+
+            void format(const Record &record) {
+                wchar_t header[40];
+                const int n = std::swprintf(header, std::size(header), L"[%10.3f ms #%u] ", record.timeUs / 1e3,
+                                            static_cast<unsigned>(record.thread));
+                if (n > 0) batch_.append(header, static_cast<std::size_t>(n));
+                batch_.append(record.text, record.length);
+                if (record.truncated) batch_ += L'…';
+                batch_ += L'\n';
+            }
+
+            void openSink() {
+                std::string path;
+                {
+                    std::lock_guard lock(mutex_);
+                    if (sinkGeneration_ == openGeneration_) return;
+                    openGeneration_ = sinkGeneration_;
+                    path = path_;
+                }
+                file_.close();
+                file_.clear();
+                if (!path.empty()) file_.open(path, std::ios::binary | std::ios::app);
+            }
+
+            void write() {
+                if (batch_.empty()) return;
+                openSink();
+                if (file_.is_open()) {
+                    bytes_.clear();
+                    encodeUtf8(batch_, bytes_);
+                    file_.write(bytes_.data(), static_cast<std::streamsize>(bytes_.size()));
+                    file_.flush();
+                } else {
+                    std::wcout << batch_;
+                    std::wcout.flush();
+                }
+                batch_.clear();
+            }
+
+            /// Take out and write every record that is in, and report new drops;
+            /// false if there was nothing to do.
+            bool drain() {
+                std::uint64_t taken = 0;
+                while (ready()) {
+                    Cell &cell = cells_[dequeue_ & (kCapacity - 1)];
+                    format(cell.record);
+                    cell.sequence.store(dequeue_ + kCapacity, std::memory_order_release);
+                    ++dequeue_;
+                    ++taken;
+                    if (batch_.size() >= 64 * 1024) write();
+                }
+                const std::uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+                if (dropped != reportedDrops_) {
+                    batch_ += L"[log] " + std::to_wstring(dropped - reportedDrops_) + L" messages dropped\n";
+                    reportedDrops_ = dropped;
+                }
+                write();
+                written_.fetch_add(taken, std::memory_order_relaxed);
+                {
+                    std::lock_guard lock(mutex_);
+                    if (taken == 0 && droppedWritten_ == reportedDrops_) return false;
+                    flushed_ = dequeue_;
+                    droppedWritten_ = reportedDrops_;
+                }
+                drained_.notify_all();
+                return true;
+            }
+
+            void run() {
+                for (;;) {
+                    while (drain()) {
+                    }
+                    std::unique_lock lock(mutex_);
+                    if (stop_) break;
+                    parked_.store(true, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (ready()) {
+                        parked_.store(false, std::memory_order_relaxed);
+                        continue;
+                    }
+                    wake_.wait(lock, [&] { return !parked_.load(std::memory_order_relaxed) || stop_; });
+                    parked_.store(false, std::memory_order_relaxed);
+                }
+                while (drain()) {
+                }
+                drained_.notify_all();
+            }
+
+            std::unique_ptr<Cell[]> cells_;
+            alignas(64) std::atomic<std::size_t> enqueue_{0};
+            alignas(64) std::atomic<std::uint64_t> dropped_{0};
+            std::atomic<std::uint64_t> written_{0};
+            std::atomic<bool> parked_{false};
+
+            std::mutex mutex_;
+            std::condition_variable wake_, drained_;
+            bool stop_ = false;
+            std::size_t flushed_ = 0;         // records written out
+            std::uint64_t droppedWritten_ = 0; // drops reported in the output
+            std::string path_;
+            std::uint64_t sinkGeneration_ = 0;
+
+            // The writer thread's own.
+            std::size_t dequeue_ = 0;
+            std::uint64_t reportedDrops_ = 0, openGeneration_ = 0;
+            std::wstring batch_;
+            std::string bytes_;
+            std::ofstream file_;
+            std::thread thread_;
+        };
+
+        /// Started by the first message, so a quiet program never has the thread.
+        Writer &writer() {
+            static Writer instance;
+            return instance;
+        }
+    }
+
+    bool submit(const Record &record) noexcept {
+        return writer().push(record);
+    }
+
+    Line::Line() noexcept {
+        record_.timeUs = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - kStart).count());
+        record_.thread = threadNumber();
+    }
+
+    Line::~Line() {
+        submit(record_);
+    }
+
+    Line &Line::operator<<(const std::wstring_view text) noexcept {
+        const std::size_t room = kTextUnits - record_.length;
+        const std::size_t n = std::min(room, text.size());
+        std::copy_n(text.data(), n, record_.text + record_.length);
+        record_.length = static_cast<std::uint16_t>(record_.length + n);
+        record_.truncated |= n < text.size();
+        return *this;
+    }
+
+    Line &Line::operator<<(const double value) noexcept {
+        char digits[32];
+        const auto end = std::to_chars(digits, digits + sizeof digits, value, std::chars_format::general, 6).ptr;
+        return appendAscii(digits, static_cast<std::size_t>(end - digits));
+    }
+
+    Line &Line::appendAscii(const char *digits, const std::size_t n) noexcept {
+        wchar_t wide[32];
+        const std::size_t count = std::min(n, std::size(wide));
+        std::copy_n(digits, count, wide);
+        return *this << std::wstring_view(wide, count);
+    }
+
+    void setFile(const std::string &path) {
+        writer().setFile(path);
+    }
+
+    void flush() {
+        writer().flush();
+    }
+
+    Stats stats() noexcept {
+        return writer().stats();
+    }
+}
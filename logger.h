@@ -0,0 +1,78 @@
+// this is logger.h
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ─── Asynchronous Log ──────────────────────────────────────────────────
+
+/// Debug output off the correction path. A message is formatted into a
+/// fixed-size record on the caller's stack, with no allocation, and put in
+/// a lock-free ring; a background thread writes the records to the console
+/// or a file. A message longer than a record is cut, so logging a whole
+/// selection costs the same as logging a word. When the writer falls behind
+/// and the ring is full, new records are dropped and counted, never waited
+/// for. Use it through DEBUG_PRINT (utils.h).
+namespace logger {
+
+    /// Characters kept per message; the rest is cut and marked with "…".
+    constexpr std::size_t kTextUnits = 160;
+
+    /// Records waiting for the writer at most.
+    constexpr std::size_t kCapacity = 512;
+
+    struct Record {
+        std::uint64_t timeUs = 0; // since the program started
+        std::uint32_t thread = 0; // 1, 2, … in the order threads first log
+        std::uint16_t length = 0; // units used in text
+        bool truncated = false;
+        wchar_t text[kTextUnits];
+    };
+
+    /// Queue a record; false (and counted) if the ring is full.
+    bool submit(const Record &record) noexcept;
+
+    /// One message, built with << and queued when it goes out of scope.
+    class Line {
+    public:
+        Line() noexcept;
+        ~Line();
+        Line(const Line &) = delete;
+        Line &operator=(const Line &) = delete;
+
+        Line &operator<<(std::wstring_view text) noexcept;
+        Line &operator<<(const wchar_t *text) noexcept { return *this << std::wstring_view(text ? text : L"(null)"); }
+        Line &operator<<(wchar_t c) noexcept { return *this << std::wstring_view(&c, 1); }
+        Line &operator<<(double value) noexcept;
+
+        template<std::integral T> requires (!std::same_as<T, bool> && !std::same_as<T, wchar_t> && !std::same_as<T, char>)
+        Line &operator<<(const T value) noexcept {
+            char digits[24];
+            const auto end = std::to_chars(digits, digits + sizeof digits, value).ptr;
+            return appendAscii(digits, static_cast<std::size_t>(end - digits));
+        }
+
+    private:
+        Line &appendAscii(const char *digits, std::size_t n) noexcept;
+
+        Record record_;
+    };
+
+    /// Write to this file (appending, as UTF-8) instead of the console; empty
+    /// goes back to the console. Takes effect from the writer's next batch.
+    void setFile(const std::string &path);
+
+    /// Wait until everything queued so far has been written out.
+    void flush();
+
+    struct Stats {
+        std::uint64_t written = 0;
+        std::uint64_t dropped = 0; // ring full
+    };
+
+    Stats stats() noexcept;
+}
@@ -1,67 +1,220 @@
 // THIS IS THE MIAN.CPP
 
+#include "action_worker.h"
 #include "config.h"
+#include "config_watcher.h"
+#include "ipc_server.h"
+#include "logger.h"
+#include "metrics.h"
+#include "platform.h"
+#include "process_memory.h"
+#include "typing_watcher.h"
 #include "utils.h"
 
 #include <windows.h>
 #include <fcntl.h>   // _O_U16TEXT
 #include <io.h>      // _setmode
 #include <iostream>
-#include <thread>
-#include <chrono>
+#include <memory>
+
+// Posted to the main thread by the config watcher after a reload.
+constexpr UINT WM_CONFIG_RELOADED = WM_APP + 1;
+
+// Time since the process was created: covers loader, static init and config.
+static double msSinceLaunch() {
+    FILETIME created, exited, kernel, user, now;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    GetSystemTimePreciseAsFileTime(&now);
+    auto ticks = [](const FILETIME &t) { return (static_cast<unsigned long long>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return static_cast<double>(ticks(now) - ticks(created)) / 1e4; // 100 ns units
+}
+
+// ─── Latency Metrics & Log ─────────────────────────────────────────────
+
+static void applyDiagnosticSettings() {
+    const auto cfg = config::current();
+    metrics::setEnabled(cfg->METRICS);
+    metrics::setTracing(cfg->METRICS_TRACE);
+    if (cfg->DEBUG_MODE) logger::setFile(cfg->LOG_FILE);
+}
+
+static void dumpMetrics() {
+    logFootprint(L"Now");
+    const auto cfg = config::current();
+    if (!cfg->METRICS || cfg->METRICS_FILE.empty()) return;
+    if (metrics::dump(cfg->METRICS_FILE)) {
+        DEBUG_PRINT(L"[metrics] Latency written to " << config::utf8_to_wstring(cfg->METRICS_FILE));
+    } else {
+        DEBUG_PRINT(L"[metrics] Could not write " << config::utf8_to_wstring(cfg->METRICS_FILE));
+    }
+}
+
+// Ctrl+Break in the console logs the memory, writes the percentiles and keeps running;
+// closing the console writes them on the way out.
+static BOOL WINAPI onConsoleEvent(const DWORD event) {
+    dumpMetrics();
+    logger::flush();
+    return event == CTRL_BREAK_EVENT;
+}
+
+// ─── Hotkey Registration ───────────────────────────────────────────────
+
+// One hotkey as registered with Windows (RegisterHotKey binds it to this thread).
+struct Hotkey {
+    HotkeyAction action;
+    int id = 0;
+    UINT modifiers = 0;
+    UINT vk = 0;
+    bool registered = false;
+
+    bool sameKey(const Hotkey &other) const {
+        return id == other.id && modifiers == other.modifiers && vk == other.vk;
+    }
+};
+
+static Hotkey configured(const HotkeyAction action) {
+    const auto cfg = config::current();
+    switch (action) {
+        case HotkeyAction::Basic: return {action, cfg->BASIC_HOTKEY_ID, cfg->BASIC_HOTKEY_MODIFIERS, cfg->BASIC_HOTKEY_VK};
+        case HotkeyAction::Line: return {action, cfg->LINE_HOTKEY_ID, cfg->LINE_HOTKEY_MODIFIERS, cfg->LINE_HOTKEY_VK};
+        default: return {action, cfg->ALL_HOTKEY_ID, cfg->ALL_HOTKEY_MODIFIERS, cfg->ALL_HOTKEY_VK};
+    }
+}
+
+// Bring the registered hotkeys in line with the config, touching only the
+// ones that changed (or failed before). False if any could not be registered.
+static bool syncHotkeys(Hotkey (&hotkeys)[3]) {
+    Hotkey wanted[3];
+    for (int i = 0; i < 3; ++i) wanted[i] = configured(hotkeys[i].action);
+
+    // Release every changed one first, so two hotkeys can swap keys or ids.
+    for (int i = 0; i < 3; ++i) {
+        if (hotkeys[i].registered && !hotkeys[i].sameKey(wanted[i])) {
+            UnregisterHotKey(nullptr, hotkeys[i].id);
+            hotkeys[i].registered = false;
+        }
+    }
+    bool ok = true;
+    for (int i = 0; i < 3; ++i) {
+        if (hotkeys[i].registered) continue;
+        wanted[i].registered = registerHotkey(wanted[i].id, wanted[i].modifiers, wanted[i].vk);
+        if (!wanted[i].registered) DEBUG_PRINT(L"[hotkey] Could not register " << makeHotkeyName(wanted[i].modifiers, wanted[i].vk));
+        ok &= wanted[i].registered;
+        hotkeys[i] = wanted[i];
+    }
+    return ok;
+}
+
+// ─── As-You-Type ───────────────────────────────────────────────────────
+
+// Fed by the keyboard hook, which runs on this thread while it waits in GetMessage.
+static std::unique_ptr<TypingWatcher> typingWatcher;
+static bool typingHooked = false;
+
+// Rebuild the watcher for the current config; hook the keyboard only while there is one.
+static void syncTypingWatcher() {
+    typingWatcher = TypingWatcher::create();
+    if (typingWatcher && !typingHooked) {
+        typingHooked = installTypingHook([](const KeyPress &key) { return typingWatcher && typingWatcher->press(key); });
+    } else if (!typingWatcher && typingHooked) {
+        removeTypingHook();
+        typingHooked = false;
+    }
+}
+
+// ─── Conversion Service ────────────────────────────────────────────────
+
+static std::unique_ptr<IpcServer> ipcServer;
+
+// Follow IPC_ENDPOINT and IPC_THREADS. A server already on the right
+// endpoint only takes the new layouts and models, keeping its clients.
+static void syncIpcServer() {
+    const auto cfg = config::current();
+    if (ipcServer && ipcServer->serves(*cfg)) {
+        ipcServer->update(*cfg, IpcServer::modelsFor(*cfg));
+        return;
+    }
+    ipcServer.reset(); // frees the endpoint before it is opened again
+    ipcServer = IpcServer::create();
+}
 
 int main() {
-    // Load config from file (will override defaults in config.cpp)
+    // Talk to the real desktop
+    platform::install(platform::win32());
+
+    // Load config from file (will override the defaults in config.h)
     config::load("config.json");
 
-    if (config::DEBUG_MODE) {
+    if (config::current()->DEBUG_MODE) {
         // enable UTF-16 output
         _setmode(_fileno(stdout), _O_U16TEXT);
         _setmode(_fileno(stderr), _O_U16TEXT);
+        SetConsoleCtrlHandler(onConsoleEvent, TRUE);
     } else {
         FreeConsole();
     }
 
-    // Register all hotkeys
-    bool ok = true;
-    ok &= registerHotkey(config::BASIC_HOTKEY_ID, config::BASIC_HOTKEY_MODIFIERS, config::BASIC_HOTKEY_VK);
-    ok &= registerHotkey(config::LINE_HOTKEY_ID, config::LINE_HOTKEY_MODIFIERS, config::LINE_HOTKEY_VK);
-    ok &= registerHotkey(config::ALL_HOTKEY_ID, config::ALL_HOTKEY_MODIFIERS, config::ALL_HOTKEY_VK);
+    applyDiagnosticSettings();
 
-    if (!ok) {
+    // Register all hotkeys
+    Hotkey hotkeys[3] = {{HotkeyAction::Basic}, {HotkeyAction::Line}, {HotkeyAction::All}};
+    if (!syncHotkeys(hotkeys)) {
         MessageBoxA(nullptr, "Could not register all hotkeys", "Error", MB_ICONERROR);
         return 1;
     }
+    {
+        const auto cfg = config::current();
+        DEBUG_PRINT(L"[startup] Hotkeys registered " << msSinceLaunch() << L" ms after launch ("
+            << (cfg->LAYOUT_PRESET.empty() ? L"keymap from config" : L"preset " + config::utf8_to_wstring(cfg->LAYOUT_PRESET))
+            << L")");
+    }
+
+    syncTypingWatcher();
+    syncIpcServer();
+    if (config::current()->LOW_FOOTPRINT) trimProcessMemory();
+    logFootprint(L"Started");
+
+    // Corrections run on the worker; this thread only hands hotkeys over
+    ActionWorker worker;
+
+    // Edits to config.json apply without a restart. The watcher thread
+    // publishes the new settings; hotkeys belong to this thread, so it is
+    // told to re-register them.
+    const DWORD mainThread = GetCurrentThreadId();
+    ConfigWatcher watcher("config.json", std::chrono::milliseconds(config::current()->CONFIG_WATCH_POLL_MS),
+                          [mainThread] {
+                              if (config::reload("config.json")) {
+                                  PostThreadMessageW(mainThread, WM_CONFIG_RELOADED, 0, 0);
+                              }
+                          });
 
     // Blocks until a message arrives for any window or thread queue
     MSG msg;
     while (GetMessage(&msg, nullptr, 0, 0)) {
         if (msg.message == WM_HOTKEY) {
-            if (msg.wParam == config::BASIC_HOTKEY_ID) {
-                std::wcout << L"Basic Case: \n";
-                flushModifiers(config::BASIC_HOTKEY_MODIFIERS);
-                copyAndFlip();
-            } else if (msg.wParam == config::LINE_HOTKEY_ID) {
-                std::wcout << L"Line Case: \n";
-                flushModifiers(config::LINE_HOTKEY_MODIFIERS);
-                selectCurrentLine();
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                copyAndFlip();
-            } else if (msg.wParam == config::ALL_HOTKEY_ID) {
-                std::wcout << L"All Case: \n";
-                flushModifiers(config::ALL_HOTKEY_MODIFIERS);
-                selectAllText();
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                copyAndFlip();
+            for (const auto &hotkey: hotkeys) {
+                if (hotkey.registered && msg.wParam == static_cast<WPARAM>(hotkey.id)) {
+                    worker.post(hotkey.action);
+                    break;
+                }
             }
+        } else if (msg.message == WM_CONFIG_RELOADED) {
+            syncHotkeys(hotkeys);
+            syncTypingWatcher();
+            syncIpcServer();
+            applyDiagnosticSettings();
         }
     }
 
 
     // Unregister on exit
-    UnregisterHotKey(nullptr, config::BASIC_HOTKEY_ID);
-    UnregisterHotKey(nullptr, config::LINE_HOTKEY_ID);
-    UnregisterHotKey(nullptr, config::ALL_HOTKEY_ID);
+    for (const auto &hotkey: hotkeys) {
+        if (hotkey.registered) UnregisterHotKey(nullptr, hotkey.id);
+    }
+    if (typingHooked) removeTypingHook();
+    ipcServer.reset();
+    dumpMetrics();
+    if (config::current()->DEBUG_MODE) logger::flush();
 
     return 0;
 }
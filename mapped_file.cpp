@@ -0,0 +1,92 @@
+// this is mapped_file.cpp
+
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+        file_ = std::exchange(other.file_, nullptr);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+MappedFile MappedFile::open(const std::string &path) {
+    MappedFile mapped;
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return mapped;
+    mapped.file_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return mapped;
+
+    const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return mapped;
+    mapped.mapping_ = mapping;
+
+    mapped.data_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped.data_) mapped.size_ = static_cast<std::size_t>(size.QuadPart);
+    return mapped;
+}
+
+void MappedFile::reset() noexcept {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+    data_ = nullptr;
+    size_ = 0;
+    file_ = mapping_ = nullptr;
+}
+
+#else
+
+MappedFile MappedFile::open(const std::string &path) {
+    MappedFile mapped;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return mapped;
+
+    struct stat info{};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            mapped.data_ = data;
+            mapped.size_ = static_cast<std::size_t>(info.st_size);
+        }
+    }
+    close(fd); // the mapping keeps the file alive
+    return mapped;
+}
+
+void MappedFile::reset() noexcept {
+    if (data_) munmap(const_cast<void *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
@@ -0,0 +1,36 @@
+// this is mapped_file.h
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// ─── Read-Only File Mapping ────────────────────────────────────────────
+
+/// A whole file mapped read-only into memory. Pages are only read from
+/// disk when touched, so opening even a large file is nearly free.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// Map path; an empty mapping (data() == nullptr) if it can't be opened.
+    static MappedFile open(const std::string &path);
+
+    const void *data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    explicit operator bool() const noexcept { return data_ != nullptr; }
+
+private:
+    void reset() noexcept;
+
+    const void *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,308 @@
+// this is metrics.cpp
+
+#include "metrics.h"
+#include "process_memory.h"
+#include "third_party/json/json.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+
+namespace metrics {
+    namespace {
+        const Clock::time_point kStart = Clock::now();
+
+        std::atomic<bool> enabled_{true};
+        std::atomic<bool> tracing_{false};
+
+        // What noteFootprint() was told.
+        std::atomic<std::uint64_t> settled_{0}, overBudget_{0};
+        std::atomic<std::size_t> settledLast_{0}, settledPeak_{0};
+
+        std::array<Histogram, kStages> &histograms() {
+            static std::array<Histogram, kStages> all;
+            return all;
+        }
+
+        thread_local StageTimer *innermost = nullptr;
+        thread_local TraceRecord *tracing = nullptr; // the correction running on this thread, when traced
+
+        std::uint64_t toNs(const Clock::duration d) noexcept {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+            return ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+        }
+
+        std::uint32_t toUs(const std::uint64_t ns) noexcept {
+            return static_cast<std::uint32_t>(std::min<std::uint64_t>(ns / 1000, UINT32_MAX));
+        }
+
+        // ─── Trace Ring ────────────────────────────────────────────────────
+
+        /// One record behind a sequence lock: odd while being written, and
+        /// 2·ticket + 2 once record number ticket is in. Readers retry or
+        /// skip a slot whose sequence moved under them.
+        struct Slot {
+            std::atomic<std::uint64_t> sequence{0};
+            std::atomic<std::uint64_t> startUs{0};
+            std::atomic<std::uint32_t> totalUs{0}, chars{0};
+            std::atomic<bool> pasted{false};
+            std::array<std::atomic<std::uint32_t>, kStages> stageUs{};
+        };
+
+        struct TraceRing {
+            std::array<Slot, kTraceCapacity> slots;
+            std::atomic<std::uint64_t> next{0};
+
+            void push(const TraceRecord &record) noexcept {
+                const std::uint64_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+                Slot &slot = slots[ticket % kTraceCapacity];
+                slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                slot.startUs.store(record.startUs, std::memory_order_relaxed);
+                slot.totalUs.store(record.totalUs, std::memory_order_relaxed);
+                slot.chars.store(record.chars, std::memory_order_relaxed);
+                slot.pasted.store(record.pasted, std::memory_order_relaxed);
+                for (std::size_t s = 0; s < kStages; ++s) slot.stageUs[s].store(record.stageUs[s], std::memory_order_relaxed);
+                slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+            }
+
+            bool read(const std::uint64_t ticket, TraceRecord &out) const noexcept {
+                const Slot &slot = slots[ticket % kTraceCapacity];
+                if (slot.sequence.load(std::memory_order_acquire) != 2 * ticket + 2) return false;
+                out.startUs = slot.startUs.load(std::memory_order_relaxed);
+                out.totalUs = slot.totalUs.load(std::memory_order_relaxed);
+                out.chars = slot.chars.load(std::memory_order_relaxed);
+                out.pasted = slot.pasted.load(std::memory_order_relaxed);
+                for (std::size_t s = 0; s < kStages; ++s) out.stageUs[s] = slot.stageUs[s].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return slot.sequence.load(std::memory_order_relaxed) == 2 * ticket + 2;
+            }
+        };
+
+        TraceRing &ring() {
+            static TraceRing traces;
+            return traces;
+        }
+    }
+
+    const char *stageName(const Stage stage) noexcept {
+        switch (stage) {
+            case Stage::FlushModifiers: return "flushModifiers";
+            case Stage::SendCtrlC: return "sendCtrlC";
+            case Stage::WaitForClipboardChange: return "waitForClipboardChange";
+            case Stage::ReadClipboard: return "readClipboard";
+            case Stage::TransformText: return "transformText";
+            case Stage::TypeText: return "typeText";
+            case Stage::PasteText: return "pasteText";
+            case Stage::RestoreClipboard: return "restoreClipboard";
+            case Stage::FlipLayout: return "flipLayout";
+            case Stage::Correction: return "correction";
+            default: return "?";
+        }
+    }
+
+    // ─── Histogram ─────────────────────────────────────────────────────────
+
+    std::size_t Histogram::bucketOf(const std::uint64_t ns) noexcept {
+        constexpr std::uint64_t kLinear = 1u << kSubBits;
+        if (ns < kLinear) return static_cast<std::size_t>(ns);
+        const unsigned exponent = static_cast<unsigned>(std::bit_width(ns)) - 1;
+        if (exponent > kMaxExponent) return kBuckets - 1;
+        return ((exponent - kSubBits + 1) << kSubBits) + ((ns >> (exponent - kSubBits)) & (kLinear - 1));
+    }
+
+    std::uint64_t Histogram::bucketFloor(const std::size_t bucket) noexcept {
+        constexpr std::size_t kLinear = std::size_t{1} << kSubBits;
+        if (bucket < kLinear) return bucket;
+        const std::size_t group = bucket >> kSubBits, sub = bucket & (kLinear - 1);
+        return static_cast<std::uint64_t>(kLinear + sub) << (group - 1);
+    }
+
+    void Histogram::record(const std::uint64_t ns) noexcept {
+        buckets_[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        sumNs_.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t max = maxNs_.load(std::memory_order_relaxed);
+        while (ns > max && !maxNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    Histogram::Snapshot Histogram::snapshot() const noexcept {
+        Snapshot s;
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            s.buckets[b] = buckets_[b].load(std::memory_order_relaxed);
+            s.count += s.buckets[b]; // so the percentiles add up even while recording goes on
+        }
+        s.sumNs = sumNs_.load(std::memory_order_relaxed);
+        s.maxNs = maxNs_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void Histogram::reset() noexcept {
+        for (auto &bucket: buckets_) bucket.store(0, std::memory_order_relaxed);
+        sumNs_.store(0, std::memory_order_relaxed);
+        maxNs_.store(0, std::memory_order_relaxed);
+    }
+
+    double Histogram::Snapshot::percentileNs(const double q) const noexcept {
+        if (count == 0) return 0;
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * count)));
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            seen += buckets[b];
+            if (seen < rank) continue;
+            const std::uint64_t floor = bucketFloor(b);
+            const std::uint64_t width = b + 1 < kBuckets ? bucketFloor(b + 1) - floor : 1;
+            return std::min(static_cast<double>(floor) + (width - 1) / 2.0, static_cast<double>(maxNs));
+        }
+        return static_cast<double>(maxNs);
+    }
+
+    // ─── Recording ─────────────────────────────────────────────────────────
+
+    void setEnabled(const bool enabled) noexcept { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+    void setTracing(const bool tracing) noexcept { tracing_.store(tracing, std::memory_order_relaxed); }
+
+    void record(const Stage stage, const Clock::duration elapsed) noexcept {
+        if (!enabled()) return;
+        const std::uint64_t ns = toNs(elapsed);
+        histograms()[static_cast<std::size_t>(stage)].record(ns);
+        if (tracing && stage != Stage::Correction) tracing->stageUs[static_cast<std::size_t>(stage)] += toUs(ns);
+    }
+
+    const Histogram &histogram(const Stage stage) noexcept {
+        return histograms()[static_cast<std::size_t>(stage)];
+    }
+
+    void reset() noexcept {
+        for (auto &h: histograms()) h.reset();
+        ring().next.store(0, std::memory_order_relaxed);
+        for (auto &slot: ring().slots) slot.sequence.store(0, std::memory_order_relaxed);
+        settled_.store(0, std::memory_order_relaxed);
+        overBudget_.store(0, std::memory_order_relaxed);
+        settledLast_.store(0, std::memory_order_relaxed);
+        settledPeak_.store(0, std::memory_order_relaxed);
+    }
+
+    StageTimer::StageTimer(const Stage stage) noexcept : stage_(stage), on_(enabled()) {
+        if (!on_) return;
+        outer_ = innermost;
+        innermost = this;
+        start_ = Clock::now();
+    }
+
+    StageTimer::~StageTimer() {
+        if (!on_) return;
+        const Clock::duration elapsed = Clock::now() - start_;
+        innermost = outer_;
+        if (outer_) outer_->nested_ += elapsed;
+        record(stage_, elapsed - nested_);
+    }
+
+    void StageTimer::split(const Stage stage, const Clock::duration elapsed) noexcept {
+        if (!on_) return;
+        nested_ += elapsed;
+        record(stage, elapsed);
+    }
+
+    Correction::Correction() noexcept : on_(enabled()) {
+        if (!on_) return;
+        start_ = Clock::now();
+        record_.startUs = toNs(start_ - kStart) / 1000;
+        outer_ = tracing;
+        if (tracing_.load(std::memory_order_relaxed)) tracing = &record_;
+    }
+
+    Correction::~Correction() {
+        if (!on_) return;
+        const Clock::duration elapsed = Clock::now() - start_;
+        const bool traced = tracing == &record_;
+        tracing = outer_;
+        record(Stage::Correction, elapsed);
+        if (traced) {
+            record_.totalUs = toUs(toNs(elapsed));
+            ring().push(record_);
+        }
+    }
+
+    void noteSelection(const std::size_t chars, const bool pasted) noexcept {
+        if (!tracing) return;
+        tracing->chars = static_cast<std::uint32_t>(std::min<std::size_t>(chars, UINT32_MAX));
+        tracing->pasted = pasted;
+    }
+
+    void noteFootprint(const std::size_t committedBytes, const bool overBudget) noexcept {
+        settled_.fetch_add(1, std::memory_order_relaxed);
+        if (overBudget) overBudget_.fetch_add(1, std::memory_order_relaxed);
+        settledLast_.store(committedBytes, std::memory_order_relaxed);
+        std::size_t peak = settledPeak_.load(std::memory_order_relaxed);
+        while (committedBytes > peak && !settledPeak_.compare_exchange_weak(peak, committedBytes)) {
+        }
+    }
+
+    std::vector<TraceRecord> traceRecords() {
+        const TraceRing &traces = ring();
+        const std::uint64_t end = traces.next.load(std::memory_order_acquire);
+        std::vector<TraceRecord> out;
+        out.reserve(std::min<std::uint64_t>(end, kTraceCapacity));
+        for (std::uint64_t ticket = end > kTraceCapacity ? end - kTraceCapacity : 0; ticket < end; ++ticket) {
+            TraceRecord record;
+            if (traces.read(ticket, record)) out.push_back(record); // skip one being overwritten
+        }
+        return out;
+    }
+
+    // ─── Export ────────────────────────────────────────────────────────────
+
+    std::string toJson() {
+        auto us = [](const double ns) { return std::round(ns / 10) / 100; }; // µs to two places
+        nlohmann::ordered_json stages = nlohmann::ordered_json::object();
+        for (std::size_t s = 0; s < kStages; ++s) {
+            const auto h = histograms()[s].snapshot();
+            stages[stageName(static_cast<Stage>(s))] = {
+                {"count", h.count},
+                {"mean_us", us(h.meanNs())},
+                {"p50_us", us(h.percentileNs(0.50))},
+                {"p90_us", us(h.percentileNs(0.90))},
+                {"p99_us", us(h.percentileNs(0.99))},
+                {"p999_us", us(h.percentileNs(0.999))},
+                {"max_us", us(static_cast<double>(h.maxNs))},
+            };
+        }
+
+        nlohmann::ordered_json trace = nlohmann::ordered_json::array();
+        for (const TraceRecord &record: traceRecords()) {
+            nlohmann::ordered_json times = nlohmann::ordered_json::object();
+            for (std::size_t s = 0; s < kStages; ++s) {
+                if (record.stageUs[s] != 0) times[stageName(static_cast<Stage>(s))] = record.stageUs[s];
+            }
+            trace.push_back({
+                {"start_us", record.startUs},
+                {"total_us", record.totalUs},
+                {"chars", record.chars},
+                {"pasted", record.pasted},
+                {"stages_us", std::move(times)},
+            });
+        }
+        nlohmann::ordered_json json{{"stages", std::move(stages)}, {"trace", std::move(trace)}};
+        if (const ProcessMemory memory = processMemory(); memory.valid) {
+            json["memory"] = {
+                {"private_kb", memory.privateBytes >> 10},
+                {"shared_kb", memory.sharedBytes >> 10},
+                {"committed_kb", memory.committedBytes >> 10},
+                {"settled_corrections", settled_.load(std::memory_order_relaxed)},
+                {"settled_last_kb", settledLast_.load(std::memory_order_relaxed) >> 10},
+                {"settled_peak_kb", settledPeak_.load(std::memory_order_relaxed) >> 10},
+                {"over_budget", overBudget_.load(std::memory_order_relaxed)},
+            };
+        }
+        return json.dump(2);
+    }
+
+    bool dump(const std::string &path) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << toJson() << '\n';
+        return static_cast<bool>(file);
+    }
+}
@@ -0,0 +1,167 @@
+// this is metrics.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ─── Stage Latency ─────────────────────────────────────────────────────
+
+/// Where a correction spends its time: every pipeline stage is timed with
+/// a monotonic clock into a fixed-size histogram that any thread may add
+/// to without locking. Cheap enough to stay on against a real target's
+/// latency: a stage costs two clock reads and a few relaxed atomic adds,
+/// though that is a sizeable share of a correction whose target answers at
+/// once. The percentiles can be written to a JSON file at any time, and
+/// each correction can optionally leave a trace record (its stage times) in
+/// a ring of the most recent ones.
+namespace metrics {
+
+    using Clock = std::chrono::steady_clock;
+
+    enum class Stage {
+        FlushModifiers,
+        SendCtrlC,              // including the selection chord for Line/All
+        WaitForClipboardChange,
+        ReadClipboard,
+        TransformText,
+        TypeText,
+        PasteText,
+        RestoreClipboard,
+        FlipLayout,
+        Correction,             // one whole action, end to end
+        Count
+    };
+
+    constexpr std::size_t kStages = static_cast<std::size_t>(Stage::Count);
+
+    /// The stage's name in dumps, after the function that does it.
+    const char *stageName(Stage stage) noexcept;
+
+    /// Latencies in nanoseconds, in log-linear buckets: exact below 16 ns,
+    /// then 16 buckets per power of two (within 6.25%). Values past about
+    /// 18 minutes land in the last bucket.
+    class Histogram {
+    public:
+        static constexpr unsigned kSubBits = 4;
+        static constexpr unsigned kMaxExponent = 40;
+        static constexpr std::size_t kBuckets = (kMaxExponent - kSubBits + 2) << kSubBits;
+
+        void record(std::uint64_t ns) noexcept;
+
+        /// Counts, taken bucket by bucket while recording may go on.
+        struct Snapshot {
+            std::array<std::uint64_t, kBuckets> buckets{};
+            std::uint64_t count = 0;
+            std::uint64_t sumNs = 0;
+            std::uint64_t maxNs = 0;
+
+            /// The value at quantile q (0–1), as the middle of its bucket; 0 when empty.
+            double percentileNs(double q) const noexcept;
+            double meanNs() const noexcept { return count ? static_cast<double>(sumNs) / count : 0; }
+        };
+
+        Snapshot snapshot() const noexcept;
+        void reset() noexcept;
+
+        static std::size_t bucketOf(std::uint64_t ns) noexcept;
+        /// Smallest value in the bucket.
+        static std::uint64_t bucketFloor(std::size_t bucket) noexcept;
+
+    private:
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+        std::atomic<std::uint64_t> sumNs_{0}, maxNs_{0}; // the count is the buckets' sum
+    };
+
+    /// Turn recording on or off (on by default). Off, a timer is one relaxed load.
+    void setEnabled(bool enabled) noexcept;
+    bool enabled() noexcept;
+
+    /// Keep a trace record per correction (off by default).
+    void setTracing(bool tracing) noexcept;
+
+    /// Add one sample by hand, for stages that can't be a StageTimer.
+    void record(Stage stage, Clock::duration elapsed) noexcept;
+
+    /// The histogram behind a stage.
+    const Histogram &histogram(Stage stage) noexcept;
+
+    /// Clear every histogram and the trace ring.
+    void reset() noexcept;
+
+    /// Times its scope into a stage. Nested timers on the same thread are
+    /// taken out of the enclosing one, so each stage gets its own time only.
+    /// Work between timers belongs to no stage, only to the correction.
+    class StageTimer {
+    public:
+        explicit StageTimer(Stage stage) noexcept;
+        ~StageTimer();
+        StageTimer(const StageTimer &) = delete;
+        StageTimer &operator=(const StageTimer &) = delete;
+
+        /// Record elapsed, spent within this scope but timed by the caller
+        /// (say, in pieces), as another stage, and take it out of this one.
+        void split(Stage stage, Clock::duration elapsed) noexcept;
+
+    private:
+        Stage stage_;
+        bool on_;
+        Clock::time_point start_;
+        Clock::duration nested_{};
+        StageTimer *outer_ = nullptr;
+    };
+
+    // ─── Per-Correction Trace ──────────────────────────────────────────────
+
+    /// What one correction spent in each stage.
+    struct TraceRecord {
+        std::uint64_t startUs = 0; // since the program started
+        std::uint32_t totalUs = 0;
+        std::uint32_t chars = 0;   // length of the selection
+        bool pasted = false;
+        std::array<std::uint32_t, kStages> stageUs{};
+    };
+
+    /// Oldest first; at most kTraceCapacity of the latest.
+    std::vector<TraceRecord> traceRecords();
+
+    constexpr std::size_t kTraceCapacity = 256;
+
+    /// Spans one hotkey action on this thread: its total goes into
+    /// Stage::Correction and, when tracing, the stages timed meanwhile go
+    /// into a trace record.
+    class Correction {
+    public:
+        Correction() noexcept;
+        ~Correction();
+        Correction(const Correction &) = delete;
+        Correction &operator=(const Correction &) = delete;
+
+    private:
+        bool on_;
+        Clock::time_point start_;
+        TraceRecord record_;
+        TraceRecord *outer_ = nullptr;
+    };
+
+    /// Describe the correction running on this thread (no-op outside one).
+    void noteSelection(std::size_t chars, bool pasted) noexcept;
+
+    /// A correction settled under LOW_FOOTPRINT with this much private
+    /// memory committed; overBudget if that is past MEMORY_BUDGET_KB. The
+    /// dump shows the last and the largest, and how many went over.
+    void noteFootprint(std::size_t committedBytes, bool overBudget) noexcept;
+
+    // ─── Export ────────────────────────────────────────────────────────────
+
+    /// The percentiles of every stage, the trace records and the process's
+    /// memory (process_memory.h), as JSON.
+    std::string toJson();
+
+    /// Write toJson() to path; false if it can't be written.
+    bool dump(const std::string &path);
+}
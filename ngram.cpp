@@ -0,0 +1,335 @@
+// this is ngram.cpp
+
+#include "ngram.h"
+
+#include <algorithm>
+#include <cstring>
+
+// ─── Character Trigram Models ──────────────────────────────────────────
+
+NgramModel NgramModel::view(const void *data, const std::size_t size) {
+    NgramModel model;
+    if (!data || size < sizeof(NgramHeader)) return model;
+
+    NgramHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "LFNG", 4) != 0 || header.version != VERSION || header.order != 3) return model;
+    if (header.tableBits == 0 || header.tableBits > 24) return model;
+    if (size != sizeof(NgramHeader) + (std::size_t{1} << header.tableBits)) return model;
+
+    model.costs_ = static_cast<const std::uint8_t *>(data) + sizeof(NgramHeader);
+    model.shift_ = 32u - header.tableBits;
+    return model;
+}
+
+NgramModelFile NgramModelFile::open(const std::string &path) {
+    NgramModelFile file;
+    file.file_ = MappedFile::open(path);
+    file.model_ = NgramModel::view(file.file_.data(), file.file_.size());
+    return file;
+}
+
+// ─── Direction Scoring ─────────────────────────────────────────────────
+
+namespace {
+    // How much better (in cost units per trigram) another reading must
+    // score before it overrides the preferred one; keeps short or
+    // ambiguous runs going the way the active layout says.
+    constexpr std::uint32_t kMargin = 4;
+
+    bool isBreak(const wchar_t ch) noexcept {
+        return ch == L' ' || ch == L'\t' || ch == L'\n' || ch == L'\r';
+    }
+
+    /// The candidates of one convert() call. Reading 0 is the text as typed,
+    /// judged by every model; reading k converts through table[k] (or
+    /// pair[k] with multi-unit keys) and is judged by judge[k].
+    struct Candidates {
+        std::size_t readings = 1;
+        std::size_t layouts = 0;
+        std::size_t keep = 0; // the preferred reading
+        const KeymapTable *table[DirectionScorer::MAX_READINGS] = {};
+        const KeymapTransducer *pair[DirectionScorer::MAX_READINGS] = {};
+        NgramModel judge[DirectionScorer::MAX_READINGS];
+        NgramModel model[LayoutMatrix::MAX_LAYOUTS];
+    };
+
+    /// Writes each run in place: same length, through the tables.
+    struct InPlace {
+        const wchar_t *src;
+        wchar_t *dst;
+
+        void keep(const std::size_t begin, const std::size_t end) const {
+            std::copy(src + begin, src + end, dst + begin);
+        }
+        void convert(const Candidates &c, const std::size_t k, const std::size_t begin, const std::size_t end) const {
+            c.table[k]->apply(src + begin, end - begin, dst + begin);
+        }
+    };
+
+    /// Appends each run to a string, through the transducers.
+    struct Appending {
+        std::wstring_view src;
+        std::wstring &out;
+
+        void keep(const std::size_t begin, const std::size_t end) const {
+            out.append(src.substr(begin, end - begin));
+        }
+        void convert(const Candidates &c, const std::size_t k, const std::size_t begin, const std::size_t end) const {
+            c.pair[k]->apply(src.substr(begin, end - begin), out);
+        }
+    };
+
+    /// Score and convert every run. Readings/Layouts are the counts when
+    /// known at compile time (so the per-character loops unroll), 0 if not.
+    /// Runs are scored through the single-unit tables either way.
+    template<std::size_t Readings, std::size_t Layouts, typename Sink>
+    void scoreRuns(const Candidates &c, const wchar_t *src, const std::size_t n, const Sink &sink,
+                   std::size_t *chars) {
+        const std::size_t readings = Readings ? Readings : c.readings;
+        const std::size_t layouts = Layouts ? Layouts : c.layouts;
+
+        // Per reading: the last two symbols and the running cost of the
+        // current run; as typed keeps one cost per model.
+        std::uint32_t prev1[DirectionScorer::MAX_READINGS], prev2[DirectionScorer::MAX_READINGS];
+        std::uint32_t cost[DirectionScorer::MAX_READINGS];
+        std::uint32_t typedCost[LayoutMatrix::MAX_LAYOUTS];
+        std::uint32_t trigrams = 0;
+        auto startRun = [&] {
+            for (std::size_t k = 0; k < readings; ++k) {
+                prev1[k] = prev2[k] = NgramModel::BOUNDARY;
+                cost[k] = 0;
+            }
+            for (std::size_t m = 0; m < layouts; ++m) typedCost[m] = 0;
+            trigrams = 0;
+        };
+        auto addTyped = [&](const std::uint32_t sym) {
+            const std::uint32_t h = NgramModel::hash(prev2[0], prev1[0], sym);
+            for (std::size_t m = 0; m < layouts; ++m) typedCost[m] += c.model[m].costAt(h);
+            prev2[0] = prev1[0];
+            prev1[0] = sym;
+        };
+        auto addConverted = [&](const std::size_t k, const std::uint32_t sym) {
+            cost[k] += c.judge[k].cost(prev2[k], prev1[k], sym);
+            prev2[k] = prev1[k];
+            prev1[k] = sym;
+        };
+
+        auto finishRun = [&](const std::size_t begin, const std::size_t end) {
+            if (begin == end) return;
+            addTyped(NgramModel::BOUNDARY);
+            for (std::size_t k = 1; k < readings; ++k) addConverted(k, NgramModel::BOUNDARY);
+            ++trigrams;
+
+            cost[0] = *std::min_element(typedCost, typedCost + layouts);
+            std::size_t rival = DirectionScorer::MAX_READINGS;
+            for (std::size_t k = 0; k < readings; ++k) {
+                if (k != c.keep && (rival == DirectionScorer::MAX_READINGS || cost[k] < cost[rival])) rival = k;
+            }
+            const std::size_t pick = rival != DirectionScorer::MAX_READINGS &&
+                                     cost[rival] + kMargin * trigrams < cost[c.keep] ? rival : c.keep;
+
+            if (pick == 0) {
+                sink.keep(begin, end);
+            } else {
+                sink.convert(c, pick, begin, end);
+            }
+            chars[pick] += end - begin;
+        };
+
+        startRun();
+        std::size_t runStart = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const wchar_t ch = src[i];
+            if (isBreak(ch)) {
+                finishRun(runStart, i);
+                sink.keep(i, i + 1);
+                runStart = i + 1;
+                startRun();
+                continue;
+            }
+            addTyped(NgramModel::symbol(ch));
+            for (std::size_t k = 1; k < readings; ++k) addConverted(k, NgramModel::symbol(c.table[k]->map(ch)));
+            ++trigrams;
+        }
+        finishRun(runStart, n);
+    }
+
+    /// Fill c with the readings to weigh for preferred; the counts name them.
+    DirectionScorer::Counts candidates(const std::span<const NgramModel *const> models, const LayoutMatrix &tables,
+                                       Candidates &c, const Direction preferred) noexcept {
+        c.layouts = models.size();
+        for (std::size_t m = 0; m < c.layouts; ++m) c.model[m] = *models[m];
+
+        const LayoutId active = preferred.from < c.layouts ? preferred.from : NO_LAYOUT;
+        DirectionScorer::Counts counts;
+        counts.direction[0] = {active, active};
+        for (LayoutId from = 0; from < c.layouts; ++from) {
+            for (LayoutId to = 0; to < c.layouts; ++to) {
+                if (from == to || (active != NO_LAYOUT && from != active && to != active)) continue;
+                const std::size_t k = c.readings++;
+                counts.direction[k] = {from, to};
+                c.pair[k] = &tables.transducer({from, to});
+                c.table[k] = &c.pair[k]->table();
+                c.judge[k] = c.model[to];
+                if (counts.direction[k] == preferred) c.keep = k;
+            }
+        }
+        counts.readings = c.readings;
+        return counts;
+    }
+
+    template<typename Sink>
+    void run(const Candidates &c, const wchar_t *src, const std::size_t n, const Sink &sink, std::size_t *chars) {
+        // Two or three layouts with the active one known are the usual cases.
+        if (c.layouts == 2 && c.readings == 3) scoreRuns<3, 2>(c, src, n, sink, chars);
+        else if (c.layouts == 3 && c.readings == 5) scoreRuns<5, 3>(c, src, n, sink, chars);
+        else scoreRuns<0, 0>(c, src, n, sink, chars);
+    }
+}
+
+Direction DirectionScorer::Counts::dominant() const noexcept {
+    std::size_t best = 0;
+    for (std::size_t k = 1; k < readings; ++k) {
+        if (chars[k] > 0 && (best == 0 || chars[k] > chars[best])) best = k;
+    }
+    return direction[best];
+}
+
+DirectionScorer::DirectionScorer(const std::span<const NgramModel *const> models, const LayoutMatrix &tables)
+    : models_(models.first(std::min(models.size(), tables.layouts()))), tables_(tables) {
+}
+
+DirectionScorer::Counts DirectionScorer::convert(const wchar_t *src, const std::size_t n, wchar_t *dst,
+                                                 const Direction preferred) const noexcept {
+    Candidates c;
+    Counts counts = candidates(models_, tables_, c, preferred);
+    run(c, src, n, InPlace{src, dst}, counts.chars);
+    return counts;
+}
+
+DirectionScorer::Counts DirectionScorer::convert(const std::wstring_view src, std::wstring &out,
+                                                 const Direction preferred) const {
+    Candidates c;
+    Counts counts = candidates(models_, tables_, c, preferred);
+    out.reserve(out.size() + src.size());
+    run(c, src.data(), src.size(), Appending{src, out}, counts.chars);
+    return counts;
+}
+
+// ─── Word-at-a-Time Scoring ────────────────────────────────────────────
+
+namespace {
+    // A typed word is converted only when a conversion beats it by this
+    // much per trigram, twice a selection's margin: a wrong conversion
+    // lands in the middle of the user's typing, not in text they picked.
+    constexpr std::uint32_t kWordMargin = 2 * kMargin;
+}
+
+struct WordScorer::State {
+    State(const std::span<const NgramModel *const> models, const LayoutMatrix &tables)
+        : models(models.first(std::min(models.size(), tables.layouts()))), tables(tables) {
+    }
+
+    /// What reading k sees for the character at i.
+    std::uint32_t symbol(const std::size_t k, const std::size_t i) const noexcept {
+        return NgramModel::symbol(k ? table[k]->map(word[i]) : word[i]);
+    }
+
+    /// Same for the character back places before i, BOUNDARY before the word.
+    std::uint32_t before(const std::size_t k, const std::size_t i, const std::size_t back) const noexcept {
+        return i >= back ? symbol(k, i - back) : NgramModel::BOUNDARY;
+    }
+
+    std::span<const NgramModel *const> models;
+    const LayoutMatrix &tables;
+    LayoutId active = NO_LAYOUT;
+    std::size_t readings = 1; // 0 is as typed, k ≥ 1 converts into to[k]
+    LayoutId to[LayoutMatrix::MAX_LAYOUTS] = {};
+    const KeymapTable *table[LayoutMatrix::MAX_LAYOUTS] = {};
+    std::size_t length = 0;
+    wchar_t word[MAX_WORD] = {};
+
+    // After i characters: cost[i][k] of reading k ≥ 1, and typed[i][m] of
+    // the word as typed under the model of layout m.
+    std::uint32_t cost[MAX_WORD + 1][LayoutMatrix::MAX_LAYOUTS] = {};
+    std::uint32_t typed[MAX_WORD + 1][LayoutMatrix::MAX_LAYOUTS] = {};
+};
+
+WordScorer::WordScorer(const std::span<const NgramModel *const> models, const LayoutMatrix &tables)
+    : state_(std::make_unique<State>(models, tables)) {
+}
+
+WordScorer::~WordScorer() = default;
+
+void WordScorer::start(const LayoutId active) noexcept {
+    State &s = *state_;
+    s.active = active < s.models.size() ? active : NO_LAYOUT;
+    s.readings = 1;
+    if (s.active != NO_LAYOUT) {
+        for (LayoutId to = 0; to < s.models.size(); ++to) {
+            if (to == s.active) continue;
+            s.to[s.readings] = to;
+            s.table[s.readings] = &s.tables.table({s.active, to});
+            ++s.readings;
+        }
+    }
+    s.length = 0;
+}
+
+LayoutId WordScorer::active() const noexcept {
+    return state_->active;
+}
+
+void WordScorer::push(const wchar_t ch) noexcept {
+    State &s = *state_;
+    const std::size_t i = s.length++;
+    if (i >= MAX_WORD) return;
+    s.word[i] = ch;
+
+    const std::uint32_t h = NgramModel::hash(s.before(0, i, 2), s.before(0, i, 1), s.symbol(0, i));
+    for (std::size_t m = 0; m < s.models.size(); ++m) s.typed[i + 1][m] = s.typed[i][m] + s.models[m]->costAt(h);
+    for (std::size_t k = 1; k < s.readings; ++k) {
+        s.cost[i + 1][k] = s.cost[i][k] + s.models[s.to[k]]->cost(s.before(k, i, 2), s.before(k, i, 1), s.symbol(k, i));
+    }
+}
+
+bool WordScorer::pop() noexcept {
+    if (state_->length == 0) return false;
+    --state_->length;
+    return true;
+}
+
+std::size_t WordScorer::length() const noexcept {
+    return state_->length;
+}
+
+std::wstring_view WordScorer::word() const noexcept {
+    const State &s = *state_;
+    return s.length <= MAX_WORD ? std::wstring_view(s.word, s.length) : std::wstring_view();
+}
+
+Direction WordScorer::verdict() const noexcept {
+    const State &s = *state_;
+    const Direction asTyped{s.active, s.active};
+    const std::size_t n = s.length;
+    if (s.readings == 1 || n == 0 || n > MAX_WORD) return asTyped;
+
+    // Close the word with a boundary, as finishing a run does.
+    const std::uint32_t h = NgramModel::hash(s.before(0, n, 2), s.before(0, n, 1), NgramModel::BOUNDARY);
+    std::uint32_t best = UINT32_MAX;
+    for (std::size_t m = 0; m < s.models.size(); ++m) best = std::min(best, s.typed[n][m] + s.models[m]->costAt(h));
+
+    std::size_t rival = 0;
+    std::uint32_t rivalCost = UINT32_MAX;
+    for (std::size_t k = 1; k < s.readings; ++k) {
+        const std::uint32_t cost = s.cost[n][k] + s.models[s.to[k]]->cost(s.before(k, n, 2), s.before(k, n, 1),
+                                                                         NgramModel::BOUNDARY);
+        if (cost < rivalCost) {
+            rival = k;
+            rivalCost = cost;
+        }
+    }
+    const auto trigrams = static_cast<std::uint32_t>(n + 1);
+    return rivalCost + kWordMargin * trigrams < best ? Direction{s.active, s.to[rival]} : asTyped;
+}
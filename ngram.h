@@ -0,0 +1,175 @@
+// this is ngram.h
+#pragma once
+
+#include "keymap.h"
+#include "layout_matrix.h"
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+// ─── Character Trigram Models ──────────────────────────────────────────
+
+/// Header of a .lfng model file. The file is this header followed by
+/// 1 << tableBits cost bytes and is used in place from a memory mapping.
+struct NgramHeader {
+    char magic[4];           // "LFNG"
+    std::uint16_t version;   // NgramModel::VERSION
+    std::uint8_t order;      // 3: costs are for P(c | two previous chars)
+    std::uint8_t tableBits;  // log2 of the number of hashed cost buckets
+    std::uint8_t unseenCost; // cost of a trigram the training text never had
+    std::uint8_t reserved[7];
+};
+static_assert(sizeof(NgramHeader) == 16);
+
+/// A read-only view of a trigram model: hashed buckets of
+/// -log2 P(c | a b), quantised to COST_UNIT bits. Lower is more plausible.
+class NgramModel {
+public:
+    static constexpr std::uint16_t VERSION = 1;
+    static constexpr double COST_UNIT = 1.0 / 8;
+    static constexpr std::uint32_t BOUNDARY = L' '; // pads both ends of a run
+
+    /// Invalid model (valid() == false).
+    NgramModel() = default;
+
+    /// View a model image; invalid unless the header and size check out.
+    static NgramModel view(const void *data, std::size_t size);
+
+    bool valid() const noexcept { return costs_ != nullptr; }
+
+    /// Cost of c following a b.
+    std::uint8_t cost(const std::uint32_t a, const std::uint32_t b, const std::uint32_t c) const noexcept {
+        return costAt(hash(a, b, c));
+    }
+
+    /// The same, for a trigram already hashed (one hash serves every model).
+    std::uint8_t costAt(const std::uint32_t trigramHash) const noexcept {
+        return costs_[trigramHash >> shift_];
+    }
+
+    /// What the model sees for a character: A–Z lowercased, whitespace as BOUNDARY.
+    static std::uint32_t symbol(wchar_t ch) noexcept {
+        if (ch >= L'A' && ch <= L'Z') return static_cast<std::uint32_t>(ch + 32);
+        if (ch == L'\t' || ch == L'\n' || ch == L'\r') return BOUNDARY;
+        return static_cast<std::uint32_t>(static_cast<KeymapTable::Unit>(ch));
+    }
+
+    /// 32-bit hash of a trigram; the top tableBits bits pick the bucket.
+    static std::uint32_t hash(const std::uint32_t a, const std::uint32_t b, const std::uint32_t c) noexcept {
+        std::uint32_t h = a * 0x9E3779B1u;
+        h = (h ^ (h >> 15) ^ b) * 0x85EBCA77u;
+        h = (h ^ (h >> 13) ^ c) * 0xC2B2AE3Du;
+        return h ^ (h >> 16);
+    }
+
+private:
+    const std::uint8_t *costs_ = nullptr;
+    unsigned shift_ = 32;
+};
+
+/// A model file kept mapped for as long as the model is in use.
+class NgramModelFile {
+public:
+    /// Map and validate path; model() is invalid if either fails.
+    static NgramModelFile open(const std::string &path);
+
+    const NgramModel &model() const noexcept { return model_; }
+
+private:
+    MappedFile file_;
+    NgramModel model_;
+};
+
+// ─── Direction Scoring ─────────────────────────────────────────────────
+
+/// Picks, for each whitespace-separated run of a selection, whether it
+/// reads best as typed or converted between two layouts, scoring every
+/// candidate in one pass over the text. A conversion is judged by the model
+/// of the language it converts to; text as typed by whichever model likes
+/// it best.
+///
+/// The candidates are the ones involving the active layout (preferred.from):
+/// out of it into each other layout, and into it out of each (text typed
+/// before the layout was switched). If the active layout isn't known, every
+/// pair is a candidate.
+class DirectionScorer {
+public:
+    static constexpr std::size_t MAX_READINGS = 1 + LayoutMatrix::MAX_LAYOUTS * (LayoutMatrix::MAX_LAYOUTS - 1);
+
+    /// Characters written per candidate by convert(); direction[0] is as typed.
+    struct Counts {
+        Direction direction[MAX_READINGS];
+        std::size_t chars[MAX_READINGS] = {};
+        std::size_t readings = 0;
+
+        /// The conversion most characters took (direction[0] if nothing was converted).
+        Direction dominant() const noexcept;
+    };
+
+    /// models[i] is the model of layout i in tables; both must outlive the scorer.
+    DirectionScorer(std::span<const NgramModel *const> models, const LayoutMatrix &tables);
+
+    /// Write the most plausible reading of each run of src to dst (same
+    /// length). preferred wins unless another reading is clearly better.
+    /// Ignores multi-unit keys; see the overload below.
+    Counts convert(const wchar_t *src, std::size_t n, wchar_t *dst, Direction preferred) const noexcept;
+
+    /// Same, appending to out and converting runs through the pairs'
+    /// transducers, so keys that type more than one unit convert too.
+    Counts convert(std::wstring_view src, std::wstring &out, Direction preferred) const;
+
+private:
+    std::span<const NgramModel *const> models_;
+    const LayoutMatrix &tables_;
+};
+
+// ─── Word-at-a-Time Scoring ────────────────────────────────────────────
+
+/// DirectionScorer's scoring for text that arrives one key at a time. Each
+/// push() adds one trigram to the running cost of every reading, pop() (a
+/// Backspace) goes back to the costs before the last one, and verdict()
+/// closes the word; all in constant time and without allocating. Typed
+/// keys come out of the active layout, so the readings are the text as
+/// typed and its conversion into each other layout, and as typed is
+/// preferred: a conversion has to win by a wider margin than in a selection.
+class WordScorer {
+public:
+    /// Longest word scored; a longer one reads as typed.
+    static constexpr std::size_t MAX_WORD = 48;
+
+    /// models[i] is the model of layout i in tables; both must outlive the scorer.
+    WordScorer(std::span<const NgramModel *const> models, const LayoutMatrix &tables);
+    ~WordScorer();
+    WordScorer(const WordScorer &) = delete;
+    WordScorer &operator=(const WordScorer &) = delete;
+
+    /// Start an empty word typed in active (NO_LAYOUT: it reads as typed).
+    void start(LayoutId active) noexcept;
+
+    LayoutId active() const noexcept;
+
+    /// Add the word's next character.
+    void push(wchar_t ch) noexcept;
+
+    /// Take back the last character; false if the word was empty.
+    bool pop() noexcept;
+
+    /// Characters typed into the word, including any past MAX_WORD.
+    std::size_t length() const noexcept;
+
+    /// The word as typed (empty once it is longer than MAX_WORD).
+    std::wstring_view word() const noexcept;
+
+    /// How the word reads best, as if it ended here: a conversion out of
+    /// the active layout, or {active, active} for as typed.
+    Direction verdict() const noexcept;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
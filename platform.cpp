@@ -0,0 +1,60 @@
+// this is platform.cpp
+
+#include "platform.h"
+
+#include <atomic>
+#include <thread>
+
+namespace platform {
+    static Backend installed;
+
+    Backend &current() {
+        return installed;
+    }
+
+    void install(const Backend &backend) {
+        installed = backend;
+    }
+
+    // ─── Polling Waiter ────────────────────────────────────────────────────
+
+    namespace {
+        class PollingWaiter final : public ClipboardWaiter {
+        public:
+            PollingWaiter(Clipboard &clipboard, const std::chrono::milliseconds interval)
+                : clipboard_(clipboard), interval_(interval) {
+            }
+
+            DWORD waitForChange(const DWORD previous, const std::chrono::milliseconds timeout) override {
+                using Clock = std::chrono::steady_clock;
+                const auto deadline = Clock::now() + timeout;
+
+                // Loop until either the clipboard sequence changes, or we hit our deadline.
+                while (Clock::now() < deadline) {
+                    DWORD current = clipboard_.sequenceNumber();
+                    if (current != previous) {
+                        return current; // we got new data
+                    }
+                    std::this_thread::sleep_for(interval_);
+                    wakeups_.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                // Timeout: no change detected
+                return previous;
+            }
+
+            std::uint64_t wakeups() const override {
+                return wakeups_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            Clipboard &clipboard_;
+            std::chrono::milliseconds interval_;
+            std::atomic<std::uint64_t> wakeups_{0};
+        };
+    }
+
+    std::unique_ptr<ClipboardWaiter> makePollingWaiter(Clipboard &clipboard, const std::chrono::milliseconds interval) {
+        return std::make_unique<PollingWaiter>(clipboard, interval);
+    }
+}
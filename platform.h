@@ -0,0 +1,165 @@
+// this is platform.h
+#pragma once
+
+#include "function_ref.h"
+#include "win32_compat.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Everything the correction pipeline needs from the OS, behind interfaces so
+// the same orchestration runs against Win32 or an in-memory simulation.
+
+namespace platform {
+
+    /// Blocks until the clipboard sequence number moves past a known value.
+    class ClipboardWaiter {
+    public:
+        virtual ~ClipboardWaiter() = default;
+
+        /// The new sequence number, or previous if the timeout ran out first.
+        virtual DWORD waitForChange(DWORD previous, std::chrono::milliseconds timeout) = 0;
+
+        /// How many times the waiting thread has woken up so far.
+        virtual std::uint64_t wakeups() const = 0;
+    };
+
+    /// Everything that was on the clipboard at one point, kept so it can be
+    /// put back. Small formats are held in memory; larger ones are written
+    /// out and only read back if someone pastes them after the restore.
+    class ClipboardSnapshot {
+    public:
+        virtual ~ClipboardSnapshot() = default;
+
+        /// Number of formats saved.
+        virtual std::size_t formatCount() const = 0;
+
+        /// Bytes held in memory.
+        virtual std::size_t residentBytes() const = 0;
+
+        /// Bytes written to the spill file instead.
+        virtual std::size_t spilledBytes() const = 0;
+    };
+
+    /// The system clipboard.
+    class Clipboard {
+    public:
+        virtual ~Clipboard() = default;
+
+        /// Changes every time the clipboard contents change.
+        virtual DWORD sequenceNumber() = 0;
+
+        /// Unicode text on the clipboard (or empty on failure).
+        virtual std::wstring readText() = 0;
+
+        /// Replace the clipboard contents with Unicode text.
+        virtual bool writeText(const std::wstring &text) = 0;
+
+        /// Call view with the clipboard's Unicode text while the clipboard is
+        /// open and its memory locked; nothing is copied. False if there is no text.
+        virtual bool viewText(FunctionRef<void(std::wstring_view)> view) = 0;
+
+        /// Replace the clipboard with map(text): map gets the locked text and
+        /// n units of the new clipboard block to fill. False if there is no text.
+        using TextMapper = FunctionRef<void(const wchar_t *src, std::size_t n, wchar_t *dst)>;
+        virtual bool rewriteText(TextMapper map) = 0;
+
+        /// Save every format on the clipboard that can be copied: not the
+        /// handles only their owner understands. Formats over residentLimit
+        /// bytes go to a spill file rather than memory. Reuses a snapshot
+        /// handed back by release() or dropped after a restore, if there is one.
+        virtual std::unique_ptr<ClipboardSnapshot> snapshot(std::size_t residentLimit) = 0;
+
+        /// Put a snapshot back. Spilled formats are offered with delayed
+        /// rendering and only read back when an app asks for them.
+        virtual bool restore(std::unique_ptr<ClipboardSnapshot> snapshot) = 0;
+
+        /// Give back a snapshot that won't be restored, for the next
+        /// snapshot() to save into instead of allocating a new one.
+        virtual void release(std::unique_ptr<ClipboardSnapshot> snapshot) { snapshot.reset(); }
+
+        /// Free the snapshot kept for reuse, so nothing of the last save
+        /// outlives the correction (LOW_FOOTPRINT).
+        virtual void dropSpare() {}
+
+        /// A waiter woken by change notifications, or nullptr if this
+        /// backend can't provide one (callers then fall back to polling).
+        virtual std::unique_ptr<ClipboardWaiter> createChangeWaiter() { return nullptr; }
+    };
+
+    /// What to select before copying.
+    enum class Selection { Current, Line, All };
+
+    /// Synthetic keyboard input into the foreground window.
+    class Input {
+    public:
+        virtual ~Input() = default;
+
+        /// Release Ctrl/Alt/Shift as given by MOD_* flags.
+        virtual void releaseModifiers(UINT modifiers) = 0;
+
+        /// Ctrl+C.
+        virtual void sendCopy() = 0;
+
+        /// Shift+Home.
+        virtual void selectLine() = 0;
+
+        /// Ctrl+A.
+        virtual void selectAll() = 0;
+
+        /// The selection chord (Shift+Home / Ctrl+A, none for Current)
+        /// followed by Ctrl+C, injected as one ordered batch.
+        virtual void selectAndCopy(Selection selection) = 0;
+
+        /// Type a string as Unicode key events, replacing the selection.
+        virtual void typeText(std::wstring_view text) = 0;
+
+        /// Backspace erase times, then type text, in one batch without
+        /// waiting on the target: a word retyped from a keyboard hook.
+        virtual void retype(std::size_t erase, std::wstring_view text) = 0;
+
+        /// Whether key events we injected are still waiting to be handled
+        /// by the foreground thread. Backends that can't tell return false.
+        virtual bool inputPending() = 0;
+
+        /// Ctrl+V.
+        virtual void sendPaste() = 0;
+    };
+
+    /// The foreground window's keyboard layout.
+    class Layout {
+    public:
+        virtual ~Layout() = default;
+
+        /// LANGID of the foreground thread's layout.
+        virtual LANGID activeLang() = 0;
+
+        /// Ask every window to switch to the given KLID ("0000040D").
+        virtual bool switchTo(std::string_view klid) = 0;
+    };
+
+    /// One implementation of each interface; not owned.
+    struct Backend {
+        Clipboard *clipboard = nullptr;
+        Input *input = nullptr;
+        Layout *layout = nullptr;
+    };
+
+    /// The backend the pipeline talks to.
+    Backend &current();
+
+    /// Install a backend (must happen before the first correction).
+    void install(const Backend &backend);
+
+    /// Waiter that samples sequenceNumber() every interval; works everywhere.
+    std::unique_ptr<ClipboardWaiter> makePollingWaiter(Clipboard &clipboard, std::chrono::milliseconds interval);
+
+#ifdef _WIN32
+    /// The real desktop.
+    Backend win32();
+#endif
+}
@@ -0,0 +1,555 @@
+// this is platform_sim.cpp
+
+#include "platform_sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+// ─── Clipboard Snapshots ───────────────────────────────────────────────
+
+/// Formats up to the resident limit in memory, the rest in a temp file.
+class SimDesktop::Snapshot final : public platform::ClipboardSnapshot {
+public:
+    struct Saved {
+        UINT format = 0;
+        std::string bytes;  // when resident
+        long offset = 0;    // when spilled
+        std::size_t size = 0;
+        bool spilled = false;
+    };
+
+    ~Snapshot() override {
+        if (spill_) std::fclose(spill_);
+    }
+
+    /// Forget what was saved but keep the buffers, to save into again.
+    void clear() {
+        used_ = 0;
+        spillEnd_ = 0;
+    }
+
+    void add(const UINT format, const void *data, const std::size_t size, const std::size_t residentLimit) {
+        if (used_ == saved_.size()) saved_.emplace_back();
+        Saved &saved = saved_[used_++];
+        saved.format = format;
+        saved.size = size;
+        saved.spilled = size > residentLimit;
+        saved.bytes.clear();
+        if (saved.spilled && (spill_ || (spill_ = std::tmpfile()))) {
+            std::fseek(spill_, spillEnd_, SEEK_SET);
+            saved.offset = spillEnd_;
+            std::fwrite(data, 1, size, spill_);
+            spillEnd_ += static_cast<long>(size);
+        } else {
+            saved.spilled = false;
+            saved.bytes.assign(static_cast<const char *>(data), size);
+        }
+    }
+
+    std::string read(const Saved &saved) const {
+        if (!saved.spilled) return saved.bytes;
+        std::string bytes(saved.size, '\0');
+        std::fseek(spill_, saved.offset, SEEK_SET);
+        if (std::fread(bytes.data(), 1, saved.size, spill_) != saved.size) bytes.clear();
+        return bytes;
+    }
+
+    std::span<const Saved> saved() const { return {saved_.data(), used_}; }
+
+    std::size_t formatCount() const override { return used_; }
+
+    std::size_t residentBytes() const override {
+        std::size_t total = 0;
+        for (auto const &saved: saved()) total += saved.bytes.size();
+        return total;
+    }
+
+    std::size_t spilledBytes() const override {
+        std::size_t total = 0;
+        for (auto const &saved: saved()) total += saved.spilled ? saved.size : 0;
+        return total;
+    }
+
+private:
+    std::vector<Saved> saved_; // the first used_ are in use; the rest wait to be reused
+    std::size_t used_ = 0;
+    std::FILE *spill_ = nullptr;
+    long spillEnd_ = 0;
+};
+
+// ─── Desktop State ─────────────────────────────────────────────────────
+
+SimDesktop::SimDesktop() = default;
+
+SimDesktop::~SimDesktop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    copyRequested_.notify_all();
+    if (app_.joinable()) app_.join();
+}
+
+platform::Backend SimDesktop::backend() {
+    return {&clipboardImpl_, &inputImpl_, &layoutImpl_};
+}
+
+void SimDesktop::setText(std::wstring text, const std::size_t selStart, const std::size_t selEnd) {
+    std::lock_guard lock(mutex_);
+    text_ = std::move(text);
+    selEnd_ = std::min(selEnd, text_.size());
+    selStart_ = std::min(selStart, selEnd_);
+}
+
+std::wstring SimDesktop::text() const {
+    std::lock_guard lock(mutex_);
+    return text_;
+}
+
+std::wstring SimDesktop::clipboardText() {
+    std::lock_guard lock(mutex_);
+    renderLocked(CF_UNICODETEXT);
+    return clipboard_;
+}
+
+void SimDesktop::setClipboardText(std::wstring text) {
+    std::lock_guard lock(mutex_);
+    emptyClipboardLocked();
+    clipboard_ = std::move(text);
+    clipboardChangedLocked();
+}
+
+void SimDesktop::setClipboardFormat(const UINT format, std::string bytes) {
+    std::lock_guard lock(mutex_);
+    formats_[format] = std::move(bytes);
+    clipboardChangedLocked();
+}
+
+std::string SimDesktop::clipboardFormat(const UINT format) {
+    std::lock_guard lock(mutex_);
+    renderLocked(format);
+    const auto it = formats_.find(format);
+    return it != formats_.end() ? it->second : std::string{};
+}
+
+std::uint64_t SimDesktop::delayedRenders() const {
+    std::lock_guard lock(mutex_);
+    return delayedRenders_;
+}
+
+LANGID SimDesktop::lang() const {
+    std::lock_guard lock(mutex_);
+    return lang_;
+}
+
+void SimDesktop::setLang(const LANGID lang) {
+    std::lock_guard lock(mutex_);
+    lang_ = lang;
+}
+
+std::uint64_t SimDesktop::keyEvents() const {
+    std::lock_guard lock(mutex_);
+    return keyEvents_;
+}
+
+void SimDesktop::setCopyLatency(const std::chrono::microseconds latency) {
+    std::lock_guard lock(mutex_);
+    copyLatency_ = latency;
+    if (latency.count() > 0) startAppThreadLocked();
+}
+
+void SimDesktop::setSelectLatency(const std::chrono::microseconds latency) {
+    std::lock_guard lock(mutex_);
+    selectLatency_ = latency;
+    if (latency.count() > 0) startAppThreadLocked();
+}
+
+void SimDesktop::setKeyEventCost(const std::chrono::nanoseconds cost) {
+    std::lock_guard lock(mutex_);
+    keyEventCost_ = cost;
+}
+
+void SimDesktop::setInputQueueLimit(const std::size_t events) {
+    std::lock_guard lock(mutex_);
+    inputQueueLimit_ = events;
+    if (events > 0) startAppThreadLocked();
+}
+
+std::uint64_t SimDesktop::droppedEvents() const {
+    std::lock_guard lock(mutex_);
+    return droppedEvents_;
+}
+
+std::size_t SimDesktop::peakQueuedEvents() const {
+    std::lock_guard lock(mutex_);
+    return peakQueued_;
+}
+
+void SimDesktop::spendKeyEvents(const std::uint64_t events) const {
+    std::chrono::nanoseconds cost;
+    {
+        std::lock_guard lock(mutex_);
+        cost = keyEventCost_;
+    }
+    if (cost.count() > 0) std::this_thread::sleep_for(cost * events);
+}
+
+void SimDesktop::replaceSelectionLocked(const std::wstring_view text) {
+    text_.replace(selStart_, selEnd_ - selStart_, text);
+    selStart_ = selEnd_ = selStart_ + text.size();
+}
+
+void SimDesktop::startAppThreadLocked() {
+    if (!app_.joinable()) app_ = std::thread([this] { appThread(); });
+}
+
+SimDesktop::Clock::time_point SimDesktop::lastClipboardChange() const {
+    std::lock_guard lock(mutex_);
+    return lastChange_;
+}
+
+void SimDesktop::copySelectionLocked() {
+    // Like most edit controls, copying an empty selection leaves the clipboard alone.
+    if (selStart_ == selEnd_) return;
+    emptyClipboardLocked();
+    clipboard_.assign(text_, selStart_, selEnd_ - selStart_);
+    clipboardChangedLocked();
+}
+
+void SimDesktop::selectLocked(const platform::Selection selection) {
+    if (selection == platform::Selection::Line) {
+        // Shift+Home: extend from the caret back to the start of its line.
+        const std::size_t caret = selEnd_;
+        const std::size_t newline = caret == 0 ? std::wstring::npos : text_.rfind(L'\n', caret - 1);
+        selStart_ = newline == std::wstring::npos ? 0 : newline + 1;
+    } else if (selection == platform::Selection::All) {
+        selStart_ = 0;
+        selEnd_ = text_.size();
+    }
+}
+
+void SimDesktop::emptyClipboardLocked() {
+    // What EmptyClipboard does to the previous owner: its delayed formats go too.
+    clipboard_.clear();
+    formats_.clear();
+    delayed_.clear();
+    if (renderSource_) spareSnapshot_ = std::move(renderSource_);
+}
+
+void SimDesktop::renderLocked(const UINT format) {
+    const auto it = delayed_.find(format);
+    if (it == delayed_.end()) return;
+    const std::string bytes = renderSource_->read(renderSource_->saved()[it->second]);
+    delayed_.erase(it);
+    ++delayedRenders_;
+    if (format == CF_UNICODETEXT) {
+        clipboard_.assign(reinterpret_cast<const wchar_t *>(bytes.data()), bytes.size() / sizeof(wchar_t));
+    } else {
+        formats_[format] = bytes;
+    }
+}
+
+void SimDesktop::clipboardChangedLocked() {
+    ++sequence_;
+    lastChange_ = Clock::now();
+    clipboardChanged_.notify_all();
+}
+
+void SimDesktop::drainTypedLocked(const Clock::time_point now) {
+    // Consume however many characters the elapsed time pays for, so the
+    // drain rate doesn't depend on how promptly this thread wakes up.
+    const auto perChar = keyEventCost_ * 2;
+    const std::size_t queued = typedQueue_.size() - typedHead_;
+    std::size_t n = queued;
+    if (perChar.count() > 0) {
+        n = std::min<std::size_t>(queued, static_cast<std::size_t>((now - typedDrained_) / perChar));
+    }
+    if (n == 0) return;
+
+    replaceSelectionLocked(std::wstring_view(typedQueue_).substr(typedHead_, n));
+    typedHead_ += n;
+    typedDrained_ += perChar * static_cast<std::int64_t>(n);
+    if (typedHead_ == typedQueue_.size()) {
+        typedQueue_.clear();
+        typedHead_ = 0;
+    }
+}
+
+void SimDesktop::appThread() {
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+        const bool typing = typedHead_ < typedQueue_.size();
+        if (!copyPending_ && !selectPending_ && !typing) {
+            copyRequested_.wait(lock);
+            continue;
+        }
+        auto due = Clock::time_point::max();
+        if (copyPending_) due = std::min(due, copyDue_);
+        if (selectPending_) due = std::min(due, selectDue_);
+        if (typing) due = std::min(due, typedDrained_ + keyEventCost_ * 2);
+        copyRequested_.wait_until(lock, due);
+
+        const auto now = Clock::now();
+        drainTypedLocked(now);
+        if (selectPending_ && now >= selectDue_) {
+            selectPending_ = false;
+            selectLocked(pendingSelection_);
+        }
+        if (copyPending_ && now >= copyDue_) {
+            copyPending_ = false;
+            copySelectionLocked();
+        }
+    }
+}
+
+// ─── Clipboard ─────────────────────────────────────────────────────────
+
+DWORD SimDesktop::Clipboard::sequenceNumber() {
+    std::lock_guard lock(desktop_.mutex_);
+    return desktop_.sequence_;
+}
+
+std::wstring SimDesktop::Clipboard::readText() {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.renderLocked(CF_UNICODETEXT);
+    return desktop_.clipboard_;
+}
+
+bool SimDesktop::Clipboard::writeText(const std::wstring &text) {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.emptyClipboardLocked();
+    desktop_.clipboard_ = text;
+    desktop_.clipboardChangedLocked();
+    return true;
+}
+
+bool SimDesktop::Clipboard::viewText(const FunctionRef<void(std::wstring_view)> view) {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.renderLocked(CF_UNICODETEXT);
+    if (desktop_.clipboard_.empty()) return false;
+    view(desktop_.clipboard_);
+    return true;
+}
+
+bool SimDesktop::Clipboard::rewriteText(const TextMapper map) {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.renderLocked(CF_UNICODETEXT);
+    if (desktop_.clipboard_.empty()) return false;
+    // Into the block the last rewrite left behind, the way Windows hands out
+    // a freed global block again.
+    std::wstring &mapped = desktop_.rewritten_;
+    mapped.resize(desktop_.clipboard_.size());
+    map(desktop_.clipboard_.data(), mapped.size(), mapped.data());
+    desktop_.emptyClipboardLocked();
+    desktop_.clipboard_.swap(mapped);
+    desktop_.clipboardChangedLocked();
+    return true;
+}
+
+std::unique_ptr<platform::ClipboardSnapshot> SimDesktop::Clipboard::snapshot(const std::size_t residentLimit) {
+    std::lock_guard lock(desktop_.mutex_);
+    std::unique_ptr<Snapshot> snapshot = std::move(desktop_.spareSnapshot_);
+    if (snapshot) snapshot->clear();
+    else snapshot = std::make_unique<Snapshot>();
+    // Taking a snapshot reads every format, which renders any still delayed.
+    while (!desktop_.delayed_.empty()) desktop_.renderLocked(desktop_.delayed_.begin()->first);
+
+    if (!desktop_.clipboard_.empty()) {
+        snapshot->add(CF_UNICODETEXT, desktop_.clipboard_.data(),
+                      desktop_.clipboard_.size() * sizeof(wchar_t), residentLimit);
+    }
+    for (auto const &[format, bytes]: desktop_.formats_) {
+        snapshot->add(format, bytes.data(), bytes.size(), residentLimit);
+    }
+    return snapshot;
+}
+
+bool SimDesktop::Clipboard::restore(std::unique_ptr<platform::ClipboardSnapshot> snapshot) {
+    auto *saved = dynamic_cast<Snapshot *>(snapshot.get());
+    if (!saved) return false;
+    snapshot.release();
+
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.emptyClipboardLocked();
+    desktop_.renderSource_.reset(saved);
+    for (std::size_t i = 0; i < saved->saved().size(); ++i) {
+        auto const &entry = saved->saved()[i];
+        if (entry.spilled) {
+            desktop_.delayed_[entry.format] = i;
+        } else if (entry.format == CF_UNICODETEXT) {
+            desktop_.clipboard_.assign(reinterpret_cast<const wchar_t *>(entry.bytes.data()),
+                                       entry.bytes.size() / sizeof(wchar_t));
+        } else {
+            desktop_.formats_[entry.format] = entry.bytes;
+        }
+    }
+    desktop_.clipboardChangedLocked();
+    return true;
+}
+
+void SimDesktop::Clipboard::release(std::unique_ptr<platform::ClipboardSnapshot> snapshot) {
+    auto *saved = dynamic_cast<Snapshot *>(snapshot.get());
+    if (!saved) return;
+    snapshot.release();
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.spareSnapshot_.reset(saved);
+}
+
+void SimDesktop::Clipboard::dropSpare() {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.spareSnapshot_.reset();
+}
+
+/// Woken by a condition variable the moment the clipboard changes.
+class SimDesktop::ChangeWaiter final : public platform::ClipboardWaiter {
+public:
+    explicit ChangeWaiter(SimDesktop &desktop) : desktop_(desktop) {
+    }
+
+    DWORD waitForChange(const DWORD previous, const std::chrono::milliseconds timeout) override {
+        const auto deadline = Clock::now() + timeout;
+        std::unique_lock lock(desktop_.mutex_);
+        while (desktop_.sequence_ == previous) {
+            if (desktop_.clipboardChanged_.wait_until(lock, deadline) == std::cv_status::timeout) break;
+            wakeups_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return desktop_.sequence_;
+    }
+
+    std::uint64_t wakeups() const override {
+        return wakeups_.load(std::memory_order_relaxed);
+    }
+
+private:
+    SimDesktop &desktop_;
+    std::atomic<std::uint64_t> wakeups_{0};
+};
+
+std::unique_ptr<platform::ClipboardWaiter> SimDesktop::Clipboard::createChangeWaiter() {
+    return std::make_unique<ChangeWaiter>(desktop_);
+}
+
+// ─── Input Simulation ──────────────────────────────────────────────────
+
+void SimDesktop::Input::releaseModifiers(const UINT modifiers) {
+    std::lock_guard lock(desktop_.mutex_);
+    for (const UINT mod: {MOD_CONTROL, MOD_ALT, MOD_SHIFT}) {
+        if (modifiers & mod) ++desktop_.keyEvents_;
+    }
+}
+
+void SimDesktop::Input::sendCopy() {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.keyEvents_ += 4;
+
+    if (desktop_.copyLatency_.count() == 0) {
+        desktop_.copySelectionLocked();
+        return;
+    }
+    desktop_.copyPending_ = true;
+    desktop_.copyDue_ = Clock::now() + desktop_.copyLatency_;
+    desktop_.copyRequested_.notify_all();
+}
+
+void SimDesktop::Input::selectLine() {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.keyEvents_ += 4;
+    desktop_.selectLocked(platform::Selection::Line);
+}
+
+void SimDesktop::Input::selectAll() {
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.keyEvents_ += 4;
+    desktop_.selectLocked(platform::Selection::All);
+}
+
+void SimDesktop::Input::selectAndCopy(const platform::Selection selection) {
+    {
+        std::lock_guard lock(desktop_.mutex_);
+        if (selection != platform::Selection::Current) {
+            desktop_.keyEvents_ += 4;
+            if (desktop_.selectLatency_.count() == 0) {
+                desktop_.selectLocked(selection);
+            } else {
+                desktop_.selectPending_ = true;
+                desktop_.pendingSelection_ = selection;
+                desktop_.selectDue_ = Clock::now() + desktop_.selectLatency_;
+                desktop_.copyRequested_.notify_all();
+            }
+        }
+    }
+    sendCopy();
+}
+
+void SimDesktop::Input::typeText(const std::wstring_view text) {
+    {
+        std::lock_guard lock(desktop_.mutex_);
+        desktop_.keyEvents_ += text.size() * 2;
+
+        if (desktop_.inputQueueLimit_ > 0) {
+            const std::size_t queued = (desktop_.typedQueue_.size() - desktop_.typedHead_) * 2;
+            const std::size_t room = desktop_.inputQueueLimit_ > queued ? (desktop_.inputQueueLimit_ - queued) / 2 : 0;
+            const std::size_t accepted = std::min(room, text.size());
+            desktop_.droppedEvents_ += (text.size() - accepted) * 2;
+
+            if (queued == 0) desktop_.typedDrained_ = Clock::now();
+            desktop_.typedQueue_.append(text.substr(0, accepted));
+            desktop_.peakQueued_ = std::max(desktop_.peakQueued_, queued + accepted * 2);
+            desktop_.copyRequested_.notify_all();
+            return;
+        }
+        desktop_.replaceSelectionLocked(text);
+    }
+    desktop_.spendKeyEvents(text.size() * 2);
+}
+
+void SimDesktop::Input::retype(const std::size_t erase, const std::wstring_view text) {
+    {
+        std::lock_guard lock(desktop_.mutex_);
+        desktop_.keyEvents_ += (erase + text.size()) * 2;
+        for (std::size_t i = 0; i < erase; ++i) {
+            // Backspace takes the selection if there is one, else the character before the caret.
+            if (desktop_.selStart_ == desktop_.selEnd_ && desktop_.selStart_ > 0) --desktop_.selStart_;
+            desktop_.replaceSelectionLocked({});
+        }
+        desktop_.replaceSelectionLocked(text);
+    }
+    desktop_.spendKeyEvents((erase + text.size()) * 2);
+}
+
+bool SimDesktop::Input::inputPending() {
+    std::lock_guard lock(desktop_.mutex_);
+    return desktop_.typedHead_ < desktop_.typedQueue_.size();
+}
+
+void SimDesktop::Input::sendPaste() {
+    {
+        std::lock_guard lock(desktop_.mutex_);
+        desktop_.keyEvents_ += 4;
+        desktop_.renderLocked(CF_UNICODETEXT);
+        desktop_.replaceSelectionLocked(desktop_.clipboard_);
+    }
+    desktop_.spendKeyEvents(4);
+}
+
+// ─── Layout Probing & Switching ────────────────────────────────────────
+
+LANGID SimDesktop::Layout::activeLang() {
+    std::lock_guard lock(desktop_.mutex_);
+    return desktop_.lang_;
+}
+
+bool SimDesktop::Layout::switchTo(const std::string_view klid) {
+    // The low word of a KLID is the LANGID.
+    unsigned value = 0;
+    const auto [end, error] = std::from_chars(klid.data(), klid.data() + klid.size(), value, 16);
+    if (error != std::errc{} || end != klid.data() + klid.size()) return false;
+
+    std::lock_guard lock(desktop_.mutex_);
+    desktop_.lang_ = static_cast<LANGID>(value & 0xFFFF);
+    return true;
+}
@@ -0,0 +1,190 @@
+// this is platform_sim.h
+#pragma once
+
+#include "platform.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// ─── Simulated Desktop ─────────────────────────────────────────────────
+
+/// An in-memory stand-in for the desktop: one focused text field with a
+/// caret and selection, a clipboard with a sequence number, and the current
+/// keyboard layout. Key chords are applied the way a typical edit control
+/// would apply them, synchronously unless a copy latency is set. Builds
+/// anywhere; used by benchmarks.
+class SimDesktop {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SimDesktop();
+    ~SimDesktop();
+    SimDesktop(const SimDesktop &) = delete;
+    SimDesktop &operator=(const SimDesktop &) = delete;
+
+    /// Interfaces backed by this desktop (valid for its lifetime).
+    platform::Backend backend();
+
+    /// Replace the field's text; selection is [selStart, selEnd), caret at selEnd.
+    void setText(std::wstring text, std::size_t selStart, std::size_t selEnd);
+
+    std::wstring text() const;
+    /// The clipboard's text, rendering it first if it was delayed.
+    std::wstring clipboardText();
+    void setClipboardText(std::wstring text);
+
+    /// Add a non-text format (e.g. an image) to what is on the clipboard.
+    void setClipboardFormat(UINT format, std::string bytes);
+
+    /// A non-text format's bytes, rendering it first if it was delayed.
+    std::string clipboardFormat(UINT format);
+
+    /// Delayed formats rendered because something asked for them.
+    std::uint64_t delayedRenders() const;
+    LANGID lang() const;
+    void setLang(LANGID lang);
+
+    /// Number of synthetic key events (down + up) received so far.
+    std::uint64_t keyEvents() const;
+
+    /// Apply Ctrl+C this long after it is sent, on a separate "app" thread,
+    /// the way a real target processes its input queue. Zero = synchronously.
+    void setCopyLatency(std::chrono::microseconds latency);
+
+    /// Apply selection chords this long after they are sent, on the app
+    /// thread, modelling targets that update their selection asynchronously:
+    /// a Ctrl+C arriving in the meantime copies the old selection.
+    void setSelectLatency(std::chrono::microseconds latency);
+
+    /// Time the target spends handling each injected key event; typeText()
+    /// and sendPaste() block for that long per event they inject.
+    void setKeyEventCost(std::chrono::nanoseconds cost);
+
+    /// Queue typed characters instead: typeText() returns at once and the
+    /// app thread consumes them at the key event cost. Events that would
+    /// take the queue past limit are dropped, as a flooded real input
+    /// queue does. Zero = typing is synchronous.
+    void setInputQueueLimit(std::size_t events);
+
+    /// Typed characters dropped because the input queue was full.
+    std::uint64_t droppedEvents() const;
+
+    /// Most key events ever waiting in the input queue at once.
+    std::size_t peakQueuedEvents() const;
+
+    /// When the clipboard contents last changed.
+    Clock::time_point lastClipboardChange() const;
+
+private:
+    class Clipboard final : public platform::Clipboard {
+    public:
+        explicit Clipboard(SimDesktop &desktop) : desktop_(desktop) {
+        }
+
+        DWORD sequenceNumber() override;
+        std::wstring readText() override;
+        bool writeText(const std::wstring &text) override;
+        bool viewText(FunctionRef<void(std::wstring_view)> view) override;
+        bool rewriteText(TextMapper map) override;
+        std::unique_ptr<platform::ClipboardSnapshot> snapshot(std::size_t residentLimit) override;
+        bool restore(std::unique_ptr<platform::ClipboardSnapshot> snapshot) override;
+        void release(std::unique_ptr<platform::ClipboardSnapshot> snapshot) override;
+        void dropSpare() override;
+        std::unique_ptr<platform::ClipboardWaiter> createChangeWaiter() override;
+
+    private:
+        SimDesktop &desktop_;
+    };
+
+    class Input final : public platform::Input {
+    public:
+        explicit Input(SimDesktop &desktop) : desktop_(desktop) {
+        }
+
+        void releaseModifiers(UINT modifiers) override;
+        void sendCopy() override;
+        void selectLine() override;
+        void selectAll() override;
+        void selectAndCopy(platform::Selection selection) override;
+        void typeText(std::wstring_view text) override;
+        void retype(std::size_t erase, std::wstring_view text) override;
+        bool inputPending() override;
+        void sendPaste() override;
+
+    private:
+        SimDesktop &desktop_;
+    };
+
+    class Layout final : public platform::Layout {
+    public:
+        explicit Layout(SimDesktop &desktop) : desktop_(desktop) {
+        }
+
+        LANGID activeLang() override;
+        bool switchTo(std::string_view klid) override;
+
+    private:
+        SimDesktop &desktop_;
+    };
+
+    class ChangeWaiter;
+    class Snapshot;
+
+    // Callers hold mutex_.
+    void copySelectionLocked();
+    void selectLocked(platform::Selection selection);
+    void clipboardChangedLocked();
+    void emptyClipboardLocked();
+    void renderLocked(UINT format);
+    void startAppThreadLocked();
+    void replaceSelectionLocked(std::wstring_view text);
+    void spendKeyEvents(std::uint64_t events) const;
+    void drainTypedLocked(Clock::time_point now);
+    void appThread();
+
+    mutable std::mutex mutex_;
+    std::condition_variable clipboardChanged_;
+    std::condition_variable copyRequested_;
+    std::chrono::microseconds copyLatency_{0};
+    Clock::time_point copyDue_{};
+    bool copyPending_ = false;
+    std::chrono::microseconds selectLatency_{0};
+    Clock::time_point selectDue_{};
+    platform::Selection pendingSelection_{};
+    bool selectPending_ = false;
+    bool stopping_ = false;
+    std::thread app_;
+    Clock::time_point lastChange_{};
+    std::chrono::nanoseconds keyEventCost_{0};
+    std::size_t inputQueueLimit_ = 0;
+    std::wstring typedQueue_;         // characters not yet consumed
+    std::size_t typedHead_ = 0;       // first unconsumed one in typedQueue_
+    Clock::time_point typedDrained_{}; // consumed up to this point in time
+    std::uint64_t droppedEvents_ = 0;
+    std::size_t peakQueued_ = 0;
+
+    std::wstring text_;
+    std::size_t selStart_ = 0, selEnd_ = 0;
+    std::wstring clipboard_;          // CF_UNICODETEXT
+    std::map<UINT, std::string> formats_;  // everything else
+    std::unique_ptr<Snapshot> renderSource_; // owner of the delayed formats
+    std::unique_ptr<Snapshot> spareSnapshot_; // the last one dropped, to save into next
+    std::wstring rewritten_;          // the block rewriteText() maps into
+    std::map<UINT, std::size_t> delayed_;  // format → entry in renderSource_
+    std::uint64_t delayedRenders_ = 0;
+    DWORD sequence_ = 1;
+    LANGID lang_ = 0;
+    std::uint64_t keyEvents_ = 0;
+
+    Clipboard clipboardImpl_{*this};
+    Input inputImpl_{*this};
+    Layout layoutImpl_{*this};
+};
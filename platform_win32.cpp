@@ -0,0 +1,954 @@
+// this is platform_win32.cpp
+
+#include "platform.h"
+#include "typing_watcher.h"
+#include "utils.h"
+#include "config.h"
+
+// Windows APIs
+#include <windows.h>
+
+// I/O & console
+#include <iostream>
+
+// Containers & strings
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Threading & timing
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+
+
+namespace {
+
+    // ─── Clipboard Change Notifications ────────────────────────────────────
+
+    /// A message-only window on its own thread, registered with
+    /// AddClipboardFormatListener. WM_CLIPBOARDUPDATE sets an auto-reset
+    /// event, so the pipeline thread sleeps in the kernel until the copy lands.
+    class Win32ClipboardListener final : public platform::ClipboardWaiter {
+    public:
+        Win32ClipboardListener() : changed_(CreateEventW(nullptr, FALSE, FALSE, nullptr)) {
+        }
+
+        ~Win32ClipboardListener() override {
+            if (hwnd_) PostMessageW(hwnd_, WM_CLOSE, 0, 0);
+            if (thread_.joinable()) thread_.join();
+            if (changed_) CloseHandle(changed_);
+        }
+
+        /// Create the window; false if the listener could not be registered.
+        bool start() {
+            if (!changed_) return false;
+            std::promise<bool> ready;
+            auto started = ready.get_future();
+            thread_ = std::thread([this, &ready] { run(ready); });
+            return started.get();
+        }
+
+        DWORD waitForChange(const DWORD previous, const std::chrono::milliseconds timeout) override {
+            using Clock = std::chrono::steady_clock;
+            const auto deadline = Clock::now() + timeout;
+
+            for (;;) {
+                // Checked before every wait, so a notification that fired
+                // before we got here is never missed.
+                const DWORD current = GetClipboardSequenceNumber();
+                if (current != previous) return current;
+
+                const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+                if (left.count() <= 0) return previous;
+
+                if (WaitForSingleObject(changed_, static_cast<DWORD>(left.count())) == WAIT_TIMEOUT) {
+                    return GetClipboardSequenceNumber();
+                }
+                wakeups_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::uint64_t wakeups() const override {
+            return wakeups_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr const wchar_t *CLASS_NAME = L"LanguageFlipperClipboardListener";
+
+        static LRESULT CALLBACK windowProc(const HWND hwnd, const UINT msg, const WPARAM wParam, const LPARAM lParam) {
+            switch (msg) {
+                case WM_CLIPBOARDUPDATE:
+                    SetEvent(reinterpret_cast<HANDLE>(GetWindowLongPtrW(hwnd, GWLP_USERDATA)));
+                    return 0;
+                case WM_CLOSE:
+                    RemoveClipboardFormatListener(hwnd);
+                    DestroyWindow(hwnd);
+                    return 0;
+                case WM_DESTROY:
+                    PostQuitMessage(0);
+                    return 0;
+                default:
+                    return DefWindowProcW(hwnd, msg, wParam, lParam);
+            }
+        }
+
+        void run(std::promise<bool> &ready) {
+            WNDCLASSEXW wc{};
+            wc.cbSize = sizeof(wc);
+            wc.lpfnWndProc = windowProc;
+            wc.hInstance = GetModuleHandleW(nullptr);
+            wc.lpszClassName = CLASS_NAME;
+            RegisterClassExW(&wc); // fails harmlessly if already registered
+
+            const HWND hwnd = CreateWindowExW(0, CLASS_NAME, L"", 0, 0, 0, 0, 0,
+                                              HWND_MESSAGE, nullptr, wc.hInstance, nullptr);
+            if (!hwnd) {
+                ready.set_value(false);
+                return;
+            }
+            SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(changed_));
+            if (!AddClipboardFormatListener(hwnd)) {
+                DestroyWindow(hwnd);
+                ready.set_value(false);
+                return;
+            }
+
+            hwnd_ = hwnd;
+            ready.set_value(true);
+
+            MSG msg;
+            while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+                DispatchMessageW(&msg);
+            }
+        }
+
+        HANDLE changed_;
+        HWND hwnd_ = nullptr;
+        std::thread thread_;
+        std::atomic<std::uint64_t> wakeups_{0};
+    };
+
+    // ─── Clipboard Snapshots ───────────────────────────────────────────────
+
+    /// Formats whose handle is a GDI object or means something only to the
+    /// owner, rather than an HGLOBAL we can copy, so they aren't saved.
+    /// Windows synthesizes them from what is: CF_BITMAP from CF_DIB and
+    /// CF_METAFILEPICT from CF_ENHMETAFILE (saved as its bytes). The private
+    /// and GDI object ranges are handles the owner made and frees.
+    bool isGdiFormat(const UINT format) {
+        if (format >= CF_PRIVATEFIRST && format <= CF_PRIVATELAST) return true;
+        if (format >= CF_GDIOBJFIRST && format <= CF_GDIOBJLAST) return true;
+        switch (format) {
+            case CF_BITMAP: case CF_DSPBITMAP: case CF_DSPENHMETAFILE:
+            case CF_METAFILEPICT: case CF_DSPMETAFILEPICT: case CF_PALETTE: case CF_OWNERDISPLAY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Small formats as bytes in memory, large ones in a delete-on-close
+    /// temp file written straight from the locked clipboard memory.
+    class Win32Snapshot final : public platform::ClipboardSnapshot {
+    public:
+        struct Saved {
+            UINT format = 0;
+            std::vector<char> bytes; // when resident
+            ULONGLONG offset = 0;    // when spilled
+            SIZE_T size = 0;
+            bool spilled = false;
+            bool rendered = false;
+        };
+
+        ~Win32Snapshot() override {
+            if (spill_ != INVALID_HANDLE_VALUE) CloseHandle(spill_);
+        }
+
+        /// Forget what was saved but keep the buffers and the spill file,
+        /// to save into again.
+        void clear() {
+            used_ = 0;
+            spillEnd_ = 0;
+        }
+
+        void add(const UINT format, const void *data, const SIZE_T size, const std::size_t residentLimit) {
+            if (used_ == saved_.size()) saved_.emplace_back();
+            Saved &saved = saved_[used_++];
+            saved.format = format;
+            saved.offset = 0;
+            saved.size = size;
+            saved.spilled = size > residentLimit;
+            saved.rendered = false;
+            saved.bytes.clear();
+            if (saved.spilled && openSpill()) {
+                saved.offset = spillEnd_;
+                LARGE_INTEGER at;
+                at.QuadPart = static_cast<LONGLONG>(spillEnd_);
+                DWORD written = 0;
+                // A single format over 4 GB isn't something a clipboard carries.
+                if (SetFilePointerEx(spill_, at, nullptr, FILE_BEGIN) &&
+                    WriteFile(spill_, data, static_cast<DWORD>(size), &written, nullptr) && written == size) {
+                    spillEnd_ += size;
+                    return;
+                }
+            }
+            saved.spilled = false;
+            saved.bytes.assign(static_cast<const char *>(data), static_cast<const char *>(data) + size);
+        }
+
+        /// A new handle holding one saved format, for SetClipboardData: a
+        /// global block, or for CF_ENHMETAFILE a metafile made from its bytes.
+        HANDLE render(const Saved &saved) const {
+            if (saved.format == CF_ENHMETAFILE) {
+                std::vector<char> spilled;
+                if (saved.spilled) {
+                    spilled.resize(saved.size);
+                    if (!read(saved, spilled.data())) return nullptr;
+                }
+                const char *bytes = saved.spilled ? spilled.data() : saved.bytes.data();
+                return SetEnhMetaFileBits(static_cast<UINT>(saved.size), reinterpret_cast<const BYTE *>(bytes));
+            }
+            HGLOBAL block = GlobalAlloc(GMEM_MOVEABLE, saved.size ? saved.size : 1);
+            if (!block) return nullptr;
+            auto *dst = static_cast<char *>(GlobalLock(block));
+            const bool ok = dst != nullptr && read(saved, dst);
+            if (dst) GlobalUnlock(block);
+            if (!ok) {
+                GlobalFree(block);
+                return nullptr;
+            }
+            return block;
+        }
+
+        /// Free what render() made when SetClipboardData didn't take it.
+        static void discard(const UINT format, const HANDLE handle) {
+            if (format == CF_ENHMETAFILE) DeleteEnhMetaFile(static_cast<HENHMETAFILE>(handle));
+            else GlobalFree(handle);
+        }
+
+        std::span<Saved> saved() { return {saved_.data(), used_}; }
+
+        std::size_t formatCount() const override { return used_; }
+
+        std::size_t residentBytes() const override {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < used_; ++i) total += saved_[i].bytes.size();
+            return total;
+        }
+
+        std::size_t spilledBytes() const override {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < used_; ++i) total += saved_[i].spilled ? saved_[i].size : 0;
+            return total;
+        }
+
+    private:
+        /// Copy one saved format's bytes to dst.
+        bool read(const Saved &saved, char *dst) const {
+            if (!saved.spilled) {
+                std::copy(saved.bytes.begin(), saved.bytes.end(), dst);
+                return true;
+            }
+            OVERLAPPED at{};
+            at.Offset = static_cast<DWORD>(saved.offset);
+            at.OffsetHigh = static_cast<DWORD>(saved.offset >> 32);
+            DWORD read = 0;
+            return ReadFile(spill_, dst, static_cast<DWORD>(saved.size), &read, &at) && read == saved.size;
+        }
+
+        bool openSpill() {
+            if (spill_ != INVALID_HANDLE_VALUE) return true;
+            wchar_t dir[MAX_PATH], path[MAX_PATH];
+            if (!GetTempPathW(MAX_PATH, dir) || !GetTempFileNameW(dir, L"lfc", 0, path)) return false;
+            spill_ = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+            return spill_ != INVALID_HANDLE_VALUE;
+        }
+
+        std::vector<Saved> saved_; // the first used_ are in use; the rest wait to be reused
+        std::size_t used_ = 0;
+        HANDLE spill_ = INVALID_HANDLE_VALUE;
+        ULONGLONG spillEnd_ = 0;
+    };
+
+    /// The last snapshot nobody needs any more, kept for the next one to be
+    /// taken into. Filled from the owner thread, emptied by the worker.
+    class SpareSnapshot {
+    public:
+        void put(std::unique_ptr<Win32Snapshot> snapshot) {
+            if (!snapshot) return;
+            std::lock_guard lock(mutex_);
+            spare_ = std::move(snapshot);
+        }
+
+        std::unique_ptr<Win32Snapshot> take() {
+            std::lock_guard lock(mutex_);
+            return std::move(spare_);
+        }
+
+    private:
+        std::mutex mutex_;
+        std::unique_ptr<Win32Snapshot> spare_;
+    };
+
+    /// Owns the clipboard after a restore: a message-only window on its own
+    /// thread that renders spilled formats on WM_RENDERFORMAT and drops the
+    /// snapshot once someone else takes the clipboard.
+    class Win32ClipboardOwner {
+    public:
+        explicit Win32ClipboardOwner(SpareSnapshot &spare) : spare_(spare) {
+        }
+
+        ~Win32ClipboardOwner() {
+            if (hwnd_) PostMessageW(hwnd_, WM_CLOSE, 0, 0);
+            if (thread_.joinable()) thread_.join();
+        }
+
+        bool start() {
+            std::promise<bool> ready;
+            auto started = ready.get_future();
+            thread_ = std::thread([this, &ready] { run(ready); });
+            return started.get();
+        }
+
+        /// Runs on the owner thread, so snapshot_ is only ever touched there.
+        bool restore(std::unique_ptr<Win32Snapshot> snapshot) {
+            return SendMessageW(hwnd_, WM_RESTORE, 0, reinterpret_cast<LPARAM>(snapshot.release())) != 0;
+        }
+
+    private:
+        static constexpr const wchar_t *CLASS_NAME = L"LanguageFlipperClipboardOwner";
+        static constexpr UINT WM_RESTORE = WM_APP + 1;
+
+        static LRESULT CALLBACK windowProc(const HWND hwnd, const UINT msg, const WPARAM wParam, const LPARAM lParam) {
+            auto *self = reinterpret_cast<Win32ClipboardOwner *>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+            switch (msg) {
+                case WM_RESTORE:
+                    return self->onRestore(std::unique_ptr<Win32Snapshot>(reinterpret_cast<Win32Snapshot *>(lParam)));
+                case WM_RENDERFORMAT:
+                    self->renderFormat(static_cast<UINT>(wParam));
+                    return 0;
+                case WM_RENDERALLFORMATS:
+                    // We're going away while still owning the clipboard.
+                    if (OpenClipboard(hwnd)) {
+                        if (GetClipboardOwner() == hwnd && self->snapshot_) {
+                            for (auto const &saved: self->snapshot_->saved()) {
+                                if (saved.spilled && !saved.rendered) self->renderFormat(saved.format);
+                            }
+                        }
+                        CloseClipboard();
+                    }
+                    return 0;
+                case WM_DESTROYCLIPBOARD:
+                    self->spare_.put(std::move(self->snapshot_));
+                    return 0;
+                case WM_CLOSE:
+                    DestroyWindow(hwnd);
+                    return 0;
+                case WM_DESTROY:
+                    PostQuitMessage(0);
+                    return 0;
+                default:
+                    return DefWindowProcW(hwnd, msg, wParam, lParam);
+            }
+        }
+
+        LRESULT onRestore(std::unique_ptr<Win32Snapshot> snapshot) {
+            if (!OpenClipboard(hwnd_)) return 0;
+            EmptyClipboard(); // sends us WM_DESTROYCLIPBOARD if we held the last one
+            for (auto &saved: snapshot->saved()) {
+                if (saved.spilled) {
+                    SetClipboardData(saved.format, nullptr); // rendered on request
+                } else if (HANDLE handle = snapshot->render(saved)) {
+                    if (!SetClipboardData(saved.format, handle)) Win32Snapshot::discard(saved.format, handle);
+                }
+            }
+            spare_.put(std::exchange(snapshot_, std::move(snapshot)));
+            CloseClipboard();
+            return 1;
+        }
+
+        void renderFormat(const UINT format) {
+            if (!snapshot_) return;
+            for (auto &saved: snapshot_->saved()) {
+                if (saved.format != format || !saved.spilled) continue;
+                if (HANDLE handle = snapshot_->render(saved)) {
+                    if (SetClipboardData(format, handle)) saved.rendered = true;
+                    else Win32Snapshot::discard(format, handle);
+                }
+                return;
+            }
+        }
+
+        void run(std::promise<bool> &ready) {
+            WNDCLASSEXW wc{};
+            wc.cbSize = sizeof(wc);
+            wc.lpfnWndProc = windowProc;
+            wc.hInstance = GetModuleHandleW(nullptr);
+            wc.lpszClassName = CLASS_NAME;
+            RegisterClassExW(&wc); // fails harmlessly if already registered
+
+            const HWND hwnd = CreateWindowExW(0, CLASS_NAME, L"", 0, 0, 0, 0, 0,
+                                              HWND_MESSAGE, nullptr, wc.hInstance, nullptr);
+            if (!hwnd) {
+                ready.set_value(false);
+                return;
+            }
+            SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+            hwnd_ = hwnd;
+            ready.set_value(true);
+
+            MSG msg;
+            while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+                DispatchMessageW(&msg);
+            }
+            snapshot_.reset();
+        }
+
+        HWND hwnd_ = nullptr;
+        std::thread thread_;
+        SpareSnapshot &spare_;
+        std::unique_ptr<Win32Snapshot> snapshot_;
+    };
+
+    // ─── Clipboard ─────────────────────────────────────────────────────────
+
+    class Win32Clipboard final : public platform::Clipboard {
+    public:
+        std::unique_ptr<platform::ClipboardWaiter> createChangeWaiter() override {
+            auto listener = std::make_unique<Win32ClipboardListener>();
+            if (!listener->start()) return nullptr;
+            return listener;
+        }
+
+        DWORD sequenceNumber() override {
+            return GetClipboardSequenceNumber();
+        }
+
+        std::wstring readText() override {
+            // 1) Open the clipboard
+            if (!OpenClipboard(nullptr)) {
+                DEBUG_PRINT(L"[readClipboard] Failed to open clipboard");
+                return L"";
+            }
+
+            std::wstring text;
+
+            // 2) Request Unicode text
+            HANDLE hData = GetClipboardData(CF_UNICODETEXT);
+            if (hData != nullptr) {
+                // 3) Lock the handle to get a pointer
+                // ReSharper disable once CppTooWideScope
+                const auto *pWide = static_cast<const wchar_t *>(GlobalLock(hData));
+                if (pWide) {
+                    // 4) Copy into our string
+                    text.assign(pWide);
+                    GlobalUnlock(hData);
+                }
+            }
+
+            // 5) Always close when done
+            CloseClipboard();
+            return text;
+        }
+
+        bool writeText(const std::wstring &text) override {
+            // 1) Copy into a movable global block the clipboard can own
+            const SIZE_T bytes = (text.size() + 1) * sizeof(wchar_t);
+            HGLOBAL hData = GlobalAlloc(GMEM_MOVEABLE, bytes);
+            if (!hData) return false;
+            if (auto *pWide = static_cast<wchar_t *>(GlobalLock(hData))) {
+                std::copy(text.begin(), text.end(), pWide);
+                pWide[text.size()] = L'\0';
+                GlobalUnlock(hData);
+            }
+
+            // 2) Take the clipboard and hand the block over
+            if (!OpenClipboard(nullptr)) {
+                GlobalFree(hData);
+                DEBUG_PRINT(L"[writeClipboard] Failed to open clipboard");
+                return false;
+            }
+            EmptyClipboard();
+            const bool ok = SetClipboardData(CF_UNICODETEXT, hData) != nullptr;
+            if (!ok) GlobalFree(hData); // on success the system owns it
+            CloseClipboard();
+            return ok;
+        }
+
+        bool viewText(const FunctionRef<void(std::wstring_view)> view) override {
+            if (!OpenClipboard(nullptr)) return false;
+            bool ok = false;
+            if (HANDLE hData = GetClipboardData(CF_UNICODETEXT)) {
+                if (const auto *pWide = static_cast<const wchar_t *>(GlobalLock(hData))) {
+                    view(std::wstring_view(pWide, lockedLength(hData, pWide)));
+                    GlobalUnlock(hData);
+                    ok = true;
+                }
+            }
+            CloseClipboard();
+            return ok;
+        }
+
+        bool rewriteText(const TextMapper map) override {
+            if (!OpenClipboard(nullptr)) return false;
+            HGLOBAL mapped = nullptr;
+
+            // Map from the locked source straight into the new block, before
+            // EmptyClipboard frees the source.
+            if (HANDLE hData = GetClipboardData(CF_UNICODETEXT)) {
+                if (const auto *src = static_cast<const wchar_t *>(GlobalLock(hData))) {
+                    const std::size_t n = lockedLength(hData, src);
+                    if ((mapped = GlobalAlloc(GMEM_MOVEABLE, (n + 1) * sizeof(wchar_t)))) {
+                        auto *dst = static_cast<wchar_t *>(GlobalLock(mapped));
+                        if (dst) {
+                            map(src, n, dst);
+                            dst[n] = L'\0';
+                            GlobalUnlock(mapped);
+                        } else {
+                            GlobalFree(mapped);
+                            mapped = nullptr;
+                        }
+                    }
+                    GlobalUnlock(hData);
+                }
+            }
+
+            bool ok = false;
+            if (mapped) {
+                EmptyClipboard();
+                ok = SetClipboardData(CF_UNICODETEXT, mapped) != nullptr;
+                if (!ok) GlobalFree(mapped);
+            }
+            CloseClipboard();
+            return ok;
+        }
+
+        std::unique_ptr<platform::ClipboardSnapshot> snapshot(const std::size_t residentLimit) override {
+            std::unique_ptr<Win32Snapshot> snapshot = spare_.take();
+            if (snapshot) snapshot->clear();
+            else snapshot = std::make_unique<Win32Snapshot>();
+            if (!OpenClipboard(nullptr)) return snapshot;
+
+            // CF_TEXT / CF_OEMTEXT are synthesized from CF_UNICODETEXT again on restore.
+            const bool hasUnicode = IsClipboardFormatAvailable(CF_UNICODETEXT);
+            for (UINT format = EnumClipboardFormats(0); format != 0; format = EnumClipboardFormats(format)) {
+                if (isGdiFormat(format)) continue;
+                if (hasUnicode && (format == CF_TEXT || format == CF_OEMTEXT)) continue;
+
+                HANDLE hData = GetClipboardData(format);
+                if (!hData) continue;
+                if (format == CF_ENHMETAFILE) {
+                    // A handle, not memory: saved as the metafile's bytes.
+                    const auto metafile = static_cast<HENHMETAFILE>(hData);
+                    const UINT size = GetEnhMetaFileBits(metafile, 0, nullptr);
+                    metafile_.resize(size);
+                    if (size && GetEnhMetaFileBits(metafile, size, metafile_.data()) == size) {
+                        snapshot->add(format, metafile_.data(), size, residentLimit);
+                    }
+                    continue;
+                }
+                const SIZE_T size = GlobalSize(hData);
+                if (const void *data = GlobalLock(hData)) {
+                    snapshot->add(format, data, size, residentLimit);
+                    GlobalUnlock(hData);
+                }
+            }
+            CloseClipboard();
+            return snapshot;
+        }
+
+        bool restore(std::unique_ptr<platform::ClipboardSnapshot> snapshot) override {
+            auto *saved = dynamic_cast<Win32Snapshot *>(snapshot.get());
+            if (!saved) return false;
+            snapshot.release();
+            std::unique_ptr<Win32Snapshot> owned(saved);
+
+            if (!owner_) {
+                auto owner = std::make_unique<Win32ClipboardOwner>(spare_);
+                if (!owner->start()) return false;
+                owner_ = std::move(owner);
+            }
+            return owner_->restore(std::move(owned));
+        }
+
+        void release(std::unique_ptr<platform::ClipboardSnapshot> snapshot) override {
+            auto *saved = dynamic_cast<Win32Snapshot *>(snapshot.get());
+            if (!saved) return;
+            snapshot.release();
+            spare_.put(std::unique_ptr<Win32Snapshot>(saved));
+        }
+
+        void dropSpare() override { spare_.take(); }
+
+    private:
+        /// Length of locked CF_UNICODETEXT, stopping at the block's end if
+        /// the terminator is missing.
+        static std::size_t lockedLength(HANDLE hData, const wchar_t *text) {
+            const std::size_t capacity = GlobalSize(hData) / sizeof(wchar_t);
+            return std::find(text, text + capacity, L'\0') - text;
+        }
+
+        SpareSnapshot spare_; // outlives owner_, which puts snapshots back into it
+        std::vector<BYTE> metafile_; // a CF_ENHMETAFILE's bytes on their way into a snapshot
+        std::unique_ptr<Win32ClipboardOwner> owner_;
+    };
+
+    // ─── Input Simulation ──────────────────────────────────────────────────
+
+    // modifier down, key down, key up, modifier up
+    void fillChord(INPUT *inputs, const WORD modifier, const WORD key) {
+        inputs[0] = {};
+        inputs[0].type = INPUT_KEYBOARD;
+        inputs[0].ki.wVk = modifier;
+        inputs[1] = {};
+        inputs[1].type = INPUT_KEYBOARD;
+        inputs[1].ki.wVk = key;
+        inputs[2] = inputs[1];
+        inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+        inputs[3] = inputs[0];
+        inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+    }
+
+    class Win32Input final : public platform::Input {
+    public:
+        // Release any stuck modifier keys (Ctrl, Alt, Shift) in one batched SendInput call
+        void releaseModifiers(const UINT modifiers) override {
+            INPUT ups[3] = {};
+            UINT count = 0;
+            for (const auto [flag, vk]: {std::pair<UINT, WORD>{MOD_CONTROL, VK_CONTROL}, {MOD_ALT, VK_MENU}, {MOD_SHIFT, VK_SHIFT}}) {
+                if (!(modifiers & flag)) continue;
+                ups[count].type = INPUT_KEYBOARD;
+                ups[count].ki.wVk = vk;
+                ups[count].ki.dwFlags = KEYEVENTF_KEYUP;
+                ++count;
+            }
+
+            if (count > 0) SendInput(count, ups, sizeof(INPUT));
+        }
+
+        void sendCopy() override {
+            INPUT inputs[4] = {};
+
+            // Ctrl down, C down, C up, Ctrl up
+            inputs[0].type = INPUT_KEYBOARD;
+            inputs[0].ki.wVk = VK_CONTROL;
+            inputs[1].type = INPUT_KEYBOARD;
+            inputs[1].ki.wVk = 'C';
+            inputs[2] = inputs[1];
+            inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+            inputs[3] = inputs[0];
+            inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+
+            SendInput(4, inputs, sizeof(INPUT));
+        }
+
+        void selectLine() override {
+            INPUT inputs[4] = {};
+
+            // Press SHIFT
+            inputs[0].type = INPUT_KEYBOARD;
+            inputs[0].ki.wVk = VK_SHIFT;
+
+            // Press HOME
+            inputs[1].type = INPUT_KEYBOARD;
+            inputs[1].ki.wVk = VK_HOME;
+
+            // Release HOME
+            inputs[2] = inputs[1];
+            inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+
+            // Release SHIFT
+            inputs[3] = inputs[0];
+            inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+
+            SendInput(4, inputs, sizeof(INPUT));
+        }
+
+        void selectAll() override {
+            INPUT inputs[4] = {};
+
+            // Press CTRL down
+            inputs[0].type = INPUT_KEYBOARD;
+            inputs[0].ki.wVk = VK_CONTROL;
+
+            // Press A
+            inputs[1].type = INPUT_KEYBOARD;
+            inputs[1].ki.wVk = 'A';
+
+            // Release A
+            inputs[2] = inputs[1];
+            inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+
+            // Release CTRL
+            inputs[3] = inputs[0];
+            inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+
+            SendInput(4, inputs, sizeof(INPUT));
+        }
+
+        void selectAndCopy(const platform::Selection selection) override {
+            // One SendInput call keeps the chords contiguous in the input
+            // stream, so the target sees the selection before the copy.
+            INPUT inputs[8];
+            UINT count = 0;
+            if (selection == platform::Selection::Line) {
+                fillChord(inputs, VK_SHIFT, VK_HOME);
+                count = 4;
+            } else if (selection == platform::Selection::All) {
+                fillChord(inputs, VK_CONTROL, 'A');
+                count = 4;
+            }
+            fillChord(inputs + count, VK_CONTROL, 'C');
+            count += 4;
+
+            SendInput(count, inputs, sizeof(INPUT));
+        }
+
+        void sendPaste() override {
+            INPUT inputs[4];
+            fillChord(inputs, VK_CONTROL, 'V');
+            SendInput(4, inputs, sizeof(INPUT));
+        }
+
+        void typeText(const std::wstring_view text) override {
+            // One INPUT down-event and one up-event per character, sent from
+            // a fixed buffer so a long string never means a huge allocation.
+            std::size_t done = 0;
+            while (done < text.size()) {
+                const std::size_t n = std::min(text.size() - done, kTypeChunk);
+                for (std::size_t i = 0; i < n; ++i) {
+                    // Key-down event (UNICODE scan code)
+                    INPUT &keyDown = typed_[2 * i];
+                    keyDown = {};
+                    keyDown.type = INPUT_KEYBOARD;
+                    keyDown.ki.wScan = text[done + i]; // Unicode code point
+                    keyDown.ki.dwFlags = KEYEVENTF_UNICODE; // tell Windows it's a unicode wScan
+
+                    // Key-up event is identical, plus the KEYEVENTF_KEYUP flag:
+                    INPUT &keyUp = typed_[2 * i + 1];
+                    keyUp = keyDown;
+                    keyUp.ki.dwFlags |= KEYEVENTF_KEYUP;
+                }
+                SendInput(static_cast<UINT>(2 * n), typed_, sizeof(INPUT));
+                done += n;
+            }
+        }
+
+        void retype(const std::size_t erase, const std::wstring_view text) override {
+            // Called from the keyboard hook, so a buffer of its own: the
+            // worker may be typing from typed_ at the same time.
+            INPUT inputs[2 * 64];
+            UINT count = 0;
+            auto add = [&](const WORD vk, const wchar_t ch) {
+                if (count == std::size(inputs)) {
+                    SendInput(count, inputs, sizeof(INPUT));
+                    count = 0;
+                }
+                INPUT &keyDown = inputs[count++];
+                keyDown = {};
+                keyDown.type = INPUT_KEYBOARD;
+                keyDown.ki.wVk = vk;
+                if (!vk) {
+                    keyDown.ki.wScan = ch;
+                    keyDown.ki.dwFlags = KEYEVENTF_UNICODE;
+                }
+                INPUT &keyUp = inputs[count++];
+                keyUp = keyDown;
+                keyUp.ki.dwFlags |= KEYEVENTF_KEYUP;
+            };
+            for (std::size_t i = 0; i < erase; ++i) add(VK_BACK, 0);
+            for (const wchar_t ch: text) add(0, ch);
+            if (count > 0) SendInput(count, inputs, sizeof(INPUT));
+        }
+
+        bool inputPending() override {
+            // Key messages sit in the target thread's input queue until it
+            // reads them. Attaching our input state to that thread lets
+            // GetQueueStatus see the shared queue.
+            const HWND foreground = GetForegroundWindow();
+            if (!foreground) return false;
+            const DWORD target = GetWindowThreadProcessId(foreground, nullptr);
+            const DWORD self = GetCurrentThreadId();
+            if (target == 0 || target == self) return false;
+            if (!AttachThreadInput(self, target, TRUE)) return false;
+            const bool pending = HIWORD(GetQueueStatus(QS_KEY)) != 0;
+            AttachThreadInput(self, target, FALSE);
+            return pending;
+        }
+
+    private:
+        static constexpr std::size_t kTypeChunk = 256;
+        INPUT typed_[2 * kTypeChunk]{};
+    };
+
+    // ─── Layout Probing & Switching ────────────────────────────────────────
+
+    class Win32Layout final : public platform::Layout {
+    public:
+        LANGID activeLang() override {
+            const HWND h = GetForegroundWindow();
+            return LOWORD(GetKeyboardLayout(GetWindowThreadProcessId(h, nullptr)));
+        }
+
+        bool switchTo(const std::string_view layoutId) override {
+            // 1) Load the layout into this process (reordering the HKL list)
+            HKL layoutHandle = LoadKeyboardLayoutA(std::string(layoutId).c_str(), KLF_REORDER);
+            if (!layoutHandle) {
+                // failed to load the layout at all
+                return false;
+            }
+
+            // 2) Broadcast a WM_INPUTLANGCHANGEREQUEST so all windows switch
+            LRESULT result = PostMessage(
+                HWND_BROADCAST,
+                WM_INPUTLANGCHANGEREQUEST,
+                0,
+                reinterpret_cast<LPARAM>(layoutHandle)
+            );
+
+            // PostMessage returns nonzero on success
+            return result != 0;
+        }
+    };
+
+    Win32Clipboard clipboard;
+    Win32Input input;
+    Win32Layout layout;
+}
+
+platform::Backend platform::win32() {
+    return {&clipboard, &input, &layout};
+}
+
+// ─── Hotkey Registration ───────────────────────────────────────────────
+
+bool registerHotkey(const int id, const UINT modifiers, const UINT vk) {
+    const std::wstring name = makeHotkeyName(modifiers, vk);
+
+    if (!RegisterHotKey(nullptr, id, modifiers, vk)) {
+        DEBUG_PRINT(L"Failed to register hotkey " << name);
+        return false;
+    }
+
+    DEBUG_PRINT(L"Hotkey registered " << name);
+    return true;
+}
+
+// ─── Typing Hook ───────────────────────────────────────────────────────
+
+namespace {
+    std::function<bool(const KeyPress &)> typingHook;
+    HHOOK keyboardHook = nullptr;
+    HHOOK mouseHook = nullptr;
+    HWND typingWindow = nullptr; // where the last key went
+
+    bool isModifierKey(const DWORD vk) {
+        switch (vk) {
+            case VK_SHIFT: case VK_LSHIFT: case VK_RSHIFT:
+            case VK_CONTROL: case VK_LCONTROL: case VK_RCONTROL:
+            case VK_MENU: case VK_LMENU: case VK_RMENU:
+            case VK_LWIN: case VK_RWIN: case VK_CAPITAL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    UINT heldModifiers() {
+        UINT modifiers = 0;
+        if (GetAsyncKeyState(VK_CONTROL) & 0x8000) modifiers |= MOD_CONTROL;
+        if (GetAsyncKeyState(VK_MENU) & 0x8000) modifiers |= MOD_ALT;
+        if (GetAsyncKeyState(VK_SHIFT) & 0x8000) modifiers |= MOD_SHIFT;
+        if ((GetAsyncKeyState(VK_LWIN) | GetAsyncKeyState(VK_RWIN)) & 0x8000) modifiers |= MOD_WIN;
+        return modifiers;
+    }
+
+    KeyPress translate(const KBDLLHOOKSTRUCT &event, const HWND window) {
+        KeyPress key;
+        const HKL layout = GetKeyboardLayout(GetWindowThreadProcessId(window, nullptr));
+        key.lang = LOWORD(reinterpret_cast<UINT_PTR>(layout));
+        key.vk = event.vkCode;
+        key.modifiers = heldModifiers();
+        if (isModifierKey(event.vkCode)) {
+            key.kind = KeyPress::Kind::Modifier;
+            return key;
+        }
+
+        // Ctrl or Alt alone (or Win) make a shortcut; Ctrl+Alt together is AltGr and types.
+        const bool ctrl = key.modifiers & MOD_CONTROL, alt = key.modifiers & MOD_ALT;
+        if ((key.modifiers & MOD_WIN) || ctrl != alt) return key;
+        if (event.vkCode == VK_BACK) {
+            key.kind = KeyPress::Kind::Backspace;
+            return key;
+        }
+
+        // What the key types in the target's layout. Flag 4 leaves the
+        // layout's dead-key state alone, so a pending accent still lands;
+        // a dead key itself (-1) or a key typing two units stays Other.
+        BYTE state[256] = {};
+        if (key.modifiers & MOD_SHIFT) state[VK_SHIFT] = 0x80;
+        if (ctrl) state[VK_CONTROL] = state[VK_MENU] = 0x80;
+        if (GetKeyState(VK_CAPITAL) & 1) state[VK_CAPITAL] = 1;
+        wchar_t typed[4];
+        if (ToUnicodeEx(event.vkCode, event.scanCode, state, typed, 4, 4, layout) == 1 &&
+            (typed[0] >= L' ' || typed[0] == L'\r')) {
+            key.kind = KeyPress::Kind::Text;
+            key.ch = typed[0];
+        }
+        return key;
+    }
+
+    LRESULT CALLBACK onKeyboardEvent(const int code, const WPARAM message, const LPARAM data) {
+        if (code == HC_ACTION && (message == WM_KEYDOWN || message == WM_SYSKEYDOWN)) {
+            const auto &event = *reinterpret_cast<const KBDLLHOOKSTRUCT *>(data);
+            // Injected keys (ours among them) aren't the user typing.
+            if (!(event.flags & LLKHF_INJECTED)) {
+                const HWND window = GetForegroundWindow();
+                if (window != typingWindow) {
+                    typingWindow = window;
+                    typingHook(KeyPress{}); // another window: its caret is somewhere else
+                }
+                if (typingHook(translate(event, window))) return 1;
+            }
+        }
+        return CallNextHookEx(nullptr, code, message, data);
+    }
+
+    LRESULT CALLBACK onMouseEvent(const int code, const WPARAM message, const LPARAM data) {
+        if (code == HC_ACTION && (message == WM_LBUTTONDOWN || message == WM_RBUTTONDOWN || message == WM_MBUTTONDOWN)) {
+            typingHook(KeyPress{}); // a click may move the caret
+        }
+        return CallNextHookEx(nullptr, code, message, data);
+    }
+}
+
+bool installTypingHook(std::function<bool(const KeyPress &)> onKey) {
+    removeTypingHook();
+    typingHook = std::move(onKey);
+    const HINSTANCE module = GetModuleHandleW(nullptr);
+    keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, onKeyboardEvent, module, 0);
+    mouseHook = SetWindowsHookExW(WH_MOUSE_LL, onMouseEvent, module, 0);
+    if (keyboardHook && mouseHook) {
+        DEBUG_PRINT(L"[typing] Watching typing");
+        return true;
+    }
+    DEBUG_PRINT(L"[typing] Could not install the keyboard hook");
+    removeTypingHook();
+    return false;
+}
+
+void removeTypingHook() {
+    if (keyboardHook) UnhookWindowsHookEx(keyboardHook);
+    if (mouseHook) UnhookWindowsHookEx(mouseHook);
+    keyboardHook = mouseHook = nullptr;
+    typingWindow = nullptr;
+    typingHook = nullptr;
+}
@@ -0,0 +1,100 @@
+// this is process_memory.cpp
+
+#include "process_memory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#include <vector>
+#else
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#endif
+
+#ifdef _WIN32
+
+ProcessMemory processMemory() {
+    ProcessMemory memory;
+    const HANDLE self = GetCurrentProcess();
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    counters.cb = sizeof counters;
+    if (!GetProcessMemoryInfo(self, reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&counters), sizeof counters)) {
+        return memory;
+    }
+    memory.committedBytes = counters.PrivateUsage;
+
+    // One entry per resident page, each saying whether it can be shared.
+    // The set may grow between asking its size and reading it.
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    std::vector<ULONG_PTR> entries(counters.WorkingSetSize / system.dwPageSize + 1024);
+    while (!QueryWorkingSet(self, entries.data(), static_cast<DWORD>(entries.size() * sizeof(ULONG_PTR)))) {
+        if (GetLastError() != ERROR_BAD_LENGTH) return memory;
+        entries.resize(entries[0] + 1024); // the first word is the entry count
+    }
+    const auto *set = reinterpret_cast<const PSAPI_WORKING_SET_INFORMATION *>(entries.data());
+    for (ULONG_PTR i = 0; i < set->NumberOfEntries; ++i) {
+        (set->WorkingSetInfo[i].Shared ? memory.sharedBytes : memory.privateBytes) += system.dwPageSize;
+    }
+    memory.valid = true;
+    return memory;
+}
+
+void trimProcessMemory() {
+    _heapmin();
+    SetProcessWorkingSetSize(GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+}
+
+#else
+
+// Anonymous pages are the process's own; resident file-backed ones (code,
+// read-only data, mapped models) are what another process can share.
+ProcessMemory processMemory() {
+    ProcessMemory memory;
+    if (std::FILE *rollup = std::fopen("/proc/self/smaps_rollup", "r")) {
+        std::size_t resident = 0, anonymous = 0, swapped = 0;
+        char line[256];
+        while (std::fgets(line, sizeof line, rollup)) {
+            char key[64];
+            unsigned long long kb = 0;
+            if (std::sscanf(line, "%63[^:]: %llu kB", key, &kb) != 2) continue;
+            const std::size_t bytes = static_cast<std::size_t>(kb) << 10;
+            if (std::strcmp(key, "Rss") == 0) resident = bytes;
+            else if (std::strcmp(key, "Anonymous") == 0) anonymous = bytes;
+            else if (std::strcmp(key, "Swap") == 0) swapped = bytes;
+        }
+        std::fclose(rollup);
+        memory.privateBytes = anonymous;
+        memory.sharedBytes = resident > anonymous ? resident - anonymous : 0;
+        memory.committedBytes = anonymous + swapped;
+        memory.valid = resident != 0;
+        if (memory.valid) return memory;
+    }
+
+    // Kernels before 4.14: resident and file-backed pages only.
+    if (std::FILE *statm = std::fopen("/proc/self/statm", "r")) {
+        unsigned long long size = 0, resident = 0, shared = 0;
+        if (std::fscanf(statm, "%llu %llu %llu", &size, &resident, &shared) == 3 && resident >= shared) {
+            const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            memory.privateBytes = memory.committedBytes = static_cast<std::size_t>(resident - shared) * page;
+            memory.sharedBytes = static_cast<std::size_t>(shared) * page;
+            memory.valid = true;
+        }
+        std::fclose(statm);
+    }
+    return memory;
+}
+
+void trimProcessMemory() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
+
+#endif
@@ -0,0 +1,32 @@
+// this is process_memory.h
+#pragma once
+
+#include <cstddef>
+
+// ─── Process Footprint ─────────────────────────────────────────────────
+
+/// What this process costs the machine, as the OS counts it.
+struct ProcessMemory {
+    /// Resident pages no other process can share: heap, stacks, written
+    /// data. On a terminal server every session pays this again.
+    std::size_t privateBytes = 0;
+    /// Resident pages that can be shared with other processes: code,
+    /// read-only data (the presets' keymap tables) and mapped models. Every
+    /// session running the same binary shares one copy.
+    std::size_t sharedBytes = 0;
+    /// Private memory committed whether resident or paged out (Windows'
+    /// "commit size"; anonymous memory plus swap elsewhere). Trimming the
+    /// working set doesn't lower it; freeing memory does.
+    std::size_t committedBytes = 0;
+
+    /// False if the OS wouldn't say.
+    bool valid = false;
+};
+
+/// Measure this process now. Walks the working set, so it costs on the
+/// order of a millisecond; not for every key.
+ProcessMemory processMemory();
+
+/// Hand freed heap back to the OS and, on Windows, empty the working set:
+/// pages come back (from memory, not disk) when next touched.
+void trimProcessMemory();
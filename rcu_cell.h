@@ -0,0 +1,110 @@
+// this is rcu_cell.h
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// ─── Read-Copy-Update Cell ─────────────────────────────────────────────
+
+/// Holds one immutable T that readers use without locks while a writer
+/// replaces it. publish() swaps the pointer, then waits until every reader
+/// that might still hold the old value is done before deleting it.
+///
+/// Readers register in one of two counters picked by the current epoch;
+/// publish() flips the epoch and waits only for the old counter to drain,
+/// so a steady stream of new readers can't hold it up.
+///
+/// Readers nest: a Reader taken while the same thread already holds one
+/// for this cell sees the same value, so everything done under one outer
+/// Reader sees one consistent T. A thread holding a Reader must not call
+/// publish() on the same cell.
+template<typename T>
+class RcuCell {
+public:
+    explicit RcuCell(std::unique_ptr<const T> initial) : value_(initial.release()) {
+    }
+
+    ~RcuCell() { delete value_.load(); }
+
+    RcuCell(const RcuCell &) = delete;
+    RcuCell &operator=(const RcuCell &) = delete;
+
+    class Reader {
+    public:
+        explicit Reader(const RcuCell &cell) noexcept : cell_(cell) {
+            Pin &pin = threadPin();
+            if (pin.depth > 0 && pin.cell == &cell) {
+                value_ = pin.value;
+                ++pin.depth;
+                kind_ = Kind::Nested;
+                return;
+            }
+
+            unsigned epoch;
+            for (;;) {
+                epoch = cell.epoch_.load();
+                cell.readers_[epoch & 1].fetch_add(1);
+                if (cell.epoch_.load() == epoch) break;
+                cell.readers_[epoch & 1].fetch_sub(1); // a publish flipped in between
+            }
+            slot_ = epoch & 1;
+            value_ = cell.value_.load();
+
+            if (pin.depth == 0) {
+                pin = {&cell, value_, 1};
+                kind_ = Kind::Outer;
+            }
+        }
+
+        ~Reader() {
+            if (kind_ != Kind::Independent) --threadPin().depth;
+            if (kind_ != Kind::Nested) cell_.readers_[slot_].fetch_sub(1);
+        }
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        const T &operator*() const noexcept { return *value_; }
+        const T *operator->() const noexcept { return value_; }
+
+    private:
+        // Outer: first on this thread, pins the value; Nested: reuses it;
+        // Independent: taken while the thread pins another cell.
+        enum class Kind { Outer, Nested, Independent };
+
+        const RcuCell &cell_;
+        const T *value_ = nullptr;
+        unsigned slot_ = 0;
+        Kind kind_ = Kind::Independent;
+    };
+
+    Reader read() const noexcept { return Reader(*this); }
+
+    /// Make next the value new readers see; returns once the old one is freed.
+    void publish(std::unique_ptr<const T> next) {
+        std::lock_guard lock(writer_);
+        const T *old = value_.exchange(next.release());
+        const unsigned epoch = epoch_.fetch_add(1); // new readers use the other counter
+        while (readers_[epoch & 1].load() != 0) std::this_thread::yield();
+        delete old;
+    }
+
+private:
+    struct Pin {
+        const RcuCell *cell = nullptr;
+        const T *value = nullptr;
+        unsigned depth = 0;
+    };
+
+    static Pin &threadPin() noexcept {
+        thread_local Pin pin;
+        return pin;
+    }
+
+    std::atomic<const T *> value_;
+    mutable std::atomic<unsigned> epoch_{0};
+    mutable std::atomic<unsigned> readers_[2]{};
+    std::mutex writer_;
+};
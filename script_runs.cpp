@@ -0,0 +1,128 @@
+// this is script_runs.cpp
+
+#include "script_runs.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+namespace {
+    bool isBreak(const wchar_t ch) noexcept {
+        return ch == L' ' || ch == L'\t' || ch == L'\n' || ch == L'\r';
+    }
+
+    /// Runs shorter than this are mapped unit by unit: in text mixed word
+    /// by word, dispatching to a kernel would cost more than the run.
+    constexpr std::size_t kShortRun = 32;
+
+    /// Writes each run to the same offsets of dst, through the tables.
+    struct InPlace {
+        const LayoutMatrix &tables;
+        const wchar_t *src;
+        wchar_t *dst;
+
+        void keep(const std::size_t begin, const std::size_t end) const {
+            if (src != dst) std::copy(src + begin, src + end, dst + begin);
+        }
+        void convert(const Direction d, const std::size_t begin, const std::size_t end) const {
+            const KeymapTable &table = tables.table(d);
+            if (end - begin >= kShortRun) {
+                table.apply(src + begin, end - begin, dst + begin);
+                return;
+            }
+            for (std::size_t i = begin; i < end; ++i) dst[i] = table.map(src[i]);
+        }
+    };
+
+    /// Appends each run to a string, through the transducers.
+    struct Appending {
+        const LayoutMatrix &tables;
+        std::wstring_view src;
+        std::wstring &out;
+
+        void keep(const std::size_t begin, const std::size_t end) const {
+            out.append(src.substr(begin, end - begin));
+        }
+        void convert(const Direction d, const std::size_t begin, const std::size_t end) const {
+            tables.transducer(d).apply(src.substr(begin, end - begin), out);
+        }
+    };
+
+    template<typename Sink>
+    Direction convertRuns(const ScriptTable &scripts, const LayoutId *next, const LayoutId fallback,
+                          const wchar_t *src, const std::size_t n, const Sink &sink,
+                          ScriptRunConverter::Carry &carry) {
+        std::size_t chars[LayoutMatrix::MAX_LAYOUTS] = {};
+        std::size_t done = 0; // everything before it is written
+
+        // Units [done, i) are the open run, typed in open; until a unit
+        // only one layout types turns up, its layout isn't known.
+        LayoutId open = carry.layout;
+        std::uint8_t openBit = carry.bit;
+        auto finish = [&](const std::size_t end, const LayoutId layout) {
+            if (layout == NO_LAYOUT || next[layout] == NO_LAYOUT) {
+                sink.keep(done, end);
+            } else {
+                sink.convert({layout, next[layout]}, done, end);
+                chars[layout] += end - done;
+            }
+            done = end;
+        };
+
+        // Units any layout types and units of the open run's layout both
+        // pass the one test, so the loop only branches where runs change.
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::uint8_t bit = scripts.layoutBit(src[i]);
+            if ((bit & ~openBit) == 0) continue;
+            if (open != NO_LAYOUT) {
+                // Back over the units no one layout types. After a unit of
+                // the open run in this word they stay with it; starting the
+                // word, they go with this unit's run.
+                std::size_t split = i;
+                while (split > done && !isBreak(src[split - 1]) && scripts.layoutBit(src[split - 1]) == 0) --split;
+                if (split > done && !isBreak(src[split - 1])) split = i;
+                finish(split, open);
+            }
+            open = static_cast<LayoutId>(std::countr_zero(bit));
+            openBit = bit;
+        }
+        finish(n, open != NO_LAYOUT ? open : fallback);
+        carry = {open, openBit};
+
+        std::size_t best = 0;
+        for (std::size_t l = 1; l < LayoutMatrix::MAX_LAYOUTS; ++l) {
+            if (chars[l] > chars[best]) best = l;
+        }
+        return chars[best] > 0 ? Direction{static_cast<LayoutId>(best), next[best]} : Direction{};
+    }
+}
+
+ScriptRunConverter::ScriptRunConverter(const LayoutMatrix &tables, const FunctionRef<LayoutId(LayoutId)> next,
+                                       const LayoutId fallback)
+    : tables_(tables), fallback_(fallback < tables.layouts() ? fallback : NO_LAYOUT) {
+    std::fill(std::begin(next_), std::end(next_), NO_LAYOUT);
+    for (std::size_t l = 0; l < tables.layouts(); ++l) {
+        const LayoutId to = next(static_cast<LayoutId>(l));
+        if (to < tables.layouts() && to != l) next_[l] = to;
+    }
+}
+
+Direction ScriptRunConverter::convert(const wchar_t *src, const std::size_t n, wchar_t *dst) const noexcept {
+    Carry carry;
+    return convert(src, n, dst, carry);
+}
+
+Direction ScriptRunConverter::convert(const std::wstring_view src, std::wstring &out) const {
+    Carry carry;
+    return convert(src, out, carry);
+}
+
+Direction ScriptRunConverter::convert(const wchar_t *src, const std::size_t n, wchar_t *dst,
+                                      Carry &carry) const noexcept {
+    return convertRuns(tables_.scripts(), next_, fallback_, src, n, InPlace{tables_, src, dst}, carry);
+}
+
+Direction ScriptRunConverter::convert(const std::wstring_view src, std::wstring &out, Carry &carry) const {
+    return convertRuns(tables_.scripts(), next_, fallback_, src.data(), src.size(), Appending{tables_, src, out},
+                       carry);
+}
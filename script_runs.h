@@ -0,0 +1,57 @@
+// this is script_runs.h
+#pragma once
+
+#include "function_ref.h"
+#include "layout_matrix.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ─── Per-Script Conversion ─────────────────────────────────────────────
+
+/// Converts a selection typed partly in one layout and partly in another,
+/// each part out of the layout that typed it. The text is cut into runs by
+/// the script of its characters (LayoutMatrix::scripts()); a character no
+/// single layout types (digits, spaces, punctuation on both layouts) joins
+/// a run next to it: the one before it in the same word, else the one after
+/// it in the same word, else the one before it, so in "שלום, ,usv" the
+/// first comma converts with the Hebrew run and the second with the Latin
+/// letters after it, and in "שלום,abc" the comma stays Hebrew. Text with
+/// no run at all reads as the fallback layout.
+///
+/// One pass over the text: each unit costs a table lookup, and every run is
+/// converted straight from the source by its pair's table (or transducer)
+/// as soon as the next run starts, with nothing copied in between.
+class ScriptRunConverter {
+public:
+    /// A run typed in layout l converts to next(l) (NO_LAYOUT or l: it stays
+    /// as typed). tables must outlive the converter.
+    ScriptRunConverter(const LayoutMatrix &tables, FunctionRef<LayoutId(LayoutId)> next, LayoutId fallback);
+
+    /// Convert n units of src into dst (same length; dst may alias src),
+    /// ignoring multi-unit keys. Returns the conversion most characters took.
+    Direction convert(const wchar_t *src, std::size_t n, wchar_t *dst) const noexcept;
+
+    /// Same, appending to out through the pairs' transducers, so keys that
+    /// type more than one unit convert too.
+    Direction convert(std::wstring_view src, std::wstring &out) const;
+
+    /// The run a piece of a longer text ended in. Passed from one piece to
+    /// the next, pieces cut between words convert as the whole text would:
+    /// what starts a piece before its first run joins the run before it.
+    struct Carry {
+        LayoutId layout = NO_LAYOUT;
+        std::uint8_t bit = 0;
+    };
+
+    /// convert() for the next piece of a text; carry starts default.
+    Direction convert(const wchar_t *src, std::size_t n, wchar_t *dst, Carry &carry) const noexcept;
+    Direction convert(std::wstring_view src, std::wstring &out, Carry &carry) const;
+
+private:
+    const LayoutMatrix &tables_;
+    LayoutId next_[LayoutMatrix::MAX_LAYOUTS];
+    LayoutId fallback_;
+};
@@ -0,0 +1,52 @@
+// this is spsc_queue.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+
+// ─── Single-Producer / Single-Consumer Queue ───────────────────────────
+
+/// Fixed-capacity ring for one producer thread and one consumer thread.
+/// Neither side ever blocks or takes a lock; each index is written by one
+/// side only and lives on its own cache line.
+template<typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    /// Producer side; false if the queue is full.
+    bool push(const T &value) noexcept {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == Capacity) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == Capacity) return false;
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side; nullopt if the queue is empty.
+    std::optional<T> pop() noexcept {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) return std::nullopt;
+        }
+        T value = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    static constexpr std::size_t kLine = 64;
+
+    alignas(kLine) std::atomic<std::size_t> head_{0}; // written by the consumer
+    std::size_t tailCache_ = 0;                        // consumer's last view of tail_
+    alignas(kLine) std::atomic<std::size_t> tail_{0}; // written by the producer
+    std::size_t headCache_ = 0;                        // producer's last view of head_
+    alignas(kLine) std::array<T, Capacity> slots_{};
+};
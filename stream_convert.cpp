@@ -0,0 +1,225 @@
+// this is stream_convert.cpp
+
+#include "stream_convert.h"
+#include "spsc_queue.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StreamConverter::Chunk {
+    std::string owned;       // the bytes, when read from a source
+    std::string_view input;  // views owned or the caller's memory
+    std::string buffer;      // converted bytes; a forced conversion keeps its largest size
+    std::string_view output; // views buffer, or input when nothing converts
+};
+
+namespace {
+    constexpr std::size_t kLaneDepth = 4;      // chunks queued per transform thread, each way
+    constexpr std::size_t kChunksPerWorker = 3; // in flight: one read, one converting, one written
+
+    /// A SpscQueue whose ends wait instead of failing when it is full or empty.
+    template<typename T, std::size_t Capacity>
+    class WaitingQueue {
+    public:
+        void push(const T &value) {
+            for (;;) {
+                const std::uint32_t seen = popped_.load(std::memory_order_acquire);
+                if (queue_.push(value)) break;
+                popped_.wait(seen, std::memory_order_acquire);
+            }
+            pushed_.fetch_add(1, std::memory_order_release);
+            pushed_.notify_one();
+        }
+
+        T pop() {
+            for (;;) {
+                const std::uint32_t seen = pushed_.load(std::memory_order_acquire);
+                if (auto value = queue_.pop()) {
+                    popped_.fetch_add(1, std::memory_order_release);
+                    popped_.notify_one();
+                    return *value;
+                }
+                pushed_.wait(seen, std::memory_order_acquire);
+            }
+        }
+
+    private:
+        SpscQueue<T, Capacity> queue_;
+        std::atomic<std::uint32_t> pushed_{0}, popped_{0};
+    };
+
+    /// Where to end a chunk within bytes: after the last whitespace, else at
+    /// the last whole character.
+    std::size_t cutPoint(const std::string_view bytes) noexcept {
+        const std::size_t space = bytes.find_last_of(" \t\r\n");
+        if (space != std::string_view::npos) return space + 1;
+        const std::size_t whole = utf8CompleteLength(bytes);
+        return whole > 0 ? whole : bytes.size();
+    }
+}
+
+StreamConverter::StreamConverter(const LayoutMatrix &keymaps, const std::span<const NgramModel *const> models,
+                                 Options options)
+    : keymaps_(keymaps), models_(models.first(std::min(models.size(), keymaps.layouts()))), options_(options) {
+    if (options_.workers == 0) {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        options_.workers = hardware > 2 ? hardware - 2 : 1;
+    }
+    options_.workers = std::clamp(options_.workers, 1u, MAX_WORKERS);
+    options_.chunkBytes = std::max<std::size_t>(options_.chunkBytes, 64);
+}
+
+bool StreamConverter::possible() const noexcept {
+    const Direction d = options_.direction;
+    if (d.converts()) return d.from < keymaps_.layouts() && d.to < keymaps_.layouts();
+    return models_.size() >= 2;
+}
+
+void StreamConverter::convert(Chunk &chunk, std::wstring &wide, std::wstring &converted) const {
+    wide.clear();
+    converted.clear();
+
+    const Direction d = options_.direction;
+    if (d.converts() && d.from < keymaps_.layouts() && d.to < keymaps_.layouts()) {
+        const KeymapTransducer &keymap = keymaps_.transducer(d);
+        // UTF-8 to UTF-8 in one pass over the chunk. Sized for every byte
+        // becoming two (Latin to Hebrew, Arabic, Cyrillic), the buffer rarely
+        // needs to grow; it only ever grows, so later chunks don't clear it.
+        std::string &buffer = chunk.buffer;
+        buffer.resize(std::max(buffer.size(), 2 * chunk.input.size() + 64));
+        std::string_view rest = chunk.input;
+        std::size_t written = 0;
+        for (;;) {
+            const auto progress = keymap.applyUtf8(rest, std::span(buffer).subspan(written));
+            written += progress.written;
+            rest.remove_prefix(progress.read);
+            if (rest.empty()) break;
+            buffer.resize(buffer.size() * 2);
+        }
+        chunk.output = std::string_view(buffer).substr(0, written);
+        return;
+    }
+    if (models_.size() >= 2) {
+        decodeUtf8(chunk.input, wide);
+        DirectionScorer(models_, keymaps_).convert(wide, converted, Direction{});
+        chunk.buffer.clear();
+        encodeUtf8(converted, chunk.buffer);
+        chunk.output = chunk.buffer;
+        return;
+    }
+    chunk.output = chunk.input;
+}
+
+template<typename Fill>
+StreamConverter::Stats StreamConverter::pipeline(Fill &fill, ByteSink &out) const {
+    const unsigned workers = options_.workers;
+    using Lane = WaitingQueue<Chunk *, kLaneDepth>;
+    std::vector<std::unique_ptr<Lane>> inbox, outbox;
+    for (unsigned w = 0; w < workers; ++w) {
+        inbox.push_back(std::make_unique<Lane>());
+        outbox.push_back(std::make_unique<Lane>());
+    }
+
+    // Every chunk is in exactly one place: free, in a lane, or with a stage.
+    static_assert(MAX_WORKERS * kChunksPerWorker <= 64);
+    WaitingQueue<Chunk *, 64> free;
+    std::vector<std::unique_ptr<Chunk>> pool;
+    for (std::size_t i = 0; i < workers * kChunksPerWorker; ++i) {
+        pool.push_back(std::make_unique<Chunk>());
+        free.push(pool.back().get());
+    }
+
+    Stats stats;
+    stats.workers = workers;
+    std::atomic<bool> failed{false};
+
+    std::vector<std::thread> transform;
+    for (unsigned w = 0; w < workers; ++w) {
+        transform.emplace_back([this, &in = *inbox[w], &done = *outbox[w]] {
+            std::wstring wide, converted;
+            while (Chunk *chunk = in.pop()) {
+                convert(*chunk, wide, converted);
+                done.push(chunk);
+            }
+            done.push(nullptr);
+        });
+    }
+
+    // Chunk i goes through transform thread i % workers, so taking the
+    // outboxes in turn restores the order.
+    std::thread writer([&] {
+        for (std::uint64_t i = 0;; ++i) {
+            Chunk *chunk = outbox[i % workers]->pop();
+            if (!chunk) break;
+            if (!failed.load(std::memory_order_relaxed)) {
+                if (out.write(chunk->output)) {
+                    stats.bytesOut += chunk->output.size();
+                } else {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            free.push(chunk);
+        }
+    });
+
+    for (std::uint64_t i = 0; !failed.load(std::memory_order_relaxed); ++i) {
+        Chunk *chunk = free.pop();
+        if (!fill(*chunk)) {
+            free.push(chunk);
+            break;
+        }
+        stats.bytesIn += chunk->input.size();
+        ++stats.chunks;
+        inbox[i % workers]->push(chunk);
+    }
+    for (auto &lane: inbox) lane->push(nullptr);
+
+    writer.join();
+    for (auto &thread: transform) thread.join();
+    stats.ok = !failed.load();
+    return stats;
+}
+
+StreamConverter::Stats StreamConverter::run(const std::string_view input, ByteSink &out) const {
+    std::size_t at = 0;
+    auto fill = [&](Chunk &chunk) {
+        if (at >= input.size()) return false;
+        const std::string_view rest = input.substr(at);
+        const std::size_t take = rest.size() <= options_.chunkBytes ? rest.size()
+                                                                   : cutPoint(rest.substr(0, options_.chunkBytes));
+        chunk.input = rest.substr(0, take);
+        at += take;
+        return true;
+    };
+    return pipeline(fill, out);
+}
+
+StreamConverter::Stats StreamConverter::run(ByteSource &source, ByteSink &out) const {
+    std::string carry; // read past the last cut; starts the next chunk
+    bool ended = false;
+    auto fill = [&](Chunk &chunk) {
+        chunk.owned.assign(carry);
+        carry.clear();
+        while (!ended && chunk.owned.size() < options_.chunkBytes) {
+            const std::size_t used = chunk.owned.size();
+            chunk.owned.resize(options_.chunkBytes);
+            const std::size_t n = source.read(chunk.owned.data() + used, options_.chunkBytes - used);
+            chunk.owned.resize(used + n);
+            ended = n == 0;
+        }
+        if (chunk.owned.empty()) return false;
+        if (!ended) {
+            const std::size_t cut = cutPoint(chunk.owned);
+            carry.assign(chunk.owned, cut);
+            chunk.owned.resize(cut);
+        }
+        chunk.input = chunk.owned;
+        return true;
+    };
+    return pipeline(fill, out);
+}
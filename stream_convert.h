@@ -0,0 +1,92 @@
+// this is stream_convert.h
+#pragma once
+
+#include "layout_matrix.h"
+#include "ngram.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// ─── Bulk Conversion ───────────────────────────────────────────────────
+
+/// Where converted UTF-8 goes.
+class ByteSink {
+public:
+    virtual ~ByteSink() = default;
+
+    /// False if the bytes couldn't be written; the conversion then stops.
+    virtual bool write(std::string_view bytes) = 0;
+};
+
+/// UTF-8 input that can't be mapped, such as a pipe.
+class ByteSource {
+public:
+    virtual ~ByteSource() = default;
+
+    /// Read up to capacity bytes into dst; 0 at the end of the input.
+    virtual std::size_t read(char *dst, std::size_t capacity) = 0;
+};
+
+/// Converts UTF-8 text of any size through a reader → transform → writer
+/// pipeline, for repairing exported logs and files rather than selections.
+///
+/// The reader cuts the input into chunks at whitespace, so no run the scorer
+/// weighs and no multi-unit key is split. Chunks go round-robin to the
+/// transform threads and the writer takes them back in the same order. A
+/// fixed pool of chunks bounds the memory in flight; a stage that gets ahead
+/// waits for one to come back.
+///
+/// A forced conversion goes UTF-8 to UTF-8 in one pass through
+/// KeymapTransducer::applyUtf8(). Its cost is the per-character work in
+/// the codec and table kernels, not memory bandwidth, so it runs well below
+/// memcpy, and only extra cores make it faster. Scoring decodes each chunk
+/// and is bound by the models' lookups.
+class StreamConverter {
+public:
+    static constexpr unsigned MAX_WORKERS = 16;
+
+    struct Options {
+        /// Forced conversion; when it doesn't convert, each run is scored
+        /// with the models instead (every pair a candidate).
+        Direction direction;
+        /// Transform threads; 0 picks from the hardware, leaving room for the
+        /// reader and the writer.
+        unsigned workers = 0;
+        /// Target size of a chunk; a chunk ends at whitespace before it.
+        std::size_t chunkBytes = std::size_t{1} << 20;
+    };
+
+    struct Stats {
+        std::uint64_t bytesIn = 0;
+        std::uint64_t bytesOut = 0;
+        std::uint64_t chunks = 0;
+        unsigned workers = 0;
+        bool ok = true; // false if the sink failed
+    };
+
+    /// keymaps and models (one per layout, or none) must outlive the converter.
+    StreamConverter(const LayoutMatrix &keymaps, std::span<const NgramModel *const> models, Options options);
+
+    /// False when neither a forced direction nor models are available.
+    bool possible() const noexcept;
+
+    /// Convert input held in memory, e.g. a mapped file; chunks view it in place.
+    Stats run(std::string_view input, ByteSink &out) const;
+
+    /// Convert input read from source.
+    Stats run(ByteSource &source, ByteSink &out) const;
+
+private:
+    struct Chunk;
+
+    template<typename Fill>
+    Stats pipeline(Fill &fill, ByteSink &out) const;
+
+    void convert(Chunk &chunk, std::wstring &wide, std::wstring &converted) const;
+
+    const LayoutMatrix &keymaps_;
+    std::span<const NgramModel *const> models_;
+    Options options_;
+};
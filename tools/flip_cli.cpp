@@ -0,0 +1,237 @@
+// this is tools/flip_cli.cpp
+//
+// Converts wrong-layout text in files of any size, without a desktop:
+//   language_flipper_cli [-c config.json] [-f FROM [-t TO]] [-o out.txt] [-j threads] [file...]
+// Files are memory-mapped; with no file (or "-") it reads stdin. Without
+// --from every run is scored with the layouts' models, as DIRECTION_MODE
+// "auto" does. Input and output are UTF-8.
+//
+// With --serve it converts for editor plugins over a local endpoint
+// instead (IpcServer), until interrupted.
+
+#include "config.h"
+#include "ipc_server.h"
+#include "mapped_file.h"
+#include "ngram.h"
+#include "stream_convert.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+    class FileSink final : public ByteSink {
+    public:
+        explicit FileSink(std::FILE *file) : file_(file) {
+        }
+
+        bool write(const std::string_view bytes) override {
+            return std::fwrite(bytes.data(), 1, bytes.size(), file_) == bytes.size();
+        }
+
+    private:
+        std::FILE *file_;
+    };
+
+    class FileSource final : public ByteSource {
+    public:
+        explicit FileSource(std::FILE *file) : file_(file) {
+        }
+
+        std::size_t read(char *dst, const std::size_t capacity) override {
+            return std::fread(dst, 1, capacity, file_);
+        }
+
+    private:
+        std::FILE *file_;
+    };
+
+    void usage(const char *program) {
+        std::cerr << "usage: " << program
+                << " [-c config.json] [-f FROM [-t TO]] [-o out] [-j threads] [--chunk-kb N] [--stats] [file...]\n"
+                << "       " << program << " [-c config.json] [-j threads] --serve NAME\n"
+                   "  -f, --from NAME   layout the text was typed in (a NAME from LAYOUTS)\n"
+                   "  -t, --to NAME     layout it was meant for; default: the next in LAYOUT_CYCLE\n"
+                   "                    without --from each run is scored with the models\n"
+                   "  -o, --output FILE write here instead of stdout\n"
+                   "  -j, --threads N   transform threads (default: from the hardware)\n"
+                   "      --stats       report throughput on stderr\n"
+                   "      --serve NAME  serve conversions on the endpoint NAME until interrupted\n"
+                   "                    (-j sets its threads)\n";
+    }
+
+    volatile std::sig_atomic_t stopping = 0;
+
+    int serve(const config::Settings &settings, const std::string &name, const unsigned threads) {
+        const std::string endpoint = ipc::endpointPath(name);
+        const auto server = IpcServer::listen(endpoint, threads ? threads : 2, settings,
+                                              IpcServer::modelsFor(settings));
+        if (!server) {
+            std::cerr << "cannot serve on " << endpoint << "\n";
+            return 1;
+        }
+        std::cerr << "serving on " << endpoint << " with " << server->threads() << " threads\n";
+        std::signal(SIGINT, [](int) { stopping = 1; });
+        std::signal(SIGTERM, [](int) { stopping = 1; });
+        while (!stopping) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const auto stats = server->stats();
+        std::cerr << stats.connections << " connections, " << stats.requests << " requests\n";
+        return 0;
+    }
+
+    LayoutId findLayout(const config::Settings &settings, const std::string &name) {
+        const std::wstring wide = config::utf8_to_wstring(name);
+        for (std::size_t i = 0; i < settings.LAYOUTS.size(); ++i) {
+            if (settings.LAYOUTS[i].name == wide) return static_cast<LayoutId>(i);
+        }
+        return NO_LAYOUT;
+    }
+}
+
+int main(const int argc, char **argv) {
+    std::string configPath, outputPath, from, to, serveName;
+    std::vector<std::string> inputs;
+    StreamConverter::Options options;
+    bool stats = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "-c" || arg == "--config") configPath = value();
+        else if (arg == "-f" || arg == "--from") from = value();
+        else if (arg == "-t" || arg == "--to") to = value();
+        else if (arg == "-o" || arg == "--output") outputPath = value();
+        else if (arg == "-j" || arg == "--threads") options.workers = static_cast<unsigned>(std::atoi(value().c_str()));
+        else if (arg == "--chunk-kb") options.chunkBytes = std::strtoull(value().c_str(), nullptr, 10) << 10;
+        else if (arg == "--stats") stats = true;
+        else if (arg == "--serve") serveName = value();
+        else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else inputs.push_back(arg);
+    }
+    if (inputs.empty()) inputs.emplace_back("-");
+
+    // Keep config messages off stdout, which may be the output.
+    config::Settings quiet;
+    quiet.DEBUG_MODE = false;
+    config::publish(quiet);
+
+    config::Settings settings = quiet;
+    if (configPath.empty() && std::filesystem::exists("config.json")) configPath = "config.json";
+    if (!configPath.empty()) {
+        auto parsed = config::parse(configPath);
+        if (!parsed) {
+            std::cerr << "cannot use " << configPath << "\n";
+            return 1;
+        }
+        settings = std::move(*parsed);
+    }
+    if (!serveName.empty()) return serve(settings, serveName, options.workers);
+
+    // Forced direction, or models for scoring.
+    std::vector<NgramModelFile> files;
+    std::vector<const NgramModel *> models;
+    if (!from.empty()) {
+        const LayoutId source = findLayout(settings, from);
+        const LayoutId target = to.empty() ? settings.nextLayout(source) : findLayout(settings, to);
+        if (source == NO_LAYOUT || target == NO_LAYOUT || source == target) {
+            std::cerr << "unknown or identical layouts; LAYOUTS names them\n";
+            return 2;
+        }
+        options.direction = {source, target};
+    } else {
+        for (const auto &layout: settings.LAYOUTS) {
+            files.push_back(NgramModelFile::open(layout.model));
+            if (!files.back().model().valid()) {
+                std::cerr << "cannot load the model " << layout.model << "; pass --from to convert by layout\n";
+                return 1;
+            }
+        }
+        for (const auto &file: files) models.push_back(&file.model());
+    }
+
+    const StreamConverter converter(settings.KEYMAPS, models, options);
+    if (!converter.possible()) {
+        std::cerr << "nothing to convert with\n";
+        return 1;
+    }
+
+    std::FILE *output = stdout;
+    if (!outputPath.empty()) {
+        output = std::fopen(outputPath.c_str(), "wb");
+        if (!output) {
+            std::cerr << "cannot write " << outputPath << "\n";
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    FileSink sink(output);
+
+    StreamConverter::Stats total;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &input: inputs) {
+        StreamConverter::Stats one;
+        MappedFile mapped;
+        if (input != "-") mapped = MappedFile::open(input);
+        if (mapped) {
+            one = converter.run(std::string_view(static_cast<const char *>(mapped.data()), mapped.size()), sink);
+        } else {
+            // stdin, or a file that can't be mapped (empty, a pipe or a device).
+            std::FILE *file = input == "-" ? stdin : std::fopen(input.c_str(), "rb");
+            if (!file) {
+                std::cerr << "cannot read " << input << "\n";
+                return 1;
+            }
+            FileSource source(file);
+            one = converter.run(source, sink);
+            if (file != stdin) std::fclose(file);
+        }
+        total.bytesIn += one.bytesIn;
+        total.bytesOut += one.bytesOut;
+        total.chunks += one.chunks;
+        total.workers = one.workers;
+        if (!one.ok) {
+            std::cerr << "write failed\n";
+            return 1;
+        }
+    }
+    if (std::fflush(output) != 0 || (output != stdout && std::fclose(output) != 0)) {
+        std::cerr << "write failed\n";
+        return 1;
+    }
+
+    if (stats) {
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::fprintf(stderr, "%llu bytes in, %llu out, %llu chunks, %u threads, %.3f s, %.2f GB/s\n",
+                     static_cast<unsigned long long>(total.bytesIn), static_cast<unsigned long long>(total.bytesOut),
+                     static_cast<unsigned long long>(total.chunks), total.workers, seconds.count(),
+                     total.bytesIn / seconds.count() / 1e9);
+    }
+    return 0;
+}
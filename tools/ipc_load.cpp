@@ -0,0 +1,223 @@
+// this is tools/ipc_load.cpp
+//
+// Load test for the conversion service (IpcServer), as many editor plugins
+// would put on it at once:
+//   language_flipper_ipc_load [-c config.json] [-e NAME | --serve [-j threads]]
+//                             [--clients N] [--requests N] [--depth N] [--batch N]
+//                             [-f FROM] [-t TO] [--text TEXT]
+// Each client connects, keeps up to --depth requests in flight, written
+// --batch frames at a time, and checks every answer. Reports requests per
+// second and the latency of a request from its write to its answer.
+
+#include "config.h"
+#include "ipc_client.h"
+#include "ipc_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string endpoint;
+        Direction direction{ipc::AUTO, ipc::AUTO};
+        std::string text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit";
+        unsigned clients = 8;
+        unsigned requests = 20000; // per client
+        unsigned depth = 16;
+        unsigned batch = 4;
+    };
+
+    struct ClientResult {
+        std::vector<double> latencies; // microseconds
+        std::string error;
+    };
+
+    void usage(const char *program) {
+        std::cerr << "usage: " << program << " [-c config.json] [-e NAME | --serve [-j threads]] [--clients N]"
+                " [--requests N] [--depth N] [--batch N] [-f FROM] [-t TO] [--text TEXT]\n"
+                "  -e, --endpoint NAME service to load (default: IPC_ENDPOINT)\n"
+                "      --serve         start one in this process and load that\n"
+                "  -j, --threads N     its threads (default: IPC_THREADS)\n"
+                "      --clients N     connections, one thread each (default 8)\n"
+                "      --requests N    requests per connection (default 20000)\n"
+                "      --depth N       requests in flight per connection (default 16)\n"
+                "      --batch N       frames per write (default 4)\n"
+                "  -f, --from NAME     layout the text was typed in, or auto (default)\n"
+                "  -t, --to NAME       layout it was meant for, or auto (default)\n"
+                "      --text TEXT     UTF-8 text of every request\n";
+    }
+
+    LayoutId findLayout(const config::Settings &settings, const std::string &name) {
+        if (name == "auto") return ipc::AUTO;
+        const std::wstring wide = config::utf8_to_wstring(name);
+        for (std::size_t i = 0; i < settings.LAYOUTS.size(); ++i) {
+            if (settings.LAYOUTS[i].name == wide) return static_cast<LayoutId>(i);
+        }
+        std::cerr << "unknown layout " << name << "; LAYOUTS names them\n";
+        std::exit(2);
+    }
+
+    void runClient(const Options &options, ClientResult &result) {
+        const auto client = IpcClient::connect(options.endpoint);
+        if (!client) {
+            result.error = "cannot connect to " + options.endpoint;
+            return;
+        }
+        std::vector<Clock::time_point> sentAt(options.requests);
+        result.latencies.reserve(options.requests);
+        std::string out;
+        ipc::Frame frame;
+        std::uint32_t sent = 0, received = 0;
+        while (received < options.requests) {
+            // Top up what's in flight, a batch per write.
+            while (sent < options.requests && sent - received < options.depth) {
+                const std::uint32_t n = std::min({options.batch, options.requests - sent,
+                                                  options.depth - (sent - received)});
+                out.clear();
+                const auto now = Clock::now();
+                for (std::uint32_t i = 0; i < n; ++i, ++sent) {
+                    ipc::appendRequest(out, sent, options.direction, options.text);
+                    sentAt[sent] = now;
+                }
+                if (!client->send(out)) {
+                    result.error = "the service closed the connection";
+                    return;
+                }
+            }
+            if (!client->receive(frame)) {
+                result.error = "the service closed the connection";
+                return;
+            }
+            const auto now = Clock::now();
+            if (frame.id != received || ipc::responseStatus(frame) != ipc::Status::Ok) {
+                result.error = "answer " + std::to_string(frame.id) + " out of order or failed (status " +
+                               std::to_string(frame.tag[0]) + ")";
+                return;
+            }
+            result.latencies.push_back(std::chrono::duration<double, std::micro>(now - sentAt[received]).count());
+            ++received;
+        }
+    }
+
+    double percentile(const std::vector<double> &sorted, const double p) {
+        const auto at = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(at, sorted.size() - 1)];
+    }
+}
+
+int main(const int argc, char **argv) {
+    Options options;
+    std::string configPath, from = "auto", to = "auto";
+    bool serve = false;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        auto count = [&] { return static_cast<unsigned>(std::max(1, std::atoi(value().c_str()))); };
+        if (arg == "-c" || arg == "--config") configPath = value();
+        else if (arg == "-e" || arg == "--endpoint") options.endpoint = value();
+        else if (arg == "--serve") serve = true;
+        else if (arg == "-j" || arg == "--threads") threads = count();
+        else if (arg == "--clients") options.clients = count();
+        else if (arg == "--requests") options.requests = count();
+        else if (arg == "--depth") options.depth = count();
+        else if (arg == "--batch") options.batch = count();
+        else if (arg == "-f" || arg == "--from") from = value();
+        else if (arg == "-t" || arg == "--to") to = value();
+        else if (arg == "--text") options.text = value();
+        else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    config::Settings quiet;
+    quiet.DEBUG_MODE = false;
+    config::publish(quiet);
+
+    config::Settings settings = quiet;
+    if (configPath.empty() && std::filesystem::exists("config.json")) configPath = "config.json";
+    if (!configPath.empty()) {
+        auto parsed = config::parse(configPath);
+        if (!parsed) {
+            std::cerr << "cannot use " << configPath << "\n";
+            return 1;
+        }
+        settings = std::move(*parsed);
+    }
+    options.direction = {findLayout(settings, from), findLayout(settings, to)};
+
+    std::unique_ptr<IpcServer> server;
+    if (serve) {
+        std::string name = options.endpoint;
+        if (name.empty()) {
+#ifdef _WIN32
+            name = "language_flipper_load";
+#else
+            name = "language_flipper_load_" + std::to_string(getpid());
+#endif
+        }
+        options.endpoint = ipc::endpointPath(name);
+        server = IpcServer::listen(options.endpoint, threads ? threads : static_cast<unsigned>(settings.IPC_THREADS),
+                                   settings, IpcServer::modelsFor(settings));
+        if (!server) {
+            std::cerr << "cannot serve on " << options.endpoint << "\n";
+            return 1;
+        }
+    } else {
+        if (options.endpoint.empty()) options.endpoint = settings.IPC_ENDPOINT;
+        if (options.endpoint.empty()) {
+            std::cerr << "no endpoint: pass -e NAME or --serve, or set IPC_ENDPOINT\n";
+            return 2;
+        }
+        options.endpoint = ipc::endpointPath(options.endpoint);
+    }
+
+    std::vector<ClientResult> results(options.clients);
+    std::vector<std::thread> clients;
+    const auto start = Clock::now();
+    for (auto &result: results) clients.emplace_back(runClient, std::cref(options), std::ref(result));
+    for (auto &client: clients) client.join();
+    const std::chrono::duration<double> seconds = Clock::now() - start;
+
+    std::vector<double> latencies;
+    for (const auto &result: results) {
+        if (!result.error.empty()) {
+            std::cerr << result.error << "\n";
+            return 1;
+        }
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("%u clients x %u requests, depth %u, batch %u, %zu bytes each%s\n", options.clients,
+                options.requests, options.depth, options.batch, options.text.size(),
+                server ? (", served in-process on " + std::to_string(server->threads()) + " threads").c_str() : "");
+    std::printf("%.0f requests/s\n", static_cast<double>(latencies.size()) / seconds.count());
+    std::printf("latency us: p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", percentile(latencies, 0.5),
+                percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.back());
+    return 0;
+}
@@ -0,0 +1,126 @@
+// this is tools/ngram_train.cpp
+//
+// Builds a .lfng character trigram model from a UTF-8 text corpus:
+//   language_flipper_train <corpus.txt> <model.lfng> [tableBits]
+// Run by the build for every corpus in res/corpus/.
+
+#include "ngram.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    constexpr double kAlpha = 0.1; // additive smoothing
+
+    std::uint8_t quantize(const double bits) {
+        return static_cast<std::uint8_t>(std::clamp(std::lround(bits / NgramModel::COST_UNIT), 0L, 255L));
+    }
+
+    std::uint64_t pack(const std::uint32_t a, const std::uint32_t b) {
+        return static_cast<std::uint64_t>(a) << 32 | b;
+    }
+}
+
+int main(const int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <corpus.txt> <model.lfng> [tableBits]\n";
+        return 2;
+    }
+    const int tableBits = argc > 3 ? std::atoi(argv[3]) : 16;
+    if (tableBits < 8 || tableBits > 24) {
+        std::cerr << "tableBits must be 8..24\n";
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot read " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream raw;
+    raw << in.rdbuf();
+    std::wstring text;
+    if (const Utf8Status status = decodeUtf8(raw.str(), text); !status.ok()) {
+        std::cerr << "warning: " << status.errors << " invalid UTF-8 sequence(s) in " << argv[1]
+                  << " (first at byte " << status.firstError << ") read as U+FFFD\n";
+    }
+
+    // Count every trigram and its two-character context, runs padded with
+    // boundaries exactly as DirectionScorer pads them.
+    std::unordered_map<std::uint64_t, std::uint32_t> contexts;
+    std::unordered_map<std::uint64_t, std::unordered_map<std::uint32_t, std::uint32_t>> trigrams;
+    std::unordered_set<std::uint32_t> alphabet;
+    std::uint64_t total = 0;
+
+    std::uint32_t prev2 = NgramModel::BOUNDARY, prev1 = NgramModel::BOUNDARY;
+    auto add = [&](const std::uint32_t sym) {
+        ++contexts[pack(prev2, prev1)];
+        ++trigrams[pack(prev2, prev1)][sym];
+        ++total;
+        prev2 = prev1;
+        prev1 = sym;
+    };
+    bool inRun = false;
+    for (const wchar_t ch: text) {
+        const std::uint32_t sym = NgramModel::symbol(ch);
+        if (sym == NgramModel::BOUNDARY) {
+            if (inRun) add(NgramModel::BOUNDARY);
+            prev2 = prev1 = NgramModel::BOUNDARY;
+            inRun = false;
+            continue;
+        }
+        alphabet.insert(sym);
+        add(sym);
+        inRun = true;
+    }
+    if (inRun) add(NgramModel::BOUNDARY);
+    if (total == 0) {
+        std::cerr << "empty corpus\n";
+        return 1;
+    }
+
+    // Smoothed conditional costs; buckets shared by several trigrams keep
+    // the cheapest, unused buckets get the cost of an unseen trigram.
+    const double symbols = static_cast<double>(alphabet.size() + 1);
+    const double meanContext = static_cast<double>(total) / static_cast<double>(contexts.size());
+    const std::uint8_t unseen = quantize(-std::log2(kAlpha / (meanContext + kAlpha * symbols)));
+
+    std::vector<std::uint8_t> costs(std::size_t{1} << tableBits, unseen);
+    const unsigned shift = 32u - static_cast<unsigned>(tableBits);
+    for (auto const &[context, next]: trigrams) {
+        const double contextCount = contexts[context];
+        const auto a = static_cast<std::uint32_t>(context >> 32), b = static_cast<std::uint32_t>(context);
+        for (auto const &[sym, count]: next) {
+            const double p = (count + kAlpha) / (contextCount + kAlpha * symbols);
+            auto &bucket = costs[NgramModel::hash(a, b, sym) >> shift];
+            bucket = std::min(bucket, quantize(-std::log2(p)));
+        }
+    }
+
+    NgramHeader header{};
+    std::copy_n("LFNG", 4, header.magic);
+    header.version = NgramModel::VERSION;
+    header.order = 3;
+    header.tableBits = static_cast<std::uint8_t>(tableBits);
+    header.unseenCost = unseen;
+
+    std::ofstream out(argv[2], std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(costs.data()), static_cast<std::streamsize>(costs.size()));
+    if (!out) {
+        std::cerr << "cannot write " << argv[2] << "\n";
+        return 1;
+    }
+    std::printf("%s: %llu trigrams, %zu symbols, %zu contexts, unseen cost %.2f bits\n", argv[2],
+                static_cast<unsigned long long>(total), alphabet.size(), contexts.size(),
+                unseen * NgramModel::COST_UNIT);
+    return 0;
+}
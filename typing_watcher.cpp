@@ -0,0 +1,118 @@
+// this is typing_watcher.cpp
+
+#include "typing_watcher.h"
+#include "platform.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace {
+    std::vector<const NgramModel *> viewsOf(const std::vector<NgramModelFile> &files) {
+        std::vector<const NgramModel *> models;
+        for (const auto &file: files) models.push_back(&file.model());
+        return models;
+    }
+}
+
+TypingWatcher::TypingWatcher(const config::Settings &settings, std::vector<NgramModelFile> models)
+    : mode_(settings.AS_YOU_TYPE),
+      minChars_(static_cast<std::size_t>(std::max(settings.AS_YOU_TYPE_MIN_CHARS, 1))),
+      basicModifiers_(settings.BASIC_HOTKEY_MODIFIERS),
+      basicVk_(settings.BASIC_HOTKEY_VK),
+      tables_(settings.KEYMAPS),
+      files_(std::move(models)),
+      models_(viewsOf(files_)),
+      scorer_(models_, tables_) {
+    for (const auto &layout: settings.LAYOUTS) langs_.push_back(layout.langId());
+    offerWord_.reserve(WordScorer::MAX_WORD);
+}
+
+TypingWatcher::~TypingWatcher() = default;
+
+std::unique_ptr<TypingWatcher> TypingWatcher::create() {
+    const auto cfg = config::current();
+    if (cfg->AS_YOU_TYPE == config::TypingMode::Off) return nullptr;
+
+    std::vector<NgramModelFile> files;
+    for (const auto &layout: cfg->LAYOUTS) {
+        files.push_back(NgramModelFile::open(layout.model));
+        if (!files.back().model().valid()) {
+            DEBUG_PRINT(L"[typing] Could not load the model for " << layout.name << L" ("
+                << config::utf8_to_wstring(layout.model) << L"); not watching typing");
+            return nullptr;
+        }
+    }
+    return std::make_unique<TypingWatcher>(*cfg, std::move(files));
+}
+
+LayoutId TypingWatcher::layoutOf(const LANGID lang) const noexcept {
+    for (std::size_t i = 0; i < langs_.size(); ++i) {
+        if (langs_[i] == lang) return static_cast<LayoutId>(i);
+    }
+    return NO_LAYOUT;
+}
+
+bool TypingWatcher::press(const KeyPress &key) {
+    ++stats_.keys;
+    if (key.kind == KeyPress::Kind::Modifier) return false;
+
+    // An offer lasts one key: the basic hotkey takes it, anything else drops it.
+    if (offering_) {
+        offering_ = false;
+        if (key.kind == KeyPress::Kind::Other && key.modifiers == basicModifiers_ && key.vk == basicVk_) {
+            platform::current().input->releaseModifiers(basicModifiers_);
+            retypeWord(offerWord_, offerDirection_, 1);
+            ++stats_.fixed;
+            tracking_ = true;
+            scorer_.start(offerDirection_.to);
+            return true;
+        }
+    }
+
+    switch (key.kind) {
+        case KeyPress::Kind::Text: {
+            const LayoutId layout = layoutOf(key.lang);
+            if (key.ch == L' ' || key.ch == L'\r') return endWord(layout, key.ch == L' ');
+            if (!tracking_) return false;
+            if (layout != scorer_.active()) {
+                // Switched by hand: a word not started yet goes on in the
+                // new layout; one half typed in each can't be judged.
+                if (scorer_.length() == 0) scorer_.start(layout);
+                else tracking_ = false;
+            }
+            if (tracking_) scorer_.push(key.ch);
+            return false;
+        }
+        case KeyPress::Kind::Backspace:
+            if (tracking_ && !scorer_.pop()) tracking_ = false;
+            return false;
+        default:
+            tracking_ = false;
+            return false;
+    }
+}
+
+bool TypingWatcher::endWord(const LayoutId next, const bool space) {
+    // Enter may already have sent the text somewhere; only a space is worth retyping.
+    bool retyped = false;
+    if (space && tracking_ && scorer_.length() >= minChars_) {
+        ++stats_.words;
+        const Direction verdict = scorer_.verdict();
+        if (verdict.converts()) {
+            if (mode_ == config::TypingMode::Fix) {
+                retypeWord(scorer_.word(), verdict, 0);
+                ++stats_.fixed;
+                retyped = true;
+            } else {
+                offerWord_.assign(scorer_.word());
+                offerDirection_ = verdict;
+                offering_ = true;
+                ++stats_.offered;
+                DEBUG_PRINT(L"[typing] Offering to convert " << offerWord_);
+            }
+        }
+    }
+    tracking_ = true;
+    scorer_.start(next);
+    return retyped;
+}
@@ -0,0 +1,98 @@
+// this is typing_watcher.h
+#pragma once
+
+#include "config.h"
+#include "layout_matrix.h"
+#include "ngram.h"
+#include "win32_compat.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ─── As-You-Type Detection ─────────────────────────────────────────────
+
+/// One key the user pressed, as a keyboard hook reports it.
+struct KeyPress {
+    enum class Kind {
+        Text,      // typed ch (a space ends a word, '\r' a line)
+        Backspace,
+        Modifier,  // Shift, Ctrl, Alt or Win on its own
+        Other,     // anything that may move the caret or edit elsewhere: arrows, chords, clicks, another window
+    };
+
+    Kind kind = Kind::Other;
+    wchar_t ch = 0;      // Text only
+    LANGID lang = 0;     // layout of the window the key went to
+    UINT modifiers = 0;  // MOD_* flags held
+    UINT vk = 0;
+};
+
+/// Catches words typed in the wrong layout as they are typed (AS_YOU_TYPE).
+/// Every key updates the running scores of the current word in constant
+/// time (WordScorer). When a space ends a word that reads clearly better
+/// converted, "fix" swallows the space and retypes the word converted,
+/// with the space, while "offer" keeps it for one key: the basic hotkey
+/// pressed next retypes it, anything else drops it. Either way the layout
+/// flips if AUTO_FLIP_ON_CHANGE says so.
+///
+/// Only words typed in one go from a known start are judged: after a
+/// caret move, a click, a dead key or a Backspace past the word's start,
+/// nothing is converted until the next space. Platform-independent; a
+/// hook feeds it key presses and the current backend does the typing.
+class TypingWatcher {
+public:
+    struct Stats {
+        std::uint64_t keys = 0;
+        std::uint64_t words = 0;   // judged: long enough and typed in one go
+        std::uint64_t offered = 0;
+        std::uint64_t fixed = 0;
+    };
+
+    /// Watch typing in settings' layouts; models[i] is the model file of layout i.
+    TypingWatcher(const config::Settings &settings, std::vector<NgramModelFile> models);
+    ~TypingWatcher();
+    TypingWatcher(const TypingWatcher &) = delete;
+    TypingWatcher &operator=(const TypingWatcher &) = delete;
+
+    /// For the current config; nullptr when AS_YOU_TYPE is off or a model can't be loaded.
+    static std::unique_ptr<TypingWatcher> create();
+
+    /// Take one key press; true if the watcher retyped in its place and
+    /// the key must not reach the target.
+    bool press(const KeyPress &key);
+
+    Stats stats() const noexcept { return stats_; }
+
+private:
+    LayoutId layoutOf(LANGID lang) const noexcept;
+
+    /// A space or Enter ended the word; true if the space was retyped with it.
+    bool endWord(LayoutId next, bool space);
+
+    config::TypingMode mode_;
+    std::size_t minChars_;
+    UINT basicModifiers_, basicVk_;
+    std::vector<LANGID> langs_; // of each layout, in LAYOUTS order
+    LayoutMatrix tables_;
+    std::vector<NgramModelFile> files_;
+    std::vector<const NgramModel *> models_;
+    WordScorer scorer_;
+
+    bool tracking_ = false; // the current word started at a known boundary
+    bool offering_ = false;
+    Direction offerDirection_;
+    std::wstring offerWord_;
+    Stats stats_;
+};
+
+/// Report every key the user presses (not injected ones) on this thread's
+/// low-level keyboard hook, and mouse clicks as Other; a key is swallowed
+/// when onKey returns true. The thread must pump messages.
+/// Win32 only; defined in platform_win32.cpp.
+bool installTypingHook(std::function<bool(const KeyPress &)> onKey);
+
+/// Take the hooks down again.
+void removeTypingHook();
@@ -0,0 +1,452 @@
+// this is utf8.cpp
+//
+// The codec runs one of three kernels, picked like KeymapTable's. The vector
+// kernels take 16 bytes (or 8 units) at a time when the block is plain ASCII
+// or a valid mix of one- and two-byte characters, which covers Latin,
+// Hebrew, Cyrillic, Greek and Arabic text; any other block, and anything
+// malformed, goes to the scalar steps, which also do the error accounting.
+
+#include "utf8.h"
+#include "keymap.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UTF8_X86 1
+#include <immintrin.h>
+#else
+#define UTF8_X86 0
+#endif
+
+#if UTF8_X86 && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_TARGET(isa) __attribute__((target(isa)))
+#else
+#define UTF8_TARGET(isa)
+#endif
+
+namespace {
+    using Unit = std::make_unsigned_t<wchar_t>;
+
+    constexpr char32_t kReplacement = 0xFFFD;
+    constexpr std::uint64_t kHighBits = 0x8080808080808080ull;
+
+    bool isContinuation(const unsigned char byte) noexcept {
+        return (byte & 0xC0) == 0x80;
+    }
+
+    void noteError(Utf8Status &status, const std::size_t at) noexcept {
+        if (status.errors++ == 0) status.firstError = at;
+    }
+
+    wchar_t *put(wchar_t *out, const char32_t cp) noexcept {
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (cp > 0xFFFF) {
+                *out++ = static_cast<wchar_t>(0xD800 + ((cp - 0x10000) >> 10));
+                *out++ = static_cast<wchar_t>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+                return out;
+            }
+        }
+        *out++ = static_cast<wchar_t>(cp);
+        return out;
+    }
+
+    // ─── Scalar Steps ──────────────────────────────────────────────────────
+
+    /// Decode the character at src[i]; returns the index after it.
+    inline std::size_t decodeOne(const unsigned char *src, const std::size_t i, const std::size_t n, wchar_t *&dst,
+                                 Utf8Status &status) noexcept {
+        const unsigned char lead = src[i];
+        if (lead < 0x80) {
+            *dst++ = static_cast<wchar_t>(lead);
+            return i + 1;
+        }
+        // Two-byte letters (Hebrew, Cyrillic, Greek, Arabic) are the common case.
+        if (lead >= 0xC2 && lead <= 0xDF && i + 1 < n && isContinuation(src[i + 1])) {
+            *dst++ = static_cast<wchar_t>(((lead & 0x1F) << 6) | (src[i + 1] & 0x3F));
+            return i + 2;
+        }
+        const Utf8Char c = readUtf8(src + i, n - i);
+        if (c.cp == kReplacement && c.length == 1) noteError(status, i);
+        dst = put(dst, c.cp);
+        return i + c.length;
+    }
+
+    /// Encode the character starting at text[i]; returns the index after it.
+    inline std::size_t encodeOne(const wchar_t *text, std::size_t i, const std::size_t n, char *&dst,
+                                 Utf8Status &status) noexcept {
+        const std::size_t at = i;
+        auto cp = static_cast<char32_t>(static_cast<Unit>(text[i++]));
+        if (cp < 0x800) {
+            dst = writeUtf8(dst, cp);
+            return i;
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF && i < n) {
+            const auto low = static_cast<char32_t>(static_cast<Unit>(text[i]));
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+        if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+            noteError(status, at);
+            cp = kReplacement;
+        }
+        dst = writeUtf8(dst, cp);
+        return i;
+    }
+
+    Utf8Status decodeScalar(const unsigned char *src, const std::size_t n, wchar_t *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0;
+        while (i < n) {
+            // Eight ASCII bytes at a time.
+            if (i + 8 <= n) {
+                std::uint64_t word;
+                std::memcpy(&word, src + i, 8);
+                if ((word & kHighBits) == 0) {
+                    for (int k = 0; k < 8; ++k) dst[k] = static_cast<wchar_t>(src[i + k]);
+                    dst += 8;
+                    i += 8;
+                    continue;
+                }
+            }
+            i = decodeOne(src, i, n, dst, status);
+        }
+        return status;
+    }
+
+    Utf8Status encodeScalar(const wchar_t *text, const std::size_t n, char *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0;
+        while (i < n) {
+            // Four ASCII units at a time.
+            if (i + 4 <= n && (static_cast<Unit>(text[i]) | static_cast<Unit>(text[i + 1]) |
+                               static_cast<Unit>(text[i + 2]) | static_cast<Unit>(text[i + 3])) < 0x80) {
+                for (int k = 0; k < 4; ++k) dst[k] = static_cast<char>(text[i + k]);
+                dst += 4;
+                i += 4;
+                continue;
+            }
+            i = encodeOne(text, i, n, dst, status);
+        }
+        return status;
+    }
+
+#if UTF8_X86
+
+    // ─── Compaction Tables ─────────────────────────────────────────────────
+
+    /// pshufb controls that pack the lanes a mask keeps to the front of a
+    /// register, for 8 bytes or 8 16-bit units, and how many lanes that is.
+    struct CompactTables {
+        alignas(16) std::uint8_t bytes[256][16];
+        alignas(16) std::uint8_t units[256][16];
+        std::uint8_t count[256];
+    };
+
+    constexpr CompactTables makeCompactTables() {
+        CompactTables t{};
+        for (int mask = 0; mask < 256; ++mask) {
+            int kept = 0;
+            for (int lane = 0; lane < 8; ++lane) {
+                if (!(mask & (1 << lane))) continue;
+                t.bytes[mask][kept] = static_cast<std::uint8_t>(lane);
+                t.units[mask][2 * kept] = static_cast<std::uint8_t>(2 * lane);
+                t.units[mask][2 * kept + 1] = static_cast<std::uint8_t>(2 * lane + 1);
+                ++kept;
+            }
+            for (int k = kept; k < 16; ++k) t.bytes[mask][k] = 0x80;
+            for (int k = 2 * kept; k < 16; ++k) t.units[mask][k] = 0x80;
+            t.count[mask] = static_cast<std::uint8_t>(kept);
+        }
+        return t;
+    }
+
+    constexpr CompactTables kCompact = makeCompactTables();
+
+    // ─── SSE4.2: 16 bytes or 8 units per step ──────────────────────────────
+
+    /// Store 8 UTF-16 units as wchar_t.
+    UTF8_TARGET("sse4.2")
+    inline void storeUnits(wchar_t *dst, const __m128i units) noexcept {
+        if constexpr (sizeof(wchar_t) == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), units);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_cvtepu16_epi32(units));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_cvtepu16_epi32(_mm_srli_si128(units, 8)));
+        }
+    }
+
+    /// Decode 16 bytes of ASCII and two-byte characters; returns the bytes
+    /// used (15 when the block ends on a lead byte) or 0 for any other block.
+    /// May write up to 16 units at dst, whatever it keeps.
+    UTF8_TARGET("sse4.2")
+    inline std::size_t decodeBlock(const unsigned char *src, wchar_t *&dst) noexcept {
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        const int high = _mm_movemask_epi8(b);
+        if (high == 0) {
+            const __m128i zero = _mm_setzero_si128();
+            storeUnits(dst, _mm_unpacklo_epi8(b, zero));
+            storeUnits(dst + 8, _mm_unpackhi_epi8(b, zero));
+            dst += 16;
+            return 16;
+        }
+
+        // As signed bytes, continuations are -128..-65 and leads C2..DF are -62..-33.
+        const __m128i lead = _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8(-63)), _mm_cmplt_epi8(b, _mm_set1_epi8(-32)));
+        const int leads = _mm_movemask_epi8(lead);
+        const int continuations = _mm_movemask_epi8(_mm_cmplt_epi8(b, _mm_set1_epi8(-64)));
+        // Nothing above 0x7F but leads and continuations, and a continuation exactly after each lead.
+        if ((leads | continuations) != high || continuations != ((leads << 1) & 0xFFFF)) return 0;
+
+        const bool split = leads & 0x8000; // the last lead's continuation is in the next block
+        const int keep = ~continuations & (split ? 0x7FFF : 0xFFFF);
+
+        // Each lead's code point from it and the byte after: 5 + 6 bits.
+        const __m128i next = _mm_srli_si128(b, 1);
+        const __m128i low = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(b, 6), _mm_set1_epi8(static_cast<char>(0xC0))),
+                                         _mm_and_si128(next, _mm_set1_epi8(0x3F)));
+        const __m128i lo = _mm_blendv_epi8(b, low, lead);
+        const __m128i hi = _mm_and_si128(_mm_and_si128(_mm_srli_epi16(b, 2), _mm_set1_epi8(0x07)), lead);
+
+        const int keep0 = keep & 0xFF, keep1 = keep >> 8;
+        const auto *units = reinterpret_cast<const __m128i *>(kCompact.units);
+        storeUnits(dst, _mm_shuffle_epi8(_mm_unpacklo_epi8(lo, hi), _mm_load_si128(units + keep0)));
+        dst += kCompact.count[keep0];
+        storeUnits(dst, _mm_shuffle_epi8(_mm_unpackhi_epi8(lo, hi), _mm_load_si128(units + keep1)));
+        dst += kCompact.count[keep1];
+        return split ? 15 : 16;
+    }
+
+    /// Encode 8 units below U+0800; false for any other block. May write up
+    /// to 16 bytes at dst, whatever it keeps.
+    UTF8_TARGET("sse4.2")
+    inline bool encodeBlock(const wchar_t *text, char *&dst) noexcept {
+        __m128i v;
+        if constexpr (sizeof(wchar_t) == 2) {
+            v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+        } else {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 4));
+            if (!_mm_testz_si128(_mm_or_si128(a, b), _mm_set1_epi32(static_cast<int>(0xFFFF0000)))) return false;
+            v = _mm_packus_epi32(a, b);
+        }
+        if (_mm_testz_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80)))) {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(v, v));
+            dst += 8;
+            return true;
+        }
+        if (!_mm_testz_si128(v, _mm_set1_epi16(static_cast<short>(0xF800)))) return false;
+
+        // A lead and a continuation byte per unit; ASCII units keep only the first.
+        const __m128i ascii = _mm_cmplt_epi16(v, _mm_set1_epi16(0x80));
+        const __m128i first = _mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0));
+        const __m128i second = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80));
+        const __m128i pairs = _mm_blendv_epi8(_mm_or_si128(first, _mm_slli_epi16(second, 8)), v, ascii);
+        const int keep = ~(_mm_movemask_epi8(ascii) & 0xAAAA) & 0xFFFF;
+
+        const int keep0 = keep & 0xFF, keep1 = keep >> 8;
+        const auto *bytes = reinterpret_cast<const __m128i *>(kCompact.bytes);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(pairs, _mm_load_si128(bytes + keep0)));
+        dst += kCompact.count[keep0];
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst),
+                         _mm_shuffle_epi8(_mm_srli_si128(pairs, 8), _mm_load_si128(bytes + keep1)));
+        dst += kCompact.count[keep1];
+        return true;
+    }
+
+    // After a block the vector step can't take, the scalar steps run to its
+    // end before the next try, so text it never takes costs one try per block.
+
+    UTF8_TARGET("sse4.2")
+    Utf8Status decodeSse42(const unsigned char *src, const std::size_t n, wchar_t *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0, scalarUntil = 0;
+        while (i < n) {
+            if (i >= scalarUntil && i + 16 <= n) {
+                if (const std::size_t used = decodeBlock(src + i, dst)) {
+                    i += used;
+                    continue;
+                }
+                scalarUntil = i + 16;
+            }
+            i = decodeOne(src, i, n, dst, status);
+        }
+        return status;
+    }
+
+    UTF8_TARGET("sse4.2")
+    Utf8Status encodeSse42(const wchar_t *text, const std::size_t n, char *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0, scalarUntil = 0;
+        while (i < n) {
+            if (i >= scalarUntil && i + 8 <= n) {
+                if (encodeBlock(text + i, dst)) {
+                    i += 8;
+                    continue;
+                }
+                scalarUntil = i + 8;
+            }
+            i = encodeOne(text, i, n, dst, status);
+        }
+        return status;
+    }
+
+    // ─── AVX2: 32 ASCII bytes or 16 ASCII units per step ───────────────────
+
+    /// Bytes (or units) to leave to the 16-byte blocks after a wide ASCII check fails.
+    constexpr std::size_t kWideBackoff = 64;
+
+    UTF8_TARGET("avx2")
+    Utf8Status decodeAvx2(const unsigned char *src, const std::size_t n, wchar_t *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0, scalarUntil = 0, wideFrom = 0;
+        while (i < n) {
+            if (i >= wideFrom && i + 32 <= n) {
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                if (_mm256_movemask_epi8(b) != 0) {
+                    wideFrom = i + kWideBackoff; // mixed text: let the 16-byte blocks have it for a while
+                } else {
+                    const __m128i b0 = _mm256_castsi256_si128(b), b1 = _mm256_extracti128_si256(b, 1);
+                    auto *out = reinterpret_cast<__m256i *>(dst);
+                    if constexpr (sizeof(wchar_t) == 2) {
+                        _mm256_storeu_si256(out, _mm256_cvtepu8_epi16(b0));
+                        _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi16(b1));
+                    } else {
+                        _mm256_storeu_si256(out, _mm256_cvtepu8_epi32(b0));
+                        _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(b0, 8)));
+                        _mm256_storeu_si256(out + 2, _mm256_cvtepu8_epi32(b1));
+                        _mm256_storeu_si256(out + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(b1, 8)));
+                    }
+                    dst += 32;
+                    i += 32;
+                    continue;
+                }
+            }
+            if (i >= scalarUntil && i + 16 <= n) {
+                if (const std::size_t used = decodeBlock(src + i, dst)) {
+                    i += used;
+                    continue;
+                }
+                scalarUntil = i + 16;
+            }
+            i = decodeOne(src, i, n, dst, status);
+        }
+        return status;
+    }
+
+    UTF8_TARGET("avx2")
+    Utf8Status encodeAvx2(const wchar_t *text, const std::size_t n, char *&dst) noexcept {
+        Utf8Status status;
+        std::size_t i = 0, scalarUntil = 0, wideFrom = 0;
+        while (i < n) {
+            if (i >= wideFrom && i + 16 <= n) {
+                bool ascii;
+                __m128i bytes;
+                if constexpr (sizeof(wchar_t) == 2) {
+                    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+                    ascii = _mm256_testz_si256(v, _mm256_set1_epi16(static_cast<short>(0xFF80)));
+                    bytes = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                } else {
+                    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+                    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + 8));
+                    ascii = _mm256_testz_si256(_mm256_or_si256(a, b), _mm256_set1_epi32(~0x7F));
+                    // packus works per 128-bit lane; the permute restores the order.
+                    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+                    bytes = _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+                }
+                if (ascii) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), bytes);
+                    dst += 16;
+                    i += 16;
+                    continue;
+                }
+                wideFrom = i + kWideBackoff;
+            }
+            if (i >= scalarUntil && i + 8 <= n) {
+                if (encodeBlock(text + i, dst)) {
+                    i += 8;
+                    continue;
+                }
+                scalarUntil = i + 8;
+            }
+            i = encodeOne(text, i, n, dst, status);
+        }
+        return status;
+    }
+
+#endif
+}
+
+std::size_t utf8CompleteLength(const std::string_view bytes) noexcept {
+    // The last sequence starts at most three bytes before the end.
+    const std::size_t n = bytes.size();
+    for (std::size_t back = 1; back <= 4 && back <= n; ++back) {
+        const auto byte = static_cast<unsigned char>(bytes[n - back]);
+        if (isContinuation(byte)) continue;
+        const std::size_t length = utf8SequenceLength(byte);
+        return length > back ? n - back : n;
+    }
+    return n;
+}
+
+namespace {
+    Utf8Status decodeInto(const std::string_view bytes, wchar_t *&dst, const KeymapKernel kernel) noexcept {
+        const auto *src = reinterpret_cast<const unsigned char *>(bytes.data());
+        switch (kernel) {
+#if UTF8_X86
+            case KeymapKernel::Avx2: return decodeAvx2(src, bytes.size(), dst);
+            case KeymapKernel::Sse42: return decodeSse42(src, bytes.size(), dst);
+#endif
+            default: return decodeScalar(src, bytes.size(), dst);
+        }
+    }
+
+    Utf8Status encodeInto(const std::wstring_view text, char *&dst, const KeymapKernel kernel) noexcept {
+        switch (kernel) {
+#if UTF8_X86
+            case KeymapKernel::Avx2: return encodeAvx2(text.data(), text.size(), dst);
+            case KeymapKernel::Sse42: return encodeSse42(text.data(), text.size(), dst);
+#endif
+            default: return encodeScalar(text.data(), text.size(), dst);
+        }
+    }
+}
+
+Utf8Status decodeUtf8(const std::string_view bytes, std::wstring &out) {
+    return decodeUtf8(bytes, out, bestKeymapKernel());
+}
+
+Utf8Status decodeUtf8(const std::string_view bytes, std::wstring &out, const KeymapKernel kernel) {
+    // Never more units than bytes: a 4-byte sequence gives at most two.
+    const std::size_t at = out.size();
+    out.resize(at + bytes.size());
+    wchar_t *dst = out.data() + at;
+    const Utf8Status status = decodeInto(bytes, dst, kernel);
+    out.resize(static_cast<std::size_t>(dst - out.data()));
+    return status;
+}
+
+Utf8Status decodeUtf8(const std::string_view bytes, wchar_t *&dst) noexcept {
+    return decodeInto(bytes, dst, bestKeymapKernel());
+}
+
+Utf8Status encodeUtf8(const std::wstring_view text, std::string &out) {
+    return encodeUtf8(text, out, bestKeymapKernel());
+}
+
+Utf8Status encodeUtf8(const std::wstring_view text, std::string &out, const KeymapKernel kernel) {
+    // Worst case: three bytes per UTF-16 unit, four per UTF-32 unit.
+    const std::size_t at = out.size();
+    out.resize(at + text.size() * (sizeof(wchar_t) == 2 ? 3 : 4));
+    char *dst = out.data() + at;
+    const Utf8Status status = encodeInto(text, dst, kernel);
+    out.resize(static_cast<std::size_t>(dst - out.data()));
+    return status;
+}
+
+Utf8Status encodeUtf8(const std::wstring_view text, char *&dst) noexcept {
+    return encodeInto(text, dst, bestKeymapKernel());
+}
@@ -0,0 +1,116 @@
+// this is utf8.h
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// ─── UTF-8 ↔ wchar_t ───────────────────────────────────────────────────
+
+// wchar_t text is UTF-16 on Windows (astral characters as surrogate pairs)
+// and UTF-32 elsewhere. Malformed input never fails: each bad byte or lone
+// surrogate becomes U+FFFD, and the result says how many there were.
+// Blocks of ASCII and two-byte letters go through SIMD kernels.
+
+enum class KeymapKernel; // keymap.h; the same CPU detection picks the kernel
+
+/// What a conversion found wrong with its input.
+struct Utf8Status {
+    std::size_t errors = 0;     // bad bytes or lone surrogates, each written as U+FFFD
+    std::size_t firstError = 0; // input offset (bytes or units) of the first, when errors > 0
+
+    bool ok() const noexcept { return errors == 0; }
+};
+
+/// Length of the longest prefix of bytes that doesn't end inside a
+/// multi-byte sequence, for cutting a stream into chunks.
+std::size_t utf8CompleteLength(std::string_view bytes) noexcept;
+
+/// Decode bytes and append them to out.
+Utf8Status decodeUtf8(std::string_view bytes, std::wstring &out);
+
+/// Same, through a specific kernel (must not exceed bestKeymapKernel()).
+Utf8Status decodeUtf8(std::string_view bytes, std::wstring &out, KeymapKernel kernel);
+
+/// Encode text and append it to out.
+Utf8Status encodeUtf8(std::wstring_view text, std::string &out);
+
+/// Same, through a specific kernel (must not exceed bestKeymapKernel()).
+Utf8Status encodeUtf8(std::wstring_view text, std::string &out, KeymapKernel kernel);
+
+/// Decode bytes into dst, which has room for bytes.size() units; dst ends
+/// past what was written. For callers that keep their own buffer.
+Utf8Status decodeUtf8(std::string_view bytes, wchar_t *&dst) noexcept;
+
+/// Encode text into dst, which has room for three bytes a UTF-16 unit or
+/// four a UTF-32 one; dst ends past what was written.
+Utf8Status encodeUtf8(std::wstring_view text, char *&dst) noexcept;
+
+// ─── Single Characters ─────────────────────────────────────────────────
+
+// The steps decodeUtf8() and encodeUtf8() take per character, for code
+// that converts without going through a wide string.
+
+/// One character read from UTF-8 and the bytes it took.
+struct Utf8Char {
+    char32_t cp;
+    std::size_t length;
+};
+
+/// Bytes in the sequence a lead byte starts (0 if it can't start one).
+inline std::size_t utf8SequenceLength(const unsigned char lead) noexcept {
+    if (lead < 0x80) return 1;
+    if (lead >= 0xC2 && lead <= 0xDF) return 2;
+    if (lead >= 0xE0 && lead <= 0xEF) return 3;
+    if (lead >= 0xF0 && lead <= 0xF4) return 4;
+    return 0;
+}
+
+/// Read the character at src (n > 0 bytes available). A byte that doesn't
+/// start a valid sequence within n reads as U+FFFD on its own.
+inline Utf8Char readUtf8(const unsigned char *src, const std::size_t n) noexcept {
+    constexpr Utf8Char bad{0xFFFD, 1};
+    const unsigned char lead = src[0];
+    if (lead < 0x80) return {lead, 1};
+    const std::size_t length = utf8SequenceLength(lead);
+    if (length == 0 || length > n) return bad;
+
+    char32_t cp = lead & (0x7F >> length);
+    for (std::size_t k = 1; k < length; ++k) {
+        if ((src[k] & 0xC0) != 0x80) return bad;
+        cp = (cp << 6) | (src[k] & 0x3F);
+    }
+    // Overlong forms, surrogates and anything past U+10FFFF.
+    if ((length == 3 && cp < 0x800) || (length == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+        (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return bad;
+    }
+    return {cp, length};
+}
+
+/// Bytes writeUtf8() takes for a scalar value.
+constexpr std::size_t utf8Length(const char32_t cp) noexcept {
+    // Without branches, as mixed scripts alternate lengths unpredictably:
+    // (limit - cp) >> 31 is 1 exactly when cp is past limit.
+    return 1 + ((0x7Fu - cp) >> 31) + ((0x7FFu - cp) >> 31) + ((0xFFFFu - cp) >> 31);
+}
+
+/// Write a scalar value (not a surrogate, at most U+10FFFF) at out; returns the end.
+inline char *writeUtf8(char *out, const char32_t cp) noexcept {
+    if (cp < 0x80) {
+        *out++ = static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (cp >> 6));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (cp >> 12));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = static_cast<char>(0xF0 | (cp >> 18));
+        *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
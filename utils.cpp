@@ -1,25 +1,30 @@
 // this is utils.cpp
 
 #include "utils.h"
+#include "clipboard_session.h"
 #include "config.h"
-
-// Windows APIs
-#include <windows.h>
+#include "injector.h"
+#include "metrics.h"
+#include "platform.h"
+#include "process_memory.h"
+#include "script_runs.h"
 
 // I/O & console
-#include <fcntl.h>   // _O_U16TEXT
 #include <iostream>
 
 // Containers & strings
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <vector>
 
 // Threading & timing
+#include <chrono>
 #include <thread>
 
 
-// ─── Layout Roles & IDs ────────────────────────────────────────────────
+// ─── Layouts & IDs ─────────────────────────────────────────────────────
 
 std::string makeLayoutString(const LANGID id) {
     char buf[9];
@@ -27,89 +32,112 @@ std::string makeLayoutString(const LANGID id) {
     return buf;
 }
 
-LANGID getLangIdPrimary() {
-    return MAKELANGID(config::LANG_PRIMARY, config::SUBLANG_PRIMARY);
+LANGID getLangId(const LayoutId layout) {
+    const auto cfg = config::current();
+    return layout < cfg->LAYOUTS.size() ? cfg->LAYOUTS[layout].langId() : 0;
 }
 
-LANGID getLangIdSecondary() {
-    return MAKELANGID(config::LANG_SECONDARY, config::SUBLANG_SECONDARY);
+std::string getKLID(const LayoutId layout) {
+    return makeLayoutString(getLangId(layout));
 }
 
-std::string getKLIDPrimary() {
-    return makeLayoutString(getLangIdPrimary());
+static const std::wstring &layoutName(const config::Settings &cfg, const LayoutId layout) {
+    static const std::wstring unknown = L"Unknown";
+    return layout < cfg.LAYOUTS.size() ? cfg.LAYOUTS[layout].name : unknown;
 }
 
-std::string getKLIDSecondary() {
-    return makeLayoutString(getLangIdSecondary());
-}
-
-// ─── Mapping Tables ────────────────────────────────────────────────────
-
-std::unordered_map<wchar_t, wchar_t> makeSecondaryToPrimaryMap() {
-    std::unordered_map<wchar_t, wchar_t> map;
-    map.reserve(config::KEYMAP_PRIMARY_TO_SECONDARY.size());
-    for (auto const &pair: config::KEYMAP_PRIMARY_TO_SECONDARY) {
-        map[pair.second] = pair.first;
-    }
-    return map;
+namespace {
+    /// What a correction converts into and types from, one set per thread
+    /// that runs corrections (the action worker). The buffers keep their
+    /// size between corrections, so once they have seen the longest text
+    /// a correction allocates nothing.
+    struct Workspace {
+        std::wstring typed;         // the selection, when it is typed (converted batch by batch)
+        std::vector<wchar_t> batch; // StreamingInjector's batches
+        std::wstring piece;         // a converted piece, when keys type several units
+    };
+
+    thread_local Workspace workspace;
 }
 
 // ─── Clipboard Helpers ─────────────────────────────────────────────────
 
 std::wstring readClipboard() {
-    // 1) Open the clipboard
-    if (!OpenClipboard(nullptr)) {
-        if (config::DEBUG_MODE) std::wcerr << L"[readClipboard] Failed to open clipboard\n";
-        return L"";
-    }
+    metrics::StageTimer timer(metrics::Stage::ReadClipboard);
+    return platform::current().clipboard->readText();
+}
 
-    std::wstring text;
-
-    // 2) Request Unicode text
-    HANDLE hData = GetClipboardData(CF_UNICODETEXT);
-    if (hData != nullptr) {
-        // 3) Lock the handle to get a pointer
-        // ReSharper disable once CppTooWideScope
-        const auto *pWide = static_cast<const wchar_t *>(GlobalLock(hData));
-        if (pWide) {
-            // 4) Copy into our string
-            text.assign(pWide);
-            GlobalUnlock(hData);
+// The waiter belongs to whichever backend/mode it was made for; rebuilt if either changes.
+static platform::ClipboardWaiter &clipboardWaiter() {
+    static std::unique_ptr<platform::ClipboardWaiter> waiter;
+    static platform::Clipboard *owner = nullptr;
+    static config::ClipboardWaitMode mode{};
+
+    const auto cfg = config::current();
+    auto *clipboard = platform::current().clipboard;
+    if (!waiter || owner != clipboard || mode != cfg->CLIPBOARD_WAIT_MODE) {
+        waiter.reset();
+        owner = clipboard;
+        mode = cfg->CLIPBOARD_WAIT_MODE;
+
+        if (mode == config::ClipboardWaitMode::Event) {
+            waiter = clipboard->createChangeWaiter();
+            if (!waiter) DEBUG_PRINT(L"[clipboard] Change notifications unavailable, polling instead");
+        }
+        if (!waiter) {
+            waiter = platform::makePollingWaiter(
+                *clipboard, std::chrono::milliseconds(cfg->CLIPBOARD_POLL_INTERVAL_MS));
         }
     }
-
-    // 5) Always close when done
-    CloseClipboard();
-    return text;
+    return *waiter;
 }
 
 DWORD waitForClipboardChange(const DWORD previousSequence) {
-    using Clock = std::chrono::steady_clock;
-    using Milliseconds = std::chrono::milliseconds;
+    const auto cfg = config::current();
+    return waitForClipboardChange(previousSequence, std::chrono::milliseconds(cfg->CLIPBOARD_POLL_TIMEOUT_MS));
+}
 
-    const auto deadline = Clock::now() + Milliseconds(config::CLIPBOARD_POLL_TIMEOUT_MS);
+DWORD waitForClipboardChange(const DWORD previousSequence, const std::chrono::milliseconds timeout) {
+    metrics::StageTimer timer(metrics::Stage::WaitForClipboardChange);
+    return clipboardWaiter().waitForChange(previousSequence, timeout);
+}
 
-    // Loop until either the clipboard sequence changes, or we hit our deadline.
-    while (Clock::now() < deadline) {
-        DWORD current = GetClipboardSequenceNumber();
-        if (current != previousSequence) {
-            return current; // we got new data
-        }
-        std::this_thread::sleep_for(Milliseconds(config::CLIPBOARD_POLL_INTERVAL_MS));
+bool copySelection(const platform::Selection selection) {
+    const auto cfg = config::current();
+    const DWORD before = platform::current().clipboard->sequenceNumber();
+
+    // select (if asked) and copy in one batch
+    {
+        metrics::StageTimer timer(metrics::Stage::SendCtrlC);
+        platform::current().input->selectAndCopy(selection);
     }
 
-    // Timeout: no change detected
-    return previousSequence;
+    // wait for it to change; a plain copy gets the full timeout
+    DWORD after;
+    if (selection == platform::Selection::Current) {
+        after = waitForClipboardChange(before);
+    } else {
+        // A target that applies the selection late copies the old (often
+        // empty) one, which never changes the clipboard. Give it a short
+        // window, then copy again; the last attempt gets the full timeout.
+        const auto retryWindow = std::chrono::milliseconds(
+            std::min(cfg->SELECT_COPY_RETRY_MS, cfg->CLIPBOARD_POLL_TIMEOUT_MS));
+        const int retries = std::max(cfg->SELECT_COPY_RETRIES, 0);
+
+        after = waitForClipboardChange(before, retries > 0 ? retryWindow
+                                                           : std::chrono::milliseconds(cfg->CLIPBOARD_POLL_TIMEOUT_MS));
+        for (int attempt = 1; after == before && attempt <= retries; ++attempt) {
+            DEBUG_PRINT(L"[clipboard] Selection copy not seen, retry " << attempt);
+            sendCtrlC();
+            after = waitForClipboardChange(before, attempt < retries ? retryWindow
+                                                                     : std::chrono::milliseconds(cfg->CLIPBOARD_POLL_TIMEOUT_MS));
+        }
+    }
+    return after != before;
 }
 
-std::wstring copyAndFetchSelection() {
-    const DWORD before = GetClipboardSequenceNumber();
-
-    sendCtrlC();
-
-    // wait for it to change
-    DWORD after = waitForClipboardChange(before);
-    if (after == before) {
+std::wstring copyAndFetchSelection(const platform::Selection selection) {
+    if (!copySelection(selection)) {
         return L"";
     }
 
@@ -119,174 +147,280 @@ std::wstring copyAndFetchSelection() {
 
 // ─── Input Simulation ──────────────────────────────────────────────────
 
-// Release any stuck modifier keys (Ctrl, Alt, Shift) in one batched SendInput call
-void flushModifiers(UINT modifiers) {
-    std::vector<INPUT> ups;
-    ups.reserve(3);
-
-    if (modifiers & MOD_CONTROL) {
-        INPUT i{};
-        i.type = INPUT_KEYBOARD;
-        i.ki.wVk = VK_CONTROL;
-        i.ki.dwFlags = KEYEVENTF_KEYUP;
-        ups.push_back(i);
-    }
-    if (modifiers & MOD_ALT) {
-        INPUT i{};
-        i.type = INPUT_KEYBOARD;
-        i.ki.wVk = VK_MENU;
-        i.ki.dwFlags = KEYEVENTF_KEYUP;
-        ups.push_back(i);
-    }
-    if (modifiers & MOD_SHIFT) {
-        INPUT i{};
-        i.type = INPUT_KEYBOARD;
-        i.ki.wVk = VK_SHIFT;
-        i.ki.dwFlags = KEYEVENTF_KEYUP;
-        ups.push_back(i);
-    }
+void flushModifiers(const UINT modifiers) {
+    metrics::StageTimer timer(metrics::Stage::FlushModifiers);
+    platform::current().input->releaseModifiers(modifiers);
+}
 
-    if (!ups.empty())
-        SendInput(static_cast<UINT>(ups.size()), ups.data(), sizeof(INPUT));
+void sendCtrlC() {
+    metrics::StageTimer timer(metrics::Stage::SendCtrlC);
+    platform::current().input->sendCopy();
 }
 
+void selectCurrentLine() {
+    platform::current().input->selectLine();
+}
 
-void sendCtrlC() {
-    INPUT inputs[4] = {};
+void selectAllText() {
+    platform::current().input->selectAll();
+}
 
-    // Ctrl down, C down, C up, Ctrl up
-    inputs[0].type = INPUT_KEYBOARD;
-    inputs[0].ki.wVk = VK_CONTROL;
-    inputs[1].type = INPUT_KEYBOARD;
-    inputs[1].ki.wVk = 'C';
-    inputs[2] = inputs[1];
-    inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
-    inputs[3] = inputs[0];
-    inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+void typeText(const std::wstring &text) {
+    metrics::StageTimer timer(metrics::Stage::TypeText);
+    StreamingInjector injector(*platform::current().input, workspace.batch);
+    injector.push(text);
+    injector.finish();
+}
 
-    SendInput(4, inputs, sizeof(INPUT));
+void pasteText(const std::wstring &text) {
+    metrics::StageTimer timer(metrics::Stage::PasteText);
+    if (!platform::current().clipboard->writeText(text)) {
+        DEBUG_PRINT(L"[paste] Could not write clipboard, typing instead");
+        typeText(text);
+        return;
+    }
+    platform::current().input->sendPaste();
 }
 
-void selectCurrentLine() {
-    INPUT inputs[4] = {};
+static bool shouldPaste(const std::size_t length) {
+    const auto cfg = config::current();
+    return cfg->PASTE_THRESHOLD_CHARS > 0 && length >= static_cast<std::size_t>(cfg->PASTE_THRESHOLD_CHARS);
+}
 
-    // Press SHIFT
-    inputs[0].type = INPUT_KEYBOARD;
-    inputs[0].ki.wVk = VK_SHIFT;
+Replacement replaceSelection(const std::wstring &text) {
+    if (shouldPaste(text.size())) {
+        pasteText(text);
+        return Replacement::Pasted;
+    }
+    typeText(text);
+    return Replacement::Typed;
+}
 
-    // Press HOME
-    inputs[1].type = INPUT_KEYBOARD;
-    inputs[1].ki.wVk = VK_HOME;
+// ─── Detection & Fixing ─────────────────────────────────────────────────
 
-    // Release HOME
-    inputs[2] = inputs[1];
-    inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+LANGID activeLang() {
+    return platform::current().layout->activeLang();
+}
 
-    // Release SHIFT
-    inputs[3] = inputs[0];
-    inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+LayoutId detectLayout() {
+    const auto cfg = config::current();
+    const LANGID id = activeLang();
+    for (std::size_t i = 0; i < cfg->LAYOUTS.size(); ++i) {
+        if (cfg->LAYOUTS[i].langId() == id) return static_cast<LayoutId>(i);
+    }
+    return NO_LAYOUT;
+}
 
-    SendInput(4, inputs, sizeof(INPUT));
+Direction cycleDirection(const LayoutId from) {
+    const auto cfg = config::current();
+    const LayoutId to = cfg->nextLayout(from);
+    return to == NO_LAYOUT ? Direction{} : Direction{from, to};
 }
 
-void selectAllText() {
-    INPUT inputs[4] = {};
+const KeymapTransducer *keymapFor(const Direction direction) {
+    const auto cfg = config::current();
+    if (!direction.converts() || direction.from >= cfg->KEYMAPS.layouts() || direction.to >= cfg->KEYMAPS.layouts()) {
+        return nullptr;
+    }
+    return &cfg->KEYMAPS.transducer(direction);
+}
 
-    // Press CTRL down
-    inputs[0].type = INPUT_KEYBOARD;
-    inputs[0].ki.wVk = VK_CONTROL;
+const LanguageModels *languageModels() {
+    const auto cfg = config::current();
+    if (cfg->DIRECTION_MODE != config::DirectionMode::Auto) return nullptr;
+
+    // Only the action worker converts text, so no locking. The files stay
+    // mapped until a reload names different ones.
+    struct Loaded {
+        std::vector<std::string> paths;
+        LanguageModels models;
+        bool valid = false;
+    };
+    static Loaded loaded;
+    static bool attempted = false;
+
+    const bool same = std::equal(loaded.paths.begin(), loaded.paths.end(), cfg->LAYOUTS.begin(), cfg->LAYOUTS.end(),
+                                 [](const std::string &path, const config::Layout &layout) { return path == layout.model; });
+    if (attempted && same) {
+        return loaded.valid ? &loaded.models : nullptr;
+    }
+    attempted = true;
+    loaded.paths.clear();
+    loaded.models.files.clear();
+    loaded.models.models.clear();
+    loaded.valid = true;
+    for (const auto &layout: cfg->LAYOUTS) {
+        loaded.paths.push_back(layout.model);
+        loaded.models.files.push_back(NgramModelFile::open(layout.model));
+        if (loaded.valid && !loaded.models.files.back().model().valid()) {
+            loaded.valid = false;
+            DEBUG_PRINT(L"[scorer] Could not load the model for " << layout.name << L" ("
+                << config::utf8_to_wstring(layout.model) << L"); converting by layout only");
+        }
+    }
+    for (const auto &file: loaded.models.files) loaded.models.models.push_back(&file.model());
+    return loaded.valid ? &loaded.models : nullptr;
+}
 
-    // Press A
-    inputs[1].type = INPUT_KEYBOARD;
-    inputs[1].ki.wVk = 'A';
+namespace {
+    /// How one correction converts its text: each script run out of the
+    /// layout that typed it into the next one in the cycle, or word by word
+    /// through the scorer with the active layout's conversion as the tiebreak.
+    class Conversion {
+    public:
+        Conversion()
+            : preferred_(cycleDirection(detectLayout())),
+              runs_(cfg_->KEYMAPS, [this](const LayoutId from) { return cfg_->nextLayout(from); }, preferred_.from) {
+            if (const LanguageModels *models = languageModels()) {
+                scorer_.emplace(models->models, cfg_->KEYMAPS);
+            }
+        }
 
-    // Release A
-    inputs[2] = inputs[1];
-    inputs[2].ki.dwFlags = KEYEVENTF_KEYUP;
+        /// What the active layout alone says to do.
+        Direction preferred() const noexcept { return preferred_; }
 
-    // Release CTRL
-    inputs[3] = inputs[0];
-    inputs[3].ki.dwFlags = KEYEVENTF_KEYUP;
+        /// False when neither the layout nor the scorer can say what to do.
+        bool possible() const noexcept { return scorer_ || preferred_.converts(); }
 
-    SendInput(4, inputs, sizeof(INPUT));
-}
+        /// No layout has keys typing more than one unit, so the text keeps
+        /// its length and can be converted in place.
+        bool sameLength() const noexcept { return cfg_->KEYMAPS.singleUnit(); }
 
-void typeText(const std::wstring &text) {
-    // We need one INPUT down‐event and one up‐event per character:
-    std::vector<INPUT> inputs;
-    // Reserve space for two events per character to avoid resizing
-    inputs.reserve(text.size() * 2);
-
-    for (const wchar_t ch: text) {
-        // Key‐down event (UNICODE scan code)
-        INPUT keyDown{};
-        keyDown.type = INPUT_KEYBOARD;
-        keyDown.ki.wScan = ch; // Unicode code point
-        keyDown.ki.dwFlags = KEYEVENTF_UNICODE; // tell Windows it's a unicode wScan
-
-        // Key‐up event is identical, plus the KEYEVENTF_KEYUP flag:
-        INPUT keyUp = keyDown;
-        keyUp.ki.dwFlags |= KEYEVENTF_KEYUP;
-
-        inputs.push_back(keyDown);
-        inputs.push_back(keyUp);
-    }
+        /// In place; only when sameLength().
+        void operator()(const wchar_t *src, const std::size_t n, wchar_t *dst) {
+            metrics::StageTimer timer(metrics::Stage::TransformText);
+            convertSameLength(src, n, dst);
+        }
 
-    // Fire them all in one batch for efficiency
-    SendInput(static_cast<UINT>(inputs.size()),
-              inputs.data(),
-              sizeof(INPUT));
-}
+        std::wstring operator()(const std::wstring_view text) {
+            std::wstring out;
+            (*this)(text, out);
+            return out;
+        }
 
-// ─── Detection & Fixing ─────────────────────────────────────────────────
+        /// Into out, reusing its buffer.
+        void operator()(const std::wstring_view text, std::wstring &out) {
+            metrics::StageTimer timer(metrics::Stage::TransformText);
+            out.clear();
+            if (sameLength()) {
+                out.resize(text.size());
+                convertSameLength(text.data(), text.size(), out.data());
+            } else if (!scorer_) {
+                flip_ = runs_.convert(text, out);
+            } else {
+                flip_ = scorer_->convert(text, out, preferred_).dominant();
+            }
+        }
 
-LANGID activeLang() {
-    const HWND h = GetForegroundWindow();
-    return LOWORD(GetKeyboardLayout(GetWindowThreadProcessId(h, nullptr)));
+        /// Type text converted a batch at a time, so the first keys go out
+        /// before the rest is converted. The batches' conversion is taken out
+        /// of the typing and recorded once as the transform stage.
+        void type(const std::wstring_view text) {
+            metrics::StageTimer timer(metrics::Stage::TypeText);
+            metrics::Clock::duration converting{};
+            auto timed = [&converting](auto &&convert) {
+                if (!metrics::enabled()) return convert();
+                const auto start = metrics::Clock::now();
+                convert();
+                converting += metrics::Clock::now() - start;
+            };
+            std::fill(std::begin(tally_), std::end(tally_), Tally{});
+            ScriptRunConverter::Carry carry;
+            StreamingInjector injector(*platform::current().input, workspace.batch);
+            if (sameLength()) {
+                injector.pushMapped(text, [&](const wchar_t *src, const std::size_t n, wchar_t *dst) {
+                    timed([&] {
+                        if (!scorer_) count(runs_.convert(src, n, dst, carry), n);
+                        else count(scorer_->convert(src, n, dst, preferred_));
+                    });
+                });
+            } else {
+                injector.pushConverted(text, [&](const std::wstring_view piece, std::wstring &out) {
+                    timed([&] {
+                        if (!scorer_) count(runs_.convert(piece, out, carry), piece.size());
+                        else count(scorer_->convert(piece, out, preferred_));
+                    });
+                }, workspace.piece);
+            }
+            injector.finish();
+            timer.split(metrics::Stage::TransformText, converting);
+            flip_ = dominant();
+        }
+
+        /// Switch to the layout most of the text was converted to, if configured.
+        void flipIfWanted() const {
+            if (cfg_->AUTO_FLIP_ON_CHANGE && flip_.converts()) {
+                flipLayout(flip_);
+            }
+        }
+
+    private:
+        /// Characters each conversion took over the pieces type() converted.
+        struct Tally {
+            Direction direction;
+            std::size_t chars = 0;
+        };
+
+        void convertSameLength(const wchar_t *src, const std::size_t n, wchar_t *dst) {
+            if (!scorer_) {
+                flip_ = runs_.convert(src, n, dst);
+                return;
+            }
+            flip_ = scorer_->convert(src, n, dst, preferred_).dominant();
+        }
+
+        /// A piece the script runs converted, counted whole for the
+        /// conversion most of it took.
+        void count(const Direction direction, const std::size_t chars) noexcept {
+            if (!direction.converts()) return;
+            for (Tally &t: tally_) {
+                if (t.chars == 0) t.direction = direction;
+                if (t.direction == direction) {
+                    t.chars += chars;
+                    return;
+                }
+            }
+        }
+
+        void count(const DirectionScorer::Counts &counts) noexcept {
+            for (std::size_t k = 1; k < counts.readings; ++k) {
+                if (counts.chars[k] > 0) count(counts.direction[k], counts.chars[k]);
+            }
+        }
+
+        Direction dominant() const noexcept {
+            const Tally *best = std::max_element(std::begin(tally_), std::end(tally_),
+                [](const Tally &a, const Tally &b) { return a.chars < b.chars; });
+            return best->chars > 0 ? best->direction : Direction{};
+        }
+
+        config::Snapshot cfg_ = config::current(); // keeps the tables alive
+        Direction preferred_;
+        ScriptRunConverter runs_;
+        std::optional<DirectionScorer> scorer_;
+        Direction flip_;
+        Tally tally_[DirectionScorer::MAX_READINGS];
+    };
 }
 
-std::wstring fix(const std::wstring &src, const std::unordered_map<wchar_t, wchar_t> &map) {
+std::wstring transformText(const std::wstring &input, const Direction direction) {
+    metrics::StageTimer timer(metrics::Stage::TransformText);
+    const auto cfg = config::current(); // owns the keymap
+    const KeymapTransducer *keymap = keymapFor(direction);
+    if (!keymap) return input;
     std::wstring out;
-    out.reserve(src.size());
-    for (wchar_t ch: src) {
-        if (ch >= L'A' && ch <= L'Z') ch = static_cast<wchar_t>(ch + 32);
-        auto it = map.find(ch);
-        out += (it != map.end()) ? it->second : ch;
-    }
+    keymap->apply(input, out);
     return out;
 }
 
-LayoutRole detectLayout() {
-    const LANGID id = activeLang();
-    if (id == getLangIdPrimary()) return LayoutRole::Primary;
-    if (id == getLangIdSecondary()) return LayoutRole::Secondary;
-    return LayoutRole::Unsupported;
-}
-
-std::wstring transformText(const std::wstring &input, const LayoutRole from) {
-    switch (from) {
-        case LayoutRole::Primary:
-            return fix(input, config::KEYMAP_PRIMARY_TO_SECONDARY); // primary→secondary map
-        case LayoutRole::Secondary:
-            return fix(input, makeSecondaryToPrimaryMap()); // secondary→primary map
-        default:
-            return input;
-    }
-}
-
-void logTransformation(const std::wstring &orig, const std::wstring &transformed, const LayoutRole from) {
-    DEBUG_PRINT(L"selected: " << orig);
-    // Choose labels based on the role
-    if (from == LayoutRole::Primary) {
-        // primary → secondary
-        DEBUG_PRINT(config::ROLE_NAME_PRIMARY << L"→"
-            << config::ROLE_NAME_SECONDARY << L": " << transformed);
-    } else if (from == LayoutRole::Secondary) {
-        // secondary → primary
-        DEBUG_PRINT(config::ROLE_NAME_SECONDARY << L"→" <<
-            config::ROLE_NAME_PRIMARY << L": " << transformed);
+void logTransformation(const std::wstring_view orig, const std::wstring_view transformed, const Direction direction) {
+    const auto cfg = config::current();
+    DEBUG_PRINT(L"selected (" << orig.size() << L" chars): " << orig);
+    if (direction.converts()) {
+        DEBUG_PRINT(layoutName(*cfg, direction.from) << L"→"
+            << layoutName(*cfg, direction.to) << L": " << transformed);
     } else {
-        DEBUG_PRINT(L"Unsupported role. Output: " << transformed);
+        DEBUG_PRINT(L"Unsupported layout. Output: " << transformed);
     }
 }
 
@@ -294,47 +428,17 @@ void logTransformation(const std::wstring &orig, const std::wstring &transformed
 // ─── Switching (optional) ──────────────────────────────────────────────
 
 bool switchKeyboardLayout(const std::string_view layoutId) {
-    // 1) Load the layout into this process (reordering the HKL list)
-    HKL layoutHandle = LoadKeyboardLayoutA(layoutId.data(), KLF_REORDER);
-    if (!layoutHandle) {
-        // failed to load the layout at all
-        return false;
-    }
+    return platform::current().layout->switchTo(layoutId);
+}
 
-    // 2) Broadcast a WM_INPUTLANGCHANGEREQUEST so all windows switch
-    LRESULT result = PostMessage(
-        HWND_BROADCAST,
-        WM_INPUTLANGCHANGEREQUEST,
-        0,
-        reinterpret_cast<LPARAM>(layoutHandle)
-    );
-
-    // PostMessage returns nonzero on success
-    return result != 0;
-}
-
-bool flipLayout(const LayoutRole from) {
-    bool ok = false;
-    const std::wstring &fromName =
-            (from == LayoutRole::Primary)
-                ? config::ROLE_NAME_PRIMARY
-                : (from == LayoutRole::Secondary)
-                      ? config::ROLE_NAME_SECONDARY
-                      : L"Unknown";
-
-    const std::wstring &toName =
-            (from == LayoutRole::Primary)
-                ? config::ROLE_NAME_SECONDARY
-                : (from == LayoutRole::Secondary)
-                      ? config::ROLE_NAME_PRIMARY
-                      : L"Unknown";
+bool flipLayout(const Direction direction) {
+    metrics::StageTimer timer(metrics::Stage::FlipLayout);
+    const auto cfg = config::current();
+    const std::wstring &fromName = layoutName(*cfg, direction.from);
+    const std::wstring &toName = layoutName(*cfg, direction.to);
 
     // do the flip
-    if (from == LayoutRole::Primary) {
-        ok = switchKeyboardLayout(getKLIDSecondary());
-    } else if (from == LayoutRole::Secondary) {
-        ok = switchKeyboardLayout(getKLIDPrimary());
-    }
+    const bool ok = direction.to < cfg->LAYOUTS.size() && switchKeyboardLayout(getKLID(direction.to));
 
     // log the result using macro
     if (ok) {
@@ -347,23 +451,111 @@ bool flipLayout(const LayoutRole from) {
 }
 
 
-// ─── Hotkey & Orchestration ────────────────────────────────────────────
+// ─── Footprint ─────────────────────────────────────────────────────────
 
-void handleClipboardText(const std::wstring &selected) {
-    const auto layout = detectLayout();
-    if (layout == LayoutRole::Unsupported) {
-        DEBUG_PRINT(L"Unsupported layout. Aborting.\n");
-        return;
+void logFootprint(const wchar_t *when) {
+    const ProcessMemory memory = processMemory();
+    if (!memory.valid) return;
+    DEBUG_PRINT(L"[memory] " << when << L": private " << (memory.privateBytes >> 10) << L" KB, shared "
+        << (memory.sharedBytes >> 10) << L" KB, committed " << (memory.committedBytes >> 10) << L" KB");
+}
+
+void settleFootprint() {
+    // Swapped with empty ones: clear() and assignment keep the capacity.
+    std::wstring().swap(workspace.typed);
+    std::vector<wchar_t>().swap(workspace.batch);
+    std::wstring().swap(workspace.piece);
+    platform::current().clipboard->dropSpare();
+    trimProcessMemory();
+
+    const auto cfg = config::current();
+    if (!cfg->DEBUG_MODE && cfg->MEMORY_BUDGET_KB <= 0) return;
+    const ProcessMemory memory = processMemory();
+    if (!memory.valid) return;
+    const std::size_t committedKb = memory.committedBytes >> 10;
+    const bool overBudget = cfg->MEMORY_BUDGET_KB > 0 && committedKb > static_cast<std::size_t>(cfg->MEMORY_BUDGET_KB);
+    metrics::noteFootprint(memory.committedBytes, overBudget);
+    if (overBudget) {
+        DEBUG_PRINT(L"[memory] Over budget after a correction: " << committedKb << L" KB committed, budget "
+            << cfg->MEMORY_BUDGET_KB << L" KB");
+    } else {
+        DEBUG_PRINT(L"[memory] Settled: private " << (memory.privateBytes >> 10) << L" KB, shared "
+            << (memory.sharedBytes >> 10) << L" KB, committed " << committedKb << L" KB");
     }
+}
 
-    const auto transformed = transformText(selected, layout);
+// ─── Hotkey & Orchestration ────────────────────────────────────────────
 
-    if (config::DEBUG_MODE) logTransformation(selected, transformed, layout);
-    typeText(transformed);
+Replacement correctCopiedText() {
+    const auto cfg = config::current();
+    Conversion convert;
+    if (!convert.possible()) {
+        DEBUG_PRINT(L"Unsupported layout. Aborting.");
+        return Replacement::None;
+    }
+    auto &clipboard = *platform::current().clipboard;
+
+    // Text to type is copied out as it is and converted a batch at a time
+    // as it is typed. A paste is mapped straight out of the locked
+    // clipboard memory into the clipboard's new block; keys typing several
+    // units change the length, so then the paste is built first.
+    std::size_t length = 0;
+    bool pasting = false;
+    std::wstring &typed = workspace.typed;
+    typed.clear();
+    bool hasText;
+    {
+        // The conversion inside is timed as a stage of its own.
+        metrics::StageTimer timer(metrics::Stage::ReadClipboard);
+        hasText = clipboard.viewText([&](const std::wstring_view selected) {
+            length = selected.size();
+            pasting = shouldPaste(length);
+            if (!pasting) typed.assign(selected);
+            else if (!convert.sameLength()) convert(selected, typed);
+            if (cfg->DEBUG_MODE) {
+                // The log keeps a line's head only; convert no more than that.
+                const bool converted = pasting && !typed.empty();
+                const std::wstring head = converted ? std::wstring() : convert(selected.substr(0, logger::kTextUnits));
+                logTransformation(selected, converted ? typed : head, convert.preferred());
+            }
+        });
+    }
+    if (!hasText || length == 0) {
+        DEBUG_PRINT(L"No text on the clipboard. Skipping.");
+        return Replacement::None;
+    }
 
-    if (config::AUTO_FLIP_ON_CHANGE) {
-        flipLayout(layout);
+    Replacement how = Replacement::Typed;
+    if (pasting && typed.empty()) {
+        metrics::StageTimer timer(metrics::Stage::PasteText);
+        const bool rewritten = clipboard.rewriteText([&convert](const wchar_t *src, const std::size_t n, wchar_t *dst) {
+            convert(src, n, dst);
+        });
+        if (rewritten) {
+            platform::current().input->sendPaste();
+            how = Replacement::Pasted;
+        } else {
+            DEBUG_PRINT(L"[paste] Could not write clipboard, typing instead");
+            clipboard.viewText([&](const std::wstring_view selected) { typed.assign(selected); });
+        }
+    } else if (pasting) {
+        pasteText(typed);
+        how = Replacement::Pasted;
     }
+    if (how == Replacement::Typed) convert.type(typed);
+    metrics::noteSelection(length, how == Replacement::Pasted);
+
+    convert.flipIfWanted();
+    return how;
+}
+
+void retypeWord(const std::wstring_view word, const Direction direction, const std::size_t typedAfter) {
+    const auto cfg = config::current();
+    std::wstring converted = transformText(std::wstring(word), direction);
+    if (cfg->DEBUG_MODE) logTransformation(word, converted, direction);
+    converted += L' ';
+    platform::current().input->retype(word.size() + typedAfter, converted);
+    if (cfg->AUTO_FLIP_ON_CHANGE) flipLayout(direction);
 }
 
 std::wstring makeHotkeyName(const UINT modifiers, const UINT vk) {
@@ -377,23 +569,47 @@ std::wstring makeHotkeyName(const UINT modifiers, const UINT vk) {
     return name;
 }
 
-bool registerHotkey(const int id, const UINT modifiers, const UINT vk) {
-    const std::wstring name = makeHotkeyName(modifiers, vk);
+void copyAndFlip(const platform::Selection selection) {
+    const auto cfg = config::current();
+    // Our Ctrl+C (and a paste) replace the user's clipboard; keep it.
+    ClipboardSession session(*platform::current().clipboard);
 
-    if (!RegisterHotKey(nullptr, id, modifiers, vk)) {
-        DEBUG_PRINT(L"Failed to register hotkey " << name);
-        return false;
+    if (!copySelection(selection)) {
+        DEBUG_PRINT(L"No new text selected. Skipping.");
+        return;
     }
-
-    DEBUG_PRINT(L"Hotkey registered " << name);
-    return true;
+    if (correctCopiedText() == Replacement::Pasted) {
+        // The target reads the clipboard when it handles Ctrl+V, some time
+        // after we sent it; give it that long before putting the user's back.
+        std::this_thread::sleep_for(std::chrono::milliseconds(cfg->PASTE_RESTORE_DELAY_MS));
+    }
+    metrics::StageTimer timer(metrics::Stage::RestoreClipboard);
+    session.restore();
 }
 
-void copyAndFlip() {
-    const auto selected = copyAndFetchSelection();
-    if (selected.empty()) {
-        if (config::DEBUG_MODE) std::wcerr << L"No new text selected. Skipping.\n";
-        return;
+void runHotkeyAction(const HotkeyAction action) {
+    // Everything below reads this one snapshot; a reload applies from the next action.
+    const auto cfg = config::current();
+    {
+        metrics::Correction correction;
+        switch (action) {
+            case HotkeyAction::Basic:
+                DEBUG_PRINT(L"Basic Case:");
+                flushModifiers(cfg->BASIC_HOTKEY_MODIFIERS);
+                copyAndFlip();
+                break;
+            case HotkeyAction::Line:
+                DEBUG_PRINT(L"Line Case:");
+                flushModifiers(cfg->LINE_HOTKEY_MODIFIERS);
+                copyAndFlip(platform::Selection::Line);
+                break;
+            case HotkeyAction::All:
+                DEBUG_PRINT(L"All Case:");
+                flushModifiers(cfg->ALL_HOTKEY_MODIFIERS);
+                copyAndFlip(platform::Selection::All);
+                break;
+        }
     }
-    handleClipboardText(selected);
+    // Not part of the correction's time: the text is already in place.
+    if (cfg->LOW_FOOTPRINT) settleFootprint();
 }
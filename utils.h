@@ -3,47 +3,53 @@
 #pragma once
 
 #include "config.h"
+#include "keymap.h"
+#include "layout_matrix.h"
+#include "logger.h"
+#include "ngram.h"
+#include "platform.h"
 
+#include <chrono>
 #include <string>
-#include <unordered_map>
-#include <windows.h>   // for LANGID
+#include <string_view>
+#include <vector>
+#include "win32_compat.h"   // for LANGID
 
 
-#define DEBUG_PRINT(msg) do { if (config::DEBUG_MODE) std::wcout << msg << std::endl; } while (0)
+// Queued for the log writer (logger.h): long messages are cut, never copied whole.
+#define DEBUG_PRINT(msg) do { if (config::current()->DEBUG_MODE) { logger::Line debugLine_; debugLine_ << msg; } } while (0)
 
-// ─── Layout Roles & IDs ────────────────────────────────────────────────
+// ─── Layouts & IDs ─────────────────────────────────────────────────────
 
-/// Which role the current layout is playing in the swap.
-enum class LayoutRole { Primary, Secondary, Unsupported };
+/// The LANGID of one of the configured LAYOUTS (0 for NO_LAYOUT).
+LANGID getLangId(LayoutId layout);
 
-/// Build the LANGIDs from your config (no more MAKELANGID in main code).
-LANGID getLangIdPrimary();
-
-LANGID getLangIdSecondary();
-
-std::string getKLIDPrimary();
-
-std::string getKLIDSecondary();
+/// Its KLID string, for switching to it.
+std::string getKLID(LayoutId layout);
 
 /// Convert a LANGID (e.g. 0x0409) to its 8-digit KLID string ("00000409").
 std::string makeLayoutString(LANGID id);
 
-// ─── Mapping Tables ────────────────────────────────────────────────────
-
-/// Generate Secondary→Primary map from your config’s Primary→Secondary map
-std::unordered_map<wchar_t, wchar_t> makeSecondaryToPrimaryMap();
-
 
 // ─── Clipboard Helpers ─────────────────────────────────────────────────
 
 /// Read CF_UNICODETEXT from the clipboard (or empty on failure).
 std::wstring readClipboard();
 
-/// Wait up to config::CLIPBOARD_POLL_TIMEOUT_MS for the clipboard sequence to change.
+/// Wait up to config::CLIPBOARD_POLL_TIMEOUT_MS for the clipboard sequence to change,
+/// woken by change notifications or by polling per config::CLIPBOARD_WAIT_MODE.
 DWORD waitForClipboardChange(DWORD previousSequence);
 
-/// Send Ctrl+C and return the newly-copied text (or empty if none).
-std::wstring copyAndFetchSelection();
+/// Same, with an explicit timeout.
+DWORD waitForClipboardChange(DWORD previousSequence, std::chrono::milliseconds timeout);
+
+/// Select (Line/All) and send Ctrl+C in one batch, then wait for the copy;
+/// false if the clipboard never changed. Line/All re-copy up to
+/// SELECT_COPY_RETRIES times if the target applied the selection too late.
+bool copySelection(platform::Selection selection = platform::Selection::Current);
+
+/// copySelection(), then return the newly-copied text (or empty if none).
+std::wstring copyAndFetchSelection(platform::Selection selection = platform::Selection::Current);
 
 
 // ─── Input Simulation ──────────────────────────────────────────────────
@@ -61,27 +67,50 @@ void selectCurrentLine();
 
 void selectAllText();
 
-/// Type out a wide string as Unicode input events.
+/// Type out a wide string as Unicode input events, in paced batches.
 void typeText(const std::wstring &text);
 
+/// Put text on the clipboard and send Ctrl+V.
+void pasteText(const std::wstring &text);
+
+/// How a correction was put in place of the selection.
+enum class Replacement { None, Typed, Pasted };
+
+/// Type text, or paste it once it reaches PASTE_THRESHOLD_CHARS.
+Replacement replaceSelection(const std::wstring &text);
+
 
 // ─── Detection & Fixing ─────────────────────────────────────────────────
 
 /// Get the current foreground‐window thread’s keyboard LANGID.
 LANGID activeLang();
 
-/// Apply the mapping table to a string, lowercasing A–Z first.
-std::wstring fix(const std::wstring &src,
-                 const std::unordered_map<wchar_t, wchar_t> &map);
+/// Which of the configured LAYOUTS is active (NO_LAYOUT if none).
+LayoutId detectLayout();
 
-/// Decide which role we’re in (Primary / Secondary / Unsupported).
-LayoutRole detectLayout();
+/// Where text typed in from goes by layout alone: the next layout in LAYOUT_CYCLE.
+Direction cycleDirection(LayoutId from);
 
-/// Transform text based on the role: Primary→Secondary or Secondary→Primary.
-std::wstring transformText(const std::wstring &input, LayoutRole from);
+/// The compiled keymap for a conversion (nullptr unless it converts).
+/// It belongs to the current config snapshot; hold one while using it.
+const KeymapTransducer *keymapFor(Direction direction);
 
-/// Log “orig → transformed” using ROLE_NAME_PRIMARY/SECONDARY from config.
-void logTransformation(const std::wstring &orig, const std::wstring &transformed, LayoutRole from);
+/// The trigram model of every layout, in LAYOUTS order.
+struct LanguageModels {
+    std::vector<NgramModelFile> files;
+    std::vector<const NgramModel *> models; // models[i] views files[i]
+};
+
+/// The models, mapped on first use and again whenever the configured paths
+/// change; nullptr when DIRECTION_MODE is Layout or any can't be loaded.
+const LanguageModels *languageModels();
+
+/// Transform text through the keymap for direction (unchanged if it doesn't convert).
+std::wstring transformText(const std::wstring &input, Direction direction);
+
+/// Log “orig → transformed” using the layout names from config; only the
+/// head of long text reaches the log, so transformed may be just that.
+void logTransformation(std::wstring_view orig, std::wstring_view transformed, Direction direction);
 
 
 // ─── Switching (optional) ──────────────────────────────────────────────
@@ -89,20 +118,48 @@ void logTransformation(const std::wstring &orig, const std::wstring &transformed
 /// Broadcast WM_INPUTLANGCHANGEREQUEST for a given KLID string.
 bool switchKeyboardLayout(std::string_view layoutId);
 
-/// Flip from Primary↔Secondary and log the result.
-bool flipLayout(LayoutRole from);
+/// Switch to the layout direction converts to and log the result.
+bool flipLayout(Direction direction);
+
+
+// ─── Footprint ─────────────────────────────────────────────────────────
+
+/// Log the process's private, shared and committed memory (see
+/// process_memory.h), tagged with when.
+void logFootprint(const wchar_t *when);
+
+/// After a correction under LOW_FOOTPRINT: free the buffers this thread
+/// keeps for the next one and the clipboard's spare snapshot, then
+/// trimProcessMemory(). With MEMORY_BUDGET_KB or DEBUG_MODE the footprint is
+/// measured too, and a budget overrun is logged and counted in the metrics.
+void settleFootprint();
 
 
 // ─── Hotkey & Orchestration ────────────────────────────────────────────
 
-/// Copy→transform→type→(optional flip) for a single clipboard event.
-void handleClipboardText(const std::wstring &selected);
+/// Transform→type/paste→(optional flip) for the text just copied,
+/// converted straight out of the locked clipboard memory without copying
+/// it first.
+Replacement correctCopiedText();
+
+/// Replace a word just typed, and the typedAfter characters after it, with
+/// its conversion and a space, then (optionally) flip. For as-you-type
+/// fixes: one batch from the keyboard hook, nothing copied.
+void retypeWord(std::wstring_view word, Direction direction, std::size_t typedAfter);
 
 
 std::wstring makeHotkeyName(UINT modifiers, UINT vk);
 
 /// Register the hotkey as defined in config (ID, modifiers, virtual key).
+/// Win32 only; defined in platform_win32.cpp.
 bool registerHotkey(int id, UINT modifiers, UINT vk);
 
-/// Run a single cycle: copy, transform, type (and optionally flip).
-void copyAndFlip();
+/// Run a single cycle: (select,) copy, transform, type (and optionally flip),
+/// then put the user's clipboard back.
+void copyAndFlip(platform::Selection selection = platform::Selection::Current);
+
+/// What each registered hotkey does.
+enum class HotkeyAction { Basic, Line, All };
+
+/// Release the hotkey's modifiers, then copyAndFlip() with the action's selection.
+void runHotkeyAction(HotkeyAction action);
@@ -0,0 +1,41 @@
+// this is win32_compat.h
+#pragma once
+
+// The portable core (config, keymaps, pipeline orchestration) only needs a
+// handful of Win32 types and constants. On Windows they come from the real
+// header; elsewhere we define the same names with the same values so the
+// simulated backend, CLI tools and benchmarks build unchanged.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <cstdint>
+
+using WORD = std::uint16_t;
+using UINT = unsigned int;
+using DWORD = std::uint32_t;
+using LANGID = WORD;
+
+constexpr UINT MOD_ALT = 0x0001;
+constexpr UINT MOD_CONTROL = 0x0002;
+constexpr UINT MOD_SHIFT = 0x0004;
+constexpr UINT MOD_WIN = 0x0008;
+
+constexpr UINT CF_UNICODETEXT = 13;
+
+constexpr WORD LANG_ENGLISH = 0x09;
+constexpr WORD LANG_HEBREW = 0x0d;
+constexpr WORD LANG_ARABIC = 0x01;
+constexpr WORD LANG_GREEK = 0x08;
+constexpr WORD LANG_RUSSIAN = 0x19;
+constexpr WORD LANG_UKRAINIAN = 0x22;
+constexpr WORD SUBLANG_DEFAULT = 0x01;
+
+constexpr LANGID MAKELANGID(const WORD primary, const WORD sub) {
+    return static_cast<LANGID>((sub << 10) | primary);
+}
+
+#endif